@@ -14,6 +14,7 @@
 #include <arch/regs.h>
 #include <arch/vm.h>
 #include <kernel/restricted_state.h>
+#include <ktl/algorithm.h>
 
 #define LOCAL_TRACE 0
 
@@ -153,3 +154,11 @@ void RestrictedState::ArchSaveRestrictedIframeState(zx_restricted_state_t& state
 
   __UNREACHABLE;
 }
+
+uintptr_t RestrictedState::ArchSwapPc(zx_restricted_state_t& state, uintptr_t pc) {
+  return ktl::exchange(state.pc, pc);
+}
+
+uintptr_t RestrictedState::ArchSwapPc(iframe_t& frame, uintptr_t pc) {
+  return ktl::exchange(frame.elr, pc);
+}
@@ -14,6 +14,7 @@
 #include <arch/vm.h>
 #include <kernel/restricted_state.h>
 #include <kernel/thread.h>
+#include <ktl/algorithm.h>
 
 #define LOCAL_TRACE 0
 
@@ -142,3 +143,11 @@ void RestrictedState::ArchSaveRestrictedExceptionState(zx_restricted_state_t& st
   DEBUG_ASSERT(status == ZX_OK);
   state = regs;
 }
+
+uintptr_t RestrictedState::ArchSwapPc(zx_restricted_state_t& state, uintptr_t pc) {
+  return ktl::exchange(state.pc, pc);
+}
+
+uintptr_t RestrictedState::ArchSwapPc(iframe_t& frame, uintptr_t pc) {
+  return ktl::exchange(frame.regs.pc, pc);
+}
@@ -18,6 +18,7 @@
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <kernel/restricted.h>
+#include <ktl/algorithm.h>
 #include <vm/vm_address_region.h>
 
 #define LOCAL_TRACE 0
@@ -286,3 +287,15 @@ void RestrictedState::ArchSaveRestrictedIframeState(zx_restricted_state_t& state
 
   __UNREACHABLE;
 }
+
+uintptr_t RestrictedState::ArchSwapPc(zx_restricted_state_t& state, uintptr_t pc) {
+  return ktl::exchange(state.ip, pc);
+}
+
+uintptr_t RestrictedState::ArchSwapPc(iframe_t& frame, uintptr_t pc) {
+  return ktl::exchange(frame.ip, pc);
+}
+
+uintptr_t RestrictedState::ArchSwapPc(syscall_regs_t& regs, uintptr_t pc) {
+  return ktl::exchange(regs.rip, pc);
+}
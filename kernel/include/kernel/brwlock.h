@@ -14,6 +14,7 @@
 #include <stdint.h>
 
 #include <fbl/canary.h>
+#include <kernel/lock_stats.h>
 #include <kernel/lock_trace.h>
 #include <kernel/lock_validation_guard.h>
 #include <kernel/owned_wait_queue.h>
@@ -92,7 +93,7 @@ static_assert(sizeof(BrwLockState<BrwLockEnablePi::No>) == 8,
 // creates an additional restriction that readers must not take any additional
 // locks or otherwise block whilst holding the read lock.
 template <BrwLockEnablePi PI>
-class TA_CAP("mutex") BrwLock {
+class TA_CAP("mutex") BrwLock : public lock_stats::ClassStatsStorage<> {
  public:
   BrwLock() = default;
   ~BrwLock();
@@ -208,6 +209,20 @@ class TA_CAP("mutex") BrwLock {
     return static_cast<uint32_t>(state & kBrwLockReaderMask);
   }
 
+  // Returns true if the lock is held for write by a thread which is known to
+  // not be running.  Only PI locks track their writer, so this is always false
+  // for non-PI locks.
+  bool WriterNotRunning(uint64_t state) {
+    if constexpr (PI == BrwLockEnablePi::Yes) {
+      if (StateHasWriter(state)) {
+        const Thread* const writer =
+            ktl::atomic_ref(state_.writer_).load(ktl::memory_order_relaxed);
+        return (writer != nullptr) && !Scheduler::PeekIsThreadRunning(writer);
+      }
+    }
+    return false;
+  }
+
   void ContendedReadAcquire() TA_EXCL(chainlock_transaction_token);
   void ContendedWriteAcquire() TA_EXCL(chainlock_transaction_token);
   void ContendedReadUpgrade() TA_EXCL(chainlock_transaction_token);
@@ -280,6 +295,7 @@ class TA_CAP("mutex") BrwLock {
                      current_thread);
       }
     }
+    NoteAcquired();
   }
 
   fbl::Canary<fbl::magic("RWLK")> canary_;
@@ -73,7 +73,17 @@ class Event {
     return WaitWorker(Deadline::no_slack(deadline), interruptible, 0);
   }
 
-  void Signal(zx_status_t wait_result = ZX_OK) TA_EXCL(chainlock_transaction_token);
+  void Signal(zx_status_t wait_result = ZX_OK) TA_EXCL(chainlock_transaction_token) {
+    SignalWorker(wait_result, false);
+  }
+
+  // Same as Signal(), but hints to the scheduler that the signaling thread is
+  // handing off directly to the woken thread and will itself block shortly, so
+  // the woken thread may be run on the signaling thread's CPU.
+  void SignalSync(zx_status_t wait_result = ZX_OK) TA_EXCL(chainlock_transaction_token) {
+    SignalWorker(wait_result, true);
+  }
+
   zx_status_t Unsignal();
   bool is_signaled() const { return result_.load(ktl::memory_order_relaxed) != kNotSignaled; }
 
@@ -90,6 +100,7 @@ class Event {
  private:
   zx_status_t WaitWorker(const Deadline& deadline, Interruptible interruptible, uint signal_mask)
       TA_EXCL(chainlock_transaction_token);
+  void SignalWorker(zx_status_t wait_result, bool sync) TA_EXCL(chainlock_transaction_token);
 
   static constexpr uint32_t kMagic = fbl::magic("evnt");
   uint32_t magic_;
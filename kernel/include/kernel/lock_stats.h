@@ -0,0 +1,317 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#ifndef ZIRCON_KERNEL_INCLUDE_KERNEL_LOCK_STATS_H_
+#define ZIRCON_KERNEL_INCLUDE_KERNEL_LOCK_STATS_H_
+
+#include <lib/affine/ratio.h>
+#include <lib/relaxed_atomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <zircon/time.h>
+#include <zircon/types.h>
+
+#include <kernel/lockdep.h>
+#include <platform/timer.h>
+
+#if LOCK_STATS_ENABLED
+constexpr bool kLockStatsEnabled = true;
+#else
+constexpr bool kLockStatsEnabled = false;
+#endif
+
+// Per lock class contention statistics and adaptive spin tuning.
+//
+// When enabled, every Mutex, CriticalMutex and BrwLock instrumented with
+// lockdep is associated with a ClassStats record shared by all of the locks of
+// the same lockdep lock class.  The record accumulates the outcome of each
+// contended acquisition's spin phase, and uses the recent history of how long
+// spinners had to wait before the lock was released to size the spin budget of
+// the next contended acquisition of any lock in the class.
+//
+// Lock stats also maintain a contention profile for every lock class: a
+// histogram of how long contended acquisitions waited for the lock, a histogram
+// of how long the lock was held, and the call sites which contended for it most
+// often.  Profile samples are recorded into per-CPU buffers, which are only
+// aggregated when read by the "lockdep profile" console command or through
+// zx_object_get_info(ZX_INFO_LOCK_CONTENTION).
+//
+// Lock stats require lockdep lock class metadata.  Enabling lock stats in the
+// build (see |lock_stats_enabled| in params.gni) also enables lockdep metadata.
+namespace lock_stats {
+
+// The maximum number of lock classes which can be tracked.
+constexpr size_t kMaxLockClasses = 512;
+
+// Profile histograms have kNumHistogramBuckets log2 buckets.  Bucket 0 counts
+// durations shorter than 2^kHistogramShift ns, bucket N counts durations in
+// [2^(kHistogramShift + N - 1), 2^(kHistogramShift + N)) ns, and the last
+// bucket also counts everything longer.
+constexpr size_t kNumHistogramBuckets = 16;
+constexpr uint32_t kHistogramShift = 10;
+
+// The number of top contending call sites tracked per lock class.
+constexpr size_t kNumCallSites = 4;
+
+// Converts a tick count to a duration.
+inline zx_duration_t TicksToDuration(zx_ticks_t ticks) {
+  return timer_get_ticks_to_time_ratio().Scale(ticks);
+}
+
+// The reason a contended acquisition stopped spinning.
+enum class SpinOutcome : uint8_t {
+  // The lock was acquired while spinning.
+  kAcquired,
+  // The spin budget expired before the lock was released.
+  kBudgetExhausted,
+  // The lock owner was observed to not be running, so spinning could not make
+  // progress.
+  kOwnerNotRunning,
+  // Other threads were already blocked on the lock.
+  kWaiters,
+};
+
+class ClassStats {
+ public:
+  // The smallest spin budget the adaptive policy will select.  Even locks which
+  // are usually held for a long time are spun on briefly, since the cost of a
+  // short spin is small compared to the cost of blocking and being woken.
+  static constexpr zx_duration_t kMinSpinBudget = ZX_USEC(2);
+
+  constexpr ClassStats() = default;
+
+  ClassStats(const ClassStats&) = delete;
+  ClassStats& operator=(const ClassStats&) = delete;
+
+  // Returns the spin budget for the next contended acquisition of a lock in
+  // this class, never more than |max_duration|.  Until the class has some
+  // history, |max_duration| is returned.
+  zx_duration_t SpinBudget(zx_duration_t max_duration) const {
+    const zx_duration_t budget = spin_budget_.load();
+    return (budget == 0 || budget > max_duration) ? max_duration : budget;
+  }
+
+  // Records the outcome of the spin phase of a contended acquisition which
+  // spun for |spin_duration|.  If |adapt| is true, the spin used the class's
+  // adaptive budget, which is then adapted to the outcome without ever growing
+  // beyond the caller's ceiling |max_duration|.
+  void RecordSpin(SpinOutcome outcome, zx_duration_t spin_duration, zx_duration_t max_duration,
+                  bool adapt);
+
+  // Accessors used when reporting.
+  lockdep::LockClassId lock_class_id() const { return lock_class_id_.load(); }
+  uint64_t contended_count() const { return contended_count_.load(); }
+  uint64_t spin_acquired_count() const { return spin_acquired_count_.load(); }
+  uint64_t budget_exhausted_count() const { return budget_exhausted_count_.load(); }
+  uint64_t owner_not_running_count() const { return owner_not_running_count_.load(); }
+  uint64_t waiters_count() const { return waiters_count_.load(); }
+  zx_duration_t total_spin_time() const { return total_spin_time_.load(); }
+  zx_duration_t average_spin_acquire_time() const { return average_spin_acquire_time_.load(); }
+  zx_duration_t spin_budget() const { return spin_budget_.load(); }
+
+ private:
+  friend ClassStats* GetClassStats(lockdep::LockClassId lcid);
+
+  // The lock class this record belongs to.  Written exactly once, when the
+  // record is claimed by GetClassStats.
+  RelaxedAtomic<lockdep::LockClassId> lock_class_id_{lockdep::kInvalidLockClassId};
+
+  RelaxedAtomic<uint64_t> contended_count_{0};
+  RelaxedAtomic<uint64_t> spin_acquired_count_{0};
+  RelaxedAtomic<uint64_t> budget_exhausted_count_{0};
+  RelaxedAtomic<uint64_t> owner_not_running_count_{0};
+  RelaxedAtomic<uint64_t> waiters_count_{0};
+  RelaxedAtomic<zx_duration_t> total_spin_time_{0};
+
+  // A moving average of how long a spinner had to wait for the lock to be
+  // released in the cases where spinning succeeded.  This approximates the
+  // remaining hold time observed by contending threads.
+  RelaxedAtomic<zx_duration_t> average_spin_acquire_time_{0};
+
+  // The current adaptive spin budget, or zero if no history has been recorded
+  // yet.  Updates are racy read-modify-write sequences; losing an occasional
+  // update only slows adaptation slightly.
+  RelaxedAtomic<zx_duration_t> spin_budget_{0};
+};
+
+// Returns the stats record for lock class |lcid|, claiming a new record if
+// this is the first time the class has been seen.  Returns nullptr if |lcid| is
+// invalid or if the table of records is full.
+ClassStats* GetClassStats(lockdep::LockClassId lcid);
+
+// Prints the statistics of up to |max_classes| lock classes, ordered by total
+// spin time, to |f|.
+void Dump(FILE* f, size_t max_classes);
+
+// Tracks the spin phase of a single contended acquisition.  Selects the spin
+// budget when the spin phase starts, and records the outcome in the lock's
+// class stats (if any) when it ends.
+class SpinPhase {
+ public:
+  // |max_duration| is the caller's spin limit.  If |adaptive| is true, the
+  // class's adaptive budget is used instead, bounded by |max_duration|.
+  SpinPhase(ClassStats* stats, zx_duration_t max_duration, bool adaptive, zx_ticks_t start_ticks)
+      : stats_(stats),
+        max_duration_(max_duration),
+        budget_((stats != nullptr && adaptive) ? stats->SpinBudget(max_duration) : max_duration),
+        adaptive_(adaptive),
+        start_ticks_(start_ticks) {}
+
+  SpinPhase(const SpinPhase&) = delete;
+  SpinPhase& operator=(const SpinPhase&) = delete;
+
+  // The amount of time to spin for.
+  zx_duration_t budget() const { return budget_; }
+
+  // Ends the spin phase, recording |outcome|.  Must be called exactly once.
+  // Only adaptive phases move the class's budget; a spin bounded by a limit
+  // the caller chose says nothing about what the budget should be.
+  void Finish(SpinOutcome outcome) {
+    if (stats_ != nullptr) {
+      stats_->RecordSpin(outcome, TicksToDuration(current_ticks() - start_ticks_), max_duration_,
+                         adaptive_);
+    }
+  }
+
+ private:
+  ClassStats* const stats_;
+  const zx_duration_t max_duration_;
+  const zx_duration_t budget_;
+  const bool adaptive_;
+  const zx_ticks_t start_ticks_;
+};
+
+namespace internal {
+extern RelaxedAtomic<bool> gProfilingEnabled;
+}  // namespace internal
+
+// Returns true if contention profile samples are currently being recorded.
+inline bool ProfilingEnabled() { return internal::gProfilingEnabled.load(); }
+
+// Starts or stops recording contention profile samples.  Recording starts
+// automatically once the per-CPU buffers have been allocated during boot.
+void SetProfilingEnabled(bool enabled);
+
+// Discards all recorded contention profile samples.
+void ResetProfiles();
+
+// Records that a contended acquisition from |caller| waited |wait| for a lock
+// in the class of |stats|.
+void RecordWait(ClassStats* stats, zx_duration_t wait, uintptr_t caller);
+
+// Records that a lock in the class of |stats| was held for |hold|.
+void RecordHold(ClassStats* stats, zx_duration_t hold);
+
+// A contending call site and the number of contended acquisitions made from it.
+// |pc| is relative to the start of the kernel image.
+struct CallSite {
+  uintptr_t pc;
+  uint64_t count;
+};
+
+// The contention profile of a lock class, aggregated across all CPUs.
+struct ClassProfile {
+  lockdep::LockClassId lock_class_id;
+  uint64_t wait_count;
+  zx_duration_t total_wait_time;
+  uint64_t hold_count;
+  zx_duration_t total_hold_time;
+  uint64_t wait_histogram[kNumHistogramBuckets];
+  uint64_t hold_histogram[kNumHistogramBuckets];
+  // Ordered by decreasing count.  Unused entries have a count of zero.
+  CallSite call_sites[kNumCallSites];
+};
+
+// Aggregates the profile in slot |index| of the lock class table, which must
+// be less than kMaxLockClasses, into |profile|.  Returns false if the slot is
+// unused or has no samples.
+bool GetClassProfile(size_t index, ClassProfile* profile);
+
+// Prints the contention profiles of up to |max_classes| lock classes, ordered
+// by total wait time, to |f|.
+void DumpProfiles(FILE* f, size_t max_classes);
+
+// Records the duration of a contended acquisition in the profile when it goes
+// out of scope.  Profiling is decided when the recorder is constructed, and
+// costs nothing when it is off, or when the lock has no class stats.
+class WaitRecorder {
+ public:
+  WaitRecorder(ClassStats* stats, void* caller)
+      : stats_((stats != nullptr && ProfilingEnabled()) ? stats : nullptr),
+        caller_(reinterpret_cast<uintptr_t>(caller)),
+        start_ticks_(stats_ != nullptr ? current_ticks() : 0) {}
+
+  ~WaitRecorder() {
+    if (stats_ != nullptr) {
+      RecordWait(stats_, TicksToDuration(current_ticks() - start_ticks_), caller_);
+    }
+  }
+
+  WaitRecorder(const WaitRecorder&) = delete;
+  WaitRecorder& operator=(const WaitRecorder&) = delete;
+
+ private:
+  ClassStats* const stats_;
+  const uintptr_t caller_;
+  const zx_ticks_t start_ticks_;
+};
+
+// Storage for a lock's class stats pointer and the time it was last acquired.
+// Locks which support lock stats inherit from this class.  When lock stats are
+// disabled this is empty, class_stats() is a constant nullptr and the
+// NoteAcquired/NoteReleasing hooks are empty, so all lock stats code folds
+// away.
+template <bool Enabled = kLockStatsEnabled>
+class ClassStatsStorage {
+ public:
+  constexpr void SetLockClassId(lockdep::LockClassId lcid) {}
+
+ protected:
+  constexpr ClassStatsStorage() = default;
+  constexpr ClassStats* class_stats() const { return nullptr; }
+  constexpr void NoteAcquired() {}
+  constexpr void NoteReleasing() {}
+};
+
+template <>
+class ClassStatsStorage<true> {
+ public:
+  void SetLockClassId(lockdep::LockClassId lcid) {
+    if (class_stats_ == nullptr) {
+      class_stats_ = GetClassStats(lcid);
+    }
+  }
+
+ protected:
+  constexpr ClassStatsStorage() = default;
+  ClassStats* class_stats() const { return class_stats_; }
+
+  // Called by the lock's new exclusive owner once it has been acquired.
+  void NoteAcquired() {
+    if (class_stats_ != nullptr && ProfilingEnabled()) {
+      acquired_ticks_ = current_ticks();
+    }
+  }
+
+  // Called by the lock's exclusive owner just before it is released.
+  void NoteReleasing() {
+    if (acquired_ticks_ != 0) {
+      RecordHold(class_stats_, TicksToDuration(current_ticks() - acquired_ticks_));
+      acquired_ticks_ = 0;
+    }
+  }
+
+ private:
+  ClassStats* class_stats_{nullptr};
+
+  // Only accessed by the lock's exclusive owner.  Zero if the current hold is
+  // not being profiled.
+  zx_ticks_t acquired_ticks_{0};
+};
+
+}  // namespace lock_stats
+
+#endif  // ZIRCON_KERNEL_INCLUDE_KERNEL_LOCK_STATS_H_
@@ -19,6 +19,7 @@
 
 #include <fbl/canary.h>
 #include <fbl/macros.h>
+#include <kernel/lock_stats.h>
 #include <kernel/lock_validation_guard.h>
 #include <kernel/lockdep.h>
 #include <kernel/owned_wait_queue.h>
@@ -30,7 +31,8 @@
 //
 class TA_CAP("mutex") Mutex
     : public spin_tracing::LockNameStorage<spin_tracing::LockType::kMutex,
-                                           kSchedulerLockSpinTracingEnabled> {
+                                           kSchedulerLockSpinTracingEnabled>,
+      public lock_stats::ClassStatsStorage<> {
  public:
   constexpr Mutex() = default;
   explicit Mutex(const fxt::InternedString& name_stringref)
@@ -42,6 +44,11 @@ class TA_CAP("mutex") Mutex
   DISALLOW_COPY_ASSIGN_AND_MOVE(Mutex);
 
   // The maximum duration to spin before falling back to blocking.
+  //
+  // When lock stats are enabled, acquisitions using the default duration spin
+  // for an adaptive budget, chosen per lock class from the recent history of
+  // contended acquisitions, which never exceeds this value.  Acquisitions which
+  // explicitly request a different duration always spin for that duration.
   // TODO(https://fxbug.dev/42109976): Decide how to make this configurable per device/platform
   // and describe how to optimize this value.
   static constexpr zx_duration_t SPIN_MAX_DURATION = ZX_USEC(150);
@@ -86,6 +93,13 @@ class TA_CAP("mutex") Mutex
   // Mutex and have yet to enter a blocking phase.
   bool IsContested() const { return val() & STATE_FLAG_CONTESTED; }
 
+  // Called by lockdep with the id of the lock class this mutex belongs to.
+  // Both the spin tracing name storage and the lock stats storage want it.
+  void SetLockClassId(lockdep::LockClassId lcid) {
+    LockNameStorage::SetLockClassId(lcid);
+    ClassStatsStorage::SetLockClassId(lcid);
+  }
+
  protected:
   // TimesliceExtension is used to control whether a timeslice extension will be
   // set and if so, what value will be used.
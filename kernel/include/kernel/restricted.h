@@ -43,6 +43,20 @@ void RedirectRestrictedExceptionToNormalMode(RestrictedState* rs);
 [[noreturn]] void RestrictedLeaveIframe(const iframe_t* iframe, zx_restricted_reason_t reason);
 [[noreturn]] void RestrictedLeaveSyscall(const syscall_regs_t* regs, zx_restricted_reason_t reason);
 
+// Delivers an upcall to the current thread, which must be about to return to restricted mode with
+// the register state in |iframe| or |regs|: the thread is redirected to the handler registered in
+// its upcall mailbox, and remains in restricted mode. Nothing is done if an upcall is already
+// active.
+//
+// Returns false, without changing the register state, if no valid handler is registered. The
+// caller is then expected to treat the upcall as a kick.
+//
+// Interrupts must be disabled.
+bool RestrictedDeliverUpcall(iframe_t* iframe);
+#if defined(__x86_64__)
+bool RestrictedDeliverUpcall(syscall_regs_t* regs);
+#endif
+
 // Dispatched directly from arch-specific syscall handler. Called after saving state
 // on the stack, but before trying to dispatch as a zircon syscall.
 extern "C" [[noreturn]] void syscall_from_restricted(const syscall_regs_t* regs);
@@ -49,6 +49,10 @@ class RestrictedState {
     return reinterpret_cast<T*>(state_mapping_ptr_);
   }
   zx_restricted_state_t* state_ptr() const { return state_ptr_as<zx_restricted_state_t>(); }
+  zx_restricted_upcall_mailbox_t* upcall_mailbox_ptr() const {
+    return reinterpret_cast<zx_restricted_upcall_mailbox_t*>(
+        static_cast<char*>(state_mapping_ptr_) + ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET);
+  }
 
   fbl::RefPtr<VmObjectPaged> vmo() const;
 
@@ -95,6 +99,14 @@ class RestrictedState {
   [[noreturn]] static void ArchEnterFull(const ArchSavedNormalState& arch_state,
                                          uintptr_t vector_table, uintptr_t context, uint64_t code);
 
+  // Set the program counter restricted mode resumes at, from a copy of the restricted state, an
+  // interrupt frame, or syscall registers. Returns the previous program counter.
+  static uintptr_t ArchSwapPc(zx_restricted_state_t& state, uintptr_t pc);
+  static uintptr_t ArchSwapPc(iframe_t& frame, uintptr_t pc);
+#if defined(__x86_64__)
+  static uintptr_t ArchSwapPc(syscall_regs_t& regs, uintptr_t pc);
+#endif
+
   // Dump the architecturally specific state out of the restricted mode state
   static void ArchDump(const zx_restricted_state_t& state);
 
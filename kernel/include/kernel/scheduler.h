@@ -210,10 +210,27 @@ class Scheduler {
   static void Unblock(Thread* thread) TA_REQ(chainlock_transaction_token)
       TA_REL(thread->get_lock());
 
+  // Hints which may be passed to Unblock describing the relationship between
+  // the thread performing the wakeup (the waker) and the threads being woken.
+  enum class UnblockHint {
+    // No relationship is known; a target CPU is chosen purely on the basis of
+    // cache affinity and load.
+    Default,
+
+    // The wakeup is synchronous: the waker is handing a result directly to the
+    // woken thread (for example, a channel reply to a thread blocked in
+    // zx_channel_call) and is expected to block or go back to waiting shortly.
+    // When the waker's CPU is permitted and lightly loaded, the woken thread is
+    // placed on the waker's CPU instead of being sent to another one.  This
+    // avoids a reschedule IPI and keeps the message data cache hot.
+    Sync,
+  };
+
   // Unblock list expects to receive a list of threads, all of whose
   // locks are currently held.  It will drop each thread's lock after
   // successfully assigning it to a scheduler.
-  static void Unblock(Thread::UnblockList thread_list) TA_REQ(chainlock_transaction_token);
+  static void Unblock(Thread::UnblockList thread_list, UnblockHint hint = UnblockHint::Default)
+      TA_REQ(chainlock_transaction_token);
 
   // UnblockIdle is used in the process of creation of the idle thread.  It
   // simply asserts that the thread is (in fact) flagged as the idle thread, and
@@ -389,6 +406,17 @@ class Scheduler {
   static cpu_mask_t PeekIdleMask() { return idle_schedulers_.load(ktl::memory_order_relaxed); }
   static bool PeekIsIdle(cpu_num_t cpu) { return (PeekIdleMask() & cpu_num_to_mask(cpu)) != 0; }
 
+  // Peek at whether |thread| is the thread currently running on |cpu|, or on
+  // any active CPU in the second form.
+  //
+  // Note that these are just lockless atomic loads and pointer comparisons;
+  // |thread| is never dereferenced, so it is safe to pass a pointer to a thread
+  // which may have exited.  The answer is a hint which may be stale by the time
+  // it is returned.  It is intended for heuristics such as deciding whether it
+  // is worth continuing to spin on a lock owned by |thread|.
+  static bool PeekIsActiveThread(cpu_num_t cpu, const Thread* thread);
+  static bool PeekIsThreadRunning(const Thread* thread);
+
  private:
   // fwd decl of a helper class used for PI Join/Split operations
   template <typename T>
@@ -489,6 +517,12 @@ class Scheduler {
     // while running on its last cpu, and now the CPU chosen must be as compatible
     // with the thread's soft affinity mask as possible.
     Migrating,
+
+    // The thread is unblocking as the result of a synchronous wakeup (see
+    // UnblockHint::Sync).  The same rules as Unblocking apply, but the current
+    // CPU is preferred over the thread's last CPU when it is available to the
+    // thread and its queue is short enough that the thread will run promptly.
+    SyncUnblocking,
   };
 
   // Returns the current system time as a SchedTime value.
@@ -1113,6 +1147,7 @@ class Scheduler {
   // cache performance.
   RelaxedAtomic<SchedDuration> exported_total_expected_runtime_ns_{SchedNs(0)};
   RelaxedAtomic<SchedUtilization> exported_total_deadline_utilization_{SchedUtilization{0}};
+  RelaxedAtomic<const Thread*> exported_active_thread_{nullptr};
 };
 
 #endif  // ZIRCON_KERNEL_INCLUDE_KERNEL_SCHEDULER_H_
@@ -17,6 +17,7 @@
 #include <arch/interrupt.h>
 #include <arch/spinlock.h>
 #include <fbl/enum_bits.h>
+#include <kernel/lock_stats.h>
 #include <kernel/lockdep.h>
 #include <kernel/spin_tracing_config.h>
 #include <kernel/spin_tracing_storage.h>
@@ -35,7 +36,8 @@ FBL_ENABLE_ENUM_BITS(SpinLockOptions)
 template <SpinLockOptions Options>
 class TA_CAP("mutex") SpinLockBase
     : public spin_tracing::LockNameStorage<spin_tracing::LockType::kSpinlock,
-                                           kSchedulerLockSpinTracingEnabled> {
+                                           kSchedulerLockSpinTracingEnabled>,
+      public lock_stats::ClassStatsStorage<> {
  public:
   constexpr SpinLockBase() = default;
   explicit SpinLockBase(const fxt::InternedString& lock_name_string_ref)
@@ -48,12 +50,7 @@ class TA_CAP("mutex") SpinLockBase
     static_assert(!kIsMonitored, "spinlock is monitored, use Acquire(const char* name) instead");
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(!arch_spin_lock_held(&spinlock_));
-
-    if constexpr (kIsTraceDisabled) {
-      arch_spin_lock_non_instrumented(&spinlock_);
-    } else {
-      arch_spin_lock_trace_instrumented(&spinlock_, this->encoded_lock_id());
-    }
+    AcquireInternal();
   }
   // See |Acquire| above.
   //
@@ -64,11 +61,7 @@ class TA_CAP("mutex") SpinLockBase
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(!arch_spin_lock_held(&spinlock_));
     LOCKUP_BEGIN(name);
-    if constexpr (kIsTraceDisabled) {
-      arch_spin_lock_non_instrumented(&spinlock_);
-    } else {
-      arch_spin_lock_trace_instrumented(&spinlock_, this->encoded_lock_id());
-    }
+    AcquireInternal();
   }
 
   // Attempt to acquire the spinlock without waiting.
@@ -84,7 +77,11 @@ class TA_CAP("mutex") SpinLockBase
   // thread during the attempt.
   bool TryAcquire() TA_TRY_ACQ(false) {
     static_assert(!kIsMonitored, "spinlock is monitored, use TryAcquire(const char* name) instead");
-    return arch_spin_trylock(&spinlock_);
+    bool failed_to_acquire = arch_spin_trylock(&spinlock_);
+    if (!failed_to_acquire) {
+      NoteAcquired();
+    }
+    return failed_to_acquire;
   }
   // See |TryAcquire| above.
   bool TryAcquire(const char* name) TA_TRY_ACQ(false) {
@@ -92,6 +89,7 @@ class TA_CAP("mutex") SpinLockBase
     bool failed_to_acquire = arch_spin_trylock(&spinlock_);
     if (!failed_to_acquire) {
       LOCKUP_BEGIN(name);
+      NoteAcquired();
     }
     return failed_to_acquire;
   }
@@ -100,6 +98,7 @@ class TA_CAP("mutex") SpinLockBase
   //
   // Interrupts must already be disabled.
   void Release() TA_REL() {
+    NoteReleasing();
     arch_spin_unlock(&spinlock_);
     if constexpr (kIsMonitored) {
       LOCKUP_END();
@@ -136,6 +135,13 @@ class TA_CAP("mutex") SpinLockBase
   // Returns which cpu currently holds the spin lock, or INVALID_CPU if not held.
   cpu_num_t HolderCpu() const { return arch_spin_lock_holder_cpu(&spinlock_); }
 
+  // Called by lockdep with the id of the lock class this spinlock belongs to.
+  // Both the spin tracing name storage and the lock stats storage want it.
+  void SetLockClassId(lockdep::LockClassId lcid) {
+    LockNameStorage::SetLockClassId(lcid);
+    ClassStatsStorage::SetLockClassId(lcid);
+  }
+
   // SpinLocks cannot be copied or moved.
   SpinLockBase(const SpinLockBase& am) = delete;
   SpinLockBase& operator=(const SpinLockBase& am) = delete;
@@ -143,6 +149,36 @@ class TA_CAP("mutex") SpinLockBase
   SpinLockBase& operator=(SpinLockBase&& c) = delete;
 
  private:
+  void AcquireInternal() {
+    // When the lock is being profiled, try to acquire it first so that the
+    // wait for a contended lock can be measured out of line.
+    if constexpr (kLockStatsEnabled) {
+      if (class_stats() != nullptr && lock_stats::ProfilingEnabled()) {
+        if (arch_spin_trylock(&spinlock_)) {
+          AcquireContended();
+        }
+        NoteAcquired();
+        return;
+      }
+    }
+    SpinAcquire();
+  }
+
+  // Not inlined, so that the return address identifies the code acquiring the
+  // lock.
+  __NO_INLINE void AcquireContended() {
+    lock_stats::WaitRecorder wait_recorder{class_stats(), __builtin_return_address(0)};
+    SpinAcquire();
+  }
+
+  void SpinAcquire() {
+    if constexpr (kIsTraceDisabled) {
+      arch_spin_lock_non_instrumented(&spinlock_);
+    } else {
+      arch_spin_lock_trace_instrumented(&spinlock_, this->encoded_lock_id());
+    }
+  }
+
   static constexpr bool kIsMonitored =
       (Options & SpinLockOptions::Monitored) != SpinLockOptions::None;
 
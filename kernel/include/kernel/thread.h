@@ -558,12 +558,14 @@ typedef void (*thread_trampoline_routine)() __NO_RETURN;
 #define THREAD_FLAG_IDLE                     (1 << 2)
 #define THREAD_FLAG_VCPU                     (1 << 3)
 #define THREAD_FLAG_RESTRICTED_KICK_PENDING  (1 << 4)
+#define THREAD_FLAG_RESTRICTED_UPCALL_PENDING (1 << 5)
 
 #define THREAD_SIGNAL_KILL                   (1 << 0)
 #define THREAD_SIGNAL_SUSPEND                (1 << 1)
 #define THREAD_SIGNAL_POLICY_EXCEPTION       (1 << 2)
 #define THREAD_SIGNAL_RESTRICTED_KICK        (1 << 3)
 #define THREAD_SIGNAL_SAMPLE_STACK           (1 << 4)
+#define THREAD_SIGNAL_RESTRICTED_UPCALL      (1 << 5)
 // clang-format on
 
 // thread priority
@@ -1213,6 +1215,7 @@ struct Thread {
   zx_status_t Suspend() { return SuspendOrKillInternal(SuspendOrKillOp::Suspend); }
   void Forget();
   zx_status_t RestrictedKick();
+  zx_status_t RestrictedUpcall();
   // Marks a thread as detached, in this state its memory will be released once
   // execution is done.
   zx_status_t Detach();
@@ -1413,6 +1416,9 @@ struct Thread {
     // Must be called with interrupts disabled.
     [[nodiscard]] static bool CheckForRestrictedKick();
 
+    // Same as CheckForRestrictedKick, for restricted upcalls.
+    [[nodiscard]] static bool CheckForRestrictedUpcall();
+
     static RestrictedState* restricted_state() {
       return Thread::Current::Get()->restricted_state();
     }
@@ -1743,6 +1749,10 @@ struct Thread {
   // Common implementation of Suspend and Kill.
   zx_status_t SuspendOrKillInternal(SuspendOrKillOp op) TA_EXCL(chainlock_transaction_token);
 
+  // Common implementation of RestrictedKick and RestrictedUpcall: asserts |signal| on the thread,
+  // and makes sure it processes it soon if it is running on another CPU.
+  zx_status_t RaiseRestrictedSignal(uint32_t signal);
+
   // Returns true if it decides to kill the thread, which must be the
   // current thread. The thread_lock must be held when calling this
   // function.
@@ -1762,6 +1772,16 @@ struct Thread {
       flags_ &= ~THREAD_FLAG_RESTRICTED_KICK_PENDING;
     }
   }
+  bool restricted_upcall_pending() const {
+    return (flags_ & THREAD_FLAG_RESTRICTED_UPCALL_PENDING) != 0;
+  }
+  void set_restricted_upcall_pending(bool value) {
+    if (value) {
+      flags_ |= THREAD_FLAG_RESTRICTED_UPCALL_PENDING;
+    } else {
+      flags_ &= ~THREAD_FLAG_RESTRICTED_UPCALL_PENDING;
+    }
+  }
 
   __NO_RETURN void ExitLocked(int retcode) TA_REQ(lock_);
 
@@ -17,6 +17,7 @@
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 
+#include <fbl/ref_ptr.h>
 #include <kernel/thread.h>
 #include <ktl/atomic.h>
 
@@ -884,6 +885,11 @@ inline void fxt_flow_end(const fxt::InternedCategory& category, uint64_t timesta
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
 
+// Rewind the trace and start streaming it into |vmo| (see
+// KTRACE_ACTION_START_STREAMING and KTraceState::StartStreaming).
+zx_status_t ktrace_start_streaming(uint32_t groups, fbl::RefPtr<VmObject> vmo,
+                                   fbl::RefPtr<EventDispatcher> event, uint32_t watermark);
+
 void ktrace_report_live_threads();
 void ktrace_report_live_processes();
 
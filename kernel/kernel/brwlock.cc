@@ -266,11 +266,13 @@ void BrwLock<PI>::ContendedReadAcquire() {
   zx_ticks_t now_ticks = current_ticks();
   Thread* const current_thread = Thread::Current::Get();
   ContentionTimer timer(current_thread, now_ticks);
+  lock_stats::WaitRecorder wait_recorder{class_stats(), __builtin_return_address(0)};
 
-  const zx_duration_t spin_max_duration = Mutex::SPIN_MAX_DURATION;
+  lock_stats::SpinPhase spin_phase{class_stats(), Mutex::SPIN_MAX_DURATION, true, now_ticks};
+  lock_stats::SpinOutcome spin_outcome = lock_stats::SpinOutcome::kBudgetExhausted;
   const affine::Ratio time_to_ticks = timer_get_ticks_to_time_ratio().Inverse();
   const zx_ticks_t spin_until_ticks =
-      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_max_duration));
+      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_phase.budget()));
 
   do {
     const uint64_t state = ktl::atomic_ref(state_.state_).load(ktl::memory_order_acquire);
@@ -278,20 +280,31 @@ void BrwLock<PI>::ContendedReadAcquire() {
     // If there are any waiters, implying another thread exhausted its spin phase on the same lock,
     // break out of the spin phase early.
     if (StateHasWaiters(state)) {
+      spin_outcome = lock_stats::SpinOutcome::kWaiters;
       break;
     }
 
     // If there are only readers now, return holding the lock for read, leaving the optimistic
     // reader count in place.
     if (!StateHasWriter(state)) {
+      spin_phase.Finish(lock_stats::SpinOutcome::kAcquired);
       return;
     }
 
+    // If the writer is not running it cannot release the lock until it has been scheduled again,
+    // so there is no point in spinning.
+    if (WriterNotRunning(state)) {
+      spin_outcome = lock_stats::SpinOutcome::kOwnerNotRunning;
+      break;
+    }
+
     // Give the arch a chance to relax the CPU.
     arch::Yield();
     now_ticks = current_ticks();
   } while (now_ticks < spin_until_ticks);
 
+  spin_phase.Finish(spin_outcome);
+
   // Enter our wait queue's lock and figure out what to do next.  We don't really know what we need
   // to do yet, so we need to be prepared for needing to back off and try again.
   ChainLockTransactionEagerReschedDisableAndIrqSave clt{
@@ -398,23 +411,34 @@ void BrwLock<PI>::ContendedWriteAcquire() {
   zx_ticks_t now_ticks = current_ticks();
   Thread* current_thread = Thread::Current::Get();
   ContentionTimer timer(current_thread, now_ticks);
+  lock_stats::WaitRecorder wait_recorder{class_stats(), __builtin_return_address(0)};
 
-  const zx_duration_t spin_max_duration = Mutex::SPIN_MAX_DURATION;
+  lock_stats::SpinPhase spin_phase{class_stats(), Mutex::SPIN_MAX_DURATION, true, now_ticks};
+  lock_stats::SpinOutcome spin_outcome = lock_stats::SpinOutcome::kBudgetExhausted;
   const affine::Ratio time_to_ticks = timer_get_ticks_to_time_ratio().Inverse();
   const zx_ticks_t spin_until_ticks =
-      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_max_duration));
+      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_phase.budget()));
 
   do {
     AcquireResult result = AtomicWriteAcquire(kBrwLockUnlocked, current_thread);
 
     // Acquire succeeded, return holding the lock.
     if (result) {
+      spin_phase.Finish(lock_stats::SpinOutcome::kAcquired);
       return;
     }
 
     // If there are any waiters, implying another thread exhausted its spin phase on the same lock,
     // break out of the spin phase early.
     if (StateHasWaiters(result.state)) {
+      spin_outcome = lock_stats::SpinOutcome::kWaiters;
+      break;
+    }
+
+    // If the writer is not running it cannot release the lock until it has been scheduled again,
+    // so there is no point in spinning.
+    if (WriterNotRunning(result.state)) {
+      spin_outcome = lock_stats::SpinOutcome::kOwnerNotRunning;
       break;
     }
 
@@ -423,6 +447,8 @@ void BrwLock<PI>::ContendedWriteAcquire() {
     now_ticks = current_ticks();
   } while (now_ticks < spin_until_ticks);
 
+  spin_phase.Finish(spin_outcome);
+
   // Enter our wait queue's lock and figure out what to do next.  We don't really know what we need
   // to do yet, so we need to be prepared for needing to back off and try again.
   ChainLockTransactionPreemptDisableAndIrqSave clt{CLT_TAG("BrwLock<PI>::ContendedWriteAcquire")};
@@ -533,6 +559,8 @@ void BrwLock<PI>::WriteRelease() {
   }
 #endif
 
+  NoteReleasing();
+
   // For correct PI handling we need to ensure that up until a higher priority
   // thread can acquire the lock we will correctly be considered the owner.
   // Other threads are able to acquire the lock *after* we call ReleaseWakeup,
@@ -602,6 +630,7 @@ void BrwLock<PI>::ContendedReadUpgrade() {
   LOCK_TRACE_DURATION("ContendedReadUpgrade");
   Thread* const current_thread = Thread::Current::Get();
   ContentionTimer timer(current_thread, current_ticks());
+  lock_stats::WaitRecorder wait_recorder{class_stats(), __builtin_return_address(0)};
 
   ChainLockTransactionPreemptDisableAndIrqSave clt{CLT_TAG("BrwLock<PI>::ContendedReadUpgrade")};
 
@@ -113,8 +113,10 @@ zx_status_t Event::WaitWorker(const Deadline& deadline, Interruptible interrupti
  * @param e           Event object
  * @param wait_result What status a wait call will return to the
  *                    thread or threads that are woken up.
+ * @param sync        Whether the wakeup is a synchronous handoff from the
+ *                    signaling thread (see Scheduler::UnblockHint::Sync).
  */
-void Event::Signal(zx_status_t wait_result) {
+void Event::SignalWorker(zx_status_t wait_result, bool sync) {
   DEBUG_ASSERT(magic_ == kMagic);
   DEBUG_ASSERT(wait_result != kNotSignaled);
 
@@ -163,7 +165,8 @@ void Event::Signal(zx_status_t wait_result) {
     // unblock all of the threads.
     guard.Release();
     if (has_threads_to_wake) {
-      Scheduler::Unblock(ktl::move(maybe_unblock_list).value());
+      Scheduler::Unblock(ktl::move(maybe_unblock_list).value(),
+                         sync ? Scheduler::UnblockHint::Sync : Scheduler::UnblockHint::Default);
     }
     break;
   }
@@ -0,0 +1,402 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "kernel/lock_stats.h"
+
+#include <debug.h>
+#include <inttypes.h>
+#include <lib/counters.h>
+
+#include <arch/ops.h>
+#include <fbl/alloc_checker.h>
+#include <ktl/algorithm.h>
+#include <ktl/array.h>
+#include <ktl/atomic.h>
+#include <ktl/bit.h>
+#include <lk/init.h>
+#include <vm/vm.h>
+
+#include <ktl/enforce.h>
+
+// Counts the lock classes which could not be given a stats record because the
+// table was full.
+KCOUNTER(counter_lock_stats_dropped_classes, "lock_stats.dropped_classes")
+
+namespace lock_stats {
+
+namespace {
+
+// Records are never released, so kMaxLockClasses must be large enough for all
+// of the lock classes in the kernel.  Must be a power of two.
+static_assert((kMaxLockClasses & (kMaxLockClasses - 1)) == 0);
+
+// The weight given to a new sample in the moving averages, as a shift.  A
+// shift of 2 gives new samples a weight of 1/4.
+constexpr int kAverageShift = 2;
+
+// Open addressed hash table of records keyed by lock class id.  Records are
+// claimed with a compare-exchange on the key, so lookups and insertions are
+// lock free and safe to perform during global construction, when the first
+// locks are being initialized.
+ktl::array<ClassStats, kMaxLockClasses> gClassStats;
+ktl::array<ktl::atomic<lockdep::LockClassId>, kMaxLockClasses> gClassKeys;
+
+size_t HashLockClassId(lockdep::LockClassId lcid) {
+  // Lock class ids are addresses of statically allocated objects; discard the
+  // low bits, which are mostly alignment.
+  const uintptr_t value = reinterpret_cast<uintptr_t>(lcid);
+  return static_cast<size_t>((value >> 4) ^ (value >> 16));
+}
+
+zx_duration_t MovingAverage(zx_duration_t average, zx_duration_t sample) {
+  return average - (average >> kAverageShift) + (sample >> kAverageShift);
+}
+
+// One CPU's profile samples for a single lock class.
+//
+// A CPU's buffer is only written by threads running on that CPU, but a thread
+// may migrate while recording a sample, so updates are (uncontended) relaxed
+// atomic operations rather than plain stores.
+struct CpuClassProfile {
+  struct CallSite {
+    RelaxedAtomic<uintptr_t> pc;
+    RelaxedAtomic<uint64_t> count;
+  };
+
+  ktl::array<RelaxedAtomic<uint64_t>, kNumHistogramBuckets> wait_histogram;
+  ktl::array<RelaxedAtomic<uint64_t>, kNumHistogramBuckets> hold_histogram;
+  RelaxedAtomic<zx_duration_t> total_wait_time;
+  RelaxedAtomic<zx_duration_t> total_hold_time;
+  ktl::array<CallSite, kNumCallSites> call_sites;
+};
+
+using CpuProfileBuffer = ktl::array<CpuClassProfile, kMaxLockClasses>;
+
+// The per-CPU profile buffers, indexed by CPU number, and their count.  Both
+// are published once during init and never change after that.
+ktl::atomic<CpuProfileBuffer*> gCpuProfileBuffers{nullptr};
+size_t gNumCpuProfileBuffers{0};
+
+size_t HistogramBucket(zx_duration_t duration) {
+  if (duration < (zx_duration_t{1} << kHistogramShift)) {
+    return 0;
+  }
+  const size_t width = ktl::bit_width(static_cast<uint64_t>(duration));
+  return ktl::min<size_t>(width - kHistogramShift, kNumHistogramBuckets - 1);
+}
+
+// Returns the calling CPU's profile for the lock class of |stats|.  Profiling
+// is only enabled once the buffers have been allocated, and they are never
+// freed, so they always exist when a sample is recorded.
+CpuClassProfile* GetCpuClassProfile(ClassStats* stats) {
+  CpuProfileBuffer* const buffers = gCpuProfileBuffers.load(ktl::memory_order_acquire);
+  DEBUG_ASSERT(buffers != nullptr);
+  const size_t cpu = ktl::min<size_t>(arch_curr_cpu_num(), gNumCpuProfileBuffers - 1);
+  return &buffers[cpu][stats - gClassStats.data()];
+}
+
+// Counts a contended acquisition from |pc|.  If |pc| is not already tracked, it
+// replaces the least frequent call site and inherits its count, so that a new
+// call site which contends often quickly ranks highly.  The counts of the
+// replaced call sites are overestimates, but frequent call sites are never
+// lost.
+void RecordCallSite(CpuClassProfile& profile, uintptr_t pc) {
+  CpuClassProfile::CallSite* least = &profile.call_sites[0];
+  for (CpuClassProfile::CallSite& site : profile.call_sites) {
+    if (site.pc.load() == pc) {
+      site.count += 1;
+      return;
+    }
+    if (site.count.load() < least->count.load()) {
+      least = &site;
+    }
+  }
+  least->pc = pc;
+  least->count += 1;
+}
+
+void InitProfileBuffers(uint level) {
+  if constexpr (!kLockStatsEnabled) {
+    return;
+  }
+
+  const size_t num_cpus = arch_max_num_cpus();
+  fbl::AllocChecker ac;
+  CpuProfileBuffer* const buffers = new (&ac) CpuProfileBuffer[num_cpus]();
+  if (!ac.check()) {
+    dprintf(INFO, "lock_stats: failed to allocate %zu bytes of profile buffers\n",
+           num_cpus * sizeof(CpuProfileBuffer));
+    return;
+  }
+  gNumCpuProfileBuffers = num_cpus;
+  gCpuProfileBuffers.store(buffers, ktl::memory_order_release);
+  SetProfilingEnabled(true);
+}
+
+}  // namespace
+
+namespace internal {
+RelaxedAtomic<bool> gProfilingEnabled{false};
+}  // namespace internal
+
+ClassStats* GetClassStats(lockdep::LockClassId lcid) {
+  if (lcid == lockdep::kInvalidLockClassId) {
+    return nullptr;
+  }
+
+  const size_t start = HashLockClassId(lcid);
+  for (size_t i = 0; i < kMaxLockClasses; i++) {
+    const size_t index = (start + i) & (kMaxLockClasses - 1);
+    lockdep::LockClassId expected = lockdep::kInvalidLockClassId;
+    if (gClassKeys[index].compare_exchange_strong(expected, lcid, ktl::memory_order_relaxed,
+                                                  ktl::memory_order_relaxed) ||
+        expected == lcid) {
+      ClassStats& stats = gClassStats[index];
+      stats.lock_class_id_ = lcid;
+      return &stats;
+    }
+  }
+
+  kcounter_add(counter_lock_stats_dropped_classes, 1);
+  return nullptr;
+}
+
+void ClassStats::RecordSpin(SpinOutcome outcome, zx_duration_t spin_duration,
+                            zx_duration_t max_duration, bool adapt) {
+  contended_count_ += 1;
+  total_spin_time_ += spin_duration;
+
+  const zx_duration_t budget = SpinBudget(max_duration);
+  switch (outcome) {
+    case SpinOutcome::kAcquired: {
+      spin_acquired_count_ += 1;
+      const zx_duration_t average = average_spin_acquire_time_.load();
+      average_spin_acquire_time_ =
+          (average == 0) ? spin_duration : MovingAverage(average, spin_duration);
+
+      // Spinning paid off.  Move the budget towards twice the time it took, so
+      // that the budget comfortably covers the typical remaining hold time
+      // while still tracking it if it grows.
+      if (adapt) {
+        const zx_duration_t target =
+            ktl::clamp(2 * spin_duration + kMinSpinBudget, kMinSpinBudget, max_duration);
+        spin_budget_ = MovingAverage(budget, target);
+      }
+      break;
+    }
+    case SpinOutcome::kBudgetExhausted:
+      // We spun for the entire budget and still had to block.  Locks in this
+      // class are being held for longer than we are willing to spin, so back
+      // off quickly.  Successful spins will grow the budget again if the hold
+      // times shrink.
+      budget_exhausted_count_ += 1;
+      if (adapt) {
+        spin_budget_ = ktl::max(budget / 2, kMinSpinBudget);
+      }
+      break;
+    case SpinOutcome::kOwnerNotRunning:
+      // These outcomes say nothing about how long the lock is held for, so
+      // they do not influence the budget.
+      owner_not_running_count_ += 1;
+      break;
+    case SpinOutcome::kWaiters:
+      waiters_count_ += 1;
+      break;
+  }
+}
+
+void Dump(FILE* f, size_t max_classes) {
+  // Select the classes with the most total spin time.  This is a simple
+  // selection rather than a sort; it runs from the kernel console, not from any
+  // performance sensitive path.
+  ktl::array<bool, kMaxLockClasses> printed{};
+  fprintf(f, "%-40s %10s %10s %10s %10s %10s %12s %10s %10s\n", "class", "contended", "spin_acq",
+          "exhausted", "not_run", "waiters", "spin_us", "avg_acq_ns", "budget_ns");
+
+  for (size_t n = 0; n < max_classes; n++) {
+    size_t best = kMaxLockClasses;
+    for (size_t i = 0; i < kMaxLockClasses; i++) {
+      if (printed[i] || gClassStats[i].lock_class_id() == lockdep::kInvalidLockClassId ||
+          gClassStats[i].contended_count() == 0) {
+        continue;
+      }
+      if (best == kMaxLockClasses ||
+          gClassStats[i].total_spin_time() > gClassStats[best].total_spin_time()) {
+        best = i;
+      }
+    }
+    if (best == kMaxLockClasses) {
+      break;
+    }
+    printed[best] = true;
+
+    const ClassStats& stats = gClassStats[best];
+    const char* name = "<unknown>";
+    if constexpr (lockdep::kLockMetadataAvailable) {
+      name = lockdep::MetadataLockClassState::GetName(stats.lock_class_id());
+    }
+    fprintf(f,
+            "%-40s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+            " %12" PRId64 " %10" PRId64 " %10" PRId64 "\n",
+            name, stats.contended_count(), stats.spin_acquired_count(),
+            stats.budget_exhausted_count(), stats.owner_not_running_count(), stats.waiters_count(),
+            stats.total_spin_time() / ZX_USEC(1), stats.average_spin_acquire_time(),
+            stats.spin_budget());
+  }
+}
+
+void SetProfilingEnabled(bool enabled) {
+  if (enabled && gCpuProfileBuffers.load(ktl::memory_order_acquire) == nullptr) {
+    return;
+  }
+  internal::gProfilingEnabled = enabled;
+}
+
+void ResetProfiles() {
+  CpuProfileBuffer* const buffers = gCpuProfileBuffers.load(ktl::memory_order_acquire);
+  if (buffers == nullptr) {
+    return;
+  }
+  // Samples recorded concurrently with the reset may be partially cleared.
+  for (size_t cpu = 0; cpu < gNumCpuProfileBuffers; cpu++) {
+    for (CpuClassProfile& profile : buffers[cpu]) {
+      for (size_t i = 0; i < kNumHistogramBuckets; i++) {
+        profile.wait_histogram[i] = 0;
+        profile.hold_histogram[i] = 0;
+      }
+      profile.total_wait_time = 0;
+      profile.total_hold_time = 0;
+      for (CpuClassProfile::CallSite& site : profile.call_sites) {
+        site.pc = 0;
+        site.count = 0;
+      }
+    }
+  }
+}
+
+void RecordWait(ClassStats* stats, zx_duration_t wait, uintptr_t caller) {
+  CpuClassProfile& profile = *GetCpuClassProfile(stats);
+  profile.wait_histogram[HistogramBucket(wait)] += 1;
+  profile.total_wait_time += wait;
+  RecordCallSite(profile, caller - reinterpret_cast<uintptr_t>(__executable_start));
+}
+
+void RecordHold(ClassStats* stats, zx_duration_t hold) {
+  CpuClassProfile& profile = *GetCpuClassProfile(stats);
+  profile.hold_histogram[HistogramBucket(hold)] += 1;
+  profile.total_hold_time += hold;
+}
+
+bool GetClassProfile(size_t index, ClassProfile* profile) {
+  DEBUG_ASSERT(index < kMaxLockClasses);
+  const lockdep::LockClassId lcid = gClassStats[index].lock_class_id();
+  CpuProfileBuffer* const buffers = gCpuProfileBuffers.load(ktl::memory_order_acquire);
+  if (lcid == lockdep::kInvalidLockClassId || buffers == nullptr) {
+    return false;
+  }
+
+  *profile = {};
+  profile->lock_class_id = lcid;
+  for (size_t cpu = 0; cpu < gNumCpuProfileBuffers; cpu++) {
+    const CpuClassProfile& cpu_profile = buffers[cpu][index];
+    for (size_t i = 0; i < kNumHistogramBuckets; i++) {
+      const uint64_t waits = cpu_profile.wait_histogram[i].load();
+      const uint64_t holds = cpu_profile.hold_histogram[i].load();
+      profile->wait_histogram[i] += waits;
+      profile->wait_count += waits;
+      profile->hold_histogram[i] += holds;
+      profile->hold_count += holds;
+    }
+    profile->total_wait_time += cpu_profile.total_wait_time.load();
+    profile->total_hold_time += cpu_profile.total_hold_time.load();
+
+    // Merge this CPU's call sites into the top call sites so far, keeping the
+    // list ordered by decreasing count.
+    for (const CpuClassProfile::CallSite& site : cpu_profile.call_sites) {
+      const CallSite cpu_site{site.pc.load(), site.count.load()};
+      if (cpu_site.count == 0) {
+        continue;
+      }
+      CallSite* const begin = profile->call_sites;
+      CallSite* const end = begin + kNumCallSites;
+      CallSite* entry = ktl::find_if(begin, end, [&](const CallSite& s) {
+        return s.count != 0 && s.pc == cpu_site.pc;
+      });
+      if (entry != end) {
+        entry->count += cpu_site.count;
+      } else if (cpu_site.count > end[-1].count) {
+        entry = end - 1;
+        *entry = cpu_site;
+      } else {
+        continue;
+      }
+      for (; entry != begin && entry[-1].count < entry->count; --entry) {
+        ktl::swap(entry[-1], entry[0]);
+      }
+    }
+  }
+
+  return profile->wait_count != 0 || profile->hold_count != 0;
+}
+
+void DumpProfiles(FILE* f, size_t max_classes) {
+  if (gCpuProfileBuffers.load(ktl::memory_order_acquire) == nullptr) {
+    fprintf(f, "Lock profile buffers are not allocated\n");
+    return;
+  }
+
+  // As in Dump, select the classes with the most total wait time one at a time.
+  ktl::array<bool, kMaxLockClasses> printed{};
+  for (size_t n = 0; n < max_classes; n++) {
+    size_t best = kMaxLockClasses;
+    zx_duration_t best_wait_time = 0;
+    for (size_t i = 0; i < kMaxLockClasses; i++) {
+      ClassProfile profile;
+      if (printed[i] || !GetClassProfile(i, &profile) || profile.wait_count == 0) {
+        continue;
+      }
+      if (best == kMaxLockClasses || profile.total_wait_time > best_wait_time) {
+        best = i;
+        best_wait_time = profile.total_wait_time;
+      }
+    }
+    if (best == kMaxLockClasses) {
+      break;
+    }
+    printed[best] = true;
+
+    ClassProfile profile;
+    GetClassProfile(best, &profile);
+    const char* name = "<unknown>";
+    if constexpr (lockdep::kLockMetadataAvailable) {
+      name = lockdep::MetadataLockClassState::GetName(profile.lock_class_id);
+    }
+    fprintf(f, "%s: waits %" PRIu64 " total %" PRId64 " us, holds %" PRIu64 " total %" PRId64
+            " us\n",
+            name, profile.wait_count, profile.total_wait_time / ZX_USEC(1), profile.hold_count,
+            profile.total_hold_time / ZX_USEC(1));
+    fprintf(f, "  wait histogram:");
+    for (uint64_t count : profile.wait_histogram) {
+      fprintf(f, " %" PRIu64, count);
+    }
+    fprintf(f, "\n  hold histogram:");
+    for (uint64_t count : profile.hold_histogram) {
+      fprintf(f, " %" PRIu64, count);
+    }
+    fprintf(f, "\n");
+    for (const CallSite& site : profile.call_sites) {
+      if (site.count != 0) {
+        fprintf(f, "  %10" PRIu64 " waits from zircon.elf+%#" PRIxPTR "\n", site.count, site.pc);
+      }
+    }
+  }
+}
+
+}  // namespace lock_stats
+
+// The profile buffers are sized by the number of CPUs, which is known once the
+// platform has been initialized.  Profiling starts once they are allocated.
+LK_INIT_HOOK(lock_stats_profile, lock_stats::InitProfileBuffers, LK_INIT_LEVEL_KERNEL)
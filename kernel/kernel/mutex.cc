@@ -181,6 +181,7 @@ bool Mutex::AcquireCommon(zx_duration_t spin_max_duration,
       // attempts to acquire the mutex and discovers it to be already locked, it
       // will take care of updating the wait queue ownership.
       KTracer{}.KernelMutexUncontestedAcquire(this);
+      NoteAcquired();
 
       return set_extension;
     }
@@ -191,7 +192,15 @@ bool Mutex::AcquireCommon(zx_duration_t spin_max_duration,
     }
   }
 
-  return AcquireContendedMutex(spin_max_duration, current_thread, timeslice_extension);
+  // AcquireCommon is out of line, while Acquire is inlined into its callers, so
+  // our return address identifies the code which is acquiring the mutex.
+  bool set_extension;
+  {
+    lock_stats::WaitRecorder wait_recorder{class_stats(), __builtin_return_address(0)};
+    set_extension = AcquireContendedMutex(spin_max_duration, current_thread, timeslice_extension);
+  }
+  NoteAcquired();
+  return set_extension;
 }
 
 template <bool TimesliceExtensionEnabled>
@@ -209,11 +218,14 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
   // exit, having achieved our goal.  Otherwise, there are 3 reasons we may end
   // up terminating the spin phase and dropping into a block operation.
   //
-  // 1) We exceed the system's configured |spin_max_duration|.
+  // 1) We exceed the system's configured |spin_max_duration|, or the adaptive
+  //    spin budget of the mutex's lock class when lock stats are enabled.
   // 2) The mutex is marked as CONTESTED, meaning that at least one other thread
   //    has dropped out of its spin phase and blocked on the mutex.
   // 3) We think that there is a reasonable chance that the owner of this mutex
   //    was assigned to the same core that we are running on.
+  // 4) We think that the owner of this mutex is not running on any core, so it
+  //    cannot release the mutex until after it has been scheduled again.
   //
   // Notes about #3:
   //
@@ -258,9 +270,20 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
   zx_ticks_t now_ticks = current_ticks();
   spin_tracing::Tracer<kSchedulerLockSpinTracingEnabled> spin_tracer{now_ticks};
 
+  // Only acquisitions which use the default spin duration are subject to the
+  // adaptive spin budget.  Callers asking for something specific get it.
+  lock_stats::SpinPhase spin_phase{class_stats(), spin_max_duration,
+                                   spin_max_duration == SPIN_MAX_DURATION, now_ticks};
+  lock_stats::SpinOutcome spin_outcome = lock_stats::SpinOutcome::kBudgetExhausted;
+
   const affine::Ratio time_to_ticks = timer_get_ticks_to_time_ratio().Inverse();
   const zx_ticks_t spin_until_ticks =
-      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_max_duration));
+      affine::utils::ClampAdd(now_ticks, time_to_ticks.Scale(spin_phase.budget()));
+
+  // Looking for the owner on every CPU is expensive, so once the owner has been
+  // found to have migrated, only do so every kOwnerScanInterval iterations.
+  constexpr uint32_t kOwnerScanInterval = 64;
+  uint32_t owner_scan_countdown = 0;
   do {
     uintptr_t old_mutex_state = STATE_FREE;
     // Attempt to acquire the mutex by swapping out "STATE_FREE" for our current thread.
@@ -273,6 +296,7 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
                                           ktl::memory_order_acquire, ktl::memory_order_relaxed))) {
       spin_tracer.Finish(spin_tracing::FinishType::kLockAcquired, this->encoded_lock_id());
       RecordInitialAssignedCpu();
+      spin_phase.Finish(lock_stats::SpinOutcome::kAcquired);
 
       // Same as above in the fastest path: leave accounting to later contending
       // threads.
@@ -287,6 +311,7 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
     // Stop spinning if the mutex is or becomes contested. All spinners convert
     // to blocking when the first one reaches the max spin duration.
     if (old_mutex_state & STATE_FLAG_CONTESTED) {
+      spin_outcome = lock_stats::SpinOutcome::kWaiters;
       break;
     }
 
@@ -297,10 +322,33 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
       // Note: The accuracy of |curr_cpu_num| depends on whether preemption is
       // currently enabled or not and whether we re-enable it below.
       const cpu_num_t curr_cpu_num = arch_curr_cpu_num();
-      if (curr_cpu_num == maybe_acquired_on_cpu_.load(ktl::memory_order_relaxed)) {
+      const cpu_num_t owner_cpu_num = maybe_acquired_on_cpu_.load(ktl::memory_order_relaxed);
+      if (curr_cpu_num == owner_cpu_num) {
+        spin_outcome = lock_stats::SpinOutcome::kOwnerNotRunning;
         break;
       }
 
+      // Stop spinning if the owner is not running anywhere.  It has blocked or
+      // been preempted, and will not release the mutex before it is scheduled
+      // again, so spinning cannot succeed.  Check the CPU the owner acquired
+      // the mutex on first, and only look at the other CPUs if the owner is not
+      // found there, since the owner rarely migrates while holding a mutex.
+      //
+      // Note: The owner is never dereferenced here, so it does not matter if it
+      // has already released the mutex and exited.
+      const Thread* const owner = holder_from_val(old_mutex_state);
+      if ((owner != nullptr) && (owner_cpu_num != INVALID_CPU) &&
+          !Scheduler::PeekIsActiveThread(owner_cpu_num, owner)) {
+        if (owner_scan_countdown == 0) {
+          if (!Scheduler::PeekIsThreadRunning(owner)) {
+            spin_outcome = lock_stats::SpinOutcome::kOwnerNotRunning;
+            break;
+          }
+          owner_scan_countdown = kOwnerScanInterval;
+        }
+        --owner_scan_countdown;
+      }
+
       if constexpr (TimesliceExtensionEnabled) {
         // If this CPU has a preemption pending, briefly enable then disable
         // preemption to give this CPU a chance to reschedule.
@@ -318,6 +366,8 @@ __NO_INLINE bool Mutex::AcquireContendedMutex(
     now_ticks = current_ticks();
   } while (now_ticks < spin_until_ticks);
 
+  spin_phase.Finish(spin_outcome);
+
   // Capture the end-of-spin timestamp for our spin tracer, but do not finish
   // the event just yet. We don't actually know if we are going to block or not
   // yet; we have one last chance to grab the lock after we obtain a few more
@@ -585,6 +635,7 @@ void Mutex::ReleaseInternal() {
   DEBUG_ASSERT(!arch_blocking_disallowed());
   Thread* current_thread = Thread::Current::Get();
 
+  NoteReleasing();
   ClearInitialAssignedCpu();
 
   if (const uintptr_t old_mutex_state = TryRelease(current_thread); old_mutex_state != STATE_FREE) {
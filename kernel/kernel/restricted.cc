@@ -7,6 +7,7 @@
 
 #include <arch.h>
 #include <inttypes.h>
+#include <lib/counters.h>
 #include <lib/zx/result.h>
 #include <stdlib.h>
 #include <trace.h>
@@ -16,6 +17,7 @@
 #include <fbl/alloc_checker.h>
 #include <kernel/restricted_state.h>
 #include <kernel/thread.h>
+#include <ktl/atomic.h>
 #include <object/exception_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/thread_dispatcher.h>
@@ -28,6 +30,15 @@
 static_assert(offsetof(zx_restricted_syscall_t, state) == 0);
 static_assert(offsetof(zx_restricted_exception_t, state) == 0);
 
+// The upcall mailbox must not overlap any of the structures above, and must fit in the state VMO.
+static_assert(sizeof(zx_restricted_exception_t) <= ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET);
+static_assert(ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET + sizeof(zx_restricted_upcall_mailbox_t) <=
+              PAGE_SIZE);
+static_assert(ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET % alignof(zx_restricted_upcall_mailbox_t) == 0);
+
+KCOUNTER(restricted_upcall_delivered_count, "restricted.upcall.delivered")
+KCOUNTER(restricted_upcall_coalesced_count, "restricted.upcall.coalesced")
+
 // Kernel implementation of restricted mode. Most of these routines are more or less directly
 // called from a corresponding syscall. The rest are up called from architecturally specific
 // hardware traps, such as an exception or syscall when the cpu is in restricted mode.
@@ -80,6 +91,46 @@ template <typename T>
   __UNREACHABLE;
 }
 
+// Redirects |regs| to the upcall handler registered in the mailbox of |rs|. See
+// RestrictedDeliverUpcall.
+template <typename T>
+static bool DeliverUpcall(RestrictedState* rs, T& regs) {
+  DEBUG_ASSERT(arch_ints_disabled());
+
+  // The mailbox lives in the pinned kernel mapping of the state VMO, so none of these accesses can
+  // fault. Restricted and normal mode may be accessing it concurrently, though.
+  zx_restricted_upcall_mailbox_t* mailbox = rs->upcall_mailbox_ptr();
+  const uint64_t handler = ktl::atomic_ref(mailbox->handler).load(ktl::memory_order_relaxed);
+  if (handler == 0 || !is_user_accessible(handler)) {
+    return false;
+  }
+
+  // Only the handler itself clears |active|, and it cannot run while we are here on its thread.
+  ktl::atomic_ref active(mailbox->active);
+  if (active.load(ktl::memory_order_relaxed) != 0) {
+    kcounter_add(restricted_upcall_coalesced_count, 1);
+    return true;
+  }
+
+  const uintptr_t interrupted_pc = RestrictedState::ArchSwapPc(regs, handler);
+  ktl::atomic_ref(mailbox->interrupted_pc).store(interrupted_pc, ktl::memory_order_relaxed);
+  active.store(1, ktl::memory_order_release);
+
+  LTRACEF("upcall to %#" PRIx64 " from %#" PRIxPTR "\n", handler, interrupted_pc);
+  kcounter_add(restricted_upcall_delivered_count, 1);
+  return true;
+}
+
+bool RestrictedDeliverUpcall(iframe_t* iframe) {
+  return DeliverUpcall(Thread::Current::restricted_state(), *iframe);
+}
+
+#if defined(__x86_64__)
+bool RestrictedDeliverUpcall(syscall_regs_t* regs) {
+  return DeliverUpcall(Thread::Current::restricted_state(), *regs);
+}
+#endif
+
 // Dispatched directly from arch-specific syscall handler. Called after saving state
 // on the stack, but before trying to dispatch as a zircon syscall.
 extern "C" [[noreturn]] void syscall_from_restricted(const syscall_regs_t* regs) {
@@ -160,7 +211,14 @@ zx_status_t RestrictedEnter(uint32_t options, uintptr_t vector_table_ptr, uintpt
 
   // Now that the normal mode state has been saved, we can decide if we're going to continue on with
   // the mode switch or simply vector-return to normal mode because of a pending kick.
-  if (Thread::Current::CheckForRestrictedKick()) {
+  // A pending upcall redirects the thread to its handler as it enters restricted mode, unless no
+  // handler is registered, in which case it is delivered as a kick. A pending kick takes precedence
+  // and leaves the upcall pending.
+  bool kicked = Thread::Current::CheckForRestrictedKick();
+  if (!kicked && Thread::Current::CheckForRestrictedUpcall()) {
+    kicked = !DeliverUpcall(rs, state);
+  }
+  if (kicked) {
     KTRACE_DURATION_END("kernel:syscall", "restricted_enter");
     RestrictedState::ArchEnterFull(rs->arch_normal_state(), vector_table_ptr, context,
                                    ZX_RESTRICTED_REASON_KICK);
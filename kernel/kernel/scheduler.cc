@@ -64,6 +64,11 @@ KCOUNTER(counter_deadline_past, "scheduler.deadline_past")
 // selected Target became in-active after we chose it.
 KCOUNTER(counter_find_target_cpu_retries, "scheduler.find_target_cpu.retries")
 
+// Counts the number of synchronous wakeups which placed the woken thread on the
+// waker's CPU, and the number which fell back to the regular target selection.
+KCOUNTER(counter_sync_wakeup_local, "scheduler.sync_wakeup.local")
+KCOUNTER(counter_sync_wakeup_remote, "scheduler.sync_wakeup.remote")
+
 namespace {
 
 // The minimum possible weight and its reciprocal.
@@ -463,6 +468,7 @@ void Scheduler::InitializeFirstThread(Thread* thread) {
     SchedulerQueueState& sqs = thread->scheduler_queue_state();
     sqs.active = true;
     sched->active_thread_ = thread;
+    sched->exported_active_thread_ = thread;
 
     sched->weight_total_ = ss.effective_profile_.fair.weight;
     sched->runnable_fair_task_count_++;
@@ -516,6 +522,7 @@ void Scheduler::RemoveFirstThread(Thread* thread) {
     DEBUG_ASSERT(sched->runnable_fair_task_count_ > 0);
     sqs.active = false;
     sched->active_thread_ = nullptr;
+    sched->exported_active_thread_ = nullptr;
     sched->weight_total_ -= ss.effective_profile_.fair.weight;
     sched->runnable_fair_task_count_--;
     sched->UpdateTotalExpectedRuntime(-ss.expected_runtime_ns_);
@@ -1062,12 +1069,31 @@ cpu_num_t Scheduler::FindTargetCpu(Thread* thread, FindTargetCpuReason reason) {
   // scheduler to complete the migration operation.
   //
   const cpu_num_t last_cpu = thread_state.last_cpu_;
-  if ((reason == FindTargetCpuReason::Unblocking) && thread->has_migrate_fn() &&
-      !thread->migrate_pending() && (last_cpu != INVALID_CPU)) {
+  const bool unblocking = (reason == FindTargetCpuReason::Unblocking) ||
+                          (reason == FindTargetCpuReason::SyncUnblocking);
+  if (unblocking && thread->has_migrate_fn() && !thread->migrate_pending() &&
+      (last_cpu != INVALID_CPU)) {
     trace = KTRACE_END_SCOPE(("last_cpu", last_cpu), ("target_cpu", last_cpu));
     return last_cpu;
   }
 
+  // For a synchronous wakeup, the waker is about to stop running, so the
+  // cheapest place for the woken thread is right here: no reschedule IPI is
+  // needed and the data the waker just produced is still in this CPU's cache.
+  // Only do this for fair threads, and only when the local queue is short
+  // enough that the woken thread would not be better served by an idle CPU.
+  // Deadline threads always go through the utilization based selection below.
+  if (reason == FindTargetCpuReason::SyncUnblocking) {
+    const bool current_available = available_mask & cpu_num_to_mask(current_cpu);
+    if (current_available && thread_state.effective_profile_.IsFair() &&
+        Get(current_cpu)->predicted_queue_time_ns() <= kIntraClusterThreshold) {
+      counter_sync_wakeup_local.Add(1u);
+      trace = KTRACE_END_SCOPE(("last_cpu", last_cpu), ("target_cpu", current_cpu));
+      return current_cpu;
+    }
+    counter_sync_wakeup_remote.Add(1u);
+  }
+
   // Find the best target CPU starting at the last CPU the task ran on, if any.
   // Alternatives are considered in order of best to worst potential cache
   // affinity.
@@ -1205,6 +1231,22 @@ cpu_num_t Scheduler::FindTargetCpu(Thread* thread, FindTargetCpuReason reason) {
 
 void Scheduler::IncFindTargetCpuRetriesKcounter() { counter_find_target_cpu_retries.Add(1u); }
 
+bool Scheduler::PeekIsActiveThread(cpu_num_t cpu, const Thread* thread) {
+  return (cpu < arch_max_num_cpus()) && (Get(cpu)->exported_active_thread_.load() == thread);
+}
+
+bool Scheduler::PeekIsThreadRunning(const Thread* thread) {
+  cpu_mask_t active_mask = PeekActiveMask();
+  while (active_mask != 0) {
+    const cpu_num_t cpu = highest_cpu_set(active_mask);
+    if (Get(cpu)->exported_active_thread_.load() == thread) {
+      return true;
+    }
+    active_mask &= ~cpu_num_to_mask(cpu);
+  }
+  return false;
+}
+
 void Scheduler::UpdateTimeline(SchedTime now) {
   ktrace::Scope trace = LOCAL_KTRACE_BEGIN_SCOPE(DETAILED, "update_vtime");
 
@@ -1502,6 +1544,7 @@ void Scheduler::RescheduleCommon(Thread* const current_thread, SchedTime now,
   next_state->last_cpu_ = current_cpu;
   DEBUG_ASSERT(next_state->curr_cpu_ == current_cpu);
   active_thread_ = next_thread;
+  exported_active_thread_ = next_thread;
 
   // Handle any pending migration work.
   next_thread->CallMigrateFnLocked(Thread::MigrateStage::After);
@@ -2336,13 +2379,23 @@ void Scheduler::Unblock(Thread* thread) {
   RescheduleMask(cpu_num_to_mask(target_cpu));
 }
 
-void Scheduler::Unblock(Thread::UnblockList list) {
+void Scheduler::Unblock(Thread::UnblockList list, UnblockHint hint) {
   ktrace::Scope trace = LOCAL_KTRACE_BEGIN_SCOPE(COMMON, "sched_unblock_list");
   ChainLockTransaction::ActiveRef().AssertFinalized();
 
   const SchedTime now = CurrentTime();
   cpu_mask_t cpus_to_reschedule_mask = 0;
 
+  // A synchronous wakeup only makes sense when there is a single thread being
+  // handed off to.  Waking several threads onto the waker's CPU would simply
+  // serialize them behind one another.  Wakeups from interrupt context have no
+  // waker which is about to block, so they are never treated as synchronous.
+  const bool single_thread = !list.is_empty() && (++list.begin() == list.end());
+  const FindTargetCpuReason reason =
+      (hint == UnblockHint::Sync) && single_thread && !arch_blocking_disallowed()
+          ? FindTargetCpuReason::SyncUnblocking
+          : FindTargetCpuReason::Unblocking;
+
   Thread* thread;
   while ((thread = list.pop_back()) != nullptr) {
     thread->canary().Assert();
@@ -2350,7 +2403,7 @@ void Scheduler::Unblock(Thread::UnblockList list) {
     thread->get_lock().AssertAcquired();
 
     const cpu_num_t target_cpu = FindActiveSchedulerForThread(
-        thread, FindTargetCpuReason::Unblocking, [now](Thread* thread, Scheduler* target) {
+        thread, reason, [now](Thread* thread, Scheduler* target) {
           MarkInFindActiveSchedulerForThreadCbk(*thread, *target);
           TraceWakeup(thread, target->this_cpu_);
           thread->UpdateRuntimeStats(thread->state());
@@ -92,6 +92,7 @@ KCOUNTER(thread_resume_count, "thread.resume")
 KCOUNTER(thread_timeslice_extended, "thread.timeslice_extended")
 // counts the number of calls to restricted_kick() that succeeded.
 KCOUNTER(thread_restricted_kick_count, "thread.restricted_kick")
+KCOUNTER(thread_restricted_upcall_count, "thread.restricted_upcall")
 // counts the number of failed samples
 KCOUNTER(thread_sampling_failed, "thread.sampling_failed")
 
@@ -620,7 +621,7 @@ zx_status_t Thread::SuspendOrKillInternal(SuspendOrKillOp op) {
   }
 }
 
-zx_status_t Thread::RestrictedKick() {
+zx_status_t Thread::RaiseRestrictedSignal(uint32_t signal) {
   LTRACE_ENTRY;
 
   canary_.Assert();
@@ -632,13 +633,13 @@ zx_status_t Thread::RestrictedKick() {
   // do.
   cpu_mask_t ipi_mask{0};
   {
-    SingletonChainLockGuardIrqSave guard{lock_, CLT_TAG("Thread::RestrictedKick")};
+    SingletonChainLockGuardIrqSave guard{lock_, CLT_TAG("Thread::RaiseRestrictedSignal")};
 
     if (state() == THREAD_DEATH) {
       return ZX_ERR_BAD_STATE;
     }
 
-    signals_.fetch_or(THREAD_SIGNAL_RESTRICTED_KICK, ktl::memory_order_relaxed);
+    signals_.fetch_or(signal, ktl::memory_order_relaxed);
 
     if (state() == THREAD_RUNNING && !kicking_myself) {
       // thread is running (on another cpu)
@@ -659,10 +660,25 @@ zx_status_t Thread::RestrictedKick() {
     mp_interrupt(MP_IPI_TARGET_MASK, ipi_mask);
   }
 
-  kcounter_add(thread_restricted_kick_count, 1);
   return ZX_OK;
 }
 
+zx_status_t Thread::RestrictedKick() {
+  zx_status_t status = RaiseRestrictedSignal(THREAD_SIGNAL_RESTRICTED_KICK);
+  if (status == ZX_OK) {
+    kcounter_add(thread_restricted_kick_count, 1);
+  }
+  return status;
+}
+
+zx_status_t Thread::RestrictedUpcall() {
+  zx_status_t status = RaiseRestrictedSignal(THREAD_SIGNAL_RESTRICTED_UPCALL);
+  if (status == ZX_OK) {
+    kcounter_add(thread_restricted_upcall_count, 1);
+  }
+  return status;
+}
+
 // Signal an exception on the current thread, to be handled when the
 // current syscall exits.  Unlike other signals, this is synchronous, in
 // the sense that a thread signals itself.  This exists primarily so that
@@ -1480,6 +1496,16 @@ void Thread::Current::ProcessPendingSignals(GeneralRegsSource source, void* greg
       }
     }
 
+    // THREAD_SIGNAL_RESTRICTED_UPCALL
+    //
+    // Upcalls are delivered once all signals are processed, since a kick may still decide that the
+    // thread should exit to normal mode instead.
+    if (signals & THREAD_SIGNAL_RESTRICTED_UPCALL) {
+      current_thread->signals_.fetch_and(~THREAD_SIGNAL_RESTRICTED_UPCALL,
+                                         ktl::memory_order_relaxed);
+      current_thread->set_restricted_upcall_pending(true);
+    }
+
     if (signals & THREAD_SIGNAL_SAMPLE_STACK) {
       // Sampling the user stack may page fault as we try to do usercopies.
       arch_enable_ints();
@@ -1492,6 +1518,26 @@ void Thread::Current::ProcessPendingSignals(GeneralRegsSource source, void* greg
   // to enable interrupts in handling we have to re-enter the loop above in order to process signals
   // that may have been raised.
 
+  // Deliver a pending upcall without leaving restricted mode, if we are not leaving it anyway. An
+  // upcall that cannot be delivered, because no handler is registered, is treated as a kick. If we
+  // are not in restricted mode the upcall stays pending until the next RestrictedEnter.
+  if (!exit_to_normal_mode && arch_get_restricted_flag() &&
+      current_thread->restricted_upcall_pending()) {
+    current_thread->set_restricted_upcall_pending(false);
+    switch (source) {
+      case GeneralRegsSource::Iframe:
+        exit_to_normal_mode = !RestrictedDeliverUpcall(reinterpret_cast<iframe_t*>(gregs));
+        break;
+#if defined(__x86_64__)
+      case GeneralRegsSource::Syscall:
+        exit_to_normal_mode = !RestrictedDeliverUpcall(reinterpret_cast<syscall_regs_t*>(gregs));
+        break;
+#endif  // defined(__x86_64__)
+      default:
+        DEBUG_ASSERT_MSG(false, "invalid source %u\n", static_cast<uint32_t>(source));
+    }
+  }
+
   if (exit_to_normal_mode) {
     switch (source) {
       case GeneralRegsSource::Iframe: {
@@ -1528,6 +1574,20 @@ bool Thread::Current::CheckForRestrictedKick() {
   return false;
 }
 
+bool Thread::Current::CheckForRestrictedUpcall() {
+  LTRACE_ENTRY;
+
+  DEBUG_ASSERT(arch_ints_disabled());
+
+  Thread* current_thread = Thread::Current::Get();
+  if (current_thread->restricted_upcall_pending()) {
+    current_thread->set_restricted_upcall_pending(false);
+    return true;
+  }
+
+  return false;
+}
+
 /**
  * @brief Yield the cpu to another thread
  *
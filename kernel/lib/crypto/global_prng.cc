@@ -13,6 +13,7 @@
 #include <lib/crypto/entropy/quality_test.h>
 #include <lib/crypto/global_prng.h>
 #include <lib/crypto/prng.h>
+#include <lib/userabi/vdso.h>
 #include <string.h>
 #include <trace.h>
 #include <zircon/errors.h>
@@ -161,6 +162,9 @@ void ReseedPRNG() {
   } else {
     LTRACEF("Successfully reseed PRNG from %u sources.\n", successful);
   }
+
+  // Make user-mode generators keyed from the old state rekey before their next draw.
+  VDso::AdvanceCprngGeneration();
 }
 
 int ReseedLoop(void* arg) {
@@ -0,0 +1,83 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ZIRCON_KERNEL_LIB_FASTTIME_INCLUDE_LIB_FASTTIME_INTERNAL_CLOCK_H_
+#define ZIRCON_KERNEL_LIB_FASTTIME_INCLUDE_LIB_FASTTIME_INTERNAL_CLOCK_H_
+
+// This file describes how the kernel exposes the state of a mappable clock
+// object (ZX_CLOCK_OPT_MAPPABLE) to userland, and how that state is read.
+// This is a PRIVATE UNSTABLE ABI that may change at any time!
+// It is used by the kernel, which publishes the state, and by the vDSO, which
+// reads it in zx_clock_read_mapped. Therefore, it must be compatible with both
+// the kernel and user header environments.
+
+#include <lib/affine/transform.h>
+#include <lib/arch/intrin.h>
+#include <zircon/time.h>
+#include <zircon/types.h>
+
+#include <atomic>
+
+namespace fasttime::internal {
+
+// The ticks to synthetic transformation of a clock, protected by a sequence
+// counter. The kernel is the only writer, and it serializes updates using the
+// clock's own lock. Readers retry until they observe the same even sequence
+// number before and after reading the transformation.
+//
+// Every field is accessed atomically, so that concurrent reads and writes of
+// the transformation are not data races.
+struct MappedClock {
+  std::atomic<uint32_t> seq{0};
+  std::atomic<uint32_t> rate_synthetic_ticks{0};
+  std::atomic<uint32_t> rate_reference_ticks{1};
+  std::atomic<int64_t> reference_offset{0};
+  std::atomic<int64_t> synthetic_offset{0};
+};
+
+// Publishes a new ticks to synthetic transformation. Callers must ensure that
+// there is only one writer at a time.
+inline void PublishMappedClock(MappedClock& clock, const affine::Transform& ticks_to_synthetic) {
+  const uint32_t seq = clock.seq.load(std::memory_order_relaxed);
+  clock.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  clock.rate_synthetic_ticks.store(ticks_to_synthetic.numerator(), std::memory_order_relaxed);
+  clock.rate_reference_ticks.store(ticks_to_synthetic.denominator(), std::memory_order_relaxed);
+  clock.reference_offset.store(ticks_to_synthetic.a_offset(), std::memory_order_relaxed);
+  clock.synthetic_offset.store(ticks_to_synthetic.b_offset(), std::memory_order_relaxed);
+
+  clock.seq.store(seq + 2, std::memory_order_release);
+}
+
+// Reads the current value of the clock, using |get_ticks| to observe the tick
+// counter. The ticks are observed inside of the read transaction, so that the
+// value returned was valid at some point during the call, just as it is for
+// zx_clock_read.
+template <typename GetTicks>
+inline zx_time_t ReadMappedClock(const MappedClock& clock, GetTicks&& get_ticks) {
+  while (true) {
+    const uint32_t before = clock.seq.load(std::memory_order_acquire);
+    if (before & 1) {
+      arch::Yield();
+      continue;
+    }
+
+    const uint32_t numerator = clock.rate_synthetic_ticks.load(std::memory_order_relaxed);
+    const uint32_t denominator = clock.rate_reference_ticks.load(std::memory_order_relaxed);
+    const int64_t reference_offset = clock.reference_offset.load(std::memory_order_relaxed);
+    const int64_t synthetic_offset = clock.synthetic_offset.load(std::memory_order_relaxed);
+    const zx_ticks_t now_ticks = get_ticks();
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (clock.seq.load(std::memory_order_relaxed) == before) {
+      return affine::Transform{reference_offset, synthetic_offset, {numerator, denominator}}.Apply(
+          now_ticks);
+    }
+  }
+}
+
+}  // namespace fasttime::internal
+
+#endif  // ZIRCON_KERNEL_LIB_FASTTIME_INCLUDE_LIB_FASTTIME_INTERNAL_CLOCK_H_
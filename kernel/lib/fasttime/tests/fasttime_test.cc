@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fcntl.h>
+#include <lib/fasttime/internal/clock.h>
 #include <lib/fasttime/time.h>
 #include <lib/fdio/io.h>
 #include <lib/fzl/owned-vmo-mapper.h>
@@ -134,4 +135,19 @@ TEST(FasttimeTest, ComputeMonotonicTime) {
   EXPECT_LE(fasttime_time, zircon_time);
 }
 
+TEST(FasttimeTest, MappedClock) {
+  fasttime::internal::MappedClock clock;
+
+  // A stopped clock reads as its backstop time, whatever the ticks.
+  fasttime::internal::PublishMappedClock(clock, affine::Transform{0, 5500, {0, 1}});
+  EXPECT_EQ(fasttime::internal::ReadMappedClock(clock, [] { return zx_ticks_t{1000}; }), 5500);
+  EXPECT_EQ(clock.seq.load(), 2u);
+
+  // Once running, reads apply the most recently published transformation.
+  fasttime::internal::PublishMappedClock(clock, affine::Transform{1000, 2000, {3, 2}});
+  EXPECT_EQ(fasttime::internal::ReadMappedClock(clock, [] { return zx_ticks_t{1000}; }), 2000);
+  EXPECT_EQ(fasttime::internal::ReadMappedClock(clock, [] { return zx_ticks_t{3000}; }), 5000);
+  EXPECT_EQ(clock.seq.load(), 4u);
+}
+
 }  // namespace
@@ -20,6 +20,9 @@
 #include <zircon/types.h>
 
 #include <algorithm>
+#ifndef _KERNEL
+#include <atomic>
+#endif
 
 #include <fbl/algorithm.h>
 #include <pretty/hexdump.h>
@@ -36,7 +39,9 @@
 //
 // Allocation strategy takes place with a global mutex.  Freelist entries are
 // kept in linked lists with 8 different sizes per binary order of magnitude
-// and the header size is two words with eager coalescing on free.
+// and the header size is two words with eager coalescing on free.  Small
+// allocations are usually satisfied by per-CPU caches which sit in front of
+// the free buckets and only take the global mutex to move blocks in batches.
 //
 // ## Concepts ##
 //
@@ -118,6 +123,9 @@
 //   Exception: to avoid OS free/alloc churn when right on the edge, the heap
 //   will try to hold onto one entirely-free, non-large OS allocation instead of
 //   returning it to the OS. See cached_os_alloc.
+//
+//   Small memory areas are not freed to a bucket straight away, but are kept
+//   in a per-CPU cache. See "Per-CPU caches" below.
 
 #if defined(DEBUG) || LK_DEBUGLEVEL > 2
 #include <platform.h>
@@ -128,9 +136,12 @@
 #ifdef _KERNEL
 #include <debug.h>
 #include <lib/ktrace.h>
+#include <lib/relaxed_atomic.h>
 #include <trace.h>
 
+#include <arch/ops.h>
 #include <kernel/auto_preempt_disabler.h>
+#include <kernel/spinlock.h>
 
 #define LOCAL_TRACE_DURATION(label, name, ...) \
   ktrace::Scope name = KTRACE_BEGIN_SCOPE_ENABLE(false, "kernel:sched", label, ##__VA_ARGS__)
@@ -141,6 +152,11 @@
 
 using LockGuard = ::Guard<Mutex>;
 
+#define DECLARE_CPU_CACHE_LOCK(containing_type) DECLARE_SPINLOCK(containing_type)
+using CpuCacheLockGuard = ::Guard<SpinLock, IrqSave>;
+constexpr size_t kNumCpuCaches = SMP_MAX_CPUS;
+constexpr size_t kCpuCacheAlignment = MAX_CACHE_LINE;
+
 KCOUNTER(malloc_size_le_64, "malloc.size_le_64")
 KCOUNTER(malloc_size_le_96, "malloc.size_le_96")
 KCOUNTER(malloc_size_le_128, "malloc.size_le_128")
@@ -152,6 +168,11 @@ KCOUNTER(malloc_size_le_2048, "malloc.size_le_2048")
 KCOUNTER(malloc_size_other, "malloc.size_other")
 // The number of failed attempts at growing the heap.
 KCOUNTER(malloc_heap_grow_fail, "malloc.heap_grow_fail")
+// Allocations satisfied by a per-CPU cache, and the number of times a per-CPU
+// cache was refilled from or flushed to the free buckets.
+KCOUNTER(malloc_cpu_cache_hit, "malloc.cpu_cache.hit")
+KCOUNTER(malloc_cpu_cache_refill, "malloc.cpu_cache.refill")
+KCOUNTER(malloc_cpu_cache_flush, "malloc.cpu_cache.flush")
 
 #else
 
@@ -175,6 +196,29 @@ class __TA_SCOPED_CAPABILITY LockGuard {
   std::unique_lock<std::mutex> guard_;
 };
 
+// There is no notion of a current CPU on the host, so threads are assigned one
+// of a fixed number of caches instead; see current_cpu_cache().
+#define DECLARE_CPU_CACHE_LOCK(containing_type) std::mutex
+using CpuCacheLockGuard = LockGuard;
+constexpr size_t kNumCpuCaches = 16;
+constexpr size_t kCpuCacheAlignment = 64;
+
+// A stand-in for the kernel's <lib/relaxed_atomic.h>, covering what is used here.
+template <typename T>
+class RelaxedAtomic {
+ public:
+  constexpr RelaxedAtomic(T value) : wrapped_(value) {}
+
+  T load() const noexcept { return wrapped_.load(std::memory_order_relaxed); }
+  void store(T desired) noexcept { wrapped_.store(desired, std::memory_order_relaxed); }
+
+  operator T() const noexcept { return load(); }
+  T operator=(T value) noexcept { return store(value), value; }
+
+ private:
+  std::atomic<T> wrapped_;
+};
+
 #define LTRACEF(...)
 #define LTRACE_ENTRY
 #define INFO 1
@@ -318,13 +362,15 @@ NO_ASAN static void dump_free(header_t* header) TA_REQ(TheHeapLock::Get()) {
           (uintptr_t)header + header->size, header->size, header->size);
 }
 
-NO_ASAN static void cmpct_dump_locked(CmpctDumpOptions options) TA_REQ(TheHeapLock::Get()) {
+NO_ASAN static void cmpct_dump_locked(CmpctDumpOptions options, size_t cpu_cached)
+    TA_REQ(TheHeapLock::Get()) {
   // This function accesses free_t * that are poisoned so it has to be NO_ASAN
   dprintf(INFO, "Heap dump (using cmpctmalloc):\n");
-  dprintf(INFO, "\tsize %lu, remaining %lu, (used %lu) cached free %u\n",
+  dprintf(INFO, "\tsize %lu, remaining %lu, (used %lu) cached free %u, per-cpu cached %lu\n",
           static_cast<unsigned long>(theheap.size), static_cast<unsigned long>(theheap.remaining),
           static_cast<unsigned long>(theheap.size - theheap.remaining),
-          theheap.cached_os_alloc ? theheap.cached_os_alloc->size : 0);
+          theheap.cached_os_alloc ? theheap.cached_os_alloc->size : 0,
+          static_cast<unsigned long>(cpu_cached));
 
   if (static_cast<bool>(options & CmpctDumpOptions::Verbose)) {
     dprintf(INFO, "\tfree list:\n");
@@ -579,8 +625,7 @@ NO_ASAN static void FixLeftPointer(header_t* right, header_t* new_left) TA_REQ(T
 }
 
 #ifdef CMPCT_DEBUG
-[[maybe_unused]] NO_ASAN static void check_free_fill(void* ptr, size_t size)
-    TA_REQ(TheHeapLock::Get()) {
+[[maybe_unused]] NO_ASAN static void check_free_fill(void* ptr, size_t size) {
   // The first 16 bytes of the region won't have free fill due to overlap
   // with the allocator bookkeeping.
   const size_t start = sizeof(free_t) - sizeof(header_t);
@@ -684,6 +729,344 @@ NO_ASAN static bool heap_grow(size_t size) TA_REQ(TheHeapLock::Get()) {
   return true;
 }
 
+// Carves a memory area of |rounded_up| bytes, including the header, out of the
+// smallest non-empty free bucket at or above |start_bucket|, and returns its
+// payload. |size| is the number of bytes that were requested. If there is no
+// suitable free area the heap is grown, unless |grow| is false.
+//
+// Returns NULL if no memory area could be found.
+NO_ASAN static void* alloc_from_buckets(int start_bucket, size_t rounded_up, size_t size,
+                                        bool grow) TA_REQ(TheHeapLock::Get()) {
+  int bucket = find_nonempty_bucket(start_bucket);
+  if (bucket == -1) {
+    if (!grow) {
+      return NULL;
+    }
+    // Grow heap by at least 12% if we can.
+    size_t growby =
+        std::min(HEAP_LARGE_ALLOC_BYTES,
+                 std::max(theheap.size >> 3, std::max(kHeapUsableGrowSize, rounded_up)));
+    // Validate that our growby calculation is correct, and that if we grew the heap by this amount
+    // we would actually satisfy our allocation.
+    ZX_DEBUG_ASSERT(growby >= rounded_up);
+    // Try to add a new OS allocation to the heap, reducing the size until
+    // we succeed or get too small.
+    while (!heap_grow(growby)) {
+      if (growby <= rounded_up) {
+        return NULL;
+      }
+      growby = std::max(growby >> 1, rounded_up);
+    }
+    bucket = find_nonempty_bucket(start_bucket);
+    // It should be the case that, since we hold the heap lock, after growing the heap there should
+    // be something in our target bucket. However, if there was any confusion in calculating the
+    // |growby| amount, then it's possible we still do not have something. As this could only happen
+    // due to a systemic configuration error, and this should get caught in tests, this only needs
+    // to be a DEBUG_ASSERT and not a always enabled ASSERT. Further, it should not be possible for
+    // the assertion of the growby amount above to succeed and then this assertion to fail.
+    ZX_DEBUG_ASSERT(bucket != -1);
+  }
+  free_t* head = theheap.free_lists[bucket];
+  size_t left_over = head->header.size - rounded_up;
+  // We can't carve off the rest for a new free space if it's smaller than the
+  // free-list linked structure.  We also don't carve it off if it's less than
+  // 1.6% the size of the allocation.  This is to avoid small long-lived
+  // allocations being placed right next to large allocations, hindering
+  // coalescing and returning pages to the OS.
+  if (left_over >= sizeof(free_t) && left_over > (size >> 6)) {
+    header_t* right = right_header(&head->header);
+    unlink_free(head, bucket);
+    void* free = (char*)head + rounded_up;
+    create_free_area(free, head, left_over);
+    FixLeftPointer(right, (header_t*)free);
+    head->header.size -= static_cast<uint32_t>(left_over);
+  } else {
+    unlink_free(head, bucket);
+  }
+  return create_allocation_header(head, 0, head->header.size, head->header.left);
+}
+
+#ifdef CMPCT_DEBUG
+// Checks that the newly allocated area at |result| has not been written to
+// since it was freed, then fills the |size| requested bytes and the padding up
+// to the |rounded_up| bucket size.
+NO_ASAN static void debug_fill_allocation(void* result, size_t size, size_t rounded_up) {
+  check_free_fill(result, size);
+  memset(result, ALLOC_FILL, size);
+  memset(((char*)result) + size, PADDING_FILL, rounded_up - size);
+}
+#endif
+
+NO_ASAN static void cmpct_free_internal(void* payload, header_t* header)
+    TA_REQ(TheHeapLock::Get());
+
+// Per-CPU caches.
+//
+// Every CPU has a cache of free memory areas for each of the buckets up to
+// kCpuCacheMaxSize bytes. Small allocations and frees push and pop areas on
+// the current CPU's cache under a lock private to the cache, rather than under
+// the global heap lock. To the rest of the heap a cached area looks allocated,
+// so it is neither coalesced with its neighbors nor counted in
+// theheap.remaining. Cached areas are kept on a LIFO list, linked through the
+// first word of their payloads.
+//
+// An empty cache is refilled with half of its capacity from the free buckets,
+// and a full cache has half of its contents freed to the free buckets, so the
+// global heap lock is only taken once per batch of allocations or frees. The
+// capacity of a cache is bounded in bytes (see kCpuCacheClassBytes), and
+// cmpct_flush_cpu_caches() empties every cache, for when the memory is needed
+// elsewhere.
+//
+// The heap lock is never acquired while holding a cache lock, nor the other way
+// around.
+//
+// On the host there is no notion of a current CPU, and threads are instead
+// assigned one of kNumCpuCaches caches round-robin.
+
+#if KERNEL_ASAN
+// Every free must pass through the ASAN quarantine, so nothing is ever cached.
+constexpr bool kCpuCachesSupported = false;
+#else
+constexpr bool kCpuCachesSupported = true;
+#endif
+
+// Allocations which round up to at most this many bytes are cached.
+constexpr size_t kCpuCacheMaxSize = 256;
+
+// A cached memory area with a usable size of |size| bytes is kept with the
+// areas of bucket size_to_index_freeing(size), so that it can satisfy any
+// allocation which would be satisfied by that bucket.
+constexpr int kNumCpuCacheClasses = size_to_index_freeing(kCpuCacheMaxSize) + 1;
+
+// Each bucket of a cache holds about this many bytes, headers included, but
+// never fewer than kCpuCacheMinBlocks areas. This limits a CPU's cache to
+// roughly 32KB.
+constexpr size_t kCpuCacheClassBytes = 1024;
+constexpr uint32_t kCpuCacheMinBlocks = 8;
+
+struct CpuCacheCapacities {
+  uint32_t blocks[kNumCpuCacheClasses];
+};
+
+static constexpr CpuCacheCapacities ComputeCpuCacheCapacities() {
+  CpuCacheCapacities capacities{};
+  for (size_t size = 8; size <= kCpuCacheMaxSize; size += 8) {
+    const size_t rounded_up = SizeToIndexAllocating(size).rounded_up;
+    capacities.blocks[size_to_index_freeing(rounded_up)] =
+        std::max(kCpuCacheMinBlocks,
+                 static_cast<uint32_t>(kCpuCacheClassBytes / (rounded_up + sizeof(header_t))));
+  }
+  return capacities;
+}
+
+constexpr CpuCacheCapacities kCpuCacheCapacities = ComputeCpuCacheCapacities();
+
+struct CachedBlock {
+  CachedBlock* next;
+#if ZX_DEBUG_ASSERT_IMPLEMENTED
+  // Set to kCachedMagic while the area is in a cache. Cached areas are not
+  // tagged as free, so this is what catches them being freed a second time.
+  uint64_t magic;
+#endif
+};
+
+// Cached areas are at least as large as free areas, and the free fill only
+// starts after the bookkeeping of a free area, so it leaves CachedBlock alone.
+static_assert(sizeof(CachedBlock) <= sizeof(free_t) - sizeof(header_t));
+
+#if ZX_DEBUG_ASSERT_IMPLEMENTED
+constexpr uint64_t kCachedMagic = 0x636d7063'74636163;
+#endif
+
+struct alignas(kCpuCacheAlignment) CpuCache {
+  NO_ASAN void Push(int index, CachedBlock* block) TA_REQ(lock) {
+#if ZX_DEBUG_ASSERT_IMPLEMENTED
+    block->magic = kCachedMagic;
+#endif
+    block->next = blocks[index];
+    blocks[index] = block;
+    counts[index]++;
+    bytes += (reinterpret_cast<header_t*>(block) - 1)->size;
+  }
+
+  NO_ASAN CachedBlock* Pop(int index) TA_REQ(lock) {
+    CachedBlock* block = blocks[index];
+    if (block != NULL) {
+#if ZX_DEBUG_ASSERT_IMPLEMENTED
+      block->magic = 0;
+#endif
+      blocks[index] = block->next;
+      counts[index]--;
+      bytes -= (reinterpret_cast<header_t*>(block) - 1)->size;
+    }
+    return block;
+  }
+
+  // Moves up to |count| areas of bucket |index| onto the list |out|.
+  NO_ASAN void Take(int index, uint32_t count, CachedBlock** out) TA_REQ(lock) {
+    for (; count > 0; count--) {
+      CachedBlock* block = Pop(index);
+      if (block == NULL) {
+        return;
+      }
+      block->next = *out;
+      *out = block;
+    }
+  }
+
+  // Forgets every cached area without freeing it.
+  void Reset() TA_REQ(lock) {
+    for (int i = 0; i < kNumCpuCacheClasses; i++) {
+      blocks[i] = NULL;
+      counts[i] = 0;
+    }
+    bytes = 0;
+  }
+
+  DECLARE_CPU_CACHE_LOCK(CpuCache) lock;
+  CachedBlock* blocks[kNumCpuCacheClasses] TA_GUARDED(lock) = {};
+  uint32_t counts[kNumCpuCacheClasses] TA_GUARDED(lock) = {};
+  // The total size of the cached areas, including their headers.
+  size_t bytes TA_GUARDED(lock) = 0;
+};
+
+static CpuCache g_cpu_caches[kNumCpuCaches];
+static RelaxedAtomic<bool> g_cpu_caches_enabled{kCpuCachesSupported};
+
+#ifdef _KERNEL
+// Callers disable preemption so that the cache stays the current CPU's while
+// they use it. The cache lock is what makes that use safe, however, so being
+// migrated would only cost locality.
+static CpuCache& current_cpu_cache() { return g_cpu_caches[arch_curr_cpu_num()]; }
+#else
+static CpuCache& current_cpu_cache() {
+  static std::atomic<size_t> next_cache{0};
+  thread_local const size_t cache =
+      next_cache.fetch_add(1, std::memory_order_relaxed) % kNumCpuCaches;
+  return g_cpu_caches[cache];
+}
+#endif
+
+// Frees a list of areas taken from a cache to the free buckets.
+NO_ASAN static void free_cached_blocks(CachedBlock* blocks) TA_EXCL(TheHeapLock::Get()) {
+  LockGuard guard(TheHeapLock::Get());
+  LOCAL_TRACE_DURATION("locked", trace_lock);
+  while (blocks != NULL) {
+    CachedBlock* block = blocks;
+    blocks = blocks->next;
+    cmpct_free_internal(block, reinterpret_cast<header_t*>(block) - 1);
+  }
+}
+
+// Allocates |size| bytes, which round up to the bucket size |rounded_up|, from
+// the current CPU's cache, refilling the cache from the free buckets if it is
+// empty.
+//
+// Returns NULL, having reported the failure, if the heap could not be grown.
+NO_ASAN static void* cpu_cache_alloc(size_t size, int start_bucket, size_t rounded_up)
+    TA_EXCL(TheHeapLock::Get()) {
+  const int index = size_to_index_freeing(rounded_up);
+  CpuCache& cache = current_cpu_cache();
+  {
+    CpuCacheLockGuard guard{&cache.lock};
+    if (CachedBlock* block = cache.Pop(index); block != NULL) {
+#ifdef _KERNEL
+      kcounter_add(malloc_cpu_cache_hit, 1);
+#endif
+      return block;
+    }
+  }
+
+  // Only the area returned to the caller may grow the heap; the refill takes
+  // whatever is already free.
+  void* result;
+  CachedBlock* refill = NULL;
+  {
+    LockGuard guard(TheHeapLock::Get());
+    LOCAL_TRACE_DURATION("locked", trace_lock);
+    result = alloc_from_buckets(start_bucket, rounded_up + sizeof(header_t), size, true);
+    if (result == NULL) {
+      guard.Release();
+      heap_report_alloc_failure();
+      return NULL;
+    }
+    for (uint32_t i = 0; i < kCpuCacheCapacities.blocks[index] / 2; i++) {
+      CachedBlock* block = static_cast<CachedBlock*>(
+          alloc_from_buckets(start_bucket, rounded_up + sizeof(header_t), rounded_up, false));
+      if (block == NULL) {
+        break;
+      }
+      block->next = refill;
+      refill = block;
+    }
+  }
+#ifdef _KERNEL
+  kcounter_add(malloc_cpu_cache_refill, 1);
+#endif
+
+  CpuCacheLockGuard guard{&cache.lock};
+  while (refill != NULL) {
+    CachedBlock* block = refill;
+    refill = refill->next;
+    cache.Push(index, block);
+  }
+  return result;
+}
+
+// Frees the memory area |header| to the current CPU's cache, first freeing half
+// of the cache's areas of the same bucket to the free buckets if it is full.
+//
+// Returns false, having done nothing, if the area is too large to be cached.
+NO_ASAN static bool cpu_cache_free(header_t* header) TA_EXCL(TheHeapLock::Get()) {
+  ZX_ASSERT_MSG(header->size > sizeof(header_t), "got %u min %lu", header->size, sizeof(header_t));
+  const size_t usable = header->size - sizeof(header_t);
+  const int index = size_to_index_freeing(usable);
+  if (index >= kNumCpuCacheClasses) {
+    return false;
+  }
+  CachedBlock* const block = reinterpret_cast<CachedBlock*>(header + 1);
+  // An area freed again after it has left the cache for the free buckets is
+  // caught by cmpct_free_internal() when the cache is next flushed.
+#if ZX_DEBUG_ASSERT_IMPLEMENTED
+  ZX_DEBUG_ASSERT_MSG(block->magic != kCachedMagic, "double free of %p", block);
+#endif
+#ifdef CMPCT_DEBUG
+  // As with free areas, the fill starts after the bookkeeping.
+  const size_t fill_start = sizeof(free_t) - sizeof(header_t);
+  if (usable > fill_start) {
+    memset(reinterpret_cast<char*>(header + 1) + fill_start, FREE_FILL, usable - fill_start);
+  }
+#endif
+
+  CpuCache& cache = current_cpu_cache();
+  CachedBlock* flush = NULL;
+  {
+    CpuCacheLockGuard guard{&cache.lock};
+    const uint32_t capacity = kCpuCacheCapacities.blocks[index];
+    if (cache.counts[index] >= capacity) {
+      cache.Take(index, capacity / 2, &flush);
+    }
+    cache.Push(index, block);
+  }
+  if (flush != NULL) {
+#ifdef _KERNEL
+    kcounter_add(malloc_cpu_cache_flush, 1);
+#endif
+    free_cached_blocks(flush);
+  }
+  return true;
+}
+
+// Returns the total size of the areas held by the per-CPU caches.
+static size_t cpu_cache_bytes() {
+  size_t bytes = 0;
+  for (CpuCache& cache : g_cpu_caches) {
+    CpuCacheLockGuard guard{&cache.lock};
+    bytes += cache.bytes;
+  }
+  return bytes;
+}
+
 // Use HEAP_ENABLE_TESTS to enable internal testing. The tests are not useful
 // when the target system is up. By that time we have done hundreds of allocations
 // already.
@@ -913,72 +1296,39 @@ NO_ASAN void* cmpct_alloc(size_t size) {
   size_t rounded_up;
   int start_bucket = size_to_index_allocating(size, &rounded_up);
 
-  rounded_up += sizeof(header_t);
-
   PREEMPT_DISABLE(preempt_disable);
-  LockGuard guard(TheHeapLock::Get());
-  LOCAL_TRACE_DURATION("locked", trace_lock);
-  int bucket = find_nonempty_bucket(start_bucket);
-  if (bucket == -1) {
-    // Grow heap by at least 12% if we can.
-    size_t growby =
-        std::min(HEAP_LARGE_ALLOC_BYTES,
-                 std::max(theheap.size >> 3, std::max(kHeapUsableGrowSize, rounded_up)));
-    // Validate that our growby calculation is correct, and that if we grew the heap by this amount
-    // we would actually satisfy our allocation.
-    ZX_DEBUG_ASSERT(growby >= rounded_up);
-    // Try to add a new OS allocation to the heap, reducing the size until
-    // we succeed or get too small.
-    while (!heap_grow(growby)) {
-      if (growby <= rounded_up) {
-        guard.Release();
-        heap_report_alloc_failure();
-        return NULL;
-      }
-      growby = std::max(growby >> 1, rounded_up);
+  void* result;
+  if (kCpuCachesSupported && g_cpu_caches_enabled && rounded_up <= kCpuCacheMaxSize) {
+    result = cpu_cache_alloc(size, start_bucket, rounded_up);
+    if (result == NULL) {
+      return NULL;
     }
-    bucket = find_nonempty_bucket(start_bucket);
-    // It should be the case that, since we hold the heap lock, after growing the heap there should
-    // be something in our target bucket. However, if there was any confusion in calculating the
-    // |growby| amount, then it's possible we still do not have something. As this could only happen
-    // due to a systemic configuration error, and this should get caught in tests, this only needs
-    // to be a DEBUG_ASSERT and not a always enabled ASSERT. Further, it should not be possible for
-    // the assertion of the growby amount above to succeed and then this assertion to fail.
-    ZX_DEBUG_ASSERT(bucket != -1);
-  }
-  free_t* head = theheap.free_lists[bucket];
-  size_t left_over = head->header.size - rounded_up;
-  // We can't carve off the rest for a new free space if it's smaller than the
-  // free-list linked structure.  We also don't carve it off if it's less than
-  // 1.6% the size of the allocation.  This is to avoid small long-lived
-  // allocations being placed right next to large allocations, hindering
-  // coalescing and returning pages to the OS.
-  if (left_over >= sizeof(free_t) && left_over > (size >> 6)) {
-    header_t* right = right_header(&head->header);
-    unlink_free(head, bucket);
-    void* free = (char*)head + rounded_up;
-    create_free_area(free, head, left_over);
-    FixLeftPointer(right, (header_t*)free);
-    head->header.size -= static_cast<uint32_t>(left_over);
+#ifdef CMPCT_DEBUG
+    debug_fill_allocation(result, size, rounded_up);
+#endif
   } else {
-    unlink_free(head, bucket);
-  }
-  void* result = create_allocation_header(head, 0, head->header.size, head->header.left);
+    LockGuard guard(TheHeapLock::Get());
+    LOCAL_TRACE_DURATION("locked", trace_lock);
+    result = alloc_from_buckets(start_bucket, rounded_up + sizeof(header_t), size, true);
+    if (result == NULL) {
+      guard.Release();
+      heap_report_alloc_failure();
+      return NULL;
+    }
 #ifdef CMPCT_DEBUG
-  check_free_fill(result, size);
-  memset(result, ALLOC_FILL, size);
-  memset(((char*)result) + size, PADDING_FILL, rounded_up - size - sizeof(header_t));
+    debug_fill_allocation(result, size, rounded_up);
 #endif
 #if KERNEL_ASAN
-  const uintptr_t redzone_start = reinterpret_cast<uintptr_t>(result) + alloc_size;
+    const uintptr_t redzone_start = reinterpret_cast<uintptr_t>(result) + alloc_size;
 
-  asan_poison_shadow(reinterpret_cast<uintptr_t>(head), sizeof(header_t),
-                     kAsanHeapLeftRedzoneMagic);
-  asan_poison_shadow(redzone_start, asan_heap_redzone_size(alloc_size), kAsanHeapLeftRedzoneMagic);
-  asan_unpoison_shadow(reinterpret_cast<uintptr_t>(result), alloc_size);
+    asan_poison_shadow(reinterpret_cast<uintptr_t>(result) - sizeof(header_t), sizeof(header_t),
+                       kAsanHeapLeftRedzoneMagic);
+    asan_poison_shadow(redzone_start, asan_heap_redzone_size(alloc_size),
+                       kAsanHeapLeftRedzoneMagic);
+    asan_unpoison_shadow(reinterpret_cast<uintptr_t>(result), alloc_size);
 #endif  //  KERNEL_ASAN
+  }
 
-  guard.Release();
   if (alloc_size < g_fill_on_alloc_threshold) {
     memset(result, 0, alloc_size);
   }
@@ -1047,9 +1397,12 @@ NO_ASAN void cmpct_free(void* payload) {
   }
 
   PREEMPT_DISABLE(preempt_disable);
+  header_t* header = (header_t*)payload - 1;
+  if (kCpuCachesSupported && g_cpu_caches_enabled && cpu_cache_free(header)) {
+    return;
+  }
   LockGuard guard(TheHeapLock::Get());
   LOCAL_TRACE_DURATION("locked", trace_locked);
-  header_t* header = (header_t*)payload - 1;
   return cmpct_free_internal(payload, header);
 }
 
@@ -1060,8 +1413,6 @@ NO_ASAN void cmpct_sized_free(void* payload, size_t s) {
   }
 
   PREEMPT_DISABLE(preempt_disable);
-  LockGuard guard(TheHeapLock::Get());
-  LOCAL_TRACE_DURATION("locked", trace_locked);
   header_t* header = (header_t*)payload - 1;
   // header->size is the size of the heap block |payload| is in, plus sizeof(header_t), plus
   // the difference between the block size and the requested allocation size. If kernel ASAN
@@ -1079,6 +1430,11 @@ NO_ASAN void cmpct_sized_free(void* payload, size_t s) {
   ZX_ASSERT_MSG((static_cast<size_t>(header->size) - s) <= max_diff, "header->size %u s %lu",
                 header->size, s);
 #endif
+  if (kCpuCachesSupported && g_cpu_caches_enabled && cpu_cache_free(header)) {
+    return;
+  }
+  LockGuard guard(TheHeapLock::Get());
+  LOCAL_TRACE_DURATION("locked", trace_locked);
   return cmpct_free_internal(payload, header);
 }
 
@@ -1134,8 +1490,38 @@ NO_ASAN void* cmpct_memalign(size_t alignment, size_t size) {
 
 void cmpct_set_fill_on_alloc_threshold(size_t size) { g_fill_on_alloc_threshold = size; }
 
+void cmpct_flush_cpu_caches(void) {
+  for (CpuCache& cache : g_cpu_caches) {
+    CachedBlock* blocks = NULL;
+    {
+      CpuCacheLockGuard guard{&cache.lock};
+      for (int i = 0; i < kNumCpuCacheClasses; i++) {
+        cache.Take(i, UINT32_MAX, &blocks);
+      }
+    }
+    if (blocks != NULL) {
+      PREEMPT_DISABLE(preempt_disable);
+      free_cached_blocks(blocks);
+    }
+  }
+}
+
+void cmpct_set_cpu_caches_enabled(bool enabled) {
+  enabled = kCpuCachesSupported && enabled;
+  g_cpu_caches_enabled = enabled;
+  if (!enabled) {
+    cmpct_flush_cpu_caches();
+  }
+}
+
 void cmpct_init(void) {
   LTRACE_ENTRY;
+  // Anything still cached belongs to a previous incarnation of the heap.
+  for (CpuCache& cache : g_cpu_caches) {
+    CpuCacheLockGuard guard{&cache.lock};
+    cache.Reset();
+  }
+
   LockGuard guard(TheHeapLock::Get());
 
   // Initialize the free lists.
@@ -1156,21 +1542,31 @@ void cmpct_init(void) {
 
 void cmpct_dump(CmpctDumpOptions options) {
   if (static_cast<bool>(options & CmpctDumpOptions::PanicTime)) {
-    // If we are panic'ing, just skip the lock.  All bets are off anyway.
-    ([options]() TA_NO_THREAD_SAFETY_ANALYSIS { cmpct_dump_locked(options); })();
+    // If we are panic'ing, just skip the locks.  All bets are off anyway.
+    ([options]() TA_NO_THREAD_SAFETY_ANALYSIS {
+      size_t cpu_cached = 0;
+      for (const CpuCache& cache : g_cpu_caches) {
+        cpu_cached += cache.bytes;
+      }
+      cmpct_dump_locked(options, cpu_cached);
+    })();
   } else {
+    const size_t cpu_cached = cpu_cache_bytes();
     LockGuard guard(TheHeapLock::Get());
-    cmpct_dump_locked(options);
+    cmpct_dump_locked(options, cpu_cached);
   }
 }
 
 NO_ASAN void cmpct_get_info(size_t* used_bytes, size_t* free_bytes, size_t* cached_bytes) {
+  // Memory areas held by the per-CPU caches are free as far as the users of the
+  // heap are concerned.
+  const size_t cpu_cached = free_bytes ? cpu_cache_bytes() : 0;
   LockGuard guard(TheHeapLock::Get());
   if (used_bytes) {
     *used_bytes = theheap.size;
   }
   if (free_bytes) {
-    *free_bytes = theheap.remaining;
+    *free_bytes = theheap.remaining + cpu_cached;
   }
   if (cached_bytes) {
     *cached_bytes = 0;
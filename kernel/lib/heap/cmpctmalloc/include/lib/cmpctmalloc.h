@@ -46,6 +46,15 @@ void* cmpct_memalign(size_t alignment, size_t size) TA_EXCL(TheHeapLock::Get());
 
 // Zero-fill allocations smaller than |size|
 void cmpct_set_fill_on_alloc_threshold(size_t size);
+
+// Frees every memory area held by the per-CPU small-object caches back to the
+// heap, so that it can be coalesced and possibly returned to the OS.
+void cmpct_flush_cpu_caches(void) TA_EXCL(TheHeapLock::Get());
+
+// Enables or disables the per-CPU small-object caches, which are enabled by
+// default (unless built with ASAN). Disabling the caches flushes them. Must not
+// race with other heap operations.
+void cmpct_set_cpu_caches_enabled(bool enabled) TA_EXCL(TheHeapLock::Get());
 void cmpct_init(void) TA_EXCL(TheHeapLock::Get());
 void cmpct_dump(CmpctDumpOptions options) TA_EXCL(TheHeapLock::Get());
 void cmpct_get_info(size_t* used_bytes, size_t* free_bytes, size_t* cached_bytes)
@@ -13,6 +13,7 @@
 
 #include <algorithm>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include <zxtest/zxtest.h>
@@ -318,4 +319,78 @@ TEST_F(CmpctmallocTest, RetryOnHeapAllocBytesUltimatelyFails) {
   EXPECT_EQ(1, page_manager->GetFailuresReported());
 }
 
+TEST_F(CmpctmallocTest, CpuCachesAreFlushed) {
+  std::vector<void*> allocations;
+  for (size_t size = 1; size <= 256; size++) {
+    allocations.push_back(cmpct_alloc(size));
+  }
+  const size_t free_bytes = heap_free_bytes();
+  for (void* p : allocations) {
+    cmpct_free(p);
+  }
+
+  // Memory held by the per-CPU caches is accounted as free, but keeps the heap
+  // from coalescing it.
+  EXPECT_GT(heap_free_bytes(), free_bytes);
+  EXPECT_EQ(0, heap_cached_bytes());
+
+  // Once flushed, the heap's memory is entirely free again.
+  cmpct_flush_cpu_caches();
+  EXPECT_GT(heap_cached_bytes(), 0);
+  EXPECT_EQ(heap_used_bytes(), heap_cached_bytes());
+}
+
+TEST_F(CmpctmallocTest, CpuCachesCanBeDisabled) {
+  cmpct_set_cpu_caches_enabled(false);
+  auto cleanup = fit::defer([] { cmpct_set_cpu_caches_enabled(true); });
+
+  void* p = cmpct_alloc(64);
+  ASSERT_NOT_NULL(p);
+  cmpct_free(p);
+
+  // Nothing was cached, so the heap's memory is entirely free again.
+  EXPECT_GT(heap_cached_bytes(), 0);
+  EXPECT_EQ(heap_used_bytes(), heap_cached_bytes());
+}
+
+TEST_F(CmpctmallocTest, ConcurrentSmallAllocsAndFrees) {
+  constexpr size_t kNumThreads = 4;
+  constexpr size_t kNumIterations = 1000;
+  constexpr size_t kWorkingSet = 32;
+
+  auto churn = [](uint8_t fill) {
+    std::default_random_engine generator(kRandomSeed + fill);
+    std::uniform_int_distribution<size_t> sizes(1, 256);
+    std::vector<std::pair<uint8_t*, size_t>> allocated;
+    for (size_t i = 0; i < kNumIterations; i++) {
+      for (size_t j = 0; j < kWorkingSet; j++) {
+        size_t size = sizes(generator);
+        auto* p = static_cast<uint8_t*>(cmpct_alloc(size));
+        ZX_ASSERT(p != nullptr);
+        memset(p, fill, size);
+        allocated.emplace_back(p, size);
+      }
+      std::shuffle(allocated.begin(), allocated.end(), generator);
+      for (auto [p, size] : allocated) {
+        // No other thread may have been handed an overlapping allocation.
+        ZX_ASSERT(std::all_of(p, p + size, [fill](uint8_t b) { return b == fill; }));
+        cmpct_free(p);
+      }
+      allocated.clear();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kNumThreads; i++) {
+    threads.emplace_back(churn, static_cast<uint8_t>(i + 1));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  cmpct_flush_cpu_caches();
+  EXPECT_EQ(heap_used_bytes(), heap_cached_bytes());
+  EXPECT_EQ(0, page_manager->GetFailuresReported());
+}
+
 }  // namespace
@@ -277,6 +277,8 @@ void heap_get_info(size_t* total_bytes, size_t* free_bytes) {
   }
 }
 
+void heap_trim() { cmpct_flush_cpu_caches(); }
+
 static void heap_test() { cmpct_test(); }
 
 void* heap_page_alloc(size_t pages) {
@@ -398,6 +400,13 @@ static int cmd_heap(int argc, const cmd_args* argv, uint32_t flags) {
     dump_stats();
   } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "test") == 0) {
     heap_test();
+  } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "trim") == 0) {
+    size_t total_before;
+    size_t total_after;
+    heap_get_info(&total_before, nullptr);
+    heap_trim();
+    heap_get_info(&total_after, nullptr);
+    printf("heap size %zu -> %zu bytes\n", total_before, total_after);
   } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "trace") == 0) {
     heap_trace = !heap_trace;
     printf("heap trace is now %s\n", heap_trace ? "on" : "off");
@@ -34,6 +34,11 @@ void sized_free(void* ptr, size_t s);
 // from the PMM), |free_bytes| is the free portion.
 void heap_get_info(size_t* total_bytes, size_t* free_bytes);
 
+// Returns the free memory the heap is holding on to for performance reasons,
+// such as the per-CPU small-object caches, to the heap proper, so that it may
+// be returned to the PMM.
+void heap_trim(void);
+
 // called once at kernel initialization
 void heap_init(void);
 
@@ -18,19 +18,25 @@
 #include <zircon/errors.h>
 #include <zircon/types.h>
 
+#include <arch/defines.h>
 #include <arch/user_copy.h>
+#include <fbl/ref_ptr.h>
 #include <kernel/lockdep.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
 #include <ktl/atomic.h>
 #include <ktl/forward.h>
 #include <ktl/move.h>
+#include <ktl/unique_ptr.h>
 
 // Fwd decl of tests to allow friendship.
 namespace ktrace_tests {
 class TestKTraceState;
 }
 
+class EventDispatcher;
+class VmObject;
+
 namespace internal {
 
 class KTraceState {
@@ -69,6 +75,24 @@ class KTraceState {
   // mode will be part of the static region of the buffer.  It is, however, not
   // legal to start a trace in Circular mode, then stop it, and then attempt to
   // start it again in Saturate mode.
+  //
+  // Records are written to the buffer of the CPU they were written on, and the
+  // rules above apply to each of the per-CPU buffers independently.  Saturating
+  // the buffer of any CPU clears the group mask for the whole trace, while in
+  // circular mode each CPU purges only its own oldest records.  Reading the
+  // trace merges the per-CPU buffers into a single stream of records ordered by
+  // timestamp.
+  //
+  // A trace may also be started in streaming mode (see StartStreaming), in
+  // which records are continuously drained from the per-CPU buffers into a
+  // ring shared with a userspace consumer while tracing stays active.
+  // Streaming always starts from a rewound trace, and each per-CPU buffer is
+  // used as a circular buffer whose oldest records are consumed by the drain
+  // instead of being purged by writers.  If a CPU's buffer is full, records
+  // written on that CPU are dropped (and counted) until the drain catches up,
+  // but tracing is never stopped.  Records which are still in the per-CPU
+  // buffers when a streaming trace is stopped, because the consumer fell
+  // behind, can be read with ReadUser like those of a circular trace.
   enum class StartMode { Saturate, Circular };
 
   constexpr KTraceState() = default;
@@ -79,7 +103,8 @@ class KTraceState {
   // should behave as no-ops.
   //
   // |target_bufsize| : The target size (in bytes) of the ktrace buffer to be
-  // allocated.  Must be a multiple of 8 bytes.
+  // allocated.  Must be a multiple of 8 bytes.  The buffer is divided equally
+  // between the per-CPU buffers.
   //
   // |initial_groups| : The initial set of enabled trace groups (see
   // zircon-internal/ktrace.h).  If non-zero, causes Init to attempt to allocate
@@ -87,16 +112,28 @@ class KTraceState {
   // group mask is zero, allocation is delayed until the first time that start
   // is called.
   //
-  void Init(uint32_t target_bufsize, uint32_t initial_groups) TA_EXCL(lock_, write_lock_);
-
-  [[nodiscard]] zx_status_t Start(uint32_t groups, StartMode mode) TA_EXCL(lock_, write_lock_);
-  [[nodiscard]] zx_status_t Stop() TA_EXCL(lock_, write_lock_);
-  [[nodiscard]] zx_status_t Rewind() TA_EXCL(lock_, write_lock_) {
+  void Init(uint32_t target_bufsize, uint32_t initial_groups) TA_EXCL(lock_);
+
+  [[nodiscard]] zx_status_t Start(uint32_t groups, StartMode mode) TA_EXCL(lock_);
+  [[nodiscard]] zx_status_t Stop() TA_EXCL(lock_);
+
+  // Rewind the trace and start it in streaming mode.  |vmo| receives a
+  // ktrace_stream_header_t followed by the ring of records (see
+  // zircon-internal/ktrace.h), and must be at least a page larger than the
+  // header offset.  The ring may be no larger than the trace buffer, since all
+  // of it is pinned and mapped into the kernel; ZX_ERR_OUT_OF_RANGE is returned
+  // otherwise.  |event| is signaled when |watermark| bytes of the ring are
+  // unread (or half of the ring, if |watermark| is zero), and when the stream
+  // is stopped.  The stream is stopped by Stop.
+  [[nodiscard]] zx_status_t StartStreaming(uint32_t groups, fbl::RefPtr<VmObject> vmo,
+                                           fbl::RefPtr<EventDispatcher> event, uint32_t watermark)
+      TA_EXCL(lock_);
+  [[nodiscard]] zx_status_t Rewind() TA_EXCL(lock_) {
     Guard<Mutex> guard(&lock_);
     return RewindLocked();
   }
 
-  ssize_t ReadUser(user_out_ptr<void> ptr, uint32_t off, size_t len) TA_EXCL(lock_, write_lock_);
+  ssize_t ReadUser(user_out_ptr<void> ptr, uint32_t off, size_t len) TA_EXCL(lock_);
 
   uint32_t grpmask() const {
     return static_cast<uint32_t>(grpmask_.load(ktl::memory_order_acquire));
@@ -194,7 +231,10 @@ class KTraceState {
     }
     uint64_t* const ptr = ReserveRaw(fxt::RecordFields::RecordSize::Get<uint32_t>(header));
     if (ptr == nullptr) {
-      ClearMaskDisableWrites();
+      // A streaming trace drops the record, but keeps tracing.
+      if (!streaming_.load(ktl::memory_order_relaxed)) {
+        ClearMaskDisableWrites();
+      }
       DecPendingWrite();
       return zx::error(ZX_ERR_NO_MEMORY);
     }
@@ -254,14 +294,6 @@ class KTraceState {
     write_state_.fetch_and(~kWritesEnabledMask, ktl::memory_order_release);
   }
 
-  // Convert an absolute read or write pointer into an offset into the circular
-  // region of the buffer.  Note that it is illegal to call this if we are not
-  // operating in circular mode.
-  uint32_t PtrToCircularOffset(uint64_t ptr) const TA_REQ(write_lock_) {
-    DEBUG_ASSERT(circular_size_ > 0);
-    return static_cast<uint32_t>((ptr % circular_size_) + wrap_offset_);
-  }
-
   uint32_t inflight_writes() const {
     return static_cast<uint32_t>(write_state_.load(ktl::memory_order_acquire) &
                                  kWritesInFlightMask);
@@ -325,69 +357,81 @@ class KTraceState {
   DECLARE_MUTEX(KTraceState) lock_;
   bool is_started_ TA_GUARDED(lock_){false};
 
-  // The core allocation state of the trace buffer, protected by the write
-  // spinlock.  See "Notes on KTrace operating modes" (above) for details on
-  // saturate vs. circular mode.  This comment will describe how the bookkeeping
-  // maintained in each of the two modes, how wrapping is handled in circular
-  // mode, and how space for records in the buffer is reserved and subsequently
-  // committed.
+  // True once the trace has been started in circular mode, until the next
+  // rewind.
+  bool is_circular_ TA_GUARDED(lock_){false};
+
+  // The core allocation state of a per-CPU trace buffer, protected by the
+  // buffer's spinlock.  See "Notes on KTrace operating modes" (above) for
+  // details on saturate vs. circular mode.  This comment will describe how the
+  // bookkeeping maintained in each of the two modes, how wrapping is handled in
+  // circular mode, and how space for records in the buffer is reserved and
+  // subsequently committed.
+  //
+  // --== Per-CPU buffers ==--
+  //
+  // Writers reserve space in the buffer of the CPU they are running on, with
+  // interrupts disabled for the duration of the reservation.  Writers on
+  // different CPUs never touch the same buffer, so a buffer's spinlock is only
+  // ever contended by control operations (such as Start) which need to update
+  // the bookkeeping of every buffer.  Each CPU's buffer is aligned to, and sized
+  // in multiples of, the cache line size.
   //
   // --== Saturate mode ==--
   //
-  // While operating in saturate mode, the value of |circular_size_| and |rd_|
-  // will always be 0, and the value of |wrap_offset_| is not defined.  The only
-  // important piece of bookkeeping maintained is the value of |wr_|.  |wr_|
+  // While operating in saturate mode, the value of |circular_size| and |rd|
+  // will always be 0, and the value of |wrap_offset| is not defined.  The only
+  // important piece of bookkeeping maintained is the value of |wr|.  |wr|
   // always points to the offset in the buffer where the next record will be
-  // stored, and it should always be <= |bufsize_|.  When reading back records,
-  // the first record will always be located at offset 0.
+  // stored, and it should always be <= |size|.  When reading back records, the
+  // first record will always be located at offset 0.
   //
   // --== Circular mode ==--
   //
   // When operating in circular mode, the buffer is partitioned into two
   // regions; a "static" region which contains the records recorded before
   // entering circular mode, and a circular region which contain records written
-  // after beginning circular operation.  |circular_size_| must be non-zero, and
-  // contains the size (in bytes) of the circular region of the buffer.  The
-  // region of the buffer from [0, wrap_offset_) is the static region of the
-  // buffer, while the region from [wrap_offset_, bufsize_) is the circular
-  // region.  |wrap_offset_| must always be < |bufsize_|.
-  //
-  // The |rd_| and |wr_| pointers are absolute offsets into the circular region
-  // of the buffer, modulo |circular_size_|.  When space in the buffer is
-  // reserved for a record, |wr_| is incremented by the size of the record.
-  // When a record is purged to make room for new records, |rd_| is incremented.
-  // At all times, |rd_| <= |wr_|, and both pointers are monotonically
+  // after beginning circular operation.  |circular_size| contains the size (in
+  // bytes) of the circular region of the buffer.  The region of the buffer from
+  // [0, wrap_offset) is the static region of the buffer, while the region from
+  // [wrap_offset, size) is the circular region.
+  //
+  // The |rd| and |wr| pointers are absolute offsets into the circular region
+  // of the buffer, modulo |circular_size|.  When space in the buffer is
+  // reserved for a record, |wr| is incremented by the size of the record.
+  // When a record is purged to make room for new records, |rd| is incremented.
+  // At all times, |rd| <= |wr|, and both pointers are monotonically
   // increasing.  The function which maps from one of these pointers to an
-  // offset in the buffer (on the range [0, bufsize_)) is given by
+  // offset in the buffer (on the range [0, size)) is given by
   //
-  //   f(ptr) = (ptr % circular_size_) + wrap_offset_
+  //   f(ptr) = (ptr % circular_size) + wrap_offset
   //
   // --== Reserving records and memory ordering ==--
   //
   // In order to write a record to the trace buffer, the writer must first
-  // reserve the space to do so.  During this period of time, the |write_lock_|
+  // reserve the space to do so.  During this period of time, the buffer's lock
   // is held while the bookkeeping is handled in order to reserve space.
-  // Holding the write lock during reservation guarantees coherent observations
-  // of the bookkeeping state by the writers.
   //
   // If the reservation succeeds, the tag field of the reserved record is stored
-  // as 0 with release semantics, then the write lock is dropped in order to
-  // allow other reservations to take place concurrently while the payload of
-  // the record is populated.  Once the writer has finished recording the
-  // payload, it must write the final tag value for the record with release
-  // semantics.  This finalizes the record, and after this operation, the
-  // payload may no longer change.
+  // as 0 with release semantics, then the lock is dropped in order to allow
+  // other reservations to take place while the payload of the record is
+  // populated.  Once the writer has finished recording the payload, it must
+  // write the final tag value for the record with release semantics.  This
+  // finalizes the record, and after this operation, the payload may no longer
+  // change.
   //
   // If, while operating in circular mode, an old record needs to be purged in
-  // order to make space for a new record, the |rd_| pointer will simply be
-  // incremented by the size of the record located at the |rd_| pointer.  The
+  // order to make space for a new record, the |rd| pointer will simply be
+  // incremented by the size of the record located at the |rd| pointer.  The
   // tag of this record must first be read with memory order acquire semantics
-  // in order to compute its length so that the |rd_| pointer may be adjusted
+  // in order to compute its length so that the |rd| pointer may be adjusted
   // appropriately.  If, during this observation, the value of the tag is
   // observed to be 0, it means that a writer is attempting to advance the read
-  // pointer past a record which has not been fully committed yet.  If this ever
-  // happens, the reservation operation fails, and the group mask will be
-  // cleared, just like if a reservation had failed in saturating mode.
+  // pointer past a record which has not been fully committed yet (for example,
+  // the record of a thread which was interrupted between reserving and
+  // committing).  If this ever happens, the reservation operation fails, and
+  // the group mask will be cleared, just like if a reservation had failed in
+  // saturating mode.
   //
   // --== Circular mode padding ==--
   //
@@ -399,29 +443,119 @@ class KTraceState {
   // out so that the record to be written may exist contiguously in the trace
   // buffer.
   //
-  DECLARE_SPINLOCK_WITH_TYPE(KTraceState, TraceDisabledSpinLock) write_lock_;
-  uint64_t rd_ TA_GUARDED(write_lock_){0};
-  uint64_t wr_ TA_GUARDED(write_lock_){0};
-  uint32_t circular_size_ TA_GUARDED(write_lock_){0};
-  uint32_t wrap_offset_ TA_GUARDED(write_lock_){0};
-
-  // Note: these don't _actually_ have to be protected by the write lock.
-  // Memory ordering consistency for mutators of these variables are protected
-  // via lock_, while observations from trace writers are actually protected by
-  // a complicated set of arguments based on the stopped/started state of the
-  // system, and the acq/rel semantics of the grpmask_ variable.
-  //
-  // Instead of relying on these complicated and difficult to
-  // communicate/enforce invariants, however, we just toss these variables into
-  // the write lock and leave it at that.  Trace writers already needed to be
-  // inside of the write lock to manipulate the read/write pointers while
-  // reserving space.  Mutation of these variables can only happen during
-  // start/init when the system is stopped (and there are no writers), so
-  // obtaining the write lock to allocate the buffer is basically free since it
-  // will never be contested.
-  //
-  uint8_t* buffer_ TA_GUARDED(write_lock_){nullptr};
-  uint32_t bufsize_ TA_GUARDED(write_lock_){0};
+  struct alignas(MAX_CACHE_LINE) CpuBuffer {
+    // Convert an absolute read or write pointer into an offset into the
+    // circular region of the buffer.  Note that it is illegal to call this if we
+    // are not operating in circular mode.
+    uint32_t PtrToCircularOffset(uint64_t ptr) const TA_REQ(lock) {
+      DEBUG_ASSERT(circular_size > 0);
+      return static_cast<uint32_t>((ptr % circular_size) + wrap_offset);
+    }
+
+    DECLARE_SPINLOCK_WITH_TYPE(CpuBuffer, TraceDisabledSpinLock) lock;
+    uint64_t rd TA_GUARDED(lock){0};
+    uint64_t wr TA_GUARDED(lock){0};
+    uint32_t circular_size TA_GUARDED(lock){0};
+    uint32_t wrap_offset TA_GUARDED(lock){0};
+
+    // The number of records dropped because the buffer was full while
+    // streaming.
+    uint64_t dropped TA_GUARDED(lock){0};
+
+    // The buffer's storage.  Assigned when the trace buffer is allocated, while
+    // writes are disabled, and never changed afterwards.
+    uint8_t* data{nullptr};
+    uint32_t size{0};
+  };
+
+  // A stopped trace's view of the records in one per-CPU buffer, and the
+  // position in that buffer of the next record to be merged into the stream of
+  // records returned by ReadUser.  Draining a streaming trace uses the same
+  // view of the committed records of each buffer.
+  struct ReadCursor {
+    // Returns the next record to be merged, or nullptr if all of the buffer's
+    // records have been merged.
+    const uint64_t* Peek() const;
+
+    // Returns the timestamp the record returned by Peek should be merged by.
+    // Records without a timestamp (such as string and kernel object records)
+    // are merged by the timestamp of the record which preceded them in this
+    // buffer, which keeps them ahead of the records which refer to them.
+    uint64_t MergeKey(const uint64_t* record) const;
+
+    // Moves past the record returned by Peek.
+    void Advance(const uint64_t* record);
+
+    const uint8_t* data{nullptr};
+    uint64_t rd{0};
+    uint32_t circular_size{0};
+    uint32_t wrap_offset{0};
+    uint32_t avail{0};
+
+    // The logical offset of the next record, on the range [0, avail), where
+    // the static region (if any) comes first.
+    uint32_t pos{0};
+    uint64_t timestamp{0};
+  };
+
+  // Snapshot the bookkeeping of each per-CPU buffer into the read cursors and
+  // rewind them, if this has not been done since the trace last changed.
+  void PrepareReadCursors() TA_REQ(lock_);
+
+  // Rewind the read cursors to the start of the merged stream of records.
+  void RewindReadCursors() TA_REQ(lock_);
+
+  // Select the cursor of |cursors| whose next record comes next in the merged
+  // stream, or nullptr if all records have been merged.
+  static ReadCursor* NextReadCursor(ReadCursor* cursors, uint32_t num_cursors);
+
+  // The state of a streaming trace, defined in ktrace.cc.
+  struct StreamState;
+
+  // Stop the stream's drain thread, drain whatever the ring has room for, and
+  // release the stream.  Called by Stop once writes have stopped.
+  void StopStreaming() TA_REQ(lock_);
+
+  // Move the committed records of each per-CPU buffer into the stream's ring,
+  // for as long as the ring has room for them.
+  void DrainStream(StreamState& stream) TA_REQ(stream_lock_);
+
+  // The body of the thread which periodically drains a streaming trace.
+  static int StreamThread(void* arg);
+
+  // Whether each CPU gets its own buffer.  Overridden by test code to measure
+  // the cost of funneling every CPU's records through a single buffer.
+  bool per_cpu_buffers_{true};
+
+  // The per-CPU buffers, and the single allocation which backs them.  These
+  // are only changed by AllocBuffer (with lock_ held) before writes are first
+  // enabled, and writers only access them while writes are enabled, so the
+  // acq/rel semantics of |write_state_| order the two.
+  ktl::unique_ptr<CpuBuffer[]> cpu_buffers_;
+  uint32_t num_cpu_buffers_{0};
+  uint8_t* buffer_{nullptr};
+  uint32_t bufsize_{0};
+
+  // The state of the merge performed by ReadUser.  Consecutive reads of the
+  // trace at increasing offsets resume the merge where the previous read left
+  // off, instead of merging everything before |read_offset_| again.
+  ktl::unique_ptr<ReadCursor[]> read_cursors_ TA_GUARDED(lock_);
+  bool read_cursors_valid_ TA_GUARDED(lock_){false};
+  // The number of bytes of merged records which precede the read cursors.
+  size_t read_offset_ TA_GUARDED(lock_){0};
+  // The total number of bytes of merged records.
+  size_t read_avail_ TA_GUARDED(lock_){0};
+
+  // True while a streaming trace is started.  Set before writes are enabled
+  // and cleared after they have been disabled, so writers observe it through
+  // |write_state_|.
+  ktl::atomic<bool> streaming_{false};
+
+  // The current stream, if any.  Draining is serialized by |stream_lock_|
+  // rather than |lock_|, so that Stop can wait for the drain thread to exit
+  // while holding |lock_|.
+  ktl::unique_ptr<StreamState> stream_ TA_GUARDED(lock_);
+  DECLARE_MUTEX(KTraceState) stream_lock_;
 };
 
 }  // namespace internal
@@ -17,16 +17,25 @@
 #include <zircon/errors.h>
 #include <zircon/types.h>
 
+#include <arch/interrupt.h>
 #include <arch/ops.h>
 #include <arch/user_copy.h>
 #include <fbl/alloc_checker.h>
 #include <hypervisor/ktrace.h>
+#include <kernel/event.h>
 #include <kernel/koid.h>
+#include <kernel/thread.h>
+#include <ktl/algorithm.h>
 #include <ktl/atomic.h>
-#include <ktl/iterator.h>
+#include <ktl/limits.h>
+#include <ktl/unique_ptr.h>
 #include <lk/init.h>
+#include <object/event_dispatcher.h>
 #include <object/thread_dispatcher.h>
+#include <vm/pinned_vm_object.h>
+#include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
+#include <vm/vm_object.h>
 
 #include <ktl/enforce.h>
 
@@ -80,6 +89,25 @@ const fxt::InternedString* ktrace_find_probe(const char* name) {
 
 void ktrace_add_probe(const fxt::InternedString& interned_string) { interned_string.GetId(); }
 
+// The FXT magic number and initialization record which start every trace.
+void GetFxtMetadata(uint64_t (&metadata)[3]) {
+  // FXT Magic bytes
+  metadata[0] = 0x0016547846040010;
+  // FXT Initialization Record
+  metadata[1] = 0x21;
+  metadata[2] = ticks_per_second();
+}
+
+// Circular buffers are padded out to their end with records which have
+// nothing but a size.
+bool IsPaddingRecord(uint64_t header) {
+  return header == fxt::RecordFields::RecordSize::Make(
+                       fxt::RecordFields::RecordSize::Get<uint64_t>(header));
+}
+
+// How often a streaming trace is drained into its ring.
+constexpr zx_duration_t kStreamDrainPeriod = ZX_MSEC(10);
+
 void ktrace_report_probes() {
   for (const fxt::InternedString& interned_string : fxt::InternedString::IterateList) {
     fxt_string_record(interned_string.id, interned_string.string,
@@ -114,7 +142,73 @@ void CpuContextMap::Init() {
 
 namespace internal {
 
+struct KTraceState::StreamState {
+  explicit StreamState(KTraceState* state) : state(state) {}
+
+  ~StreamState() {
+    if (mapping != nullptr) {
+      mapping->Destroy();
+    }
+  }
+
+  // The number of bytes of the ring which the consumer has not consumed yet.
+  // The consumer's read offset is not trusted; one which is ahead of the write
+  // offset, or which has fallen more than a ring behind it, leaves no room.
+  uint64_t Unread() const {
+    const uint64_t read_offset =
+        ktl::atomic_ref<uint64_t>(header->read_offset).load(ktl::memory_order_acquire);
+    return (read_offset <= write_offset) ? ktl::min<uint64_t>(write_offset - read_offset, ring_size)
+                                         : ring_size;
+  }
+
+  // Copy |len| bytes to the ring at the write offset, wrapping around its end
+  // if needed.  The caller must have checked that the ring has room for them.
+  void Write(const void* src, size_t len) {
+    DEBUG_ASSERT(len <= ring_size);
+    const size_t offset = write_offset % ring_size;
+    const size_t first = ktl::min<size_t>(len, ring_size - offset);
+    memcpy(ring + offset, src, first);
+    memcpy(ring, static_cast<const uint8_t*>(src) + first, len - first);
+    write_offset += len;
+  }
+
+  // Make everything written so far visible to the consumer, and signal it if
+  // the watermark has been reached.
+  void Publish(uint64_t dropped_records) {
+    ktl::atomic_ref<uint64_t>(header->dropped_records)
+        .store(dropped_records, ktl::memory_order_relaxed);
+    ktl::atomic_ref<uint64_t>(header->write_offset).store(write_offset, ktl::memory_order_release);
+    if (Unread() >= watermark) {
+      event->user_signal_self(0, ZX_EVENT_SIGNALED);
+    }
+  }
+
+  KTraceState* const state;
+  fbl::RefPtr<EventDispatcher> event;
+
+  // The stream's VMO is pinned and mapped into the kernel for as long as the
+  // stream exists.
+  PinnedVmObject pin;
+  fbl::RefPtr<VmMapping> mapping;
+  ktrace_stream_header_t* header{nullptr};
+  uint8_t* ring{nullptr};
+  uint32_t ring_size{0};
+  uint32_t watermark{0};
+
+  // The kernel's copy of |header->write_offset|.  The consumer cannot be
+  // trusted to leave the shared one alone.
+  uint64_t write_offset{0};
+
+  // The drain's position in each of the per-CPU buffers.  Only the timestamps
+  // carry over from one drain to the next.
+  ktl::unique_ptr<ReadCursor[]> cursors;
+
+  Thread* thread{nullptr};
+  Event stop_event;
+};
+
 KTraceState::~KTraceState() {
+  DEBUG_ASSERT(stream_ == nullptr);
   if (buffer_ != nullptr) {
     VmAspace* aspace = VmAspace::kernel_aspace();
     aspace->FreeRegion(reinterpret_cast<vaddr_t>(buffer_));
@@ -167,13 +261,13 @@ zx_status_t KTraceState::Start(uint32_t groups, StartMode mode) {
   // that we were not previously operating in circular mode.  It is not legal to
   // re-start a ktrace buffer in saturating mode which had been operating in
   // circular mode.
-  if (mode == StartMode::Saturate) {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-    if (circular_size_ != 0) {
-      return ZX_ERR_BAD_STATE;
-    }
+  if ((mode == StartMode::Saturate) && is_circular_) {
+    return ZX_ERR_BAD_STATE;
   }
 
+  // Whatever we have read so far is about to change.
+  read_cursors_valid_ = false;
+
   // If we are not yet started, we need to report the current thread and process
   // names.
   if (!is_started_) {
@@ -184,17 +278,22 @@ zx_status_t KTraceState::Start(uint32_t groups, StartMode mode) {
   }
 
   // If we are changing from saturating mode, to circular mode, we need to
-  // update our circular bookkeeping.
-  {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-    if ((mode == StartMode::Circular) && (circular_size_ == 0)) {
+  // update the circular bookkeeping of each of the per-CPU buffers.
+  if ((mode == StartMode::Circular) && !is_circular_) {
+    for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+      CpuBuffer& cb = cpu_buffers_[i];
+      Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
       // Mark the point at which the static data ends and the circular
-      // portion of the buffer starts (the "wrap offset").
-      DEBUG_ASSERT(wr_ <= bufsize_);
-      wrap_offset_ = static_cast<uint32_t>(ktl::min<uint64_t>(bufsize_, wr_));
-      circular_size_ = bufsize_ - wrap_offset_;
-      wr_ = 0;
+      // portion of the buffer starts (the "wrap offset").  A buffer which has
+      // no room left for a circular region remains saturated.
+      DEBUG_ASSERT(cb.wr <= cb.size);
+      cb.wrap_offset = static_cast<uint32_t>(ktl::min<uint64_t>(cb.size, cb.wr));
+      cb.circular_size = cb.size - cb.wrap_offset;
+      if (cb.circular_size != 0) {
+        cb.wr = 0;
+      }
     }
+    is_circular_ = true;
   }
 
   // It's possible that a |ReserveRaw| failure may have disabled writes so make
@@ -240,9 +339,220 @@ zx_status_t KTraceState::Stop() {
 
   // Great, we are now officially stopped.  Record this.
   is_started_ = false;
+  if (stream_ != nullptr) {
+    StopStreaming();
+  }
   return ZX_OK;
 }
 
+zx_status_t KTraceState::StartStreaming(uint32_t groups, fbl::RefPtr<VmObject> vmo,
+                                        fbl::RefPtr<EventDispatcher> event, uint32_t watermark) {
+  Guard<Mutex> guard(&lock_);
+
+  if ((groups == 0) || (vmo == nullptr) || (event == nullptr)) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  const uint64_t vmo_size = vmo->size();
+  if ((vmo_size <= KTRACE_STREAM_RING_OFFSET) || ((vmo_size % PAGE_SIZE) != 0) ||
+      (vmo_size - KTRACE_STREAM_RING_OFFSET > ktl::numeric_limits<uint32_t>::max())) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+  const uint32_t ring_size = static_cast<uint32_t>(vmo_size - KTRACE_STREAM_RING_OFFSET);
+  if (ring_size > target_bufsize_) {
+    return ZX_ERR_OUT_OF_RANGE;
+  }
+  if (watermark == 0) {
+    watermark = ring_size / 2;
+  } else if (watermark > ring_size) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  // A stream starts from an empty trace, so it cannot be started on top of
+  // another trace.
+  if (is_started_) {
+    return ZX_ERR_BAD_STATE;
+  }
+
+  if (zx_status_t status = AllocBuffer(); status != ZX_OK) {
+    return status;
+  }
+
+  fbl::AllocChecker ac;
+  ktl::unique_ptr<StreamState> stream{new (&ac) StreamState{this}};
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+  stream->cursors.reset(new (&ac) ReadCursor[num_cpu_buffers_]);
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+
+  // Pin the VMO and map it into the kernel, so that draining never has to
+  // fault in pages.
+  zx_status_t status = PinnedVmObject::Create(vmo, 0, vmo_size, /*write=*/true, &stream->pin);
+  if (status != ZX_OK) {
+    return status;
+  }
+  zx::result<VmAddressRegion::MapResult> mapping_result =
+      VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+          0, vmo_size, 0, 0, ktl::move(vmo), 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+          "ktrace stream");
+  if (mapping_result.is_error()) {
+    return mapping_result.status_value();
+  }
+  stream->mapping = ktl::move(mapping_result->mapping);
+  if ((status = stream->mapping->MapRange(0, vmo_size, /*commit=*/true)) != ZX_OK) {
+    return status;
+  }
+
+  uint8_t* const base = reinterpret_cast<uint8_t*>(mapping_result->base);
+  stream->header = reinterpret_cast<ktrace_stream_header_t*>(base);
+  stream->ring = base + KTRACE_STREAM_RING_OFFSET;
+  stream->ring_size = ring_size;
+  stream->watermark = watermark;
+  stream->event = ktl::move(event);
+  *stream->header = ktrace_stream_header_t{.ring_size = ring_size};
+
+  // The stream starts with our fxt metadata, just like a trace which is read
+  // with ReadUser.
+  uint64_t metadata[3];
+  GetFxtMetadata(metadata);
+  stream->Write(metadata, sizeof(metadata));
+  ktl::atomic_ref<uint64_t>(stream->header->write_offset)
+      .store(stream->write_offset, ktl::memory_order_release);
+
+  stream->thread =
+      Thread::Create("ktrace-stream", &KTraceState::StreamThread, stream.get(), DEFAULT_PRIORITY);
+  if (stream->thread == nullptr) {
+    return ZX_ERR_NO_MEMORY;
+  }
+
+  // Start from an empty trace, with each of the per-CPU buffers operating as a
+  // circular buffer which covers the whole buffer.
+  [[maybe_unused]] zx_status_t rewind_res = RewindLocked();
+  DEBUG_ASSERT(rewind_res == ZX_OK);
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    CpuBuffer& cb = cpu_buffers_[i];
+    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
+    cb.circular_size = cb.size;
+    cb.dropped = 0;
+  }
+  is_circular_ = true;
+  streaming_.store(true, ktl::memory_order_relaxed);
+
+  stream_ = ktl::move(stream);
+  stream_->thread->Resume();
+
+  // The static names are streamed like every other record.
+  is_started_ = true;
+  EnableWrites();
+  ReportStaticNames();
+  ReportThreadProcessNames();
+  SetGroupMask(groups);
+
+  DiagsPrintf(INFO, "ktrace: streaming to a %u byte ring, category mask 0x%03x\n", ring_size,
+              groups);
+  return ZX_OK;
+}
+
+void KTraceState::StopStreaming() {
+  DEBUG_ASSERT(!is_started_);
+
+  // Stop the drain thread, then drain whatever is left, as far as the ring has
+  // room for it.  Records the ring has no room for stay in the per-CPU buffers,
+  // where they can still be read with ReadUser.
+  stream_->stop_event.Signal();
+  stream_->thread->Join(nullptr, ZX_TIME_INFINITE);
+  {
+    Guard<Mutex> stream_guard{&stream_lock_};
+    DrainStream(*stream_);
+  }
+
+  ktl::atomic_ref<uint32_t>(stream_->header->flags)
+      .fetch_or(KTRACE_STREAM_FLAG_STOPPED, ktl::memory_order_release);
+  stream_->event->user_signal_self(0, ZX_EVENT_SIGNALED);
+
+  stream_.reset();
+  streaming_.store(false, ktl::memory_order_relaxed);
+  read_cursors_valid_ = false;
+}
+
+int KTraceState::StreamThread(void* arg) {
+  StreamState& stream = *static_cast<StreamState*>(arg);
+  KTraceState& state = *stream.state;
+  while (stream.stop_event.WaitDeadline(current_time() + kStreamDrainPeriod, Interruptible::No) ==
+         ZX_ERR_TIMED_OUT) {
+    Guard<Mutex> stream_guard{&state.stream_lock_};
+    state.DrainStream(stream);
+  }
+  return 0;
+}
+
+void KTraceState::DrainStream(StreamState& stream) {
+  uint64_t dropped_records = 0;
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    CpuBuffer& cb = cpu_buffers_[i];
+    ReadCursor& cursor = stream.cursors[i];
+    uint64_t wr;
+    {
+      Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
+      DEBUG_ASSERT(cb.circular_size > 0);
+      cursor.rd = cb.rd;
+      cursor.circular_size = cb.circular_size;
+      cursor.wrap_offset = cb.wrap_offset;
+      wr = cb.wr;
+      dropped_records += cb.dropped;
+    }
+    cursor.data = cb.data;
+    cursor.pos = 0;
+
+    // Only the records before the first one which has not been committed yet
+    // can be drained.  While streaming, writers never touch the records
+    // between |rd| and |wr| other than to commit them, so once a record has
+    // been observed to be committed it can be read without the buffer's lock.
+    uint64_t committed = cursor.rd;
+    while (committed < wr) {
+      uint64_t* tag_ptr = reinterpret_cast<uint64_t*>(
+          cb.data + (committed % cursor.circular_size) + cursor.wrap_offset);
+      const uint64_t tag = ktl::atomic_ref<uint64_t>(*tag_ptr).load(ktl::memory_order_acquire);
+      const uint32_t size = fxt::RecordFields::RecordSize::Get<uint32_t>(tag) * 8;
+      if (size == 0) {
+        break;
+      }
+      committed += size;
+    }
+    cursor.avail = static_cast<uint32_t>(committed - cursor.rd);
+  }
+
+  // Merge the drained records into the ring in timestamp order.  Records are
+  // only ordered within a single drain; a record which was committed late may
+  // come after records with later timestamps from an earlier drain.
+  uint64_t room = stream.ring_size - stream.Unread();
+  while (ReadCursor* const cursor = NextReadCursor(stream.cursors.get(), num_cpu_buffers_)) {
+    const uint64_t* record = cursor->Peek();
+    const uint32_t size = fxt::RecordFields::RecordSize::Get<uint32_t>(*record) * 8;
+    if (!IsPaddingRecord(*record)) {
+      if (size > room) {
+        break;
+      }
+      stream.Write(record, size);
+      room -= size;
+    }
+    cursor->Advance(record);
+  }
+
+  // Hand the space of the drained records back to the writers.
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    CpuBuffer& cb = cpu_buffers_[i];
+    const ReadCursor& cursor = stream.cursors[i];
+    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
+    cb.rd = cursor.rd + cursor.pos;
+  }
+
+  stream.Publish(dropped_records);
+}
+
 zx_status_t KTraceState::RewindLocked() {
   if (is_started_) {
     return ZX_ERR_BAD_STATE;
@@ -253,36 +563,122 @@ zx_status_t KTraceState::RewindLocked() {
   DEBUG_ASSERT_MSG((observed = write_state_.load(ktl::memory_order_acquire)) == 0, "0x%lx",
                    observed);
 
-  {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-    // 1 magic bytes record: 8 bytes
-    // 1 Initialization/tickrate record: 16 bytes
-    const size_t fxt_metadata_size = 24;
-
-    // roll back to just after the metadata
-    rd_ = 0;
-    wr_ = fxt_metadata_size;
-
-    // After a rewind, we are no longer in circular buffer mode.
-    wrap_offset_ = 0;
-    circular_size_ = 0;
-
-    // We cannot add metadata rewind if we have not allocated a buffer yet.
-    if (buffer_ == nullptr) {
-      wr_ = 0;
-      return ZX_OK;
+  // Roll each of the per-CPU buffers back to the beginning.  After a rewind, we
+  // are no longer in circular buffer mode.
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    CpuBuffer& cb = cpu_buffers_[i];
+    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
+    cb.rd = 0;
+    cb.wr = 0;
+    cb.wrap_offset = 0;
+    cb.circular_size = 0;
+  }
+  is_circular_ = false;
+  read_cursors_valid_ = false;
+
+  return ZX_OK;
+}
+
+const uint64_t* KTraceState::ReadCursor::Peek() const {
+  if (pos >= avail) {
+    return nullptr;
+  }
+
+  const uint32_t offset =
+      ((circular_size == 0) || (pos < wrap_offset))
+          ? pos
+          : static_cast<uint32_t>(((rd + (pos - wrap_offset)) % circular_size) + wrap_offset);
+  const uint64_t* record = reinterpret_cast<const uint64_t*>(data + offset);
+
+  // Every reserved record has been committed by the time the trace is stopped,
+  // so a record with no length, or one which runs past the end of the buffer's
+  // records, means the buffer is corrupt.  Stop merging this buffer instead of
+  // looping forever.
+  const uint32_t size = fxt::RecordFields::RecordSize::Get<uint32_t>(*record) * 8;
+  if ((size == 0) || (size > avail - pos)) {
+    return nullptr;
+  }
+
+  return record;
+}
+
+uint64_t KTraceState::ReadCursor::MergeKey(const uint64_t* record) const {
+  // Event, scheduler, and log records store their timestamp in the word which
+  // follows the record header.
+  const uint32_t type = fxt::RecordFields::Type::Get<uint32_t>(*record);
+  const uint32_t size = fxt::RecordFields::RecordSize::Get<uint32_t>(*record);
+  const bool has_timestamp = (type == static_cast<uint32_t>(fxt::RecordType::kEvent)) ||
+                             (type == static_cast<uint32_t>(fxt::RecordType::kScheduler)) ||
+                             (type == static_cast<uint32_t>(fxt::RecordType::kLog));
+  return (has_timestamp && (size >= 2)) ? record[1] : timestamp;
+}
+
+void KTraceState::ReadCursor::Advance(const uint64_t* record) {
+  timestamp = MergeKey(record);
+  pos += fxt::RecordFields::RecordSize::Get<uint32_t>(*record) * 8;
+}
+
+void KTraceState::PrepareReadCursors() {
+  if (read_cursors_valid_) {
+    return;
+  }
+
+  read_avail_ = 0;
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    CpuBuffer& cb = cpu_buffers_[i];
+    ReadCursor& cursor = read_cursors_[i];
+    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&cb.lock};
+
+    // The amount of data we have to exfiltrate is equal to the distance
+    // between the read and the write pointers, plus the non-circular region of
+    // the buffer (if we are in circular mode).
+    cursor.data = cb.data;
+    cursor.rd = cb.rd;
+    cursor.circular_size = cb.circular_size;
+    cursor.wrap_offset = cb.wrap_offset;
+    if (cb.circular_size == 0) {
+      DEBUG_ASSERT(cb.rd == 0);
+      DEBUG_ASSERT(cb.wr <= cb.size);
+      cursor.avail = static_cast<uint32_t>(cb.wr);
+    } else {
+      DEBUG_ASSERT(cb.rd <= cb.wr);
+      DEBUG_ASSERT((cb.wr - cb.rd) <= cb.circular_size);
+      cursor.avail = static_cast<uint32_t>(cb.wr - cb.rd) + cb.wrap_offset;
     }
+    read_avail_ += cursor.avail;
+  }
+
+  read_cursors_valid_ = true;
+  RewindReadCursors();
+}
 
-    // Write our fxt metadata -- our magic number and timestamp resolution.
-    uint64_t* recs = reinterpret_cast<uint64_t*>(buffer_);
-    // FXT Magic bytes
-    recs[0] = 0x0016547846040010;
-    // FXT Initialization Record
-    recs[1] = 0x21;
-    recs[2] = ticks_per_second();
+void KTraceState::RewindReadCursors() {
+  for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+    read_cursors_[i].pos = 0;
+    read_cursors_[i].timestamp = 0;
   }
+  read_offset_ = 0;
+}
 
-  return ZX_OK;
+KTraceState::ReadCursor* KTraceState::NextReadCursor(ReadCursor* cursors, uint32_t num_cursors) {
+  // Records within each buffer are (very nearly) in timestamp order already,
+  // so merging only needs to compare the next record of each buffer.  Ties go
+  // to the lowest numbered CPU, which keeps the merge deterministic.
+  ReadCursor* next = nullptr;
+  uint64_t next_key = 0;
+  for (uint32_t i = 0; i < num_cursors; ++i) {
+    ReadCursor& cursor = cursors[i];
+    const uint64_t* record = cursor.Peek();
+    if (record == nullptr) {
+      continue;
+    }
+    const uint64_t key = cursor.MergeKey(record);
+    if ((next == nullptr) || (key < next_key)) {
+      next = &cursor;
+      next_key = key;
+    }
+  }
+  return next;
 }
 
 ssize_t KTraceState::ReadUser(user_out_ptr<void> ptr, uint32_t off, size_t len) {
@@ -307,110 +703,19 @@ ssize_t KTraceState::ReadUser(user_out_ptr<void> ptr, uint32_t off, size_t len)
   DEBUG_ASSERT_MSG((observed = write_state_.load(ktl::memory_order_acquire)) == 0, "0x%lx",
                    observed);
 
-  // Grab the write lock, then figure out what we need to copy.  We need to make
-  // sure to drop the lock before calling CopyToUser (holding spinlocks while
-  // copying to user mode memory is not allowed because of the possibility of
-  // faulting).
-  //
-  // It may appear like a bad thing to drop the lock before performing the copy,
-  // but it really should not be much of an issue.  The grpmask is disabled, so
-  // no new writes are coming in, and the lock_ is blocking any other threads
-  // which might be attempting command and control operations.
-  //
-  // The only potential place where another thread might contend on the write
-  // lock here would be if someone was trying to add a name record to the trace
-  // with the |always| flag set (ignoring the grpmask).  This should only ever
-  // happen during rewind and start operations which are serialized by lock_.
-  struct Region {
-    uint8_t* ptr{nullptr};
-    size_t len{0};
-  };
-
-  struct ToCopy {
-    size_t avail{0};
-    Region regions[3];
-  } to_copy = [this, &off, &len]() -> ToCopy {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-
-    // The amount of data we have to exfiltrate is equal to the distance between
-    // the read and the write pointers, plus the non-circular region of the buffer
-    // (if we are in circular mode).
-    const uint32_t avail = [this]() TA_REQ(write_lock_) -> uint32_t {
-      if (circular_size_ == 0) {
-        DEBUG_ASSERT(rd_ == 0);
-        DEBUG_ASSERT(wr_ <= bufsize_);
-        return static_cast<uint32_t>(wr_);
-      } else {
-        DEBUG_ASSERT(rd_ <= wr_);
-        DEBUG_ASSERT((wr_ - rd_) <= circular_size_);
-        return static_cast<uint32_t>(wr_ - rd_) + wrap_offset_;
-      }
-    }();
-
-    // constrain read to available buffer
-    if (off >= avail) {
-      return ToCopy{};
-    }
-
-    len = ktl::min<size_t>(len, avail - off);
-
-    ToCopy ret{.avail = avail};
-    uint32_t ndx = 0;
-
-    // Go ahead report the region(s) of data which need to be copied.
-    if (circular_size_ == 0) {
-      // Non-circular mode is simple.
-      DEBUG_ASSERT(ndx < ktl::size(ret.regions));
-      Region& r = ret.regions[ndx++];
-      r.ptr = buffer_ + off;
-      r.len = len;
-    } else {
-      // circular mode requires a bit more care.
-      size_t remaining = len;
-
-      // Start by consuming the non-circular portion of the buffer, taking into
-      // account the offset.
-      if (off < wrap_offset_) {
-        const size_t todo = ktl::min<size_t>(wrap_offset_ - off, remaining);
-
-        DEBUG_ASSERT(ndx < ktl::size(ret.regions));
-        Region& r = ret.regions[ndx++];
-        r.ptr = buffer_ + off;
-        r.len = todo;
-
-        remaining -= todo;
-        off = 0;
-      } else {
-        off -= wrap_offset_;
-      }
-
-      // Now consume as much of the circular payload as we have space for.
-      if (remaining) {
-        const uint32_t rd_offset = PtrToCircularOffset(rd_ + off);
-        DEBUG_ASSERT(rd_offset <= bufsize_);
-        size_t todo = ktl::min<size_t>(bufsize_ - rd_offset, remaining);
-
-        {
-          DEBUG_ASSERT(ndx < ktl::size(ret.regions));
-          Region& r = ret.regions[ndx++];
-          r.ptr = buffer_ + rd_offset;
-          r.len = todo;
-        }
-
-        remaining -= todo;
-
-        if (remaining) {
-          DEBUG_ASSERT(remaining <= (rd_offset - wrap_offset_));
-          DEBUG_ASSERT(ndx < ktl::size(ret.regions));
-          Region& r = ret.regions[ndx++];
-          r.ptr = buffer_ + wrap_offset_;
-          r.len = remaining;
-        }
-      }
-    }
+  // If we have not allocated a buffer yet, there is nothing to read, not even
+  // the metadata.
+  if (cpu_buffers_ == nullptr) {
+    return 0;
+  }
 
-    return ret;
-  }();
+  // The trace starts with our fxt metadata -- our magic number and timestamp
+  // resolution -- followed by the records of each of the per-CPU buffers,
+  // merged in timestamp order.
+  uint64_t metadata[3];
+  GetFxtMetadata(metadata);
+  PrepareReadCursors();
+  const size_t avail = sizeof(metadata) + read_avail_;
 
   // null read is a query for trace buffer size
   //
@@ -421,36 +726,105 @@ ssize_t KTraceState::ReadUser(user_out_ptr<void> ptr, uint32_t off, size_t len)
   // all of the available bytes, but someday the defined behavior of this API
   // needs to be clearly specified.
   if (!ptr) {
-    return to_copy.avail;
+    return avail;
   }
 
   // constrain read to available buffer
-  if (off >= to_copy.avail) {
+  if (off >= avail) {
     return 0;
   }
+  len = ktl::min<size_t>(len, avail - off);
 
-  // Go ahead and copy the data.
+  // Copy the data, coalescing runs of records which are contiguous in memory
+  // (usually, consecutive records from the same CPU) into a single copy.
   auto ptr8 = ptr.reinterpret<uint8_t>();
-  size_t done = 0;
-  for (const auto& r : to_copy.regions) {
-    if (r.ptr != nullptr) {
-      zx_status_t copy_result = ZX_OK;
-      // Performing user copies whilst holding locks is not generally allowed, however in this case
-      // the entire purpose of lock_ is to serialize these operations and so is safe to be held for
-      // this copy.
-      //
-      // TOOD(https://fxbug.dev/42052646): Determine if this should be changed to capture faults and
-      // resolve them outside the lock.
-      guard.CallUntracked([&] { copy_result = CopyToUser(ptr8.byte_offset(done), r.ptr, r.len); });
-      if (copy_result != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+  size_t copied = 0;
+  struct Region {
+    const uint8_t* ptr{nullptr};
+    size_t len{0};
+  } pending;
+  auto Flush = [&]() -> zx_status_t {
+    if (pending.len == 0) {
+      return ZX_OK;
+    }
+    zx_status_t copy_result = ZX_OK;
+    // Performing user copies whilst holding locks is not generally allowed, however in this case
+    // the entire purpose of lock_ is to serialize these operations and so is safe to be held for
+    // this copy.
+    //
+    // TOOD(https://fxbug.dev/42052646): Determine if this should be changed to capture faults and
+    // resolve them outside the lock.
+    guard.CallUntracked(
+        [&] { copy_result = CopyToUser(ptr8.byte_offset(copied), pending.ptr, pending.len); });
+    copied += pending.len;
+    pending = Region{};
+    return copy_result;
+  };
+  auto Append = [&](const uint8_t* src, size_t todo) -> zx_status_t {
+    if (pending.ptr + pending.len != src) {
+      if (zx_status_t status = Flush(); status != ZX_OK) {
+        return status;
       }
+      pending.ptr = src;
+    }
+    pending.len += todo;
+    return ZX_OK;
+  };
+
+  size_t done = 0;
+  if (off < sizeof(metadata)) {
+    const size_t todo = ktl::min<size_t>(sizeof(metadata) - off, len);
+    if (Append(reinterpret_cast<const uint8_t*>(metadata) + off, todo) != ZX_OK) {
+      return ZX_ERR_INVALID_ARGS;
     }
+    done += todo;
+  }
 
-    done += r.len;
+  // Sequential reads resume the merge where the previous read stopped.  Reads
+  // which go backwards have to start the merge over.
+  size_t stream_off = ktl::max<size_t>(off, sizeof(metadata)) - sizeof(metadata);
+  if (stream_off < read_offset_) {
+    RewindReadCursors();
+  }
+
+  while (done < len) {
+    ReadCursor* const cursor = NextReadCursor(read_cursors_.get(), num_cpu_buffers_);
+    if (cursor == nullptr) {
+      break;
+    }
+    const uint64_t* record = cursor->Peek();
+    const size_t record_size = fxt::RecordFields::RecordSize::Get<size_t>(*record) * 8;
+
+    // Skip over records which come entirely before the requested range.
+    if (read_offset_ + record_size <= stream_off) {
+      cursor->Advance(record);
+      read_offset_ += record_size;
+      continue;
+    }
+
+    const size_t skip = stream_off - read_offset_;
+    const size_t todo = ktl::min(record_size - skip, len - done);
+    if (Append(reinterpret_cast<const uint8_t*>(record) + skip, todo) != ZX_OK) {
+      return ZX_ERR_INVALID_ARGS;
+    }
+    done += todo;
+    stream_off += todo;
+
+    // If we only had room for part of this record, leave the cursor on it so
+    // that the next read picks up where this one left off.
+    if (skip + todo < record_size) {
+      break;
+    }
+    cursor->Advance(record);
+    read_offset_ += record_size;
+  }
+
+  if (Flush() != ZX_OK) {
+    return ZX_ERR_INVALID_ARGS;
   }
 
   // Success!
+  DEBUG_ASSERT(copied == done);
   return done;
 }
 
@@ -467,11 +841,8 @@ void KTraceState::ReportThreadProcessNames() {
 zx_status_t KTraceState::AllocBuffer() {
   // The buffer is allocated once, then never deleted.  If it has already been
   // allocated, then we are done.
-  {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-    if (buffer_) {
-      return ZX_OK;
-    }
+  if (cpu_buffers_ != nullptr) {
+    return ZX_OK;
   }
 
   // We require that our buffer be a multiple of page size, and non-zero.  If
@@ -488,6 +859,27 @@ zx_status_t KTraceState::AllocBuffer() {
 
   DEBUG_ASSERT(is_started_ == false);
 
+  // Split the buffer evenly between the CPUs, in whole cache lines so that no
+  // two CPUs ever write to the same line.
+  const uint32_t num_cpu_buffers = per_cpu_buffers_ ? arch_max_num_cpus() : 1;
+  const uint32_t cpu_bufsize =
+      fbl::round_down(target_bufsize_ / num_cpu_buffers, static_cast<uint32_t>(MAX_CACHE_LINE));
+  if (!cpu_bufsize) {
+    DiagsPrintf(INFO, "ktrace: buffer of %u bytes is too small for %u CPUs\n", target_bufsize_,
+                num_cpu_buffers);
+    return ZX_ERR_NOT_SUPPORTED;
+  }
+
+  fbl::AllocChecker ac;
+  ktl::unique_ptr<CpuBuffer[]> cpu_buffers{new (&ac) CpuBuffer[num_cpu_buffers]};
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+  ktl::unique_ptr<ReadCursor[]> read_cursors{new (&ac) ReadCursor[num_cpu_buffers]};
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+
   zx_status_t status;
   VmAspace* aspace = VmAspace::kernel_aspace();
   void* ptr;
@@ -497,14 +889,19 @@ zx_status_t KTraceState::AllocBuffer() {
     return ZX_ERR_NO_MEMORY;
   }
 
-  {
-    Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-    buffer_ = static_cast<uint8_t*>(ptr);
-    bufsize_ = target_bufsize_;
+  buffer_ = static_cast<uint8_t*>(ptr);
+  bufsize_ = target_bufsize_;
+  for (uint32_t i = 0; i < num_cpu_buffers; ++i) {
+    cpu_buffers[i].data = buffer_ + (i * cpu_bufsize);
+    cpu_buffers[i].size = cpu_bufsize;
   }
-  DiagsPrintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ptr, target_bufsize_);
+  cpu_buffers_ = ktl::move(cpu_buffers);
+  num_cpu_buffers_ = num_cpu_buffers;
+  read_cursors_ = ktl::move(read_cursors);
+  DiagsPrintf(INFO, "ktrace: buffer at %p (%u bytes, %u x %u bytes per CPU)\n", ptr,
+              target_bufsize_, num_cpu_buffers, cpu_bufsize);
 
-  // Rewind will take care of writing the metadata records as it resets the state.
+  // Rewind will take care of resetting the state.
   [[maybe_unused]] zx_status_t rewind_res = RewindLocked();
   DEBUG_ASSERT(rewind_res == ZX_OK);
 
@@ -522,14 +919,20 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
     ktl::atomic_ref(*ptr).store(tag, ktl::memory_order_release);
   };
 
-  Guard<TraceDisabledSpinLock, IrqSave> write_guard{&write_lock_};
-  if (!bufsize_) {
+  if (cpu_buffers_ == nullptr) {
     return nullptr;
   }
 
-  if (circular_size_ == 0) {
-    DEBUG_ASSERT(bufsize_ >= wr_);
-    const size_t space = bufsize_ - wr_;
+  // Reserve space in the buffer of the CPU we are running on.  Keeping
+  // interrupts disabled keeps us on this CPU until the reservation is complete,
+  // so the buffer's lock is never contended by writers on other CPUs.
+  InterruptDisableGuard irqd;
+  CpuBuffer& cb = cpu_buffers_[per_cpu_buffers_ ? arch_curr_cpu_num() : 0];
+  Guard<TraceDisabledSpinLock, NoIrqSave> write_guard{&cb.lock};
+
+  if (cb.circular_size == 0) {
+    DEBUG_ASSERT(cb.size >= cb.wr);
+    const size_t space = cb.size - cb.wr;
 
     // if there is not enough space, we are done.
     if (space < num_bytes) {
@@ -539,14 +942,14 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
     // We have the space for this record.  Stash the tag with a sentinel value
     // of zero, indicating that there is a reservation here, but that the record
     // payload has not been fully committed yet.
-    uint64_t* ptr = reinterpret_cast<uint64_t*>(buffer_ + wr_);
+    uint64_t* ptr = reinterpret_cast<uint64_t*>(cb.data + cb.wr);
     Commit(ptr, kUncommitedRecordTag);
-    wr_ += num_bytes;
+    cb.wr += num_bytes;
     return ptr;
   } else {
     // If there is not enough space in this circular buffer to hold our message,
     // don't even try.  Just give up.
-    if (num_bytes > circular_size_) {
+    if (num_bytes > cb.circular_size) {
       return nullptr;
     }
 
@@ -557,19 +960,25 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
       // hold our record, we reserve that amount of space instead, so that we
       // can put in a placeholder record at the end of the buffer which will be
       // skipped, in addition to our actual record.
-      const uint32_t wr_offset = PtrToCircularOffset(wr_);
-      const uint32_t contiguous_space = bufsize_ - wr_offset;
+      const uint32_t wr_offset = cb.PtrToCircularOffset(cb.wr);
+      const uint32_t contiguous_space = cb.size - wr_offset;
       const uint32_t to_reserve = ktl::min(contiguous_space, num_bytes);
       DEBUG_ASSERT((to_reserve > 0) && ((to_reserve & 0x7) == 0));
 
       // Do we have the space for our reservation?  If not, then
       // move the read pointer forward until we do.
-      DEBUG_ASSERT((wr_ >= rd_) && ((wr_ - rd_) <= circular_size_));
-      size_t avail = circular_size_ - (wr_ - rd_);
+      DEBUG_ASSERT((cb.wr >= cb.rd) && ((cb.wr - cb.rd) <= cb.circular_size));
+      size_t avail = cb.circular_size - (cb.wr - cb.rd);
+      // While streaming, the oldest records belong to the drain.  Drop this
+      // record instead of purging them.
+      if ((avail < to_reserve) && streaming_.load(ktl::memory_order_relaxed)) {
+        ++cb.dropped;
+        return nullptr;
+      }
       while (avail < to_reserve) {
         // We have to have space for a header tag.
-        const uint32_t rd_offset = PtrToCircularOffset(rd_);
-        DEBUG_ASSERT(bufsize_ - rd_offset >= sizeof(uint64_t));
+        const uint32_t rd_offset = cb.PtrToCircularOffset(cb.rd);
+        DEBUG_ASSERT(cb.size - rd_offset >= sizeof(uint64_t));
 
         // Make sure that we read the next tag in the sequence with acquire
         // semantics.  Before committing, records which have been reserved in
@@ -577,7 +986,7 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
         // lock. During commit, however, the actual record tag (with non-zero
         // length) will be written to memory atomically with release semantics,
         // outside of the lock.
-        uint64_t* rd_tag_ptr = reinterpret_cast<uint64_t*>(buffer_ + rd_offset);
+        uint64_t* rd_tag_ptr = reinterpret_cast<uint64_t*>(cb.data + rd_offset);
         const uint64_t rd_tag =
             ktl::atomic_ref<uint64_t>(*rd_tag_ptr).load(ktl::memory_order_acquire);
         const uint32_t sz = fxt::RecordFields::RecordSize::Get<uint32_t>(rd_tag) * 8;
@@ -591,7 +1000,7 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
         }
 
         // Now go ahead and move read up.
-        rd_ += sz;
+        cb.rd += sz;
         avail += sz;
       }
 
@@ -599,8 +1008,8 @@ uint64_t* KTraceState::ReserveRaw(uint32_t num_words) {
       // for our entire record, go ahead and reserve the space now.  Otherwise,
       // stuff in a placeholder which fills all of the remaining contiguous
       // space in the buffer, then try the allocation again.
-      uint64_t* ptr = reinterpret_cast<uint64_t*>(buffer_ + wr_offset);
-      wr_ += to_reserve;
+      uint64_t* ptr = reinterpret_cast<uint64_t*>(cb.data + wr_offset);
+      cb.wr += to_reserve;
       if (num_bytes == to_reserve) {
         Commit(ptr, kUncommitedRecordTag);
         return ptr;
@@ -663,6 +1072,12 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
   return ZX_OK;
 }
 
+zx_status_t ktrace_start_streaming(uint32_t groups, fbl::RefPtr<VmObject> vmo,
+                                   fbl::RefPtr<EventDispatcher> event, uint32_t watermark) {
+  return KTRACE_STATE.StartStreaming(groups ? groups : KTRACE_GRP_ALL, ktl::move(vmo),
+                                     ktl::move(event), watermark);
+}
+
 static void ktrace_init(unsigned level) {
   // There's no utility in setting up the singleton ktrace instance if there are
   // no syscalls to access it. See zircon/kernel/syscalls/debug.cc for the
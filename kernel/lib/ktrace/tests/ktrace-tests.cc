@@ -4,15 +4,22 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <inttypes.h>
+#include <lib/arch/intrin.h>
+#include <lib/console.h>
 #include <lib/fit/defer.h>
 #include <lib/fxt/serializer.h>
 #include <lib/ktrace/ktrace_internal.h>
 #include <lib/unittest/unittest.h>
 
+#include <kernel/mp.h>
+#include <kernel/thread.h>
 #include <ktl/algorithm.h>
 #include <ktl/limits.h>
 #include <ktl/unique_ptr.h>
-#include <vm/vm_aspace.h>
+#include <object/event_dispatcher.h>
+#include <platform/timer.h>
+#include <vm/vm_object_paged.h>
 
 #include <ktl/enforce.h>
 
@@ -23,21 +30,21 @@ namespace ktrace_tests {
 class TestKTraceState : public ::internal::KTraceState {
  public:
   using StartMode = internal::KTraceState::StartMode;
+  // The size of the buffer of each CPU.
   static constexpr uint32_t kDefaultBufferSize = 4096;
 
-  // Immediately after initialization, ktrace will write two metadata records
-  // expressing the version of the trace buffer format, as well as the
-  // resolution of the timestamps in the trace.  This initial offset value
-  // reflects that.
-  static constexpr uint32_t kInitialOffset = sizeof(uint64_t) * 3;
+  // When read, the trace starts with two metadata records expressing the
+  // version of the trace buffer format, as well as the resolution of the
+  // timestamps in the trace.  These are not stored in the per-CPU buffers, so
+  // records are written starting at the beginning of each buffer.
+  static constexpr uint32_t kMetadataSize = sizeof(uint64_t) * 3;
+  static constexpr uint32_t kInitialOffset = 0;
 
-  // Figure out how many 32 byte records we should be able to fit into our
-  // default buffer size, minus the two metadata records we consume up front.  Since we
-  // always allocate buffers in multiples of page size, we should be able to
-  // assert that this is an integral number of records.
-  static_assert(kDefaultBufferSize > kInitialOffset);
-  static_assert(((kDefaultBufferSize - kInitialOffset) % 8) == 0);
-  static constexpr uint32_t kMaxWords = (kDefaultBufferSize - kInitialOffset) / sizeof(uint64_t);
+  // Figure out how many words we should be able to fit into our default buffer
+  // size.  Since we always allocate buffers in multiples of page size, we
+  // should be able to assert that this is an integral number of words.
+  static_assert((kDefaultBufferSize % 8) == 0);
+  static constexpr uint32_t kMaxWords = kDefaultBufferSize / sizeof(uint64_t);
 
   static bool InitStartTest() {
     BEGIN_TEST;
@@ -52,10 +59,11 @@ class TestKTraceState : public ::internal::KTraceState {
       TestKTraceState state;
       ASSERT_TRUE(state.Init(kDefaultBufferSize, 0));
       {
-        Guard<TraceDisabledSpinLock, IrqSave> guard{&state.write_lock_};
+        Guard<Mutex> guard{&state.lock_};
+        EXPECT_NULL(state.cpu_buffers_.get());
         EXPECT_NULL(state.buffer_);
         EXPECT_EQ(0u, state.bufsize_);
-        EXPECT_EQ(kDefaultBufferSize, state.target_bufsize_);
+        EXPECT_EQ(state.TotalBufferSize(kDefaultBufferSize), state.target_bufsize_);
         EXPECT_EQ(0u, state.static_name_report_count_);
         EXPECT_EQ(0u, state.thread_name_report_count_);
         EXPECT_EQ(0u, state.grpmask());
@@ -70,11 +78,13 @@ class TestKTraceState : public ::internal::KTraceState {
       // before thread)
       ASSERT_OK(state.Start(kAllGroups, StartMode::Saturate));
       {
-        Guard<TraceDisabledSpinLock, IrqSave> guard{&state.write_lock_};
+        Guard<Mutex> guard{&state.lock_};
+        EXPECT_NONNULL(state.cpu_buffers_.get());
+        EXPECT_EQ(arch_max_num_cpus(), state.num_cpu_buffers_);
         EXPECT_NONNULL(state.buffer_);
         EXPECT_GT(state.bufsize_, 0u);
         EXPECT_LE(state.bufsize_, state.target_bufsize_);
-        EXPECT_EQ(kDefaultBufferSize, state.target_bufsize_);
+        EXPECT_EQ(state.TotalBufferSize(kDefaultBufferSize), state.target_bufsize_);
         EXPECT_EQ(1u, state.static_name_report_count_);
         EXPECT_EQ(1u, state.thread_name_report_count_);
         EXPECT_LE(state.last_static_name_report_time_, state.last_thread_name_report_time_);
@@ -89,11 +99,12 @@ class TestKTraceState : public ::internal::KTraceState {
       ASSERT_TRUE(state.Init(kDefaultBufferSize, kAllGroups));
 
       {
-        Guard<TraceDisabledSpinLock, IrqSave> guard{&state.write_lock_};
+        Guard<Mutex> guard{&state.lock_};
+        EXPECT_NONNULL(state.cpu_buffers_.get());
         EXPECT_NONNULL(state.buffer_);
         EXPECT_GT(state.bufsize_, 0u);
         EXPECT_LE(state.bufsize_, state.target_bufsize_);
-        EXPECT_EQ(kDefaultBufferSize, state.target_bufsize_);
+        EXPECT_EQ(state.TotalBufferSize(kDefaultBufferSize), state.target_bufsize_);
         EXPECT_EQ(1u, state.static_name_report_count_);
         EXPECT_EQ(1u, state.thread_name_report_count_);
         EXPECT_LE(state.last_static_name_report_time_, state.last_thread_name_report_time_);
@@ -172,8 +183,8 @@ class TestKTraceState : public ::internal::KTraceState {
     TestKTraceState state;
     ASSERT_TRUE(state.Init(kDefaultBufferSize, kGroups));
 
-    // Write the (max - 1) 32 byte records to the buffer, then write a single 24 byte record.
-    for (uint32_t i = 0; i + 2 < kMaxWords; i += 2) {
+    // Fill the buffer with 16 byte records.
+    for (uint32_t i = 0; i + 2 <= kMaxWords; i += 2) {
       // Instant records are 2 words
       fxt::WriteInstantEventRecord(&state, 0, fxt::ThreadRef{0x0A}, fxt::StringRef{0x1},
                                    fxt::StringRef{0x2});
@@ -185,7 +196,7 @@ class TestKTraceState : public ::internal::KTraceState {
     EXPECT_EQ(kGroups, state.grpmask());
     ASSERT_OK(state.Stop());
     EXPECT_TRUE(state.TestAllRecords(rcnt, checker));
-    EXPECT_TRUE(state.CheckExpectedOffset(kDefaultBufferSize - 8));
+    EXPECT_TRUE(state.CheckExpectedOffset(kDefaultBufferSize));
     EXPECT_EQ(kMaxWords / 2, rcnt);
 
     // Now write one more record, this time with a different payload.
@@ -407,22 +418,22 @@ class TestKTraceState : public ::internal::KTraceState {
           EXPECT_EQ(uint64_t{0x2222'2222'2222'2222}, hdr[3]);
         } else if (record_count == 1) {
           // Record number #1 should always be present, and will have a length
-          // of 4 or 5 words, and a 0xBBBB'BBBB'BBBB'BBBB or 0xCCCC'CCCC'CCCC'CCCC payload,
+          // of 5 or 4 words, and a 0xCCCC'CCCC'CCCC'CCCC or 0xBBBB'BBBB'BBBB'BBBB payload,
           // depending on whether or not this pass of the test is one where we
           // expect to need a padding record or not.
           if (pass == Padding::Needed) {
-            ASSERT_EQ(4u, len);
-            EXPECT_EQ(uint64_t{0x0002'0001'0110'0044}, hdr[0]);
-            EXPECT_EQ(uint64_t{0xBBBB'BBBB'BBBB'BBBB}, hdr[1]);
-            EXPECT_EQ(uint64_t{0x0000'0000'0003'0023}, hdr[2]);
-            EXPECT_EQ(uint64_t{0x3333'3333'3333'3333}, hdr[3]);
-          } else {
             ASSERT_EQ(5u, len);
             EXPECT_EQ(uint64_t{0x0002'0001'0120'0054}, hdr[0]);
             EXPECT_EQ(uint64_t{0xCCCC'CCCC'CCCC'CCCC}, hdr[1]);
             EXPECT_EQ(uint64_t{0x0000'0000'0003'0023}, hdr[2]);
             EXPECT_EQ(uint64_t{0x4444'4444'4444'4444}, hdr[3]);
             EXPECT_EQ(uint64_t{0x4444'4444'0004'0011}, hdr[4]);
+          } else {
+            ASSERT_EQ(4u, len);
+            EXPECT_EQ(uint64_t{0x0002'0001'0110'0044}, hdr[0]);
+            EXPECT_EQ(uint64_t{0xBBBB'BBBB'BBBB'BBBB}, hdr[1]);
+            EXPECT_EQ(uint64_t{0x0000'0000'0003'0023}, hdr[2]);
+            EXPECT_EQ(uint64_t{0x3333'3333'3333'3333}, hdr[3]);
           }
         } else {
           // All subsequent records should either be a padding record, or a 32
@@ -460,30 +471,29 @@ class TestKTraceState : public ::internal::KTraceState {
       TestKTraceState state;
       ASSERT_TRUE(state.Init(kDefaultBufferSize, kAllGroups));
 
-      // In order to run this test, we need enough space in our buffer after the
-      // 3 reserved metadata words for a least two "static" records, and a
-      // small number of extra records.
-      constexpr uint32_t kOverhead = sizeof(uint64_t) * 3;
+      // In order to run this test, we need enough space in our buffer for a
+      // least two "static" records, and a small number of extra records.
+      constexpr uint32_t kOverhead = kInitialOffset;
       constexpr uint32_t kExtraRecords = 5;
-      const uint32_t kStaticOverhead = 32 + ((pass == Padding::Needed) ? 32 : 40);
+      const uint32_t kStaticOverhead = 32 + ((pass == Padding::Needed) ? 40 : 32);
       ASSERT_GE(kDefaultBufferSize, (kOverhead + kStaticOverhead + (32 * kExtraRecords)));
 
       fxt::WriteInstantEventRecord(
           &state, 0xAAAA'AAAA'AAAA'AAAA, fxt::ThreadRef{0x01}, fxt::StringRef{1}, fxt::StringRef{2},
           fxt::Argument{fxt::StringRef{3}, int64_t{0x2222'2222'2222'2222}});
       if (pass == Padding::Needed) {
-        // 8 bytes header, 8 bytes ts, 16 bytes int64 arg = 32 bytes
         ASSERT_NE(0u, (kDefaultBufferSize - (kOverhead + kStaticOverhead)) % 32);
-        fxt::WriteInstantEventRecord(
-            &state, 0xBBBB'BBBB'BBBB'BBBB, fxt::ThreadRef{0x01}, fxt::StringRef{1},
-            fxt::StringRef{2}, fxt::Argument{fxt::StringRef{3}, int64_t{0x3333'3333'3333'3333}});
-      } else {
-        ASSERT_EQ(0u, (kDefaultBufferSize - (kOverhead + kStaticOverhead)) % 32);
         // 8 bytes header, 8 bytes ts, 16 bytes int64 arg, 8 bytes int32 arg = 40 bytes
         fxt::WriteInstantEventRecord(
             &state, 0xCCCC'CCCC'CCCC'CCCC, fxt::ThreadRef{0x01}, fxt::StringRef{1},
             fxt::StringRef{2}, fxt::Argument{fxt::StringRef{3}, int64_t{0x4444'4444'4444'4444}},
             fxt::Argument{fxt::StringRef{4}, int32_t{0x4444'4444}});
+      } else {
+        ASSERT_EQ(0u, (kDefaultBufferSize - (kOverhead + kStaticOverhead)) % 32);
+        // 8 bytes header, 8 bytes ts, 16 bytes int64 arg = 32 bytes
+        fxt::WriteInstantEventRecord(
+            &state, 0xBBBB'BBBB'BBBB'BBBB, fxt::ThreadRef{0x01}, fxt::StringRef{1},
+            fxt::StringRef{2}, fxt::Argument{fxt::StringRef{3}, int64_t{0x3333'3333'3333'3333}});
       }
       ASSERT_TRUE(state.CheckExpectedOffset(kOverhead + kStaticOverhead));
 
@@ -666,6 +676,293 @@ class TestKTraceState : public ::internal::KTraceState {
     END_TEST;
   }
 
+  // Records written on different CPUs are stored in different buffers, and
+  // merged in timestamp order when the trace is read.
+  static bool PerCpuMergeTest() {
+    BEGIN_TEST;
+
+    TestKTraceState state;
+    ASSERT_TRUE(state.Init(kDefaultBufferSize, KTRACE_GRP_ALL));
+
+    // Find a second CPU to write records from.  There is nothing to merge on a
+    // uniprocessor.
+    const cpu_mask_t other_cpus = mp_get_online_mask() & ~cpu_num_to_mask(state.test_cpu_);
+    if (other_cpus == 0) {
+      printf("only one CPU online, skipping\n");
+      ASSERT_OK(state.Stop());
+      END_TEST;
+    }
+    const cpu_num_t other_cpu = lowest_cpu_set(other_cpus);
+
+    // Write the records with even timestamps on one CPU, then the records
+    // with odd timestamps on the other, so that the order the records are
+    // written in differs from the order they should be read back in.
+    constexpr uint64_t kNumRecords = 64;
+    const cpu_num_t cpus[] = {state.test_cpu_, other_cpu};
+    for (const cpu_num_t cpu : cpus) {
+      PinTo(cpu);
+      const uint64_t first = (cpu == state.test_cpu_) ? 0 : 1;
+      for (uint64_t ts = first; ts < kNumRecords; ts += 2) {
+        EXPECT_OK(fxt::WriteInstantEventRecord(&state, ts, fxt::ThreadRef{0x0A},
+                                               fxt::StringRef{1}, fxt::StringRef{2}));
+      }
+    }
+    PinTo(state.test_cpu_);
+    ASSERT_OK(state.Stop());
+
+    uint64_t expected_ts = 0;
+    auto order_checker = [&](const uint64_t* hdr) -> bool {
+      BEGIN_TEST;
+      ASSERT_NONNULL(hdr);
+      EXPECT_EQ(expected_ts, hdr[1]);
+      ++expected_ts;
+      END_TEST;
+    };
+    uint32_t rcnt = 0;
+    EXPECT_TRUE(state.TestAllRecords(rcnt, order_checker));
+    EXPECT_EQ(kNumRecords, rcnt);
+
+    // Reading the trace in small pieces, which split records, must produce
+    // the same bytes as reading it all at once.
+    const ssize_t available = state.ReadUser(user_out_ptr<void>(nullptr), 0, 0);
+    ASSERT_GT(available, 0);
+    fbl::AllocChecker ac;
+    ktl::unique_ptr<uint8_t[]> pieces{new (&ac) uint8_t[available]};
+    ASSERT_TRUE(ac.check());
+    constexpr size_t kPieceSize = 20;
+    for (size_t off = 0; off < static_cast<size_t>(available); off += kPieceSize) {
+      const size_t len = ktl::min<size_t>(kPieceSize, available - off);
+      ASSERT_EQ(static_cast<ssize_t>(len),
+                state.ReadUser(user_out_ptr<void>(pieces.get() + off), static_cast<uint32_t>(off),
+                               len));
+    }
+    EXPECT_BYTES_EQ(state.validation_buffer_.get(), pieces.get(), available);
+
+    // Going back to an earlier offset restarts the merge.
+    uint64_t word = 0;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(word)),
+              state.ReadUser(user_out_ptr<void>(&word), kMetadataSize + 8, sizeof(word)));
+    EXPECT_EQ(0u, word);
+
+    END_TEST;
+  }
+
+  static bool StreamingTest() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kRecordSize = 16;
+    constexpr uint32_t kRingSize = PAGE_SIZE;
+    TestKTraceState state;
+    ASSERT_TRUE(state.Init(kDefaultBufferSize, 0));
+
+    fbl::RefPtr<VmObjectPaged> vmo;
+    ASSERT_OK(VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0, KTRACE_STREAM_RING_OFFSET + kRingSize,
+                                    &vmo));
+    KernelHandle<EventDispatcher> event;
+    zx_rights_t rights;
+    ASSERT_OK(EventDispatcher::Create(0, &event, &rights));
+
+    // The ring cannot be larger than the trace buffer.
+    fbl::RefPtr<VmObjectPaged> large_vmo;
+    ASSERT_OK(VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0,
+                                    KTRACE_STREAM_RING_OFFSET + kDefaultBufferSize + PAGE_SIZE,
+                                    &large_vmo));
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE,
+              state.StartStreaming(KTRACE_GRP_ALL, large_vmo, event.dispatcher(), 0));
+
+    // The watermark cannot be larger than the ring.
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              state.StartStreaming(KTRACE_GRP_ALL, vmo, event.dispatcher(), kRingSize + 1));
+    ASSERT_OK(state.StartStreaming(KTRACE_GRP_ALL, vmo, event.dispatcher(), 8 * kRecordSize));
+    EXPECT_EQ(ZX_ERR_BAD_STATE,
+              state.StartStreaming(KTRACE_GRP_ALL, vmo, event.dispatcher(), 8 * kRecordSize));
+
+    auto ReadHeader = [&]() {
+      ktrace_stream_header_t header{};
+      EXPECT_OK(vmo->Read(&header, 0, sizeof(header)));
+      return header;
+    };
+    // Returns the timestamp of the instant record at |stream_offset|.
+    auto ReadTimestamp = [&](uint64_t stream_offset) {
+      uint64_t words[2] = {};
+      for (uint64_t i = 0; i < sizeof(words); i += sizeof(uint64_t)) {
+        EXPECT_OK(vmo->Read(reinterpret_cast<uint8_t*>(words) + i,
+                            KTRACE_STREAM_RING_OFFSET + ((stream_offset + i) % kRingSize),
+                            sizeof(uint64_t)));
+      }
+      EXPECT_EQ(2u, fxt::RecordFields::RecordSize::Get<uint32_t>(words[0]));
+      return words[1];
+    };
+    auto Write = [&](uint64_t first_ts, uint64_t count) {
+      for (uint64_t ts = first_ts; ts < first_ts + count; ++ts) {
+        fxt::WriteInstantEventRecord(&state, ts, fxt::ThreadRef{0x0A}, fxt::StringRef{1},
+                                     fxt::StringRef{2});
+      }
+    };
+
+    StreamState* stream;
+    {
+      Guard<Mutex> guard{&state.lock_};
+      stream = state.stream_.get();
+      ASSERT_NONNULL(stream);
+    }
+
+    {
+      // Hold off the drain thread, so that the test decides when the trace is
+      // drained.
+      Guard<Mutex> stream_guard{&state.stream_lock_};
+
+      // The stream starts with the fxt metadata.
+      ktrace_stream_header_t header = ReadHeader();
+      EXPECT_EQ(kRingSize, header.ring_size);
+      EXPECT_EQ(kMetadataSize, header.write_offset);
+      uint64_t magic = 0;
+      EXPECT_OK(vmo->Read(&magic, KTRACE_STREAM_RING_OFFSET, sizeof(magic)));
+      EXPECT_EQ(uint64_t{0x0016547846040010}, magic);
+
+      // Draining the trace publishes its records, and signals the event once
+      // the watermark has been reached.
+      Write(0, 8);
+      state.DrainStream(*stream);
+      header = ReadHeader();
+      EXPECT_EQ(kMetadataSize + 8 * kRecordSize, header.write_offset);
+      EXPECT_EQ(0u, header.dropped_records);
+      EXPECT_EQ(ZX_EVENT_SIGNALED, event.dispatcher()->PollSignals() & ZX_EVENT_SIGNALED);
+      for (uint64_t i = 0; i < 8; ++i) {
+        EXPECT_EQ(i, ReadTimestamp(kMetadataSize + i * kRecordSize));
+      }
+      event.dispatcher()->user_signal_self(ZX_EVENT_SIGNALED, 0);
+
+      // Overfill the CPU's buffer.  Records which do not fit are dropped, but
+      // tracing continues.
+      const uint64_t cpu_buffer_records = kDefaultBufferSize / kRecordSize;
+      constexpr uint64_t kExtraRecords = 44;
+      Write(8, cpu_buffer_records + kExtraRecords);
+      EXPECT_EQ(KTRACE_GRP_ALL, state.grpmask());
+
+      // Only as many records as the ring has room for are drained.  The rest
+      // wait in the CPU's buffer for the consumer to catch up.
+      const uint64_t ring_records = (kRingSize - header.write_offset) / kRecordSize;
+      ASSERT_LT(ring_records, cpu_buffer_records);
+      state.DrainStream(*stream);
+      header = ReadHeader();
+      EXPECT_EQ(kExtraRecords, header.dropped_records);
+      EXPECT_EQ(kMetadataSize + (8 + ring_records) * kRecordSize, header.write_offset);
+      EXPECT_EQ(8 + ring_records - 1, ReadTimestamp(header.write_offset - kRecordSize));
+
+      // Once the consumer catches up, the rest of the records are drained,
+      // wrapping around the end of the ring.
+      const uint64_t read_offset = header.write_offset;
+      ASSERT_OK(vmo->Write(&read_offset, offsetof(ktrace_stream_header_t, read_offset),
+                           sizeof(read_offset)));
+      state.DrainStream(*stream);
+      header = ReadHeader();
+      EXPECT_EQ(read_offset + (cpu_buffer_records - ring_records) * kRecordSize,
+                header.write_offset);
+      for (uint64_t offset = read_offset; offset < header.write_offset; offset += kRecordSize) {
+        EXPECT_EQ(8 + ring_records + (offset - read_offset) / kRecordSize, ReadTimestamp(offset));
+      }
+    }
+
+    // Stopping the trace ends the stream.
+    ASSERT_OK(state.Stop());
+    EXPECT_EQ(KTRACE_STREAM_FLAG_STOPPED, ReadHeader().flags);
+    EXPECT_EQ(ZX_EVENT_SIGNALED, event.dispatcher()->PollSignals() & ZX_EVENT_SIGNALED);
+    {
+      Guard<Mutex> guard{&state.lock_};
+      EXPECT_NULL(state.stream_.get());
+    }
+
+    // Everything was drained, so there is nothing left to read.
+    uint32_t rcnt = 0;
+    auto checker = [&](const uint64_t* hdr) -> bool { return true; };
+    EXPECT_TRUE(state.TestAllRecords(rcnt, checker));
+    EXPECT_EQ(0u, rcnt);
+
+    END_TEST;
+  }
+
+  // Measures how many records per second each CPU can write while every
+  // online CPU is writing records, first with a single buffer shared by all of
+  // the CPUs (which is how ktrace worked before it had per-CPU buffers), and
+  // then with per-CPU buffers.
+  static void WriteThroughputBenchmark(zx_duration_t duration) {
+    constexpr uint32_t kCpuBufferSize = 64 * 1024;
+    constexpr uint32_t kRecordsPerTimeCheck = 64;
+
+    struct Writer {
+      TestKTraceState* state;
+      zx_time_t start;
+      zx_time_t deadline;
+      uint64_t records;
+    };
+
+    constexpr bool kPerCpuModes[] = {false, true};
+    for (const bool per_cpu : kPerCpuModes) {
+      TestKTraceState state;
+      state.per_cpu_buffers_ = per_cpu;
+
+      // Give the shared buffer as much space as all of the per-CPU buffers
+      // together, and trace in circular mode so that writes never stop.
+      const uint32_t bufsize = per_cpu ? kCpuBufferSize : kCpuBufferSize * arch_max_num_cpus();
+      if (!state.Init(bufsize, 0) || (state.Start(KTRACE_GRP_ALL, StartMode::Circular) != ZX_OK)) {
+        printf("failed to start trace\n");
+        return;
+      }
+
+      Writer writers[SMP_MAX_CPUS];
+      Thread* threads[SMP_MAX_CPUS] = {};
+      const zx_time_t start = current_time() + ZX_MSEC(10);
+      const cpu_mask_t online = mp_get_online_mask();
+      uint32_t num_cpus = 0;
+      for (cpu_num_t cpu = 0; cpu < arch_max_num_cpus(); ++cpu) {
+        if ((online & cpu_num_to_mask(cpu)) == 0) {
+          continue;
+        }
+        writers[cpu] = Writer{&state, start, start + duration, 0};
+        threads[cpu] = Thread::Create(
+            "ktrace bench",
+            [](void* arg) -> int {
+              Writer& writer = *static_cast<Writer*>(arg);
+              while (current_time() < writer.start) {
+                arch::Yield();
+              }
+              do {
+                for (uint32_t i = 0; i < kRecordsPerTimeCheck; ++i) {
+                  fxt::WriteInstantEventRecord(writer.state, current_ticks(), fxt::ThreadRef{0x0A},
+                                               fxt::StringRef{1}, fxt::StringRef{2});
+                }
+                writer.records += kRecordsPerTimeCheck;
+              } while (current_time() < writer.deadline);
+              return 0;
+            },
+            &writers[cpu], DEFAULT_PRIORITY);
+        if (threads[cpu] == nullptr) {
+          continue;
+        }
+        threads[cpu]->SetCpuAffinity(cpu_num_to_mask(cpu));
+        threads[cpu]->Resume();
+        ++num_cpus;
+      }
+
+      uint64_t total_records = 0;
+      for (cpu_num_t cpu = 0; cpu < arch_max_num_cpus(); ++cpu) {
+        if (threads[cpu] != nullptr) {
+          threads[cpu]->Join(nullptr, ZX_TIME_INFINITE);
+          total_records += writers[cpu].records;
+        }
+      }
+      [[maybe_unused]] zx_status_t status = state.Stop();
+
+      if (num_cpus == 0) {
+        return;
+      }
+      const uint64_t per_cpu_rate = total_records * ZX_SEC(1) / duration / num_cpus;
+      printf("%u CPUs writing to %s: %" PRIu64 " records/sec/CPU\n", num_cpus,
+             per_cpu ? "per-CPU buffers" : "a shared buffer", per_cpu_rate);
+    }
+  }
+
  private:
   //////////////////////////////////////////////////////////////////////////////
   //
@@ -678,27 +975,29 @@ class TestKTraceState : public ::internal::KTraceState {
   enum class CheckOp { LT, LE, EQ, GT, GE };
   // clang-format on
 
-  TestKTraceState() {
+  TestKTraceState() : saved_affinity_(Thread::Current::Get()->GetCpuAffinity()) {
     // disable diagnostic printfs in the test instances of KTrace we create.
     disable_diags_printfs_ = true;
+
+    // Keep the test thread on a single CPU, so that all of the records it
+    // writes end up in the same per-CPU buffer.
+    test_cpu_ = arch_curr_cpu_num();
+    PinTo(test_cpu_);
   }
 
-  // TODO(johngro): The default KTraceState implementation never cleans up its
-  // buffer allocation, as it assumes that it is being used as a global
-  // singleton, and that the kernel will never "exit". Test instances of
-  // KTraceState *must* clean themselves up, however.  Should we push this
-  // behavior down one level into the default KTraceState implementation's
-  // destructor, even though it (currently) does not ever have any reason to
-  // destruct?
-  ~TestKTraceState() {
-    if (buffer_ != nullptr) {
-      VmAspace* aspace = VmAspace::kernel_aspace();
-      aspace->FreeRegion(reinterpret_cast<vaddr_t>(buffer_));
-    }
+  ~TestKTraceState() { Thread::Current::Get()->SetCpuAffinity(saved_affinity_); }
+
+  static void PinTo(cpu_num_t cpu) { Thread::Current::Get()->SetCpuAffinity(cpu_num_to_mask(cpu)); }
+
+  // The size of the whole trace buffer when each per-CPU buffer is
+  // |cpu_bufsize| bytes.
+  uint32_t TotalBufferSize(uint32_t cpu_bufsize) const {
+    return cpu_bufsize * (per_cpu_buffers_ ? arch_max_num_cpus() : 1);
   }
 
   // We interpose ourselves in the Init path so that we can allocate the side
-  // buffer we will use for validation.
+  // buffer we will use for validation.  |target_bufsize| is the size of the
+  // buffer of each CPU.
   [[nodiscard]] bool Init(uint32_t target_bufsize, uint32_t initial_groups) {
     BEGIN_TEST;
 
@@ -707,17 +1006,21 @@ class TestKTraceState : public ::internal::KTraceState {
     // Double init is not allowed.
     ASSERT_NULL(validation_buffer_.get());
 
+    const uint32_t total_bufsize = TotalBufferSize(target_bufsize);
     fbl::AllocChecker ac;
-    validation_buffer_.reset(new (&ac) uint8_t[target_bufsize]);
+    validation_buffer_.reset(new (&ac) uint8_t[kMetadataSize + total_bufsize]);
     ASSERT_TRUE(ac.check());
-    validation_buffer_size_ = target_bufsize;
+    validation_buffer_size_ = kMetadataSize + total_bufsize;
 
-    KTraceState::Init(target_bufsize, initial_groups);
+    KTraceState::Init(total_bufsize, initial_groups);
 
     // Make sure that the buffer size we requested was allocated exactly.
     {
-      Guard<TraceDisabledSpinLock, IrqSave> guard{&write_lock_};
-      ASSERT_GE(target_bufsize, bufsize_);
+      Guard<Mutex> guard{&lock_};
+      ASSERT_GE(total_bufsize, bufsize_);
+      for (uint32_t i = 0; i < num_cpu_buffers_; ++i) {
+        ASSERT_EQ(target_bufsize, cpu_buffers_[i].size);
+      }
     }
 
     END_TEST;
@@ -740,31 +1043,31 @@ class TestKTraceState : public ::internal::KTraceState {
 
   // Check to make sure that the buffer is not operating in circular mode, and
   // that the write pointer is at the offset we expect.
-  [[nodiscard]] bool CheckExpectedOffset(size_t expected, CheckOp op = CheckOp::EQ)
-      TA_EXCL(write_lock_) {
+  [[nodiscard]] bool CheckExpectedOffset(size_t expected, CheckOp op = CheckOp::EQ) {
     BEGIN_TEST;
 
-    Guard<TraceDisabledSpinLock, IrqSave> guard{&write_lock_};
+    ASSERT_NONNULL(cpu_buffers_.get());
+    CpuBuffer& cb = cpu_buffers_[per_cpu_buffers_ ? test_cpu_ : 0];
+    Guard<TraceDisabledSpinLock, IrqSave> guard{&cb.lock};
     switch (op) {
         // clang-format off
-      case CheckOp::LT: EXPECT_LT(expected, wr_); break;
-      case CheckOp::LE: EXPECT_LE(expected, wr_); break;
-      case CheckOp::EQ: EXPECT_EQ(expected, wr_); break;
-      case CheckOp::GT: EXPECT_GT(expected, wr_); break;
-      case CheckOp::GE: EXPECT_GE(expected, wr_); break;
+      case CheckOp::LT: EXPECT_LT(expected, cb.wr); break;
+      case CheckOp::LE: EXPECT_LE(expected, cb.wr); break;
+      case CheckOp::EQ: EXPECT_EQ(expected, cb.wr); break;
+      case CheckOp::GT: EXPECT_GT(expected, cb.wr); break;
+      case CheckOp::GE: EXPECT_GE(expected, cb.wr); break;
       // clang-format on
       default:
         ASSERT_TRUE(false);
     }
-    EXPECT_EQ(0u, rd_);
-    EXPECT_EQ(0u, circular_size_);
+    EXPECT_EQ(0u, cb.rd);
+    EXPECT_EQ(0u, cb.circular_size);
 
     END_TEST;
   }
 
   template <typename Checker>
-  bool TestAllRecords(uint32_t& records_enumerated_out, const Checker& do_check)
-      TA_EXCL(write_lock_) {
+  bool TestAllRecords(uint32_t& records_enumerated_out, const Checker& do_check) {
     BEGIN_TEST;
     // Make sure that we give a value to all of our out parameters.
     records_enumerated_out = 0;
@@ -781,7 +1084,7 @@ class TestKTraceState : public ::internal::KTraceState {
         ReadUser(user_out_ptr<void>(validation_buffer_.get()), 0, validation_buffer_size_);
     ASSERT_EQ(static_cast<size_t>(available), to_validate);
 
-    size_t rd_offset = sizeof(uint64_t) * 3;
+    size_t rd_offset = kMetadataSize;
     ASSERT_GE(to_validate, rd_offset);
 
     // We expect all trace buffers to start with a metadata records indicating the
@@ -830,6 +1133,9 @@ class TestKTraceState : public ::internal::KTraceState {
 
   ktl::unique_ptr<uint8_t[]> validation_buffer_;
   size_t validation_buffer_size_{0};
+
+  const cpu_mask_t saved_affinity_;
+  cpu_num_t test_cpu_{0};
 };
 
 }  // namespace ktrace_tests
@@ -845,4 +1151,24 @@ UNITTEST("fxt compat writer", ktrace_tests::TestKTraceState::FxtCompatWriterTest
 UNITTEST("disable writes", ktrace_tests::TestKTraceState::DisableWritesTest)
 UNITTEST("disable writes during pending commit",
          ktrace_tests::TestKTraceState::DisableWritesDuringPendingCommitTest)
+UNITTEST("per-cpu merge", ktrace_tests::TestKTraceState::PerCpuMergeTest)
+UNITTEST("streaming", ktrace_tests::TestKTraceState::StreamingTest)
 UNITTEST_END_TESTCASE(ktrace_tests, "ktrace", "KTrace tests")
+
+namespace {
+
+int cmd_ktrace_bench(int argc, const cmd_args* argv, uint32_t flags) {
+  const zx_duration_t duration = ZX_MSEC(argc > 1 ? argv[1].u : 1000);
+  if (duration <= 0) {
+    printf("usage: %s [duration_ms]\n", argv[0].str);
+    return -1;
+  }
+  ktrace_tests::TestKTraceState::WriteThroughputBenchmark(duration);
+  return 0;
+}
+
+}  // namespace
+
+STATIC_COMMAND_START
+STATIC_COMMAND("ktrace_bench", "measure ktrace record write throughput", &cmd_ktrace_bench)
+STATIC_COMMAND_END(ktrace_bench)
@@ -13,6 +13,7 @@
 
 #include <arch/ops.h>
 #include <kernel/event.h>
+#include <kernel/lock_stats.h>
 #include <kernel/mutex.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
@@ -91,6 +92,13 @@ int CommandLockDep(int argc, const cmd_args* argv, uint32_t flags) {
   usage:
     printf("%s dump              : dump lock classes\n", argv[0].str);
     printf("%s loop              : trigger loop detection pass\n", argv[0].str);
+    printf("%s stats [count]     : dump contention stats of the top lock classes\n",
+           argv[0].str);
+    printf("%s profile [count]   : dump contention profiles of the top lock classes\n",
+           argv[0].str);
+    printf("%s profile start     : start recording contention profiles\n", argv[0].str);
+    printf("%s profile stop      : stop recording contention profiles\n", argv[0].str);
+    printf("%s profile reset     : discard recorded contention profiles\n", argv[0].str);
     return -1;
   }
 
@@ -99,6 +107,26 @@ int CommandLockDep(int argc, const cmd_args* argv, uint32_t flags) {
   } else if (strcmp(argv[1].str, "loop") == 0) {
     printf("Triggering loop detection pass:\n");
     lockdep::SystemTriggerLoopDetection();
+  } else if (strcmp(argv[1].str, "stats") == 0) {
+    if constexpr (!kLockStatsEnabled) {
+      printf("Lock stats are not enabled in this build (see lock_stats_enabled)\n");
+    } else {
+      const size_t count = (argc >= 3) ? static_cast<size_t>(argv[2].u) : 20;
+      lock_stats::Dump(stdout, count);
+    }
+  } else if (strcmp(argv[1].str, "profile") == 0) {
+    if constexpr (!kLockStatsEnabled) {
+      printf("Lock stats are not enabled in this build (see lock_stats_enabled)\n");
+    } else if (argc >= 3 && strcmp(argv[2].str, "start") == 0) {
+      lock_stats::SetProfilingEnabled(true);
+    } else if (argc >= 3 && strcmp(argv[2].str, "stop") == 0) {
+      lock_stats::SetProfilingEnabled(false);
+    } else if (argc >= 3 && strcmp(argv[2].str, "reset") == 0) {
+      lock_stats::ResetProfiles();
+    } else {
+      const size_t count = (argc >= 3) ? static_cast<size_t>(argv[2].u) : 10;
+      lock_stats::DumpProfiles(stdout, count);
+    }
   } else {
     printf("Unrecognized subcommand: '%s'\n", argv[1].str);
     goto usage;
@@ -24,10 +24,13 @@
 #include <zircon/syscalls/debug.h>
 #include <zircon/types.h>
 
+#include <object/event_dispatcher.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/resource.h>
+#include <object/vm_object_dispatcher.h>
 #include <platform/debug.h>
+#include <vm/vm_object_paged.h>
 
 #define LOCAL_TRACE 0
 
@@ -173,6 +176,61 @@ zx_status_t sys_ktrace_control(zx_handle_t handle, uint32_t action, uint32_t opt
       name[sizeof(name) - 1] = 0;
       return ktrace_control(action, options, name);
     }
+    case KTRACE_ACTION_START_STREAMING: {
+      auto stream_ptr = _ptr.reinterpret<ktrace_stream_t>();
+      ktrace_stream_t stream;
+      if (stream_ptr.copy_from_user(&stream) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+      // The ring's upper bound is checked by ktrace_start_streaming(), before
+      // any of the VMO is committed.
+      if ((stream.ring_size == 0) || ((stream.ring_size % PAGE_SIZE) != 0))
+        return ZX_ERR_INVALID_ARGS;
+
+      auto up = ProcessDispatcher::GetCurrent();
+      if ((status = up->EnforceBasicPolicy(ZX_POL_NEW_VMO)) != ZX_OK)
+        return status;
+      if ((status = up->EnforceBasicPolicy(ZX_POL_NEW_EVENT)) != ZX_OK)
+        return status;
+
+      fbl::RefPtr<VmObjectPaged> vmo;
+      status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY | PMM_ALLOC_FLAG_CAN_WAIT, 0,
+                                     KTRACE_STREAM_RING_OFFSET + uint64_t{stream.ring_size}, &vmo);
+      if (status != ZX_OK)
+        return status;
+      KernelHandle<VmObjectDispatcher> vmo_handle;
+      zx_rights_t vmo_rights;
+      status = VmObjectDispatcher::Create(vmo, vmo->size(),
+                                          VmObjectDispatcher::InitialMutability::kMutable,
+                                          &vmo_handle, &vmo_rights);
+      if (status != ZX_OK)
+        return status;
+      KernelHandle<EventDispatcher> event_handle;
+      zx_rights_t event_rights;
+      if ((status = EventDispatcher::Create(0, &event_handle, &event_rights)) != ZX_OK)
+        return status;
+      fbl::RefPtr<EventDispatcher> event = event_handle.dispatcher();
+
+      // The handles are only added to the process once the stream has started
+      // and their values have been copied out.
+      HandleOwner vmo_owner = Handle::Make(ktl::move(vmo_handle), vmo_rights);
+      HandleOwner event_owner = Handle::Make(ktl::move(event_handle), event_rights);
+      if (!vmo_owner || !event_owner)
+        return ZX_ERR_NO_MEMORY;
+
+      if ((status = ktrace_start_streaming(options, ktl::move(vmo), ktl::move(event),
+                                           stream.watermark)) != ZX_OK)
+        return status;
+
+      stream.vmo = up->handle_table().MapHandleToValue(vmo_owner);
+      stream.event = up->handle_table().MapHandleToValue(event_owner);
+      if (stream_ptr.copy_to_user(stream) != ZX_OK) {
+        [[maybe_unused]] zx_status_t stop_status = ktrace_control(KTRACE_ACTION_STOP, 0, nullptr);
+        return ZX_ERR_INVALID_ARGS;
+      }
+      up->handle_table().AddHandle(ktl::move(vmo_owner));
+      up->handle_table().AddHandle(ktl::move(event_owner));
+      return ZX_OK;
+    }
     default:
       return ktrace_control(action, options, nullptr);
   }
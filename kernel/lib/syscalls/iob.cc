@@ -89,3 +89,25 @@ zx_status_t sys_iob_allocate_id(zx_handle_t handle, zx_iob_allocate_id_options_t
   }
   return id.copy_to_user(result.value());
 }
+
+// zx_status_t zx_iob_write_record
+zx_status_t sys_iob_write_record(zx_handle_t handle, zx_iob_write_record_options_t options,
+                                 uint32_t region_index, user_in_ptr<const void> data_ptr,
+                                 uint64_t data_size) {
+  // No options are supported at this time.
+  if (options != 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto* up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<IoBufferDispatcher> iob;
+  zx_status_t status =
+      up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_WRITE, &iob);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  return iob->WriteRecord(region_index, data_ptr.reinterpret<const std::byte>(), data_size)
+      .status_value();
+}
@@ -11,6 +11,7 @@
 #include <lib/syscalls/forward.h>
 #include <lib/zircon-internal/macros.h>
 #include <platform.h>
+#include <string.h>
 #include <trace.h>
 #include <zircon/errors.h>
 #include <zircon/syscalls/iob.h>
@@ -19,6 +20,7 @@
 #include <zircon/types.h>
 
 #include <fbl/ref_ptr.h>
+#include <kernel/lock_stats.h>
 #include <kernel/mp.h>
 #include <kernel/scheduler.h>
 #include <kernel/stats.h>
@@ -893,6 +895,68 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic, user_out_ptr
       return single_record_result(_buffer, buffer_size, _actual, _avail, kstats);
     }
 
+    case ZX_INFO_LOCK_CONTENTION: {
+      zx_status_t status =
+          validate_ranged_resource(handle, ZX_RSRC_KIND_SYSTEM, ZX_RSRC_SYSTEM_INFO_BASE, 1);
+      if (status != ZX_OK)
+        return status;
+
+      if constexpr (!kLockStatsEnabled) {
+        return ZX_ERR_NOT_SUPPORTED;
+      }
+
+      static_assert(lock_stats::kNumHistogramBuckets == ZX_INFO_LOCK_CONTENTION_HISTOGRAM_BUCKETS);
+      static_assert(lock_stats::kNumCallSites == ZX_INFO_LOCK_CONTENTION_CALL_SITES);
+
+      const size_t num_space_for = buffer_size / sizeof(zx_info_lock_contention_t);
+      user_out_ptr<zx_info_lock_contention_t> info_buf =
+          _buffer.reinterpret<zx_info_lock_contention_t>();
+
+      // Profiles are aggregated from the per-CPU buffers one class at a time,
+      // so the records are not a consistent snapshot of all classes.
+      size_t num_avail = 0;
+      for (size_t i = 0; i < lock_stats::kMaxLockClasses; i++) {
+        lock_stats::ClassProfile profile;
+        if (!lock_stats::GetClassProfile(i, &profile)) {
+          continue;
+        }
+        if (num_avail < num_space_for) {
+          zx_info_lock_contention_t info = {};
+          if constexpr (lockdep::kLockMetadataAvailable) {
+            strlcpy(info.name, lockdep::MetadataLockClassState::GetName(profile.lock_class_id),
+                    sizeof(info.name));
+          }
+          info.wait_count = profile.wait_count;
+          info.total_wait_time = profile.total_wait_time;
+          info.hold_count = profile.hold_count;
+          info.total_hold_time = profile.total_hold_time;
+          for (size_t j = 0; j < lock_stats::kNumHistogramBuckets; j++) {
+            info.wait_histogram[j] = profile.wait_histogram[j];
+            info.hold_histogram[j] = profile.hold_histogram[j];
+          }
+          for (size_t j = 0; j < lock_stats::kNumCallSites; j++) {
+            info.call_site_pcs[j] = profile.call_sites[j].pc;
+            info.call_site_counts[j] = profile.call_sites[j].count;
+          }
+          if (info_buf.copy_array_to_user(&info, 1, num_avail) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        }
+        num_avail++;
+      }
+
+      if (_actual) {
+        zx_status_t copy_status = _actual.copy_to_user(ktl::min(num_avail, num_space_for));
+        if (copy_status != ZX_OK)
+          return copy_status;
+      }
+      if (_avail) {
+        zx_status_t copy_status = _avail.copy_to_user(num_avail);
+        if (copy_status != ZX_OK)
+          return copy_status;
+      }
+      return ZX_OK;
+    }
+
     case ZX_INFO_RESOURCE: {
       // grab a reference to the dispatcher
       fbl::RefPtr<ResourceDispatcher> resource;
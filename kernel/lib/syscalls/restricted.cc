@@ -100,7 +100,7 @@ zx_status_t sys_restricted_unbind_state(uint32_t options) {
 zx_status_t sys_restricted_kick(zx_handle_t handle, uint32_t options) {
   LTRACEF("options 0x%x\n", options);
 
-  if (options != 0) {
+  if (options & ~ZX_RESTRICTED_KICK_OPT_UPCALL) {
     return ZX_ERR_INVALID_ARGS;
   }
 
@@ -113,5 +113,5 @@ zx_status_t sys_restricted_kick(zx_handle_t handle, uint32_t options) {
     return status;
   }
 
-  return thread->RestrictedKick();
+  return thread->RestrictedKick((options & ZX_RESTRICTED_KICK_OPT_UPCALL) != 0);
 }
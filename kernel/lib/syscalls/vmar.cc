@@ -15,6 +15,7 @@
 
 #include <arch/ops.h>
 #include <fbl/ref_ptr.h>
+#include <object/clock_dispatcher.h>
 #include <object/handle.h>
 #include <object/io_buffer_dispatcher.h>
 #include <object/process_dispatcher.h>
@@ -320,3 +321,39 @@ zx_status_t sys_vmar_map_iob(zx_handle_t handle, zx_vm_option_t options, size_t
   return vmar_map_common(options, ktl::move(vmar), vmar_offset, vmar_rights, ktl::move(*vmo),
                          region_offset, region_rights, region_length, mapped_addr);
 }
+
+// zx_status_t zx_vmar_map_clock
+zx_status_t sys_vmar_map_clock(zx_handle_t handle, zx_vm_option_t options, uint64_t vmar_offset,
+                               zx_handle_t clock_handle, uint64_t len,
+                               user_out_ptr<zx_vaddr_t> mapped_addr) {
+  // The clock state always occupies exactly one page.
+  if (len != PAGE_SIZE) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto* up = ProcessDispatcher::GetCurrent();
+
+  // Lookup the VMAR dispatcher from handle.
+  fbl::RefPtr<VmAddressRegionDispatcher> vmar;
+  zx_rights_t vmar_rights;
+  zx_status_t status = up->handle_table().GetDispatcherAndRights(*up, handle, &vmar, &vmar_rights);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  // Lookup the clock dispatcher from handle. Anyone who may read the clock may
+  // map it.
+  fbl::RefPtr<ClockDispatcher> clock;
+  status = up->handle_table().GetDispatcherWithRights(*up, clock_handle, ZX_RIGHT_READ, &clock);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  if (!clock->mapped_vmo()) {
+    return ZX_ERR_BAD_STATE;
+  }
+
+  // The clock state may only ever be mapped read-only.
+  return vmar_map_common(options, ktl::move(vmar), vmar_offset, vmar_rights, clock->mapped_vmo(),
+                         0, ZX_RIGHT_READ | ZX_RIGHT_MAP, len, mapped_addr);
+}
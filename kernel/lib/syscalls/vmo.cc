@@ -11,9 +11,12 @@
 #include <lib/zircon-internal/thread_annotations.h>
 #include <trace.h>
 #include <zircon/errors.h>
+#include <zircon/syscalls-next.h>
 #include <zircon/types.h>
 
 #include <fbl/ref_ptr.h>
+#include <ktl/algorithm.h>
+#include <ktl/span.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/resource.h>
@@ -103,6 +106,76 @@ zx_status_t sys_vmo_write(zx_handle_t handle, user_in_ptr<const void> _data, uin
   return vmo->Write(_data.reinterpret<const char>(), len, offset, nullptr);
 }
 
+namespace {
+
+// The number of vector elements copied in from the user at a time by zx_vmo_read_vector() and
+// zx_vmo_write_vector(). Each batch is transferred under a single acquisition of the VMO lock.
+constexpr size_t kVmoIoBatchSize = 16;
+
+template <typename Func>
+zx_status_t ForEachVmoIoBatch(user_in_ptr<const zx_vmo_io_t> vector, size_t vector_count,
+                              Func func) {
+  zx_vmo_io_t batch[kVmoIoBatchSize];
+  for (size_t i = 0; i < vector_count; i += kVmoIoBatchSize) {
+    const size_t count = ktl::min(vector_count - i, kVmoIoBatchSize);
+    if (vector.element_offset(i).copy_array_from_user(batch, count) != ZX_OK) {
+      return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status = func(ktl::span<const zx_vmo_io_t>(batch, count));
+    if (status != ZX_OK) {
+      return status;
+    }
+  }
+  return ZX_OK;
+}
+
+}  // namespace
+
+// zx_status_t zx_vmo_read_vector
+zx_status_t sys_vmo_read_vector(zx_handle_t handle, uint32_t options,
+                                user_in_ptr<const zx_vmo_io_t> vector, size_t vector_count) {
+  LTRACEF("handle %x, vector_count %zu\n", handle, vector_count);
+
+  if (options != 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<VmObjectDispatcher> vmo;
+  zx_status_t status = up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_READ, &vmo);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  return ForEachVmoIoBatch(vector, vector_count, [&vmo](ktl::span<const zx_vmo_io_t> batch) {
+    return vmo->ReadScatter(batch, nullptr);
+  });
+}
+
+// zx_status_t zx_vmo_write_vector
+zx_status_t sys_vmo_write_vector(zx_handle_t handle, uint32_t options,
+                                 user_in_ptr<const zx_vmo_io_t> vector, size_t vector_count) {
+  LTRACEF("handle %x, vector_count %zu\n", handle, vector_count);
+
+  if (options != 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<VmObjectDispatcher> vmo;
+  zx_status_t status =
+      up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_WRITE, &vmo);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  return ForEachVmoIoBatch(vector, vector_count, [&vmo](ktl::span<const zx_vmo_io_t> batch) {
+    return vmo->WriteGather(batch, nullptr);
+  });
+}
+
 // zx_status_t zx_vmo_transfer_data
 zx_status_t sys_vmo_transfer_data(zx_handle_t dst_vmo_handle, uint32_t options, uint64_t offset,
                                   uint64_t length, zx_handle_t src_vmo_handle,
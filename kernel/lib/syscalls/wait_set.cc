@@ -0,0 +1,129 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <inttypes.h>
+#include <lib/syscalls/forward.h>
+#include <trace.h>
+#include <zircon/errors.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/syscalls/policy.h>
+#include <zircon/types.h>
+
+#include <fbl/ref_ptr.h>
+#include <kernel/lockdep.h>
+#include <ktl/algorithm.h>
+#include <object/handle.h>
+#include <object/process_dispatcher.h>
+#include <object/wait_set_dispatcher.h>
+
+#define LOCAL_TRACE 0
+
+// zx_status_t zx_wait_set_create
+zx_status_t sys_wait_set_create(uint32_t options, zx_handle_t* out) {
+  LTRACEF("options %u\n", options);
+  auto up = ProcessDispatcher::GetCurrent();
+  // A wait set is a port-like object, and is subject to the same policy.
+  zx_status_t result = up->EnforceBasicPolicy(ZX_POL_NEW_PORT);
+  if (result != ZX_OK) {
+    return result;
+  }
+
+  KernelHandle<WaitSetDispatcher> handle;
+  zx_rights_t rights;
+
+  result = WaitSetDispatcher::Create(options, &handle, &rights);
+  if (result != ZX_OK) {
+    return result;
+  }
+
+  return up->MakeAndAddHandle(ktl::move(handle), rights, out);
+}
+
+// zx_status_t zx_wait_set_add
+zx_status_t sys_wait_set_add(zx_handle_t handle, zx_handle_t object, uint64_t key,
+                             zx_signals_t signals, uint32_t options) {
+  LTRACEF("handle %x object %x key %" PRIu64 "\n", handle, object, key);
+
+  if (options != 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<WaitSetDispatcher> wait_set;
+  zx_status_t status =
+      up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_WRITE, &wait_set);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  // The entry is tied to |object|'s Handle, so hold the handle table lock to
+  // keep the Handle from being destroyed while the entry is being registered.
+  Guard<BrwLockPi, BrwLockPi::Reader> guard{up->handle_table().get_lock()};
+
+  Handle* object_handle = up->handle_table().GetHandleLocked(*up, object);
+  if (!object_handle) {
+    return ZX_ERR_BAD_HANDLE;
+  }
+  if (!object_handle->HasRights(ZX_RIGHT_WAIT)) {
+    return ZX_ERR_ACCESS_DENIED;
+  }
+
+  return wait_set->Add(object_handle, key, signals);
+}
+
+// zx_status_t zx_wait_set_remove
+zx_status_t sys_wait_set_remove(zx_handle_t handle, uint64_t key) {
+  LTRACEF("handle %x key %" PRIu64 "\n", handle, key);
+
+  auto up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<WaitSetDispatcher> wait_set;
+  zx_status_t status =
+      up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_WRITE, &wait_set);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  return wait_set->Remove(key);
+}
+
+// zx_status_t zx_wait_set_wait
+zx_status_t sys_wait_set_wait(zx_handle_t handle, zx_time_t deadline,
+                              user_out_ptr<zx_wait_set_result_t> results, size_t count,
+                              user_out_ptr<size_t> actual) {
+  LTRACEF("handle %x count %zu\n", handle, count);
+
+  if (count == 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  auto up = ProcessDispatcher::GetCurrent();
+
+  fbl::RefPtr<WaitSetDispatcher> wait_set;
+  zx_status_t status =
+      up->handle_table().GetDispatcherWithRights(*up, handle, ZX_RIGHT_READ, &wait_set);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  const Deadline slackDeadline(deadline, up->GetTimerSlackPolicy());
+
+  zx_wait_set_result_t ready[WaitSetDispatcher::kMaxResults];
+  size_t num_ready = 0;
+  status = wait_set->Wait(slackDeadline, ready,
+                          ktl::min(count, WaitSetDispatcher::kMaxResults), &num_ready);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  // The entries reported here are still on the ready list, so nothing is lost
+  // if the copy fails: they will be reported by the next wait.
+  if (results.copy_array_to_user(ready, num_ready) != ZX_OK) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+  return actual.copy_to_user(num_ready);
+}
@@ -9,6 +9,7 @@
 #include <lib/crypto/global_prng.h>
 #include <lib/syscalls/forward.h>
 #include <lib/user_copy/user_ptr.h>
+#include <lib/userabi/vdso.h>
 #include <platform.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -306,6 +307,7 @@ zx_status_t sys_cprng_add_entropy(user_in_ptr<const void> buffer, size_t buffer_
   auto prng = crypto::global_prng::GetInstance();
   ASSERT(prng->is_thread_safe());
   prng->AddEntropy(kernel_buf, buffer_size);
+  VDso::AdvanceCprngGeneration();
 
   return ZX_OK;
 }
@@ -0,0 +1,28 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#ifndef ZIRCON_KERNEL_LIB_USERABI_INCLUDE_LIB_USERABI_VDSO_CPRNG_H_
+#define ZIRCON_KERNEL_LIB_USERABI_INCLUDE_LIB_USERABI_VDSO_CPRNG_H_
+
+// This file is used both in the kernel and in the vDSO implementation.
+// So it must be compatible with both the kernel and userland header
+// environments.
+
+#include <stdint.h>
+
+#include <atomic>
+
+// This struct lives on its own page of the vDSO image, which the kernel maps
+// and keeps writing after boot. The vDSO only ever reads it.
+struct vdso_cprng_values {
+  // Advanced by the kernel every time the kernel CPRNG is reseeded. It starts
+  // at 1, so that a zero-initialized user state always keys itself on first
+  // use. zx_cprng_draw_with_state rekeys any state that was keyed under an
+  // older generation.
+  std::atomic<uint64_t> generation;
+};
+
+#endif  // ZIRCON_KERNEL_LIB_USERABI_INCLUDE_LIB_USERABI_VDSO_CPRNG_H_
@@ -11,6 +11,7 @@
 #include <lib/instrumentation/kernel-mapped-vmo.h>
 #include <lib/userabi/rodso.h>
 #include <lib/userabi/userboot.h>
+#include <lib/userabi/vdso-cprng.h>
 
 #include <vm/vm_object.h>
 
@@ -59,6 +60,17 @@ class VDso : public RoDso {
   // system spent in a suspended state.
   static void AddMonotonicTicksOffset(zx_ticks_t additional);
 
+  // Advances the CPRNG generation in all of the vDSO variants, so that every state used with
+  // zx_cprng_draw_with_state rekeys from the kernel CPRNG before producing more output. This is
+  // called each time the kernel CPRNG is reseeded, which may happen before the vDSO exists.
+  static void AdvanceCprngGeneration() {
+#ifndef KERNEL_NO_USERABI
+    if (likely(instance_)) {
+      instance_->AdvanceCprngGenerationImpl();
+    }
+#endif
+  }
+
  private:
   using Variant = userboot::VdsoVariant;
 
@@ -66,6 +78,8 @@ class VDso : public RoDso {
   void CreateVariant(Variant, KernelHandle<VmObjectDispatcher>* vmo_kernel_handle);
   void CreateTimeValuesVmo(KernelHandle<VmObjectDispatcher>* time_values_handle);
   zx_status_t MapTimeValuesVmo(Variant, const fbl::RefPtr<VmObject>& vdso_vmo);
+  zx_status_t MapCprngValuesVmo(Variant, const fbl::RefPtr<VmObject>& vdso_vmo);
+  void AdvanceCprngGenerationImpl() const;
 
   bool vmo_is_vdso_impl(const fbl::RefPtr<VmObject>& vmo_ref) const {
     if (vmo_ref == vmo()->vmo())
@@ -85,6 +99,8 @@ class VDso : public RoDso {
   fbl::RefPtr<VmObjectDispatcher> variant_vmo_[static_cast<size_t>(Variant::COUNT)];
   KernelMappedVmo variant_time_mappings_[static_cast<size_t>(Variant::COUNT)];
   fasttime::internal::TimeValues* time_values_[static_cast<size_t>(Variant::COUNT)];
+  KernelMappedVmo variant_cprng_mappings_[static_cast<size_t>(Variant::COUNT)];
+  vdso_cprng_values* cprng_values_[static_cast<size_t>(Variant::COUNT)];
 
   static const VDso* instance_;
 };
@@ -8,6 +8,7 @@
 #include <lib/boot-options/boot-options.h>
 #include <lib/fasttime/internal/abi.h>
 #include <lib/userabi/vdso-constants.h>
+#include <lib/userabi/vdso-cprng.h>
 #include <lib/userabi/vdso.h>
 #include <lib/version.h>
 #include <platform.h>
@@ -248,6 +249,17 @@ void SetTimeValues(const fbl::RefPtr<VmObject>& vmo) {
              bytes.size(), uint64_t{VDSO_DATA_TIME_VALUES}, status);
 }
 
+// Fill out the initial contents of the vdso_cprng_values struct.
+void SetCprngValues(const fbl::RefPtr<VmObject>& vmo) {
+  // Generation 0 is reserved for states that have never been keyed.
+  vdso_cprng_values values = {.generation = 1};
+
+  ktl::span bytes = ktl::as_bytes(ktl::span{&values, 1});
+  zx_status_t status = vmo->Write(bytes.data(), VDSO_DATA_CPRNG_VALUES, bytes.size());
+  ASSERT_MSG(status == ZX_OK, "vDSO CPRNG Values VMO Write of %zu bytes at %#" PRIx64 " failed: %d",
+             bytes.size(), uint64_t{VDSO_DATA_CPRNG_VALUES}, status);
+}
+
 // Fill out the contents of the vdso_constants struct.
 void SetConstants(const fbl::RefPtr<VmObject>& vmo) {
   ktl::string_view version = VersionString();
@@ -307,6 +319,7 @@ void PatchTimeSyscalls(VDsoMutator mutator) {
 
   if (need_syscall_for_ticks) {
     REDIRECT_SYSCALL(mutator, zx_ticks_get, SYSCALL_zx_ticks_get_via_kernel);
+    REDIRECT_SYSCALL(mutator, zx_clock_read_mapped, clock_read_mapped_via_kernel_ticks);
   }
 
   if (gBootOptions->vdso_clock_get_monotonic_force_syscall) {
@@ -352,6 +365,9 @@ const VDso* VDso::Create(KernelHandle<VmObjectDispatcher>* vmo_kernel_handles,
   // Fill out the contents of the time_values struct.
   SetTimeValues(vdso->vmo()->vmo());
 
+  // Fill out the contents of the cprng_values struct.
+  SetCprngValues(vdso->vmo()->vmo());
+
   DEBUG_ASSERT(!(vdso->vmo_rights() & ZX_RIGHT_WRITE));
   // Create the standalone time values VMO for use by fasttime.
   vdso->CreateTimeValuesVmo(time_values_handle);
@@ -361,13 +377,15 @@ const VDso* VDso::Create(KernelHandle<VmObjectDispatcher>* vmo_kernel_handles,
        ++v)
     vdso->CreateVariant(static_cast<Variant>(v), &vmo_kernel_handles[v]);
 
-  // Map and pin the time values VMO for each variant. We do this after having created all of the
-  // variants to avoid any issues with pinning pages in a VMO prior to snapshotting it.
+  // Map and pin the time and CPRNG values for each variant. We do this after having created all of
+  // the variants to avoid any issues with pinning pages in a VMO prior to snapshotting it.
   for (size_t v = static_cast<size_t>(Variant::STABLE); v < static_cast<size_t>(Variant::COUNT);
        ++v) {
     Variant var = static_cast<Variant>(v);
     zx_status_t status = vdso->MapTimeValuesVmo(var, vdso->variant_vmo_[variant_index(var)]->vmo());
     ASSERT(status == ZX_OK);
+    status = vdso->MapCprngValuesVmo(var, vdso->variant_vmo_[variant_index(var)]->vmo());
+    ASSERT(status == ZX_OK);
   }
 
   instance_ = vdso;
@@ -405,6 +423,12 @@ void VDso::AddMonotonicTicksOffset(zx_ticks_t additional) {
   }
 }
 
+void VDso::AdvanceCprngGenerationImpl() const {
+  for (auto cprng_values : cprng_values_) {
+    cprng_values->generation.fetch_add(1, ktl::memory_order_release);
+  }
+}
+
 zx_status_t VDso::MapTimeValuesVmo(Variant variant, const fbl::RefPtr<VmObject>& vdso_vmo) {
   size_t variant_idx = variant_index(variant);
   zx_status_t status = variant_time_mappings_[variant_idx].Init(
@@ -421,6 +445,20 @@ zx_status_t VDso::MapTimeValuesVmo(Variant variant, const fbl::RefPtr<VmObject>&
   return ZX_OK;
 }
 
+zx_status_t VDso::MapCprngValuesVmo(Variant variant, const fbl::RefPtr<VmObject>& vdso_vmo) {
+  size_t variant_idx = variant_index(variant);
+  zx_status_t status = variant_cprng_mappings_[variant_idx].Init(
+      vdso_vmo, VDSO_DATA_CPRNG_VALUES, VDSO_DATA_CPRNG_VALUES_SIZE, "vdso cprng values");
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  cprng_values_[variant_idx] =
+      reinterpret_cast<vdso_cprng_values*>(variant_cprng_mappings_[variant_idx].base_locking());
+
+  return ZX_OK;
+}
+
 // Each vDSO variant VMO is made via a COW clone of the next vDSO
 // VMO.  A variant can block some system calls, by syscall category.
 // This works by modifying the symbol table entries to make the symbols
@@ -0,0 +1,14 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ZIRCON_KERNEL_LIB_USERABI_VDSO_DATA_CPRNG_VALUES_H_
+#define ZIRCON_KERNEL_LIB_USERABI_VDSO_DATA_CPRNG_VALUES_H_
+
+// This defines the struct shared with the kernel.
+#include <lib/userabi/vdso-cprng.h>
+
+// References the DATA_CPRNG_VALUES variable declared in data.S.
+extern __LOCAL const struct vdso_cprng_values DATA_CPRNG_VALUES;
+
+#endif  // ZIRCON_KERNEL_LIB_USERABI_VDSO_DATA_CPRNG_VALUES_H_
@@ -0,0 +1,33 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fasttime/internal/clock.h>
+#include <lib/fasttime/internal/time.h>
+
+#include "data-time-values.h"
+#include "private.h"
+
+// Read a mapped clock by applying the transformation the kernel publishes in
+// the clock's page to the user-mode resident version of zx_ticks_get.
+__EXPORT zx_status_t _zx_clock_read_mapped(const void* clock_addr, zx_time_t* now) {
+  const auto& clock = *static_cast<const fasttime::internal::MappedClock*>(clock_addr);
+  *now = fasttime::internal::ReadMappedClock(clock, [] {
+    return fasttime::internal::compute_monotonic_ticks<
+        fasttime::internal::FasttimeVerificationMode::kSkip>(DATA_TIME_VALUES);
+  });
+  return ZX_OK;
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_read_mapped);
+
+// If user mode cannot read the tick counter, the kernel selects this version
+// instead. It still performs the sequence lock read and the transformation in
+// user mode, but queries ticks through the via_kernel version of zx_ticks_get.
+VDSO_KERNEL_EXPORT zx_status_t CODE_clock_read_mapped_via_kernel_ticks(const void* clock_addr,
+                                                                       zx_time_t* now) {
+  const auto& clock = *static_cast<const fasttime::internal::MappedClock*>(clock_addr);
+  *now = fasttime::internal::ReadMappedClock(clock,
+                                             [] { return SYSCALL_zx_ticks_get_via_kernel(); });
+  return ZX_OK;
+}
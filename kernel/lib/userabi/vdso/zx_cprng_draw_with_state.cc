@@ -0,0 +1,181 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "data-cprng-values.h"
+#include "private.h"
+
+// zx_cprng_draw_with_state is a ChaCha20 generator using "fast key erasure":
+// every batch of output is generated from the current key, the first 32 bytes
+// of the batch immediately replace that key, and each output byte is erased
+// from the state as it is handed out. The key itself comes from the kernel
+// CPRNG, which remains the root of trust. It is replaced whenever the kernel
+// advances DATA_CPRNG_VALUES.generation after reseeding.
+//
+// The vDSO cannot rely on memcpy or memset being available, so all copying is
+// done by hand, and all erasure uses volatile stores that cannot be elided.
+
+namespace {
+
+constexpr size_t kKeySize = 32;
+constexpr size_t kBlockSize = 64;
+constexpr size_t kBatchBlocks = 3;
+constexpr size_t kBatchSize = kBatchBlocks * kBlockSize;
+
+// The layout of the opaque ZX_CPRNG_STATE_SIZE bytes the caller provides.
+// A zero-initialized state has generation 0, which the kernel never
+// publishes, so it gets keyed on first use.
+struct State {
+  uint64_t generation;
+  uint32_t batch_used;
+  uint32_t reserved;
+  uint8_t key[kKeySize];
+  uint8_t batch[kBatchSize];
+};
+static_assert(sizeof(State) <= ZX_CPRNG_STATE_SIZE);
+
+void Wipe(void* ptr, size_t len) {
+  volatile uint8_t* p = static_cast<volatile uint8_t*>(ptr);
+  for (size_t i = 0; i < len; ++i) {
+    p[i] = 0;
+  }
+}
+
+[[noreturn]] void Crash() {
+  // We loop around __builtin_trap in case __builtin_trap doesn't
+  // actually terminate the process.
+  while (true) {
+    __builtin_trap();
+  }
+}
+
+constexpr uint32_t Rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+uint32_t LoadLe32(const uint8_t* p) {
+  return uint32_t{p[0]} | (uint32_t{p[1]} << 8) | (uint32_t{p[2]} << 16) | (uint32_t{p[3]} << 24);
+}
+
+void StoreLe32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+void QuarterRound(uint32_t x[16], int a, int b, int c, int d) {
+  x[a] += x[b];
+  x[d] = Rotl(x[d] ^ x[a], 16);
+  x[c] += x[d];
+  x[b] = Rotl(x[b] ^ x[c], 12);
+  x[a] += x[b];
+  x[d] = Rotl(x[d] ^ x[a], 8);
+  x[c] += x[d];
+  x[b] = Rotl(x[b] ^ x[c], 7);
+}
+
+// Computes ChaCha20 block |counter| for |key|, with an all-zero nonce, into
+// |out|. The nonce can stay fixed because no key is ever used for more than
+// one batch.
+void ChaCha20Block(const uint32_t key[8], uint32_t counter, uint8_t out[kBlockSize]) {
+  uint32_t input[16] = {
+      0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,  // "expand 32-byte k"
+      key[0],     key[1],     key[2],     key[3],      //
+      key[4],     key[5],     key[6],     key[7],      //
+      counter,    0,          0,          0,           //
+  };
+  uint32_t x[16];
+  for (int i = 0; i < 16; ++i) {
+    x[i] = input[i];
+  }
+  for (int round = 0; round < 20; round += 2) {
+    QuarterRound(x, 0, 4, 8, 12);
+    QuarterRound(x, 1, 5, 9, 13);
+    QuarterRound(x, 2, 6, 10, 14);
+    QuarterRound(x, 3, 7, 11, 15);
+    QuarterRound(x, 0, 5, 10, 15);
+    QuarterRound(x, 1, 6, 11, 12);
+    QuarterRound(x, 2, 7, 8, 13);
+    QuarterRound(x, 3, 4, 9, 14);
+  }
+  for (int i = 0; i < 16; ++i) {
+    StoreLe32(&out[i * 4], x[i] + input[i]);
+  }
+  Wipe(x, sizeof(x));
+  Wipe(input, sizeof(input));
+}
+
+// Generates a new batch from the current key, and replaces the key with the
+// first half of block 0. The rest of block 0 is discarded.
+void Refill(State& state) {
+  uint32_t key[8];
+  for (size_t i = 0; i < 8; ++i) {
+    key[i] = LoadLe32(&state.key[i * 4]);
+  }
+
+  uint8_t block[kBlockSize];
+  ChaCha20Block(key, 0, block);
+  for (size_t i = 0; i < kKeySize; ++i) {
+    state.key[i] = block[i];
+  }
+  Wipe(block, sizeof(block));
+
+  for (size_t i = 0; i < kBatchBlocks; ++i) {
+    ChaCha20Block(key, static_cast<uint32_t>(i + 1), &state.batch[i * kBlockSize]);
+  }
+  Wipe(key, sizeof(key));
+
+  state.batch_used = 0;
+}
+
+// Discards everything derived from the old key, and draws a new one from the
+// kernel CPRNG.
+void Rekey(State& state, uint64_t generation) {
+  Wipe(state.batch, sizeof(state.batch));
+  state.batch_used = kBatchSize;
+  if (unlikely(SYSCALL_zx_cprng_draw_once(state.key, sizeof(state.key)) != ZX_OK)) {
+    // zx_cprng_draw_once shouldn't fail unless given bogus arguments.
+    Crash();
+  }
+  state.generation = generation;
+}
+
+}  // namespace
+
+__EXPORT void _zx_cprng_draw_with_state(void* state_ptr, void* buffer, size_t len) {
+  State& state = *static_cast<State*>(state_ptr);
+
+  // The generation is read before rekeying, so that a reseed racing with this
+  // call leaves the state behind and the next call rekeys again.
+  const uint64_t generation = DATA_CPRNG_VALUES.generation.load(std::memory_order_acquire);
+  if (unlikely(state.generation != generation)) {
+    Rekey(state, generation);
+  }
+
+  uint8_t* out = static_cast<uint8_t*>(buffer);
+  while (len != 0) {
+    // The state is caller memory, so a corrupt batch_used must not be able to
+    // index past the batch.
+    if (state.batch_used >= kBatchSize) {
+      Refill(state);
+    }
+    size_t chunk = kBatchSize - state.batch_used;
+    if (chunk > len) {
+      chunk = len;
+    }
+    // Copy and erase one byte at a time, so that no output ever stays behind
+    // in the state once it has been returned.
+    volatile uint8_t* batch = &state.batch[state.batch_used];
+    for (size_t i = 0; i < chunk; ++i) {
+      out[i] = batch[i];
+      batch[i] = 0;
+    }
+    state.batch_used += static_cast<uint32_t>(chunk);
+    out += chunk;
+    len -= chunk;
+  }
+}
+
+VDSO_INTERFACE_FUNCTION(zx_cprng_draw_with_state);
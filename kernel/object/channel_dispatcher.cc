@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <platform.h>
 #include <string.h>
 #include <trace.h>
@@ -19,6 +20,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <kernel/event.h>
+#include <lk/init.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
 #include <object/process_dispatcher.h>
@@ -35,6 +37,8 @@ KCOUNTER(channel_packet_depth_unbounded, "channel.depth.unbounded")
 KCOUNTER(channel_full, "channel.full")
 KCOUNTER(dispatcher_channel_create_count, "dispatcher.channel.create")
 KCOUNTER(dispatcher_channel_destroy_count, "dispatcher.channel.destroy")
+KCOUNTER(dispatcher_channel_cache_live, "dispatcher.channel.cache.live")
+KCOUNTER(dispatcher_channel_cache_slabs, "dispatcher.channel.cache.slabs")
 
 namespace {
 
@@ -52,8 +56,33 @@ constexpr uint32_t kMinKernelGeneratedTxid = 0x80000000u;
 
 bool IsKernelGeneratedTxid(zx_txid_t txid) { return txid >= kMinKernelGeneratedTxid; }
 
+// Number of slabs each CPU retains for channel endpoints once they have been
+// allocated.
+constexpr size_t kChannelReserveSlabs = 1;
+
+object_cache::ObjectCache<ChannelDispatcher, object_cache::Option::PerCpu,
+                          ChannelDispatcherAllocator>
+    channel_allocator;
+
 }  // namespace
 
+void ChannelDispatcherAllocator::CountObjectAllocation() {
+  DefaultAllocator::CountObjectAllocation();
+  dispatcher_channel_cache_live.Add(1);
+}
+void ChannelDispatcherAllocator::CountObjectFree() {
+  DefaultAllocator::CountObjectFree();
+  dispatcher_channel_cache_live.Add(-1);
+}
+void ChannelDispatcherAllocator::CountSlabAllocation() {
+  DefaultAllocator::CountSlabAllocation();
+  dispatcher_channel_cache_slabs.Add(1);
+}
+void ChannelDispatcherAllocator::CountSlabFree() {
+  DefaultAllocator::CountSlabFree();
+  dispatcher_channel_cache_slabs.Add(-1);
+}
+
 // static
 int64_t ChannelDispatcher::get_channel_full_count() { return channel_full.SumAcrossAllCpus(); }
 
@@ -68,15 +97,17 @@ zx_status_t ChannelDispatcher::Create(KernelHandle<ChannelDispatcher>* handle0,
   }
   auto holder1 = holder0;
 
-  KernelHandle new_handle0(fbl::AdoptRef(new (&ac) ChannelDispatcher(ktl::move(holder0))));
-  if (!ac.check()) {
-    return ZX_ERR_NO_MEMORY;
+  auto result0 = channel_allocator.Allocate(ConstructorKey{}, ktl::move(holder0));
+  if (result0.is_error()) {
+    return result0.status_value();
   }
+  KernelHandle new_handle0(fbl::AdoptRef(result0.value().release()));
 
-  KernelHandle new_handle1(fbl::AdoptRef(new (&ac) ChannelDispatcher(ktl::move(holder1))));
-  if (!ac.check()) {
-    return ZX_ERR_NO_MEMORY;
+  auto result1 = channel_allocator.Allocate(ConstructorKey{}, ktl::move(holder1));
+  if (result1.is_error()) {
+    return result1.status_value();
   }
+  KernelHandle new_handle1(fbl::AdoptRef(result1.value().release()));
 
   new_handle0.dispatcher()->InitPeer(new_handle1.dispatcher());
   new_handle1.dispatcher()->InitPeer(new_handle0.dispatcher());
@@ -88,7 +119,8 @@ zx_status_t ChannelDispatcher::Create(KernelHandle<ChannelDispatcher>* handle0,
   return ZX_OK;
 }
 
-ChannelDispatcher::ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder)
+ChannelDispatcher::ChannelDispatcher(ConstructorKey,
+                                     fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder)
     : PeeredDispatcher(ktl::move(holder), ZX_CHANNEL_WRITABLE) {
   kcounter_add(dispatcher_channel_create_count, 1);
 }
@@ -498,7 +530,10 @@ void ChannelDispatcher::MessageWaiter::Deliver(MessagePacketPtr msg) {
 
   msg_ = ktl::move(msg);
   status_ = ZX_OK;
-  event_.Signal(ZX_OK);
+  // The reply is being handed directly to the thread blocked in Call.  Let the
+  // scheduler run it on this CPU, where the message was just written, rather
+  // than paying for an IPI and a cross-CPU cache transfer on every round trip.
+  event_.SignalSync(ZX_OK);
 }
 
 void ChannelDispatcher::MessageWaiter::Cancel(zx_status_t status) {
@@ -524,3 +559,14 @@ zx_status_t ChannelDispatcher::MessageWaiter::EndWait(MessagePacketPtr* out) {
   channel_ = nullptr;
   return status_;
 }
+
+void ChannelDispatcher::InitializeCacheAllocator(uint32_t /*level*/) {
+  zx::result result =
+      object_cache::ObjectCache<ChannelDispatcher, object_cache::Option::PerCpu,
+                                ChannelDispatcherAllocator>::Create(kChannelReserveSlabs);
+  ASSERT(result.is_ok());
+  channel_allocator = ktl::move(*result);
+}
+
+LK_INIT_HOOK(channel_dispatcher_cache_init, ChannelDispatcher::InitializeCacheAllocator,
+             LK_INIT_LEVEL_KERNEL + 1)
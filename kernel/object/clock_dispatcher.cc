@@ -13,7 +13,10 @@
 #include <zircon/syscalls/clock.h>
 
 #include <fbl/alloc_checker.h>
+#include <ktl/move.h>
 #include <object/clock_dispatcher.h>
+#include <vm/physmap.h>
+#include <vm/vm_object_paged.h>
 
 KCOUNTER(dispatcher_clock_create_count, "dispatcher.clock.create")
 KCOUNTER(dispatcher_clock_destroy_count, "dispatcher.clock.destroy")
@@ -83,8 +86,23 @@ zx_status_t ClockDispatcher::Create(uint64_t options, const zx_clock_create_args
     return ZX_ERR_INVALID_ARGS;
   }
 
+  // Mappable clocks publish their transformation in a page of their own which
+  // can be mapped read-only by clients. The page is pinned so that the kernel
+  // can update it through the physmap, with interrupts disabled.
+  fbl::RefPtr<VmObjectPaged> mapped_vmo;
+  if (options & ZX_CLOCK_OPT_MAPPABLE) {
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kAlwaysPinned,
+                                               PAGE_SIZE, &mapped_vmo);
+    if (status != ZX_OK) {
+      return status;
+    }
+    static constexpr char kName[] = "clock-mapped";
+    mapped_vmo->set_name(kName, sizeof(kName));
+  }
+
   fbl::AllocChecker ac;
-  KernelHandle clock(fbl::AdoptRef(new (&ac) ClockDispatcher(options, create_args.backstop_time)));
+  KernelHandle clock(fbl::AdoptRef(
+      new (&ac) ClockDispatcher(options, create_args.backstop_time, ktl::move(mapped_vmo))));
   if (!ac.check()) {
     return ZX_ERR_NO_MEMORY;
   }
@@ -94,8 +112,26 @@ zx_status_t ClockDispatcher::Create(uint64_t options, const zx_clock_create_args
   return ZX_OK;
 }
 
-ClockDispatcher::ClockDispatcher(uint64_t options, zx_time_t backstop_time)
-    : options_(options), backstop_time_(backstop_time) {
+namespace {
+
+fasttime::internal::MappedClock* MapClockPage(const fbl::RefPtr<VmObjectPaged>& vmo) {
+  if (!vmo) {
+    return nullptr;
+  }
+  paddr_t paddr;
+  zx_status_t status = vmo->LookupContiguous(0, PAGE_SIZE, &paddr);
+  ASSERT(status == ZX_OK);
+  return new (paddr_to_physmap(paddr)) fasttime::internal::MappedClock{};
+}
+
+}  // namespace
+
+ClockDispatcher::ClockDispatcher(uint64_t options, zx_time_t backstop_time,
+                                 fbl::RefPtr<VmObjectPaged> mapped_vmo)
+    : options_(options),
+      backstop_time_(backstop_time),
+      mapped_vmo_(ktl::move(mapped_vmo)),
+      mapped_clock_(MapClockPage(mapped_vmo_)) {
   affine::Transform local_ticks_to_synthetic;
   Params local_params;
 
@@ -120,6 +156,9 @@ ClockDispatcher::ClockDispatcher(uint64_t options, zx_time_t backstop_time)
     SeqLockGuard<ExclusiveIrqSave> lock{&seq_lock_};
     ticks_to_synthetic_.Update(local_ticks_to_synthetic);
     params_.Update(local_params);
+    if (mapped_clock_ != nullptr) {
+      fasttime::internal::PublishMappedClock(*mapped_clock_, local_ticks_to_synthetic);
+    }
   }
 
   // If we auto-started our clock, update our state.
@@ -374,6 +413,9 @@ zx_status_t ClockDispatcher::Update(uint64_t options, const UpdateArgsType& _arg
     ++local_params.generation_counter_;
     ticks_to_synthetic_.Update(local_ticks_to_synthetic);
     params_.Update(local_params);
+    if (mapped_clock_ != nullptr) {
+      fasttime::internal::PublishMappedClock(*mapped_clock_, local_ticks_to_synthetic);
+    }
   }
 
   // Now that we are out of the time critical section, if the clock was just
@@ -92,7 +92,9 @@ zx_status_t Dispatcher::AddObserver(SignalObserver* observer, const void* handle
     const zx_signals_t active_signals = signals_.load(ktl::memory_order_acquire);
     if ((active_signals & signals) != 0) {
       observer->OnMatch(active_signals);
-      return ZX_OK;
+      if (!observer->persistent_) {
+        return ZX_OK;
+      }
     }
   }
 
@@ -196,10 +198,12 @@ void Dispatcher::NotifyObserversLocked(zx_signals_t signals) {
       continue;
     }
 
-    auto to_remove = it;
+    auto matched = it;
     ++it;
-    observers_.erase(to_remove);
-    to_remove->OnMatch(signals);
+    if (!matched->persistent_) {
+      observers_.erase(matched);
+    }
+    matched->OnMatch(signals);
   }
 }
 
@@ -6,30 +6,73 @@
 
 #include "object/event_dispatcher.h"
 
+#include <assert.h>
 #include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <zircon/errors.h>
 #include <zircon/rights.h>
 #include <zircon/types.h>
 
-#include <fbl/alloc_checker.h>
+#include <lk/init.h>
 
 KCOUNTER(dispatcher_event_create_count, "dispatcher.event.create")
 KCOUNTER(dispatcher_event_destroy_count, "dispatcher.event.destroy")
+KCOUNTER(dispatcher_event_cache_live, "dispatcher.event.cache.live")
+KCOUNTER(dispatcher_event_cache_slabs, "dispatcher.event.cache.slabs")
+
+namespace {
+
+// Number of slabs each CPU retains for events once they have been allocated.
+constexpr size_t kEventReserveSlabs = 1;
+
+object_cache::ObjectCache<EventDispatcher, object_cache::Option::PerCpu, EventDispatcherAllocator>
+    event_allocator;
+
+}  // namespace
+
+void EventDispatcherAllocator::CountObjectAllocation() {
+  DefaultAllocator::CountObjectAllocation();
+  dispatcher_event_cache_live.Add(1);
+}
+void EventDispatcherAllocator::CountObjectFree() {
+  DefaultAllocator::CountObjectFree();
+  dispatcher_event_cache_live.Add(-1);
+}
+void EventDispatcherAllocator::CountSlabAllocation() {
+  DefaultAllocator::CountSlabAllocation();
+  dispatcher_event_cache_slabs.Add(1);
+}
+void EventDispatcherAllocator::CountSlabFree() {
+  DefaultAllocator::CountSlabFree();
+  dispatcher_event_cache_slabs.Add(-1);
+}
 
 zx_status_t EventDispatcher::Create(uint32_t options, KernelHandle<EventDispatcher>* handle,
                                     zx_rights_t* rights) {
-  fbl::AllocChecker ac;
-  KernelHandle event(fbl::AdoptRef(new (&ac) EventDispatcher(options)));
-  if (!ac.check())
-    return ZX_ERR_NO_MEMORY;
+  auto result = event_allocator.Allocate(ConstructorKey{}, options);
+  if (result.is_error())
+    return result.status_value();
+  KernelHandle event(fbl::AdoptRef(result.value().release()));
 
   *rights = default_rights();
   *handle = ktl::move(event);
   return ZX_OK;
 }
 
-EventDispatcher::EventDispatcher(uint32_t options) {
+EventDispatcher::EventDispatcher(ConstructorKey, uint32_t options) {
   kcounter_add(dispatcher_event_create_count, 1);
 }
 
 EventDispatcher::~EventDispatcher() { kcounter_add(dispatcher_event_destroy_count, 1); }
+
+void EventDispatcher::InitializeCacheAllocator(uint32_t /*level*/) {
+  zx::result result =
+      object_cache::ObjectCache<EventDispatcher, object_cache::Option::PerCpu,
+                                EventDispatcherAllocator>::Create(kEventReserveSlabs);
+  ASSERT(result.is_ok());
+  event_allocator = ktl::move(*result);
+}
+
+// Initialize the cache after the percpu data structures are initialized.
+LK_INIT_HOOK(event_dispatcher_cache_init, EventDispatcher::InitializeCacheAllocator,
+             LK_INIT_LEVEL_KERNEL + 1)
@@ -8,14 +8,47 @@
 
 #include <assert.h>
 #include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <zircon/errors.h>
 #include <zircon/rights.h>
 #include <zircon/types.h>
 
 #include <fbl/alloc_checker.h>
+#include <lk/init.h>
 
 KCOUNTER(dispatcher_eventpair_create_count, "dispatcher.eventpair.create")
 KCOUNTER(dispatcher_eventpair_destroy_count, "dispatcher.eventpair.destroy")
+KCOUNTER(dispatcher_eventpair_cache_live, "dispatcher.eventpair.cache.live")
+KCOUNTER(dispatcher_eventpair_cache_slabs, "dispatcher.eventpair.cache.slabs")
+
+namespace {
+
+// Each CPU keeps a slab of event pair endpoints around once it has been
+// allocated. Endpoints are allocated two at a time, from the same CPU.
+constexpr size_t kEventPairReserveSlabs = 1;
+
+object_cache::ObjectCache<EventPairDispatcher, object_cache::Option::PerCpu,
+                          EventPairDispatcherAllocator>
+    eventpair_allocator;
+
+}  // namespace
+
+void EventPairDispatcherAllocator::CountObjectAllocation() {
+  DefaultAllocator::CountObjectAllocation();
+  dispatcher_eventpair_cache_live.Add(1);
+}
+void EventPairDispatcherAllocator::CountObjectFree() {
+  DefaultAllocator::CountObjectFree();
+  dispatcher_eventpair_cache_live.Add(-1);
+}
+void EventPairDispatcherAllocator::CountSlabAllocation() {
+  DefaultAllocator::CountSlabAllocation();
+  dispatcher_eventpair_cache_slabs.Add(1);
+}
+void EventPairDispatcherAllocator::CountSlabFree() {
+  DefaultAllocator::CountSlabFree();
+  dispatcher_eventpair_cache_slabs.Add(-1);
+}
 
 zx_status_t EventPairDispatcher::Create(KernelHandle<EventPairDispatcher>* handle0,
                                         KernelHandle<EventPairDispatcher>* handle1,
@@ -26,13 +59,15 @@ zx_status_t EventPairDispatcher::Create(KernelHandle<EventPairDispatcher>* handl
     return ZX_ERR_NO_MEMORY;
   auto holder1 = holder0;
 
-  KernelHandle ep0(fbl::AdoptRef(new (&ac) EventPairDispatcher(ktl::move(holder0))));
-  if (!ac.check())
-    return ZX_ERR_NO_MEMORY;
+  auto result0 = eventpair_allocator.Allocate(ConstructorKey{}, ktl::move(holder0));
+  if (result0.is_error())
+    return result0.status_value();
+  KernelHandle ep0(fbl::AdoptRef(result0.value().release()));
 
-  KernelHandle ep1(fbl::AdoptRef(new (&ac) EventPairDispatcher(ktl::move(holder1))));
-  if (!ac.check())
-    return ZX_ERR_NO_MEMORY;
+  auto result1 = eventpair_allocator.Allocate(ConstructorKey{}, ktl::move(holder1));
+  if (result1.is_error())
+    return result1.status_value();
+  KernelHandle ep1(fbl::AdoptRef(result1.value().release()));
 
   ep0.dispatcher()->InitPeer(ep1.dispatcher());
   ep1.dispatcher()->InitPeer(ep0.dispatcher());
@@ -52,7 +87,19 @@ void EventPairDispatcher::OnPeerZeroHandlesLocked() {
   UpdateStateLocked(0u, ZX_EVENTPAIR_PEER_CLOSED);
 }
 
-EventPairDispatcher::EventPairDispatcher(fbl::RefPtr<PeerHolder<EventPairDispatcher>> holder)
+EventPairDispatcher::EventPairDispatcher(ConstructorKey,
+                                         fbl::RefPtr<PeerHolder<EventPairDispatcher>> holder)
     : PeeredDispatcher(ktl::move(holder)) {
   kcounter_add(dispatcher_eventpair_create_count, 1);
 }
+
+void EventPairDispatcher::InitializeCacheAllocator(uint32_t /*level*/) {
+  zx::result result =
+      object_cache::ObjectCache<EventPairDispatcher, object_cache::Option::PerCpu,
+                                EventPairDispatcherAllocator>::Create(kEventPairReserveSlabs);
+  ASSERT(result.is_ok());
+  eventpair_allocator = ktl::move(*result);
+}
+
+LK_INIT_HOOK(eventpair_dispatcher_cache_init, EventPairDispatcher::InitializeCacheAllocator,
+             LK_INIT_LEVEL_KERNEL + 1)
@@ -7,6 +7,7 @@
 #ifndef ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_CHANNEL_DISPATCHER_H_
 #define ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_CHANNEL_DISPATCHER_H_
 
+#include <lib/object_cache.h>
 #include <stdint.h>
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -21,14 +22,31 @@
 #include <object/handle.h>
 #include <object/message_packet.h>
 
+// Slab allocator for channel endpoints, with occupancy reported through the
+// dispatcher.channel.cache.* kcounters.
+struct ChannelDispatcherAllocator : object_cache::DefaultAllocator {
+  static void CountObjectAllocation();
+  static void CountObjectFree();
+  static void CountSlabAllocation();
+  static void CountSlabFree();
+};
+
 class ChannelDispatcher final
-    : public PeeredDispatcher<ChannelDispatcher, ZX_DEFAULT_CHANNEL_RIGHTS> {
+    : public PeeredDispatcher<ChannelDispatcher, ZX_DEFAULT_CHANNEL_RIGHTS>,
+      public object_cache::Deletable<ChannelDispatcher, ChannelDispatcherAllocator> {
+ private:
+  // Only Create() can construct endpoints; see EventDispatcher::ConstructorKey.
+  struct ConstructorKey {
+    explicit ConstructorKey() = default;
+  };
+
  public:
   class MessageWaiter;
 
   static zx_status_t Create(KernelHandle<ChannelDispatcher>* handle0,
                             KernelHandle<ChannelDispatcher>* handle1, zx_rights_t* rights);
 
+  ChannelDispatcher(ConstructorKey, fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder);
   ~ChannelDispatcher() final;
   zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_CHANNEL; }
 
@@ -116,12 +134,12 @@ class ChannelDispatcher final
 
   void set_owner(zx_koid_t new_owner) final;
 
+  static void InitializeCacheAllocator(uint32_t level);
+
  private:
   using MessageList = fbl::SizedDoublyLinkedList<MessagePacketPtr>;
   using WaiterList = fbl::DoublyLinkedList<MessageWaiter*>;
 
-  explicit ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder);
-
   void RemoveWaiter(MessageWaiter* waiter);
 
   // Cancels (with |status|) any channel_call message waiters waiting on this endpoint.
@@ -8,6 +8,7 @@
 #define ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_CLOCK_DISPATCHER_H_
 
 #include <lib/affine/transform.h>
+#include <lib/fasttime/internal/clock.h>
 #include <lib/kconcurrent/seqlock.h>
 #include <lib/relaxed_atomic.h>
 #include <sys/types.h>
@@ -17,6 +18,7 @@
 
 #include <object/dispatcher.h>
 #include <object/handle.h>
+#include <vm/vm_object_paged.h>
 
 class ClockDispatcher final : public SoloDispatcher<ClockDispatcher, ZX_DEFAULT_CLOCK_RIGHTS> {
  public:
@@ -32,6 +34,10 @@ class ClockDispatcher final : public SoloDispatcher<ClockDispatcher, ZX_DEFAULT_
   template <typename UpdateArgsType>
   zx_status_t Update(uint64_t options, const UpdateArgsType& args);
 
+  // The read-only page that a ZX_CLOCK_OPT_MAPPABLE clock publishes its ticks
+  // to synthetic transformation in, or null if the clock is not mappable.
+  const fbl::RefPtr<VmObjectPaged>& mapped_vmo() const { return mapped_vmo_; }
+
  private:
   struct Params {
     affine::Transform mono_to_synthetic{0, 0, {0, 1}};
@@ -43,10 +49,12 @@ class ClockDispatcher final : public SoloDispatcher<ClockDispatcher, ZX_DEFAULT_
     int32_t cur_ppm_adj = 0;
   };
 
-  ClockDispatcher(uint64_t options, zx_time_t backstop_time);
+  ClockDispatcher(uint64_t options, zx_time_t backstop_time,
+                  fbl::RefPtr<VmObjectPaged> mapped_vmo);
 
   bool is_monotonic() const { return (options_ & ZX_CLOCK_OPT_MONOTONIC) != 0; }
   bool is_continuous() const { return (options_ & ZX_CLOCK_OPT_CONTINUOUS) != 0; }
+  bool is_mappable() const { return (options_ & ZX_CLOCK_OPT_MAPPABLE) != 0; }
   bool is_started() TA_REQ(seq_lock_) {
     // Note, we require that we hold the seq_lock_ exclusively here.  This
     // should ensure that there are no other threads writing to this memory
@@ -71,6 +79,13 @@ class ClockDispatcher final : public SoloDispatcher<ClockDispatcher, ZX_DEFAULT_
   using SeqLockGuard = Guard<decltype(seq_lock_)::LockType, Policy>;
   TA_GUARDED(seq_lock_) Payload<affine::Transform> ticks_to_synthetic_{0, 0, affine::Ratio{0, 1}};
   TA_GUARDED(seq_lock_) Payload<Params> params_;
+
+  // For mappable clocks, every update of ticks_to_synthetic_ is mirrored into
+  // |mapped_clock_|, which lives in the pinned page of |mapped_vmo_| and is
+  // accessed through the physmap. Writers are serialized by seq_lock_, while
+  // userspace readers use the sequence counter of the MappedClock itself.
+  const fbl::RefPtr<VmObjectPaged> mapped_vmo_;
+  fasttime::internal::MappedClock* const mapped_clock_;
 };
 
 #endif  // ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_CLOCK_DISPATCHER_H_
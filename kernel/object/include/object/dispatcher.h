@@ -76,6 +76,7 @@ DECLARE_DISPTAG(ClockDispatcher, ZX_OBJ_TYPE_CLOCK, "CLOK")
 DECLARE_DISPTAG(StreamDispatcher, ZX_OBJ_TYPE_STREAM, "STRM")
 DECLARE_DISPTAG(MsiDispatcher, ZX_OBJ_TYPE_MSI, "MSID")
 DECLARE_DISPTAG(IoBufferDispatcher, ZX_OBJ_TYPE_IOB, "IOBD")
+DECLARE_DISPTAG(WaitSetDispatcher, ZX_OBJ_TYPE_WAIT_SET, "WSTD")
 
 #undef DECLARE_DISPTAG
 
@@ -149,7 +150,8 @@ class Dispatcher : private fbl::RefCountedUpgradeable<Dispatcher>,
   //
   // If |trigger_mode| is set to Edge, the signal state is not checked
   // on entry and the observer is only triggered if a signal subsequently
-  // becomes active.
+  // becomes active. A persistent observer that matches on entry is still
+  // added.
   zx_status_t AddObserver(SignalObserver* observer, const void* handle, zx_signals_t signals,
                           TriggerMode trigger_mode = TriggerMode::Level);
 
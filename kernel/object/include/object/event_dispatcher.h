@@ -7,6 +7,7 @@
 #ifndef ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_EVENT_DISPATCHER_H_
 #define ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_EVENT_DISPATCHER_H_
 
+#include <lib/object_cache.h>
 #include <sys/types.h>
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -14,17 +15,35 @@
 #include <object/dispatcher.h>
 #include <object/handle.h>
 
+// Slab allocator for EventDispatcher that reports the cache occupancy through
+// the dispatcher.event.cache.* kcounters, in addition to the global cache.*
+// kcounters.
+struct EventDispatcherAllocator : object_cache::DefaultAllocator {
+  static void CountObjectAllocation();
+  static void CountObjectFree();
+  static void CountSlabAllocation();
+  static void CountSlabFree();
+};
+
 class EventDispatcher final
-    : public SoloDispatcher<EventDispatcher, ZX_DEFAULT_EVENT_RIGHTS, ZX_EVENT_SIGNALED> {
+    : public SoloDispatcher<EventDispatcher, ZX_DEFAULT_EVENT_RIGHTS, ZX_EVENT_SIGNALED>,
+      public object_cache::Deletable<EventDispatcher, EventDispatcherAllocator> {
+ private:
+  // Restricts construction to Create(). The constructor has to be public so
+  // that the object cache can construct instances in place.
+  struct ConstructorKey {
+    explicit ConstructorKey() = default;
+  };
+
  public:
   static zx_status_t Create(uint32_t options, KernelHandle<EventDispatcher>* handle,
                             zx_rights_t* rights);
 
+  EventDispatcher(ConstructorKey, uint32_t options);
   ~EventDispatcher() final;
   zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_EVENT; }
 
- private:
-  explicit EventDispatcher(uint32_t options);
+  static void InitializeCacheAllocator(uint32_t level);
 };
 
 fbl::RefPtr<EventDispatcher> GetMemPressureEvent(uint32_t kind);
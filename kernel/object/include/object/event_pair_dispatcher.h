@@ -7,6 +7,7 @@
 #ifndef ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_EVENT_PAIR_DISPATCHER_H_
 #define ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_EVENT_PAIR_DISPATCHER_H_
 
+#include <lib/object_cache.h>
 #include <sys/types.h>
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -15,12 +16,29 @@
 #include <object/dispatcher.h>
 #include <object/handle.h>
 
+// Slab allocator for event pair endpoints. Occupancy is reported through the
+// dispatcher.eventpair.cache.* kcounters.
+struct EventPairDispatcherAllocator : object_cache::DefaultAllocator {
+  static void CountObjectAllocation();
+  static void CountObjectFree();
+  static void CountSlabAllocation();
+  static void CountSlabFree();
+};
+
 class EventPairDispatcher final
-    : public PeeredDispatcher<EventPairDispatcher, ZX_DEFAULT_EVENTPAIR_RIGHTS, ZX_EVENT_SIGNALED> {
+    : public PeeredDispatcher<EventPairDispatcher, ZX_DEFAULT_EVENTPAIR_RIGHTS, ZX_EVENT_SIGNALED>,
+      public object_cache::Deletable<EventPairDispatcher, EventPairDispatcherAllocator> {
+ private:
+  // See EventDispatcher::ConstructorKey.
+  struct ConstructorKey {
+    explicit ConstructorKey() = default;
+  };
+
  public:
   static zx_status_t Create(KernelHandle<EventPairDispatcher>* handle0,
                             KernelHandle<EventPairDispatcher>* handle1, zx_rights_t* rights);
 
+  EventPairDispatcher(ConstructorKey, fbl::RefPtr<PeerHolder<EventPairDispatcher>> holder);
   ~EventPairDispatcher() final;
   zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_EVENTPAIR; }
 
@@ -28,8 +46,7 @@ class EventPairDispatcher final
   void on_zero_handles_locked() TA_REQ(get_lock());
   void OnPeerZeroHandlesLocked() TA_REQ(get_lock());
 
- private:
-  explicit EventPairDispatcher(fbl::RefPtr<PeerHolder<EventPairDispatcher>> holder);
+  static void InitializeCacheAllocator(uint32_t level);
 };
 
 #endif  // ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_EVENT_PAIR_DISPATCHER_H_
@@ -11,6 +11,7 @@
 #include <lib/zx/result.h>
 #include <zircon/assert.h>
 #include <zircon/rights.h>
+#include <zircon/syscalls-next.h>
 #include <zircon/syscalls/iob.h>
 #include <zircon/types.h>
 
@@ -32,8 +33,9 @@
 
 enum class IobEndpointId : size_t { Ep0 = 0, Ep1 = 1 };
 
-class IoBufferDispatcher : public PeeredDispatcher<IoBufferDispatcher, ZX_DEFAULT_IOB_RIGHTS>,
-                           public VmObjectChildObserver {
+class IoBufferDispatcher
+    : public PeeredDispatcher<IoBufferDispatcher, ZX_DEFAULT_IOB_RIGHTS, ZX_IOB_RING_WATERMARK>,
+      public VmObjectChildObserver {
  public:
   // Make sure that RegionArray is small enough to comfortably fit on the stack.
   using RegionArray = fbl::InlineArray<zx_iob_region_t, 4>;
@@ -62,6 +64,12 @@ class IoBufferDispatcher : public PeeredDispatcher<IoBufferDispatcher, ZX_DEFAUL
   zx::result<uint32_t> AllocateId(size_t region_index, user_in_ptr<const ktl::byte> blob_ptr,
                                   size_t blob_size);
 
+  // Writes a record to a ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER region, asserting
+  // ZX_IOB_RING_WATERMARK on the peer if the ring has filled up to its
+  // watermark.
+  zx::result<> WriteRecord(size_t region_index, user_in_ptr<const ktl::byte> data_ptr,
+                           size_t data_size);
+
   // PeeredDispatcher implementation
   void on_zero_handles_locked() TA_REQ(get_lock());
   virtual void OnPeerZeroHandlesLocked() TA_REQ(get_lock());
@@ -218,7 +226,33 @@ class IoBufferDispatcher : public PeeredDispatcher<IoBufferDispatcher, ZX_DEFAUL
     PinnedVmObject pin_;
   };
 
-  using IobRegionVariant = ktl::variant<IobRegionNone, IobRegionIdAllocator>;
+  // Represents ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER.
+  class IobRegionRingBuffer : public IobRegion {
+   public:
+    using IobRegion::IobRegion;
+
+    // Validates the configuration and initializes the ring header, and, when
+    // mediated access is requested, pins and maps the whole region for
+    // reliable future access. This must be called before other methods.
+    zx::result<> Init();
+
+    // Copies a record into the ring. On success, returns whether the unread
+    // bytes in the ring have reached the watermark.
+    zx::result<bool> WriteRecord(IobEndpointId id, user_in_ptr<const ktl::byte> data_ptr,
+                                 size_t data_size);
+
+   private:
+    ktl::span<ktl::byte> data() {
+      return {reinterpret_cast<ktl::byte*>(base()) + sizeof(zx_iob_ring_header_t), capacity_};
+    }
+
+    PinnedVmObject pin_;
+    uint64_t capacity_ = 0;
+    uint64_t watermark_ = 0;
+  };
+
+  using IobRegionVariant =
+      ktl::variant<IobRegionNone, IobRegionIdAllocator, IobRegionRingBuffer>;
 
   static zx::result<IobRegionVariant> CreateIobRegionVariant(fbl::RefPtr<VmObject> ep0_vmo,     //
                                                              fbl::RefPtr<VmObject> ep1_vmo,     //
@@ -22,10 +22,18 @@ class SignalObserver : public fbl::DoublyLinkedListable<SignalObserver*> {
  public:
   SignalObserver() = default;
 
+  // Tag type for constructing a persistent observer. By default observers
+  // are one-shot: they are unregistered just before OnMatch is called. A
+  // persistent observer stays registered until it is removed or canceled,
+  // and OnMatch is called every time its signals match.
+  struct Persistent {};
+  explicit SignalObserver(Persistent) : persistent_(true) {}
+
   // Called when the set of active signals matches an expected set.
   //
   // At the time this is call, it is safe to delete this object: the
-  // caller will not interact with it again.
+  // caller will not interact with it again. This does not hold for
+  // persistent observers, which are still registered.
   //
   // WARNING: This is called under Dispatcher's lock
   virtual void OnMatch(zx_signals_t signals) = 0;
@@ -55,6 +63,7 @@ class SignalObserver : public fbl::DoublyLinkedListable<SignalObserver*> {
   friend class Dispatcher;
   zx_signals_t triggering_signals_;
   const void* handle_;
+  const bool persistent_ = false;
 };
 
 #endif  // ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_SIGNAL_OBSERVER_H_
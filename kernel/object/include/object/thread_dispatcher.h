@@ -113,8 +113,10 @@ class ThreadDispatcher final : public SoloDispatcher<ThreadDispatcher, ZX_DEFAUL
   // Issues a restricted kick on the thread which will kick the thread out of restricted
   // mode to normal mode if it's currently in restricted mode or remember the kick state for
   // the next attempt to enter restricted state.
+  // If |upcall| is set, the thread is instead redirected to its restricted mode upcall handler,
+  // without leaving restricted mode.
   // Returns ZX_OK on success or ZX_ERR_BAD_STATE iff the thread is dying or dead.
-  zx_status_t RestrictedKick();
+  zx_status_t RestrictedKick(bool upcall);
 
   // accessors
   ProcessDispatcher* process() const { return process_.get(); }
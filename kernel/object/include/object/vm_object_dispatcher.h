@@ -85,6 +85,8 @@ class VmObjectDispatcher final : public SoloDispatcher<VmObjectDispatcher, ZX_DE
   zx_status_t WriteVector(user_in_iovec_t user_data, size_t length, uint64_t offset,
                           size_t* out_actual,
                           VmObject::OnWriteBytesTransferredCallback on_bytes_transferred = nullptr);
+  zx_status_t ReadScatter(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual);
+  zx_status_t WriteGather(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual);
   zx_status_t SetSize(uint64_t);
   zx_status_t GetSize(uint64_t* size);
   zx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_inout_ptr<void> buffer,
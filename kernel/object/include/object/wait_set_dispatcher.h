@@ -0,0 +1,185 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#ifndef ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_WAIT_SET_DISPATCHER_H_
+#define ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_WAIT_SET_DISPATCHER_H_
+
+#include <sys/types.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/types.h>
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <object/dispatcher.h>
+#include <object/handle.h>
+#include <object/signal_observer.h>
+
+// The wait set object is a persistent version of zx_object_wait_many(). Rather
+// than registering and unregistering an observer for every item of every wait,
+// each object is registered once with a WaitSetEntry, and the wait set keeps a
+// list of the entries whose signals became active. A wait only looks at that
+// list, so it costs O(ready) rather than O(registered).
+//
+// Entries are level triggered, and are registered as persistent observers, so
+// OnMatch is called every time an entry's object asserts any of its signals,
+// which puts the entry onto the ready list unless it is already there. A wait
+// takes entries off the list, and puts the ones it reports back on, as their
+// objects are still asserting the signals of interest.
+//
+// Lifetime
+//
+// Entries are reference counted. The wait set's tree of entries holds one
+// reference, as does the ready list while an entry is on it, and so does any
+// thread that is adding an entry or reporting it from a wait. The Dispatcher
+// only has a raw pointer to the entry, so an entry must be unregistered before
+// the last reference to it is dropped:
+//
+// - An entry is removed from the set (zx_wait_set_remove, or the last handle to
+//   the set being closed) by marking it removed under the wait set's lock, and
+//   then calling RemoveObserver without that lock.
+//
+// - The thread that adds an entry checks whether the entry was removed once
+//   AddObserver returns, and calls RemoveObserver itself if it was. This covers
+//   a removal that happens while the registration is in progress.
+//
+// - An entry is registered with the handle used to add it, in the same way as
+//   zx_object_wait_async() registers a port observer. Closing or transferring
+//   that handle cancels the entry, which removes it from the set. The handle
+//   being closed still holds a reference to the object, so the entry's own
+//   reference is never the last one when it is dropped from OnCancel.
+//
+// OnMatch and OnCancel are ignored for removed entries.
+//
+// Tying entries to handles is what keeps a wait set from leaking: an entry
+// holds a reference to its object, and that object may in turn hold the last
+// handle to the wait set, for instance in a message queued on a channel.
+//
+// Locking
+//
+// The WaitSetDispatcher's lock guards its tree of entries, its ready list, and
+// the |removed_| flag of every entry. Since OnMatch is called with the observed
+// Dispatcher's lock held, the wait set's lock can be acquired while holding a
+// Dispatcher's lock, and a Dispatcher's lock must never be acquired while
+// holding the wait set's lock.
+
+class WaitSetDispatcher;
+
+namespace internal {
+struct WaitSetEntryTreeTag {};
+struct WaitSetEntryListTag {};
+}  // namespace internal
+
+class WaitSetEntry final
+    : public SignalObserver,
+      public fbl::RefCounted<WaitSetEntry>,
+      public fbl::ContainableBaseClasses<
+          fbl::TaggedWAVLTreeContainable<fbl::RefPtr<WaitSetEntry>, internal::WaitSetEntryTreeTag>,
+          fbl::TaggedDoublyLinkedListable<fbl::RefPtr<WaitSetEntry>,
+                                          internal::WaitSetEntryListTag>> {
+ public:
+  using TreeTag = internal::WaitSetEntryTreeTag;
+  using ListTag = internal::WaitSetEntryListTag;
+
+  WaitSetEntry(WaitSetDispatcher* wait_set, fbl::RefPtr<Dispatcher> dispatcher, uint64_t key,
+               zx_signals_t signals)
+      : SignalObserver(SignalObserver::Persistent{}),
+        wait_set_(wait_set),
+        dispatcher_(ktl::move(dispatcher)),
+        key_(key),
+        signals_(signals) {}
+
+  ~WaitSetEntry() final = default;
+
+  uint64_t GetKey() const { return key_; }
+  zx_signals_t signals() const { return signals_; }
+  Dispatcher& dispatcher() const { return *dispatcher_; }
+
+ private:
+  friend class WaitSetDispatcher;
+
+  WaitSetEntry(const WaitSetEntry&) = delete;
+  WaitSetEntry& operator=(const WaitSetEntry&) = delete;
+
+  // |SignalObserver| implementation.
+  void OnMatch(zx_signals_t signals) final;
+  void OnCancel(zx_signals_t signals) final;
+
+  // A raw pointer is enough, as entries are unregistered from their Dispatcher
+  // before the wait set can be destroyed.
+  WaitSetDispatcher* const wait_set_;
+  const fbl::RefPtr<Dispatcher> dispatcher_;
+  const uint64_t key_;
+  const zx_signals_t signals_;
+
+  // Guarded by the wait set's lock.
+  bool removed_ = false;
+};
+
+class WaitSetDispatcher final
+    : public SoloDispatcher<WaitSetDispatcher, ZX_DEFAULT_WAIT_SET_RIGHTS> {
+ public:
+  // The maximum number of entries a single wait set can hold. Entries go away
+  // when the handles used to add them are closed, but one handle can be added
+  // under many keys, so this is what bounds the kernel memory a wait set can
+  // consume.
+  static constexpr size_t kMaxEntries = 16384;
+
+  // The maximum number of results a single Wait() can return.
+  static constexpr size_t kMaxResults = 32;
+
+  static zx_status_t Create(uint32_t options, KernelHandle<WaitSetDispatcher>* handle,
+                            zx_rights_t* rights);
+
+  ~WaitSetDispatcher() final;
+  zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_WAIT_SET; }
+  void on_zero_handles() final;
+
+  // Registers the object behind |handle| under |key|, to be reported whenever
+  // it asserts any of |signals|. The entry is removed when |handle| is closed.
+  // Must be called under the handle table lock, so that |handle| cannot be
+  // closed while it is being registered.
+  zx_status_t Add(Handle* handle, uint64_t key, zx_signals_t signals);
+
+  // Removes the entry registered under |key|.
+  zx_status_t Remove(uint64_t key);
+
+  // Waits until at least one entry is ready or |deadline| passes, and fills in
+  // up to |count| of |results| with ready entries, where |count| is at most
+  // kMaxResults.
+  zx_status_t Wait(const Deadline& deadline, zx_wait_set_result_t* results, size_t count,
+                   size_t* actual);
+
+ private:
+  using EntryTree = fbl::TaggedWAVLTree<uint64_t, fbl::RefPtr<WaitSetEntry>, WaitSetEntry::TreeTag>;
+  using ReadyList = fbl::TaggedDoublyLinkedList<fbl::RefPtr<WaitSetEntry>, WaitSetEntry::ListTag>;
+
+  friend class WaitSetEntry;
+
+  WaitSetDispatcher();
+
+  // Called by |entry| when its signals become active.
+  void OnEntryMatch(WaitSetEntry* entry);
+
+  // Called by |entry| when the handle it was added with is closed.
+  void OnEntryCancel(WaitSetEntry* entry);
+
+  // Marks |entry| as removed and takes it off the ready list. The caller is
+  // responsible for unregistering the entry once the lock is dropped.
+  void UnlinkLocked(WaitSetEntry& entry) TA_REQ(get_lock());
+
+  // Signaled for as long as |ready_| is not empty.
+  Event ready_event_;
+
+  bool zero_handles_ TA_GUARDED(get_lock()) = false;
+  EntryTree entries_ TA_GUARDED(get_lock());
+  ReadyList ready_ TA_GUARDED(get_lock());
+};
+
+#endif  // ZIRCON_KERNEL_OBJECT_INCLUDE_OBJECT_WAIT_SET_DISPATCHER_H_
@@ -18,12 +18,14 @@
 
 #include <cstdint>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
 #include <fbl/ref_ptr.h>
 #include <kernel/koid.h>
 #include <kernel/lockdep.h>
 #include <kernel/mutex.h>
+#include <ktl/atomic.h>
 #include <ktl/move.h>
 #include <object/dispatcher.h>
 #include <object/handle.h>
@@ -41,6 +43,21 @@
 KCOUNTER(dispatcher_iob_create_count, "dispatcher.iob.create")
 KCOUNTER(dispatcher_iob_destroy_count, "dispatcher.iob.destroy")
 
+namespace {
+
+// Publishes a ring buffer record header. Both fields are stored together as
+// a single 64-bit word, which is how producers and consumers access them.
+void CommitRingRecord(ktl::byte* record, uint32_t size, uint32_t flags) {
+  zx_iob_ring_record_t header = {.size = size, .flags = flags};
+  uint64_t word;
+  static_assert(sizeof(header) == sizeof(word));
+  memcpy(&word, &header, sizeof(word));
+  ktl::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t*>(record))
+      .store(word, ktl::memory_order_release);
+}
+
+}  // namespace
+
 // static
 zx::result<fbl::Array<IoBufferDispatcher::IobRegionVariant>> IoBufferDispatcher::CreateRegions(
     const IoBufferDispatcher::RegionArray& region_configs, VmObjectChildObserver* ep0,
@@ -372,6 +389,31 @@ zx::result<uint32_t> IoBufferDispatcher::AllocateId(size_t region_index,
   return zx::error{ZX_ERR_WRONG_TYPE};
 }
 
+zx::result<> IoBufferDispatcher::WriteRecord(size_t region_index,
+                                             user_in_ptr<const ktl::byte> data_ptr,
+                                             size_t data_size) {
+  if (region_index >= RegionCount()) {
+    return zx::error{ZX_ERR_OUT_OF_RANGE};
+  }
+  auto* region = shared_state_->GetRegion<IobRegionRingBuffer>(region_index);
+  if (!region) {
+    return zx::error{ZX_ERR_WRONG_TYPE};
+  }
+
+  zx::result<bool> result = region->WriteRecord(GetEndpointId(), data_ptr, data_size);
+  if (result.is_error()) {
+    return result.take_error();
+  }
+  if (*result) {
+    Guard<CriticalMutex> guard{get_lock()};
+    if (const fbl::RefPtr<IoBufferDispatcher>& p = peer(); p) {
+      AssertHeld(*p->get_lock());
+      p->UpdateStateLocked(0, ZX_IOB_RING_WATERMARK);
+    }
+  }
+  return zx::ok();
+}
+
 // static
 zx::result<IoBufferDispatcher::IobRegionVariant> IoBufferDispatcher::CreateIobRegionVariant(
     fbl::RefPtr<VmObject> ep0_vmo,     //
@@ -410,6 +452,14 @@ zx::result<IoBufferDispatcher::IobRegionVariant> IoBufferDispatcher::CreateIobRe
         }
         mapping_name = "IOBuffer region (ID allocator)";
         break;
+      case ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER:
+        // The kernel only ever produces into a ring, so as with ID allocators,
+        // mediated access must admit writes.
+        if (mediated0 == kEp0MedR || mediated1 == kEp1MedR) {
+          return zx::error{ZX_ERR_INVALID_ARGS};
+        }
+        mapping_name = "IOBuffer region (ring buffer)";
+        break;
       case ZX_IOB_DISCIPLINE_TYPE_NONE:
         // NONE type discipline does not support mediated access.
         [[fallthrough]];
@@ -449,6 +499,15 @@ zx::result<IoBufferDispatcher::IobRegionVariant> IoBufferDispatcher::CreateIobRe
       variant = ktl::move(allocator);
       break;
     }
+    case ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER: {
+      IobRegionRingBuffer ring{
+          ktl::move(ep0_vmo), ktl::move(ep1_vmo), ktl::move(mapping), base, region, koid};
+      if (zx::result result = ring.Init(); result.is_error()) {
+        return result.take_error();
+      }
+      variant = ktl::move(ring);
+      break;
+    }
     default:
       // Unknown discipline.
       return zx::error{ZX_ERR_INVALID_ARGS};
@@ -508,3 +567,125 @@ zx::result<uint32_t> IoBufferDispatcher::IobRegionIdAllocator::AllocateId(
   }
   return zx::ok(result.value());
 }
+
+zx::result<> IoBufferDispatcher::IobRegionRingBuffer::Init() {
+  AssertDiscipline(ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER);
+
+  const zx_iob_region_t config = region();
+  const zx_iob_discipline_ring_buffer_t& ring_config = config.discipline.ring_buffer;
+  for (uint64_t reserved : ring_config.reserved) {
+    if (reserved != 0) {
+      return zx::error{ZX_ERR_INVALID_ARGS};
+    }
+  }
+
+  // The consumer must be able to map the ring to read records and to release
+  // them.
+  constexpr zx_iob_access_t kEp0MapRW =
+      ZX_IOB_ACCESS_EP0_CAN_MAP_READ | ZX_IOB_ACCESS_EP0_CAN_MAP_WRITE;
+  constexpr zx_iob_access_t kEp1MapRW =
+      ZX_IOB_ACCESS_EP1_CAN_MAP_READ | ZX_IOB_ACCESS_EP1_CAN_MAP_WRITE;
+  if ((config.access & kEp0MapRW) != kEp0MapRW && (config.access & kEp1MapRW) != kEp1MapRW) {
+    return zx::error{ZX_ERR_INVALID_ARGS};
+  }
+
+  // The region size is a multiple of the page size, and so the capacity is a
+  // multiple of the record alignment.
+  if (config.size <= sizeof(zx_iob_ring_header_t)) {
+    return zx::error{ZX_ERR_INVALID_ARGS};
+  }
+  capacity_ = config.size - sizeof(zx_iob_ring_header_t);
+  static_assert(sizeof(zx_iob_ring_header_t) % ZX_IOB_RING_RECORD_ALIGN == 0);
+  DEBUG_ASSERT(capacity_ % ZX_IOB_RING_RECORD_ALIGN == 0);
+
+  watermark_ = ring_config.watermark;
+  if (watermark_ == 0 || watermark_ > capacity_) {
+    return zx::error{ZX_ERR_INVALID_ARGS};
+  }
+
+  // Publish the configuration for producers and the consumer. The kernel only
+  // ever uses its own copies of these values.
+  const zx_iob_ring_header_t header = {.watermark = watermark_, .capacity = capacity_};
+  if (zx_status_t status = GetVmo(IobEndpointId::Ep0)->Write(&header, 0, sizeof(header));
+      status != ZX_OK) {
+    return zx::error{status};
+  }
+
+  if (!mapping()) {
+    return zx::ok();
+  }
+
+  zx_status_t status =
+      PinnedVmObject::Create(mapping()->vmo(), 0, config.size, /*write=*/true, &pin_);
+  if (status != ZX_OK) {
+    return zx::error{status};
+  }
+  status = mapping()->MapRange(0, config.size, /*commit=*/true);
+  if (status != ZX_OK) {
+    return zx::error{status};
+  }
+  return zx::ok();
+}
+
+zx::result<bool> IoBufferDispatcher::IobRegionRingBuffer::WriteRecord(
+    IobEndpointId id, user_in_ptr<const ktl::byte> data_ptr, size_t data_size) {
+  AssertDiscipline(ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER);
+
+  zx_rights_t mediated_rights = GetMediatedRights(id);
+  if ((mediated_rights & ZX_RIGHT_WRITE) == 0) {
+    return zx::error{ZX_ERR_ACCESS_DENIED};
+  }
+  DEBUG_ASSERT(base() != 0);
+
+  constexpr uint64_t kRecordHeaderSize = sizeof(zx_iob_ring_record_t);
+  if (data_size > capacity_ - kRecordHeaderSize || data_size > UINT32_MAX) {
+    return zx::error{ZX_ERR_INVALID_ARGS};
+  }
+  const uint64_t record_size =
+      fbl::round_up(kRecordHeaderSize + data_size, ZX_IOB_RING_RECORD_ALIGN);
+
+  // The header is shared with user mode, which may have corrupted it. The
+  // counts are only trusted as far as they describe a possible ring state, and
+  // every offset derived from them is reduced modulo the capacity.
+  auto* header = reinterpret_cast<zx_iob_ring_header_t*>(base());
+  ktl::atomic_ref<uint64_t> reserve(header->reserve);
+  ktl::atomic_ref<uint64_t> consume(header->consume);
+
+  uint64_t tail = reserve.load(ktl::memory_order_relaxed);
+  uint64_t padding;
+  do {
+    // Acquire, so that the consumer is done with the space before it is
+    // reused.
+    const uint64_t head = consume.load(ktl::memory_order_acquire);
+    if (tail - head > capacity_ || tail % ZX_IOB_RING_RECORD_ALIGN != 0) {
+      return zx::error{ZX_ERR_IO_DATA_INTEGRITY};
+    }
+    const uint64_t offset = tail % capacity_;
+    padding = capacity_ - offset < record_size ? capacity_ - offset : 0;
+    if (tail - head + padding + record_size > capacity_) {
+      return zx::error{ZX_ERR_SHOULD_WAIT};
+    }
+  } while (!reserve.compare_exchange_weak(tail, tail + padding + record_size,
+                                          ktl::memory_order_relaxed, ktl::memory_order_relaxed));
+
+  ktl::span<ktl::byte> ring = data();
+  uint64_t offset = tail % capacity_;
+  if (padding != 0) {
+    CommitRingRecord(&ring[offset], static_cast<uint32_t>(padding - kRecordHeaderSize),
+                     ZX_IOB_RING_RECORD_COMMITTED | ZX_IOB_RING_RECORD_PADDING);
+    offset = 0;
+  }
+
+  ktl::span<ktl::byte> payload = ring.subspan(offset + kRecordHeaderSize, data_size);
+  if (data_ptr.copy_array_from_user(payload.data(), payload.size()) != ZX_OK) {
+    // The space has already been reserved, so it must still be committed for
+    // the consumer to be able to move past it.
+    CommitRingRecord(&ring[offset], static_cast<uint32_t>(record_size - kRecordHeaderSize),
+                     ZX_IOB_RING_RECORD_COMMITTED | ZX_IOB_RING_RECORD_PADDING);
+    return zx::error{ZX_ERR_INVALID_ARGS};
+  }
+  CommitRingRecord(&ring[offset], static_cast<uint32_t>(data_size), ZX_IOB_RING_RECORD_COMMITTED);
+
+  const uint64_t end = tail + padding + record_size;
+  return zx::ok(end - consume.load(ktl::memory_order_relaxed) >= watermark_);
+}
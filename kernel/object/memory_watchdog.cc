@@ -7,6 +7,7 @@
 #include <lib/boot-options/boot-options.h>
 #include <lib/counters.h>
 #include <lib/debuglog.h>
+#include <lib/heap.h>
 #include <lib/zircon-internal/macros.h>
 
 #include <object/executor.h>
@@ -266,6 +267,12 @@ void MemoryWatchdog::WorkerThread() {
              PressureLevelToString(mem_event_idx_));
       pmm_page_queues()->Dump();
 
+      // Give back the free memory the kernel heap keeps in its per-CPU caches, so that any heap
+      // pages which become entirely free can be returned to the PMM.
+      if (mem_event_idx_ <= PressureLevel::kCritical) {
+        heap_trim();
+      }
+
       if (IsEvictionRequired(mem_event_idx_)) {
         // Clear any previous eviction trigger. Once Cancel completes we know that we will not race
         // with the callback and are free to update the targets. Cancel will return true if the
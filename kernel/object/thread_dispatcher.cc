@@ -293,7 +293,7 @@ void ThreadDispatcher::Resume() {
   }
 }
 
-zx_status_t ThreadDispatcher::RestrictedKick() {
+zx_status_t ThreadDispatcher::RestrictedKick(bool upcall) {
   canary_.Assert();
 
   LTRACE_ENTRY_OBJ;
@@ -308,7 +308,7 @@ zx_status_t ThreadDispatcher::RestrictedKick() {
     case ThreadState::Lifecycle::INITIALIZED:
     case ThreadState::Lifecycle::RUNNING:
     case ThreadState::Lifecycle::SUSPENDED:
-      return core_thread_->RestrictedKick();
+      return upcall ? core_thread_->RestrictedUpcall() : core_thread_->RestrictedKick();
     case ThreadState::Lifecycle::DYING:
     case ThreadState::Lifecycle::DEAD:
       return ZX_ERR_BAD_STATE;
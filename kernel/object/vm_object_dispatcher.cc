@@ -173,6 +173,20 @@ zx_status_t VmObjectDispatcher::Write(
                          on_bytes_transferred);
 }
 
+zx_status_t VmObjectDispatcher::ReadScatter(ktl::span<const zx_vmo_io_t> vec,
+                                            size_t* out_actual) {
+  canary_.Assert();
+
+  return vmo_->ReadUserScatter(vec, out_actual);
+}
+
+zx_status_t VmObjectDispatcher::WriteGather(ktl::span<const zx_vmo_io_t> vec,
+                                            size_t* out_actual) {
+  canary_.Assert();
+
+  return vmo_->WriteUserGather(vec, out_actual, nullptr);
+}
+
 zx_status_t VmObjectDispatcher::SetSize(uint64_t size) {
   canary_.Assert();
 
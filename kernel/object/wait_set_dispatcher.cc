@@ -0,0 +1,238 @@
+// Copyright 2024 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "object/wait_set_dispatcher.h"
+
+#include <assert.h>
+#include <lib/counters.h>
+#include <zircon/errors.h>
+#include <zircon/rights.h>
+#include <zircon/types.h>
+
+#include <fbl/alloc_checker.h>
+#include <object/thread_dispatcher.h>
+
+KCOUNTER(dispatcher_wait_set_create_count, "dispatcher.wait_set.create")
+KCOUNTER(dispatcher_wait_set_destroy_count, "dispatcher.wait_set.destroy")
+KCOUNTER(wait_set_wait_count, "wait_set.wait.count")
+KCOUNTER(wait_set_wait_stale_count, "wait_set.wait.stale.count")
+
+void WaitSetEntry::OnMatch(zx_signals_t signals) { wait_set_->OnEntryMatch(this); }
+
+void WaitSetEntry::OnCancel(zx_signals_t signals) { wait_set_->OnEntryCancel(this); }
+
+zx_status_t WaitSetDispatcher::Create(uint32_t options, KernelHandle<WaitSetDispatcher>* handle,
+                                      zx_rights_t* rights) {
+  if (options != 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+  fbl::AllocChecker ac;
+  KernelHandle new_handle(fbl::AdoptRef(new (&ac) WaitSetDispatcher()));
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+
+  *rights = default_rights();
+  *handle = ktl::move(new_handle);
+  return ZX_OK;
+}
+
+WaitSetDispatcher::WaitSetDispatcher() { kcounter_add(dispatcher_wait_set_create_count, 1); }
+
+WaitSetDispatcher::~WaitSetDispatcher() {
+  DEBUG_ASSERT(entries_.is_empty());
+  DEBUG_ASSERT(ready_.is_empty());
+  kcounter_add(dispatcher_wait_set_destroy_count, 1);
+}
+
+void WaitSetDispatcher::on_zero_handles() {
+  canary_.Assert();
+
+  Guard<CriticalMutex> guard{get_lock()};
+  DEBUG_ASSERT(!zero_handles_);
+  zero_handles_ = true;
+
+  // Drop every entry, and with it the references to the objects being
+  // watched. A thread that is still in Add() holds its own reference to us,
+  // and will unregister the entry it was in the middle of registering.
+  while (!entries_.is_empty()) {
+    fbl::RefPtr<WaitSetEntry> entry = entries_.pop_front();
+    UnlinkLocked(*entry);
+    guard.CallUnlocked([&entry]() {
+      entry->dispatcher().RemoveObserver(entry.get());
+      entry.reset();
+    });
+  }
+}
+
+zx_status_t WaitSetDispatcher::Add(Handle* handle, uint64_t key, zx_signals_t signals) {
+  canary_.Assert();
+
+  fbl::RefPtr<Dispatcher> dispatcher = handle->dispatcher();
+  if (!dispatcher->is_waitable()) {
+    return ZX_ERR_NOT_SUPPORTED;
+  }
+
+  fbl::AllocChecker ac;
+  fbl::RefPtr<WaitSetEntry> entry =
+      fbl::AdoptRef(new (&ac) WaitSetEntry(this, ktl::move(dispatcher), key, signals));
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+
+  {
+    Guard<CriticalMutex> guard{get_lock()};
+    if (zero_handles_) {
+      return ZX_ERR_BAD_HANDLE;
+    }
+    if (entries_.find(key).IsValid()) {
+      return ZX_ERR_ALREADY_EXISTS;
+    }
+    if (entries_.size() >= kMaxEntries) {
+      return ZX_ERR_NO_RESOURCES;
+    }
+    entries_.insert(entry);
+  }
+
+  // If the signals are already active, this calls OnEntryMatch right away,
+  // which needs our lock. That is why the lock cannot be held here.
+  [[maybe_unused]] zx_status_t status =
+      entry->dispatcher().AddObserver(entry.get(), handle, entry->signals());
+  DEBUG_ASSERT(status == ZX_OK);
+
+  bool removed;
+  {
+    Guard<CriticalMutex> guard{get_lock()};
+    removed = entry->removed_;
+  }
+  if (removed) {
+    // The entry was removed while we were registering it, possibly before we
+    // did, in which case nobody else is going to unregister it.
+    entry->dispatcher().RemoveObserver(entry.get());
+  }
+  return ZX_OK;
+}
+
+zx_status_t WaitSetDispatcher::Remove(uint64_t key) {
+  canary_.Assert();
+
+  fbl::RefPtr<WaitSetEntry> entry;
+  {
+    Guard<CriticalMutex> guard{get_lock()};
+    entry = entries_.erase(key);
+    if (entry == nullptr) {
+      return ZX_ERR_NOT_FOUND;
+    }
+    UnlinkLocked(*entry);
+  }
+
+  // The entry may also be unregistered concurrently by the thread that was
+  // adding it, or canceled by its handle being closed, so RemoveObserver can
+  // legitimately return false.
+  entry->dispatcher().RemoveObserver(entry.get());
+  return ZX_OK;
+}
+
+zx_status_t WaitSetDispatcher::Wait(const Deadline& deadline, zx_wait_set_result_t* results,
+                                    size_t count, size_t* actual) {
+  canary_.Assert();
+  DEBUG_ASSERT(count > 0 && count <= kMaxResults);
+
+  while (true) {
+    // The entries are taken off the ready list, so that one which matches
+    // again while we look at it is put straight back by OnEntryMatch.
+    fbl::RefPtr<WaitSetEntry> taken[kMaxResults];
+    size_t num_taken = 0;
+    {
+      Guard<CriticalMutex> guard{get_lock()};
+      for (; num_taken < count && !ready_.is_empty(); ++num_taken) {
+        taken[num_taken] = ready_.pop_front();
+      }
+      if (ready_.is_empty()) {
+        ready_event_.Unsignal();
+      }
+    }
+
+    // An entry became ready when its signals did, but they may have been
+    // deasserted since. Only report the entries that are still ready now, and
+    // put those back onto the ready list, as they are level triggered.
+    size_t num_results = 0;
+    for (size_t i = 0; i < num_taken; ++i) {
+      fbl::RefPtr<WaitSetEntry> entry = ktl::move(taken[i]);
+      const zx_signals_t pending = entry->dispatcher().PollSignals();
+      const bool active = (pending & entry->signals()) != 0;
+      if (active) {
+        results[num_results++] = {.key = entry->GetKey(), .pending = pending, .reserved = 0};
+      }
+
+      Guard<CriticalMutex> guard{get_lock()};
+      if (active && !entry->removed_ && !fbl::InContainer<WaitSetEntry::ListTag>(*entry)) {
+        ready_.push_back(ktl::move(entry));
+        ready_event_.Signal();
+      }
+    }
+
+    if (num_results > 0) {
+      kcounter_add(wait_set_wait_count, 1);
+      *actual = num_results;
+      return ZX_OK;
+    }
+
+    if (num_taken > 0) {
+      // Every entry we took had gone stale. Some of them may have matched again
+      // since, so look again before blocking.
+      kcounter_add(wait_set_wait_stale_count, 1);
+      continue;
+    }
+
+    {
+      ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::WAIT_MANY);
+      zx_status_t status = ready_event_.Wait(deadline);
+      if (status != ZX_OK) {
+        return status;
+      }
+    }
+  }
+}
+
+void WaitSetDispatcher::OnEntryMatch(WaitSetEntry* entry) {
+  Guard<CriticalMutex> guard{get_lock()};
+  if (entry->removed_) {
+    return;
+  }
+  if (fbl::InContainer<WaitSetEntry::ListTag>(*entry)) {
+    return;
+  }
+  // The tree still holds a reference to the entry, as it has not been removed.
+  ready_.push_back(fbl::RefPtr(entry));
+  ready_event_.Signal();
+}
+
+void WaitSetDispatcher::OnEntryCancel(WaitSetEntry* entry) {
+  // The Dispatcher has already unregistered the entry, so all that is left is
+  // to take it out of the set.
+  fbl::RefPtr<WaitSetEntry> canceled;
+  {
+    Guard<CriticalMutex> guard{get_lock()};
+    if (entry->removed_) {
+      return;
+    }
+    canceled = entries_.erase(*entry);
+    UnlinkLocked(*entry);
+  }
+  // |canceled| may be the last reference to the entry, and is dropped here,
+  // without our lock held.
+}
+
+void WaitSetDispatcher::UnlinkLocked(WaitSetEntry& entry) {
+  entry.removed_ = true;
+  if (fbl::InContainer<WaitSetEntry::ListTag>(entry)) {
+    ready_.erase(entry);
+    if (ready_.is_empty()) {
+      ready_event_.Unsignal();
+    }
+  }
+}
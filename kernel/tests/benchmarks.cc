@@ -21,6 +21,7 @@
 #include <dev/hw_watchdog.h>
 #include <kernel/auto_preempt_disabler.h>
 #include <kernel/brwlock.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
 #include <kernel/scheduler.h>
@@ -431,6 +432,57 @@ __NO_INLINE static void bench_heap() {
   }
 }
 
+// Measures the round trip latency of two threads handing control back and
+// forth through a pair of events, the way a client blocked in zx_channel_call
+// and the server replying to it do.  When |sync| is set, each side wakes the
+// other using Event::SignalSync, allowing the scheduler to hand off on the
+// waker's CPU instead of selecting (and IPIing) another one.
+template <bool kSync>
+__NO_INLINE static void bench_event_ping_pong() {
+  static constexpr uint kRoundTrips = 100000;
+
+  struct Args {
+    AutounsignalEvent ping;
+    AutounsignalEvent pong;
+  };
+
+  thread_start_routine Server = [](void* args_) -> int {
+    auto* args = reinterpret_cast<Args*>(args_);
+    for (uint i = 0; i < kRoundTrips; i++) {
+      args->ping.Wait();
+      if constexpr (kSync) {
+        args->pong.SignalSync();
+      } else {
+        args->pong.Signal();
+      }
+    }
+    return 0;
+  };
+
+  Args args;
+  Thread* server = Thread::Create("bench_ping_pong", Server, &args, DEFAULT_PRIORITY);
+  if (server == nullptr) {
+    TRACEF("error: failed to create thread\n");
+    return;
+  }
+  server->Resume();
+
+  const zx_time_t start = current_time();
+  for (uint i = 0; i < kRoundTrips; i++) {
+    if constexpr (kSync) {
+      args.ping.SignalSync();
+    } else {
+      args.ping.Signal();
+    }
+    args.pong.Wait();
+  }
+  const zx_duration_t elapsed = zx_time_sub_time(current_time(), start);
+  server->Join(nullptr, ZX_TIME_INFINITE);
+
+  printf("%" PRId64 " ns for %u event ping-pong round trips (sync: %d) (%" PRId64 " ns per)\n",
+         elapsed, kRoundTrips, kSync, elapsed / kRoundTrips);
+}
+
 int benchmarks(int, const cmd_args*, uint32_t) {
   // Disable the hardware watchdog (if present and enabled) because some of these benchmarks will
   // disable interrupts for extended periods of time.
@@ -445,6 +497,11 @@ int benchmarks(int, const cmd_args*, uint32_t) {
     }
   });
 
+  // The ping-pong benchmarks block, so they need to run before preemption is
+  // disabled below.
+  bench_event_ping_pong<false>();
+  bench_event_ping_pong<true>();
+
   // Ensure that benchmarks aren't impacted by preemption.
   AutoPreemptDisabler preempt_disabler;
 
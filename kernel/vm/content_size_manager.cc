@@ -175,13 +175,15 @@ void ContentSizeManager::BeginReadLocked(uint64_t target_size, uint64_t* out_con
   // Other concurrent, in-flight operations may or may not complete before this read, so it is okay
   // to be more conservative here and only read up to the guaranteed valid region.
   *out_content_size_limit = GetContentSize();
-  for (auto& op : read_q_) {
-    if (op.GetType() != OperationType::SetSize) {
-      continue;
+  if (read_q_set_size_count_ > 0) {
+    for (auto& op : read_q_) {
+      if (op.GetType() != OperationType::SetSize) {
+        continue;
+      }
+
+      op.AssertParentLockHeld();
+      *out_content_size_limit = ktl::min(op.GetSizeLocked(), *out_content_size_limit);
     }
-
-    op.AssertParentLockHeld();
-    *out_content_size_limit = ktl::min(op.GetSizeLocked(), *out_content_size_limit);
   }
   *out_content_size_limit = ktl::min(target_size, *out_content_size_limit);
 
@@ -195,6 +197,7 @@ void ContentSizeManager::BeginSetContentSizeLocked(uint64_t target_size, Operati
 
   write_q_.push_back(out_op);
   read_q_.push_back(out_op);
+  read_q_set_size_count_++;
 
   // Block until head if there are any of the following operations preceding this one:
   //   * Appends or writes that exceed either the current content size or the target size.
@@ -314,6 +317,8 @@ void ContentSizeManager::DequeueOperationLocked(Operation* op) {
       DEBUG_ASSERT(fbl::InContainer<WriteQueueTag>(*op));
       dequeue_from_list(write_q_);
       dequeue_from_list(read_q_);
+      DEBUG_ASSERT(read_q_set_size_count_ > 0);
+      read_q_set_size_count_--;
       break;
   }
 
@@ -241,6 +241,10 @@ class ContentSizeManager : public fbl::RefCounted<ContentSizeManager> {
   fbl::DoublyLinkedList<Operation*, WriteQueueTag> write_q_ TA_GUARDED(lock_);
   fbl::DoublyLinkedList<Operation*, ReadQueueTag> read_q_ TA_GUARDED(lock_);
 
+  // The number of `SetSize` operations in `read_q_`. Reads only need to look through `read_q_` for
+  // these, and they are rare, so this lets concurrent readers skip walking each other's operations.
+  size_t read_q_set_size_count_ TA_GUARDED(lock_) = 0;
+
   // `content_size_` is not guarded by a lock because the queues above maintains that only one
   // operation can ever be mutating `content_size_` at any given point.
   //
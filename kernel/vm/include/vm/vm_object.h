@@ -31,6 +31,7 @@
 #include <kernel/lockdep.h>
 #include <kernel/mutex.h>
 #include <ktl/move.h>
+#include <ktl/span.h>
 #include <vm/page.h>
 #include <vm/vm.h>
 #include <vm/vm_page_list.h>
@@ -461,6 +462,16 @@ class VmObject : public VmHierarchyBase,
                                       size_t* out_actual,
                                       const OnWriteBytesTransferredCallback& on_bytes_transferred);
 
+  // Positional scatter/gather variants of ReadUser and WriteUser. Each element of |vec| names a
+  // range of the VMO and the user buffer it is transferred to or from. Elements are transferred in
+  // order, and the transfer stops at the first element that fails. |out_actual| is the total
+  // number of bytes transferred across all elements, even upon error.
+  //
+  // May block on user pager requests and must be called without locks held.
+  virtual zx_status_t ReadUserScatter(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual);
+  virtual zx_status_t WriteUserGather(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual,
+                                      const OnWriteBytesTransferredCallback& on_bytes_transferred);
+
   // Removes the pages from this vmo in the range [offset, offset + len) and returns
   // them in pages.  This vmo must be a paged vmo with no parent, and it cannot have any
   // pinned pages in the source range. |offset| and |len| must be page aligned.
@@ -165,6 +165,9 @@ class VmObjectPaged final : public VmObject {
   zx_status_t WriteUser(user_in_ptr<const char> ptr, uint64_t offset, size_t len,
                         VmObjectReadWriteOptions options, size_t* out_actual,
                         const OnWriteBytesTransferredCallback& on_bytes_transferred) override;
+  zx_status_t ReadUserScatter(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual) override;
+  zx_status_t WriteUserGather(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual,
+                              const OnWriteBytesTransferredCallback& on_bytes_transferred) override;
 
   zx_status_t TakePages(uint64_t offset, uint64_t len, VmPageSpliceList* pages) override;
   zx_status_t SupplyPages(uint64_t offset, uint64_t len, VmPageSpliceList* pages,
@@ -231,6 +231,45 @@ zx_status_t VmObject::WriteUserVector(user_in_iovec_t vec, uint64_t offset, size
   return (status == ZX_OK && len > 0) ? ZX_ERR_BUFFER_TOO_SMALL : status;
 }
 
+zx_status_t VmObject::ReadUserScatter(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual) {
+  if (out_actual != nullptr) {
+    *out_actual = 0;
+  }
+  for (const zx_vmo_io_t& io : vec) {
+    size_t chunk_actual = 0;
+    zx_status_t status =
+        ReadUser(user_out_ptr<char>(static_cast<char*>(io.buffer)), io.offset, io.length,
+                 VmObjectReadWriteOptions::None, &chunk_actual);
+    if (out_actual != nullptr) {
+      *out_actual += chunk_actual;
+    }
+    if (status != ZX_OK) {
+      return status;
+    }
+  }
+  return ZX_OK;
+}
+
+zx_status_t VmObject::WriteUserGather(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual,
+                                      const OnWriteBytesTransferredCallback& on_bytes_transferred) {
+  if (out_actual != nullptr) {
+    *out_actual = 0;
+  }
+  for (const zx_vmo_io_t& io : vec) {
+    size_t chunk_actual = 0;
+    zx_status_t status =
+        WriteUser(user_in_ptr<const char>(static_cast<const char*>(io.buffer)), io.offset,
+                  io.length, VmObjectReadWriteOptions::None, &chunk_actual, on_bytes_transferred);
+    if (out_actual != nullptr) {
+      *out_actual += chunk_actual;
+    }
+    if (status != ZX_OK) {
+      return status;
+    }
+  }
+  return ZX_OK;
+}
+
 void VmObject::SetChildObserver(VmObjectChildObserver* child_observer) {
   Guard<Mutex> guard{&child_observer_lock_};
   child_observer_ = child_observer;
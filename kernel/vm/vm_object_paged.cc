@@ -45,6 +45,81 @@ KCOUNTER(vmo_attribution_queries, "vm.attributed_memory.object.queries")
 KCOUNTER(vmo_attribution_cache_hits, "vm.attributed_memory.object.cache_hits")
 KCOUNTER(vmo_attribution_cache_misses, "vm.attributed_memory.object.cache_misses")
 
+// Returns a ReadWriteInternalLocked copy routine that copies out to the user buffer |ptr|, and adds
+// the number of bytes copied to |out_actual| if it is not null.
+auto UserReadRoutine(user_out_ptr<char> ptr, size_t* out_actual) {
+  return [ptr, out_actual](const char* src, size_t offset, size_t len,
+                           Guard<CriticalMutex>* guard) -> zx_status_t {
+    __UNINITIALIZED auto copy_result =
+        ptr.byte_offset(offset).copy_array_to_user_capture_faults(src, len);
+
+    // If a fault has actually occurred, then we will have captured fault info that we can use to
+    // handle the fault.
+    if (copy_result.fault_info.has_value()) {
+      zx_status_t result;
+      guard->CallUnlocked([&info = *copy_result.fault_info, &result] {
+        result = Thread::Current::SoftFault(info.pf_va, info.pf_flags);
+      });
+      // If we handled the fault, tell the upper level to try again.
+      return result == ZX_OK ? ZX_ERR_SHOULD_WAIT : result;
+    }
+
+    // If we encounter _any_ unrecoverable error from the copy operation which
+    // produced no fault address, squash the error down to just "NOT_FOUND".
+    // This is what the SoftFault error would have told us if we did try to
+    // handle the fault and could not.
+    if (copy_result.status != ZX_OK) {
+      return ZX_ERR_NOT_FOUND;
+    }
+
+    if (out_actual != nullptr) {
+      *out_actual += len;
+    }
+    return ZX_OK;
+  };
+}
+
+// Returns a ReadWriteInternalLocked copy routine that copies in from the user buffer |ptr|, which
+// is destined for VMO offset |base_vmo_offset|. The number of bytes copied is added to |out_actual|
+// if it is not null, and reported to |on_bytes_transferred| if it is set.
+auto UserWriteRoutine(user_in_ptr<const char> ptr, uint64_t base_vmo_offset, size_t* out_actual,
+                      const VmObject::OnWriteBytesTransferredCallback& on_bytes_transferred) {
+  return [ptr, base_vmo_offset, out_actual, &on_bytes_transferred](
+             char* dst, size_t offset, size_t len, Guard<CriticalMutex>* guard) -> zx_status_t {
+    __UNINITIALIZED auto copy_result =
+        ptr.byte_offset(offset).copy_array_from_user_capture_faults(dst, len);
+
+    // If a fault has actually occurred, then we will have captured fault info that we can use to
+    // handle the fault.
+    if (copy_result.fault_info.has_value()) {
+      zx_status_t result;
+      guard->CallUnlocked([&info = *copy_result.fault_info, &result] {
+        result = Thread::Current::SoftFault(info.pf_va, info.pf_flags);
+      });
+      // If we handled the fault, tell the upper level to try again.
+      return result == ZX_OK ? ZX_ERR_SHOULD_WAIT : result;
+    }
+
+    // If we encounter _any_ unrecoverable error from the copy operation which
+    // produced no fault address, squash the error down to just "NOT_FOUND".
+    // This is what the SoftFault error would have told us if we did try to
+    // handle the fault and could not.
+    if (copy_result.status != ZX_OK) {
+      return ZX_ERR_NOT_FOUND;
+    }
+
+    if (out_actual != nullptr) {
+      *out_actual += len;
+    }
+
+    if (on_bytes_transferred) {
+      on_bytes_transferred(base_vmo_offset + offset, len);
+    }
+
+    return ZX_OK;
+  };
+}
+
 }  // namespace
 
 VmObjectPaged::VmObjectPaged(uint32_t options, fbl::RefPtr<VmHierarchyState> hierarchy_state)
@@ -1734,44 +1809,14 @@ zx_status_t VmObjectPaged::ReadUser(user_out_ptr<char> ptr, uint64_t offset, siz
     *out_actual = 0;
   }
 
-  // read routine that uses copy_to_user
-  auto read_routine = [ptr, out_actual](const char* src, size_t offset, size_t len,
-                                        Guard<CriticalMutex>* guard) -> zx_status_t {
-    __UNINITIALIZED auto copy_result =
-        ptr.byte_offset(offset).copy_array_to_user_capture_faults(src, len);
-
-    // If a fault has actually occurred, then we will have captured fault info that we can use to
-    // handle the fault.
-    if (copy_result.fault_info.has_value()) {
-      zx_status_t result;
-      guard->CallUnlocked([&info = *copy_result.fault_info, &result] {
-        result = Thread::Current::SoftFault(info.pf_va, info.pf_flags);
-      });
-      // If we handled the fault, tell the upper level to try again.
-      return result == ZX_OK ? ZX_ERR_SHOULD_WAIT : result;
-    }
-
-    // If we encounter _any_ unrecoverable error from the copy operation which
-    // produced no fault address, squash the error down to just "NOT_FOUND".
-    // This is what the SoftFault error would have told us if we did try to
-    // handle the fault and could not.
-    if (copy_result.status != ZX_OK) {
-      return ZX_ERR_NOT_FOUND;
-    }
-
-    if (out_actual != nullptr) {
-      *out_actual += len;
-    }
-    return ZX_OK;
-  };
-
   if (can_block_on_page_requests()) {
     lockdep::AssertNoLocksHeld();
   }
 
   Guard<CriticalMutex> guard{lock()};
 
-  return ReadWriteInternalLocked(offset, len, false, options, read_routine, &guard);
+  return ReadWriteInternalLocked(offset, len, false, options, UserReadRoutine(ptr, out_actual),
+                                 &guard);
 }
 
 zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const char> ptr, uint64_t offset, size_t len,
@@ -1783,42 +1828,52 @@ zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const char> ptr, uint64_t offse
     *out_actual = 0;
   }
 
-  // write routine that uses copy_from_user
-  auto write_routine = [ptr, base_vmo_offset = offset, out_actual, &on_bytes_transferred](
-                           char* dst, size_t offset, size_t len,
-                           Guard<CriticalMutex>* guard) -> zx_status_t {
-    __UNINITIALIZED auto copy_result =
-        ptr.byte_offset(offset).copy_array_from_user_capture_faults(dst, len);
+  if (can_block_on_page_requests()) {
+    lockdep::AssertNoLocksHeld();
+  }
 
-    // If a fault has actually occurred, then we will have captured fault info that we can use to
-    // handle the fault.
-    if (copy_result.fault_info.has_value()) {
-      zx_status_t result;
-      guard->CallUnlocked([&info = *copy_result.fault_info, &result] {
-        result = Thread::Current::SoftFault(info.pf_va, info.pf_flags);
-      });
-      // If we handled the fault, tell the upper level to try again.
-      return result == ZX_OK ? ZX_ERR_SHOULD_WAIT : result;
-    }
+  Guard<CriticalMutex> guard{lock()};
 
-    // If we encounter _any_ unrecoverable error from the copy operation which
-    // produced no fault address, squash the error down to just "NOT_FOUND".
-    // This is what the SoftFault error would have told us if we did try to
-    // handle the fault and could not.
-    if (copy_result.status != ZX_OK) {
-      return ZX_ERR_NOT_FOUND;
-    }
+  return ReadWriteInternalLocked(offset, len, true, options,
+                                 UserWriteRoutine(ptr, offset, out_actual, on_bytes_transferred),
+                                 &guard);
+}
 
-    if (out_actual != nullptr) {
-      *out_actual += len;
-    }
+zx_status_t VmObjectPaged::ReadUserScatter(ktl::span<const zx_vmo_io_t> vec, size_t* out_actual) {
+  canary_.Assert();
 
-    if (on_bytes_transferred) {
-      on_bytes_transferred(base_vmo_offset + offset, len);
+  if (out_actual != nullptr) {
+    *out_actual = 0;
+  }
+
+  if (can_block_on_page_requests()) {
+    lockdep::AssertNoLocksHeld();
+  }
+
+  // The whole vector is transferred under a single acquisition of the lock. It may still be
+  // dropped along the way to wait on page requests, to handle faults, or when contested.
+  Guard<CriticalMutex> guard{lock()};
+
+  for (const zx_vmo_io_t& io : vec) {
+    user_out_ptr<char> ptr(static_cast<char*>(io.buffer));
+    zx_status_t status =
+        ReadWriteInternalLocked(io.offset, io.length, false, VmObjectReadWriteOptions::None,
+                                UserReadRoutine(ptr, out_actual), &guard);
+    if (status != ZX_OK) {
+      return status;
     }
+  }
+  return ZX_OK;
+}
 
-    return ZX_OK;
-  };
+zx_status_t VmObjectPaged::WriteUserGather(
+    ktl::span<const zx_vmo_io_t> vec, size_t* out_actual,
+    const OnWriteBytesTransferredCallback& on_bytes_transferred) {
+  canary_.Assert();
+
+  if (out_actual != nullptr) {
+    *out_actual = 0;
+  }
 
   if (can_block_on_page_requests()) {
     lockdep::AssertNoLocksHeld();
@@ -1826,7 +1881,16 @@ zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const char> ptr, uint64_t offse
 
   Guard<CriticalMutex> guard{lock()};
 
-  return ReadWriteInternalLocked(offset, len, true, options, write_routine, &guard);
+  for (const zx_vmo_io_t& io : vec) {
+    user_in_ptr<const char> ptr(static_cast<const char*>(io.buffer));
+    zx_status_t status = ReadWriteInternalLocked(
+        io.offset, io.length, true, VmObjectReadWriteOptions::None,
+        UserWriteRoutine(ptr, io.offset, out_actual, on_bytes_transferred), &guard);
+    if (status != ZX_OK) {
+      return status;
+    }
+  }
+  return ZX_OK;
 }
 
 zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, VmPageSpliceList* pages) {
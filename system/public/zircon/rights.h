@@ -131,4 +131,6 @@ typedef uint32_t zx_rights_t;
   (ZX_RIGHTS_BASIC | ZX_RIGHT_WAIT | ZX_RIGHTS_IO | ZX_RIGHTS_PROPERTY | ZX_RIGHT_MAP | \
    ZX_RIGHT_SIGNAL | ZX_RIGHT_SIGNAL_PEER)
 
+#define ZX_DEFAULT_WAIT_SET_RIGHTS ((ZX_RIGHTS_BASIC & (~ZX_RIGHT_WAIT)) | ZX_RIGHTS_IO)
+
 #endif  // ZIRCON_RIGHTS_H_
@@ -90,6 +90,32 @@ typedef struct zx_restricted_exception {
   zx_exception_report_t exception;
 } zx_restricted_exception_t;
 
+// Options for zx_restricted_kick().
+#define ZX_RESTRICTED_KICK_OPT_UPCALL ((uint32_t)1)
+
+// Offset of the upcall mailbox within the restricted mode state VMO. It lies
+// past any of the structures above.
+#define ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET ((uint64_t)2048)
+
+// Structure used to deliver upcalls to restricted mode. See zx_restricted_kick()
+// with ZX_RESTRICTED_KICK_OPT_UPCALL. Its fields are accessed concurrently by
+// the kernel, normal mode and restricted mode, and must be accessed atomically.
+typedef struct zx_restricted_upcall_mailbox {
+  // Restricted mode address of the upcall handler, set by the runtime. Upcalls
+  // are delivered as regular kicks while this is zero.
+  uint64_t handler;
+  // Restricted mode address the kernel interrupted to run the handler. The
+  // handler must read it before clearing |active|.
+  uint64_t interrupted_pc;
+  // Not used by the kernel. Meant for the runtime to record why it requested
+  // an upcall, before calling zx_restricted_kick().
+  uint64_t events;
+  // Set to 1 by the kernel as it starts the handler, and cleared by the
+  // handler. Upcalls requested while it is set are not delivered.
+  uint32_t active;
+  uint32_t reserved;
+} zx_restricted_upcall_mailbox_t;
+
 // ====== End of restricted mode support ====== //
 
 // ====== Wake vector support ====== //
@@ -213,8 +239,109 @@ typedef struct {
 // Allocation options for `zx_iob_allocate_id()`.
 typedef uint32_t zx_iob_allocate_id_options_t;
 
+// Represents an IOBuffer region of "ring buffer" discipline, used to pass
+// variable-sized records from any number of producers to a single consumer.
+//
+// The region starts with a zx_iob_ring_header_t, followed by the data area of
+// `capacity` bytes. Records are 8-byte aligned, never wrap around the end of
+// the data area, and each starts with a zx_iob_ring_record_t:
+// --------------------------------
+//   reserve (8 bytes)            } written by producers
+//   ----------------------------
+//   consume (8 bytes)            } written by the consumer
+//   ----------------------------
+//   watermark (8 bytes)          } written by the kernel at creation
+//   capacity (8 bytes)           }
+//   ----------------------------
+//   data area (capacity bytes)
+// --------------------------------
+//
+// `reserve` and `consume` are running byte counts, and a record lives at
+// offset (count % capacity) of the data area. Every access to `reserve`,
+// `consume` and record headers must be a naturally aligned 64-bit atomic.
+//
+// To write a record of N bytes, a producer:
+//  1. Computes the record size R = 8 + N, rounded up to a multiple of 8, and,
+//     if fewer than R bytes remain before the end of the data area, the number
+//     of bytes P to the end of it.
+//  2. Reserves P + R bytes by a compare-and-swap of `reserve`, provided that
+//     `reserve` - `consume` + P + R does not exceed `capacity`.
+//  3. If P is nonzero, stores a record header of size P - 8 with
+//     ZX_IOB_RING_RECORD_COMMITTED | ZX_IOB_RING_RECORD_PADDING.
+//  4. Writes the payload after the record header, and then stores the header
+//     of size N with ZX_IOB_RING_RECORD_COMMITTED, using release semantics.
+//  5. If `reserve` - `consume` reached `watermark` through this record, and
+//     the producer does not otherwise know the consumer to be awake, signals
+//     ZX_IOB_RING_WATERMARK to the consumer with `zx_object_signal_peer()`.
+//
+// The consumer reads records in order from `consume` until it finds one
+// without ZX_IOB_RING_RECORD_COMMITTED, loading record headers with acquire
+// semantics. It zeroes each record it has consumed, then advances `consume`
+// past it with release semantics, so that stale bytes are never mistaken for
+// a committed record header. Before waiting for ZX_IOB_RING_WATERMARK, it
+// clears the signal on its own endpoint and checks for records once more.
+//
+// Endpoints with mediated write access may use `zx_iob_write_record()`
+// instead, in which case the kernel follows the same protocol, ensures that
+// the record is correctly framed, and asserts ZX_IOB_RING_WATERMARK on the
+// peer endpoint whenever the unread bytes reach the watermark. Producers that
+// are not trusted to frame records correctly should be given only mediated
+// access.
+#define ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER ((zx_iob_discipline_type_t)(2u))
+
+typedef struct zx_iob_ring_header {
+  uint64_t reserve;
+  uint64_t padding1[7];
+  uint64_t consume;
+  uint64_t padding2[7];
+  uint64_t watermark;
+  uint64_t capacity;
+  uint64_t padding3[6];
+} zx_iob_ring_header_t;
+
+typedef struct zx_iob_ring_record {
+  // The size of the payload following this header, excluding the header and
+  // any alignment padding.
+  uint32_t size;
+  uint32_t flags;
+} zx_iob_ring_record_t;
+
+#define ZX_IOB_RING_RECORD_ALIGN ((uint64_t)8u)
+
+#define ZX_IOB_RING_RECORD_COMMITTED ((uint32_t)1u << 0)
+#define ZX_IOB_RING_RECORD_PADDING ((uint32_t)1u << 1)
+
+// Options for `zx_iob_write_record()`.
+typedef uint32_t zx_iob_write_record_options_t;
+
 // ====== End of upcoming IOB support ====== //
 
+// ====== Wait set support ====== //
+
+// An entry of a wait set that zx_wait_set_wait() found to be asserting at
+// least one of the signals it was registered for.
+typedef struct zx_wait_set_result {
+  // The key the entry was registered with by zx_wait_set_add().
+  uint64_t key;
+  // All of the signals the object was asserting when the entry was reported.
+  zx_signals_t pending;
+  uint32_t reserved;
+} zx_wait_set_result_t;
+
+// ====== End of wait set support ====== //
+
+// ====== Vectored VMO I/O support ====== //
+
+// A range of a VMO, and the buffer it is read into by zx_vmo_read_vector() or
+// written from by zx_vmo_write_vector().
+typedef struct zx_vmo_io {
+  uint64_t offset;
+  void* buffer;
+  size_t length;
+} zx_vmo_io_t;
+
+// ====== End of vectored VMO I/O support ====== //
+
 #ifndef _KERNEL
 
 #include <zircon/syscalls.h>
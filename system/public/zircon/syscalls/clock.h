@@ -26,11 +26,13 @@
 #define ZX_CLOCK_OPT_MONOTONIC  ((uint64_t)1u << 0)
 #define ZX_CLOCK_OPT_CONTINUOUS ((uint64_t)1u << 1)
 #define ZX_CLOCK_OPT_AUTO_START ((uint64_t)1u << 2)
+#define ZX_CLOCK_OPT_MAPPABLE   ((uint64_t)1u << 3)
 
 #define ZX_CLOCK_OPTS_ALL ( \
         ZX_CLOCK_OPT_MONOTONIC | \
         ZX_CLOCK_OPT_CONTINUOUS | \
-        ZX_CLOCK_OPT_AUTO_START)
+        ZX_CLOCK_OPT_AUTO_START | \
+        ZX_CLOCK_OPT_MAPPABLE)
 
 // v1 clock update flags
 #define ZX_CLOCK_UPDATE_OPTION_VALUE_VALID        ((uint64_t)1u << 0)
@@ -24,6 +24,16 @@ typedef uint64_t zx_iob_discipline_type_t;
 
 // TODO(https://fxbug.dev/319501447): + ID allocator discipline.
 // TODO(https://fxbug.dev/319500512): + ring buffer discipline.
+// Both are currently available in <zircon/syscalls-next.h>.
+
+// Configuration of a region of ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER discipline.
+typedef struct zx_iob_discipline_ring_buffer {
+  // The number of unread bytes at or above which the consumer should be
+  // woken with ZX_IOB_RING_WATERMARK. Must be nonzero and no larger than the
+  // data capacity of the ring.
+  uint64_t watermark;
+  uint64_t reserved[7];
+} zx_iob_discipline_ring_buffer_t;
 
 // An IOBuffer (memory access) discipline specifies the layout of a region's
 // memory and manner in which it should be directly accessed. Each discipline
@@ -33,6 +43,7 @@ typedef uint64_t zx_iob_discipline_type_t;
 typedef struct zx_iob_discipline {
   zx_iob_discipline_type_t type;
   union {
+    zx_iob_discipline_ring_buffer_t ring_buffer;
     uint64_t reserved[8];
   };
 } zx_iob_discipline_t;
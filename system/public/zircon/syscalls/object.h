@@ -59,6 +59,7 @@ typedef uint32_t zx_object_info_topic_t;
 #define ZX_INFO_KMEM_STATS_COMPRESSION      ((zx_object_info_topic_t) 33u) // zx_info_kmem_stats_compression_t[1]
 #define ZX_INFO_IOB                         ((zx_object_info_topic_t) 34u) // zx_info_iob_t[1]
 #define ZX_INFO_IOB_REGIONS                 ((zx_object_info_topic_t) 35u) // zx_iob_region_info_t[n]
+#define ZX_INFO_LOCK_CONTENTION             ((zx_object_info_topic_t) 36u) // zx_info_lock_contention_t[n]
 
 // Return codes set when a task is killed.
 #define ZX_TASK_RETCODE_SYSCALL_KILL            ((int64_t) -1024)   // via zx_task_kill().
@@ -870,6 +871,39 @@ typedef struct zx_info_kmem_stats_compression {
     uint64_t pages_decompressed_within_log_time[8];
 } zx_info_kmem_stats_compression_t;
 
+// Values and types used by ZX_INFO_LOCK_CONTENTION.
+#define ZX_INFO_LOCK_CONTENTION_NAME_LEN          ((size_t)64u)
+#define ZX_INFO_LOCK_CONTENTION_HISTOGRAM_BUCKETS ((size_t)16u)
+#define ZX_INFO_LOCK_CONTENTION_CALL_SITES        ((size_t)4u)
+
+typedef struct zx_info_lock_contention {
+    // The name of the kernel lock class, truncated if necessary.  Always
+    // NUL terminated.
+    char name[ZX_INFO_LOCK_CONTENTION_NAME_LEN];
+
+    // The number of contended acquisitions of locks in the class, and the
+    // total time they spent waiting for the lock.
+    uint64_t wait_count;
+    zx_duration_t total_wait_time;
+
+    // The number of exclusive holds of locks in the class, and the total time
+    // the locks were held.
+    uint64_t hold_count;
+    zx_duration_t total_hold_time;
+
+    // Log2 histograms of wait and hold durations.  Bucket 0 counts durations
+    // shorter than 1024ns, bucket N counts durations in [2^(9+N), 2^(10+N))
+    // ns, and the last bucket also counts all longer durations.
+    uint64_t wait_histogram[ZX_INFO_LOCK_CONTENTION_HISTOGRAM_BUCKETS];
+    uint64_t hold_histogram[ZX_INFO_LOCK_CONTENTION_HISTOGRAM_BUCKETS];
+
+    // The code locations which most often contended for locks in the class, as
+    // offsets from the start of the kernel image, ordered by decreasing
+    // count.  Unused entries have a count of zero.
+    uint64_t call_site_pcs[ZX_INFO_LOCK_CONTENTION_CALL_SITES];
+    uint64_t call_site_counts[ZX_INFO_LOCK_CONTENTION_CALL_SITES];
+} zx_info_lock_contention_t;
+
 typedef struct zx_info_resource {
     // The resource kind; resource object kinds are detailed in the resource.md
     uint32_t kind;
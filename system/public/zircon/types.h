@@ -176,6 +176,7 @@ typedef uint32_t zx_signals_t;
 
 // IOBuffer
 #define ZX_IOB_PEER_CLOSED          __ZX_OBJECT_PEER_CLOSED
+#define ZX_IOB_RING_WATERMARK       __ZX_OBJECT_SIGNAL_4
 
 // global kernel object id.
 // Note: kernel object ids use 63 bits, with the most significant bit being zero.
@@ -347,6 +348,10 @@ typedef struct zx_iovec {
 #define ZX_CPRNG_DRAW_MAX_LEN        ((size_t)256u)
 #define ZX_CPRNG_ADD_ENTROPY_MAX_LEN ((size_t)256u)
 
+// Size of the caller-owned state used by zx_cprng_draw_with_state. The state
+// must be 8-byte aligned and zero-initialized before its first use.
+#define ZX_CPRNG_STATE_SIZE          ((size_t)256u)
+
 // interrupt_create flags
 #define ZX_INTERRUPT_REMAP_IRQ       ((uint32_t)0x1u)
 #define ZX_INTERRUPT_MODE_DEFAULT    ((uint32_t)0u << 1)
@@ -474,6 +479,7 @@ typedef uint32_t zx_obj_type_t;
 #define ZX_OBJ_TYPE_STREAM          ((zx_obj_type_t)31u)
 #define ZX_OBJ_TYPE_MSI             ((zx_obj_type_t)32u)
 #define ZX_OBJ_TYPE_IOB             ((zx_obj_type_t)33u)
+#define ZX_OBJ_TYPE_WAIT_SET        ((zx_obj_type_t)34u)
 
 // For backwards compatibility.
 #define ZX_OBJ_TYPE_LOG             ZX_OBJ_TYPE_DEBUGLOG
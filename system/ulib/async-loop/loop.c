@@ -69,6 +69,17 @@ typedef struct thread_record {
   thrd_t thread;
 } thread_record_t;
 
+// An entry of the pending task heap. The deadline is copied out of the task so that the heap can
+// be reordered without touching the tasks themselves.
+typedef struct task_heap_entry {
+  zx_time_t deadline;
+  uint64_t sequence;  // orders tasks with the same deadline by the time they were posted
+  async_task_t* task;
+} task_heap_entry_t;
+
+// The smallest number of entries the pending task heap is allocated for.
+#define TASK_HEAP_MIN_CAPACITY (16u)
+
 const async_loop_config_t kAsyncLoopConfigNeverAttachToThread = {
     .make_default_for_current_thread = false,
     .default_accessors = {.getter = NULL, .setter = NULL}};
@@ -86,7 +97,10 @@ typedef struct async_loop {
   mtx_t lock;                  // guards the lists and the dispatching tasks flag
   bool dispatching_tasks;      // true while the loop is busy dispatching tasks
   list_node_t wait_list;       // most recently added first
-  list_node_t task_list;       // pending tasks, earliest deadline first
+  task_heap_entry_t* task_heap;  // pending tasks, as a binary min-heap ordered by deadline
+  size_t task_heap_count;        // number of tasks in |task_heap|
+  size_t task_heap_capacity;     // number of entries allocated for |task_heap|
+  uint64_t task_sequence;        // sequence number of the next task to be posted
   list_node_t due_list;        // due tasks, earliest deadline first
   list_node_t thread_list;     // earliest created thread first
   list_node_t irq_list;        // list of IRQs
@@ -112,7 +126,8 @@ static zx_status_t async_loop_dispatch_paged_vmo(async_loop_t* loop, async_paged
                                                  const zx_packet_page_request_t* page_request);
 static zx_status_t async_loop_cancel_paged_vmo(async_paged_vmo_t* paged_vmo);
 static void async_loop_wake_threads(async_loop_t* loop);
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static async_task_t* async_loop_remove_task_locked(async_loop_t* loop, size_t index);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
 static void async_loop_invoke_epilogue(async_loop_t* loop);
@@ -136,6 +151,28 @@ static inline async_task_t* node_to_task(list_node_t* node) {
   return FROM_NODE(async_task_t, node);
 }
 
+// A pending task is either in |task_heap| or in |due_list|. While it is in |due_list| its state
+// holds a list node, and while it is in |task_heap| it holds the task's index in the heap instead,
+// so that it can be canceled without searching for it. The two are told apart by the first word,
+// which is never zero for a list node that is in a list.
+typedef struct task_heap_node {
+  uintptr_t zero;
+  uintptr_t index;  // index in |task_heap| plus one
+} task_heap_node_t;
+
+static_assert(sizeof(task_heap_node_t) <= sizeof(async_state_t), "async_state_t too small");
+static_assert(offsetof(task_heap_node_t, zero) == offsetof(list_node_t, prev),
+              "task_heap_node_t must overlay list_node_t");
+
+static inline task_heap_node_t* task_to_heap_node(async_task_t* task) {
+  return (task_heap_node_t*)&task->state;
+}
+
+static inline bool task_in_heap(async_task_t* task) {
+  const task_heap_node_t* node = task_to_heap_node(task);
+  return node->zero == 0u && node->index != 0u;
+}
+
 static inline async_irq_t* node_to_irq(list_node_t* node) { return FROM_NODE(async_irq_t, node); }
 
 static inline list_node_t* paged_vmo_to_node(async_paged_vmo_t* paged_vmo) {
@@ -165,7 +202,6 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_loop_t**
   mtx_init(&loop->lock, mtx_plain);
   list_initialize(&loop->wait_list);
   list_initialize(&loop->irq_list);
-  list_initialize(&loop->task_list);
   list_initialize(&loop->due_list);
   list_initialize(&loop->thread_list);
   list_initialize(&loop->paged_vmo_list);
@@ -196,7 +232,7 @@ void async_loop_destroy(async_loop_t* loop) {
 
   ZX_DEBUG_ASSERT(list_is_empty(&loop->wait_list));
   ZX_DEBUG_ASSERT(list_is_empty(&loop->irq_list));
-  ZX_DEBUG_ASSERT(list_is_empty(&loop->task_list));
+  ZX_DEBUG_ASSERT(loop->task_heap_count == 0u);
   ZX_DEBUG_ASSERT(list_is_empty(&loop->due_list));
   ZX_DEBUG_ASSERT(list_is_empty(&loop->thread_list));
   ZX_DEBUG_ASSERT(list_is_empty(&loop->paged_vmo_list));
@@ -204,6 +240,7 @@ void async_loop_destroy(async_loop_t* loop) {
   zx_handle_close(loop->port);
   zx_handle_close(loop->timer);
   mtx_destroy(&loop->lock);
+  free(loop->task_heap);
   free(loop);
 }
 
@@ -233,9 +270,9 @@ static void async_loop_cancel_all(async_loop_t* loop) {
     async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
     mtx_lock(&loop->lock);
   }
-  while ((node = list_remove_head(&loop->task_list))) {
+  while (loop->task_heap_count > 0u) {
+    async_task_t* task = async_loop_remove_task_locked(loop, 0u);
     mtx_unlock(&loop->lock);
-    async_task_t* task = node_to_task(node);
     async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
     mtx_lock(&loop->lock);
   }
@@ -419,20 +456,9 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     list_node_t* node;
     if (list_is_empty(&loop->due_list)) {
       zx_time_t due_time = async_loop_now((async_dispatcher_t*)loop);
-      list_node_t* tail = NULL;
-      list_for_every(&loop->task_list, node) {
-        if (node_to_task(node)->deadline > due_time)
-          break;
-        tail = node;
-      }
-      if (tail) {
-        list_node_t* head = loop->task_list.next;
-        loop->task_list.next = tail->next;
-        tail->next->prev = &loop->task_list;
-        loop->due_list.next = head;
-        head->prev = &loop->due_list;
-        loop->due_list.prev = tail;
-        tail->next = &loop->due_list;
+      while (loop->task_heap_count > 0u && loop->task_heap[0].deadline <= due_time) {
+        async_task_t* task = async_loop_remove_task_locked(loop, 0u);
+        list_add_tail(&loop->due_list, task_to_node(task));
       }
     }
 
@@ -608,14 +634,14 @@ static zx_status_t async_loop_post_task(async_dispatcher_t* async, async_task_t*
     return ZX_ERR_BAD_STATE;
   }
 
-  async_loop_insert_task_locked(loop, task);
-  if (!loop->dispatching_tasks && task_to_node(task)->prev == &loop->task_list) {
+  zx_status_t status = async_loop_insert_task_locked(loop, task);
+  if (status == ZX_OK && !loop->dispatching_tasks && task_to_heap_node(task)->index == 1u) {
     // Task inserted at head.  Earliest deadline changed.
     async_loop_restart_timer_locked(loop);
   }
 
   mtx_unlock(&loop->lock);
-  return ZX_OK;
+  return status;
 }
 
 static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_t* task) {
@@ -627,25 +653,26 @@ static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_
   // destroyed in case the client is counting on the handler not being
   // invoked again past this point.  Also, the task we're removing here
   // might be present in the dispatcher's |due_list| if it is pending
-  // dispatch instead of in the loop's |task_list| as usual.  The same
-  // logic works in both cases.
+  // dispatch instead of in the loop's |task_heap| as usual.
 
   mtx_lock(&loop->lock);
-  list_node_t* node = task_to_node(task);
-  if (!list_in_list(node)) {
-    mtx_unlock(&loop->lock);
-    return ZX_ERR_NOT_FOUND;
+  if (task_in_heap(task)) {
+    // Determine whether the head task was canceled and the next task has
+    // a later deadline.  If so, we will bump the timer along to that deadline.
+    size_t index = task_to_heap_node(task)->index - 1u;
+    async_loop_remove_task_locked(loop, index);
+    if (!loop->dispatching_tasks && index == 0u &&
+        (loop->task_heap_count == 0u || loop->task_heap[0].deadline > task->deadline))
+      async_loop_restart_timer_locked(loop);
+  } else {
+    list_node_t* node = task_to_node(task);
+    if (!list_in_list(node)) {
+      mtx_unlock(&loop->lock);
+      return ZX_ERR_NOT_FOUND;
+    }
+    list_delete(node);
   }
 
-  // Determine whether the head task was canceled and following task has
-  // a later deadline.  If so, we will bump the timer along to that deadline.
-  bool must_restart =
-      !loop->dispatching_tasks && node->prev == &loop->task_list &&
-      (node->next == &loop->task_list || node_to_task(node->next)->deadline > task->deadline);
-  list_delete(node);
-  if (must_restart)
-    async_loop_restart_timer_locked(loop);
-
   mtx_unlock(&loop->lock);
   return ZX_OK;
 }
@@ -735,29 +762,104 @@ static zx_status_t async_loop_cancel_paged_vmo(async_paged_vmo_t* paged_vmo) {
   return zx_pager_detach_vmo(paged_vmo->pager, paged_vmo->vmo);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-  // TODO(https://fxbug.dev/42105840): We assume that tasks are inserted in quasi-monotonic order and
-  // that insertion into the task queue will typically take no more than a few steps.
-  // If this assumption proves false and the cost of insertion becomes a problem, we
-  // should consider using a more efficient representation for maintaining order.
-  list_node_t* node;
-  for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-    if (task->deadline >= node_to_task(node)->deadline)
+static inline bool task_heap_entry_before(const task_heap_entry_t* a, const task_heap_entry_t* b) {
+  return a->deadline < b->deadline || (a->deadline == b->deadline && a->sequence < b->sequence);
+}
+
+static inline void async_loop_set_task_heap_entry_locked(async_loop_t* loop, size_t index,
+                                                         const task_heap_entry_t* entry) {
+  loop->task_heap[index] = *entry;
+  task_to_heap_node(entry->task)->index = index + 1u;
+}
+
+static void async_loop_sift_task_up_locked(async_loop_t* loop, size_t index) {
+  task_heap_entry_t entry = loop->task_heap[index];
+  while (index > 0u) {
+    size_t parent = (index - 1u) / 2u;
+    if (!task_heap_entry_before(&entry, &loop->task_heap[parent]))
+      break;
+    async_loop_set_task_heap_entry_locked(loop, index, &loop->task_heap[parent]);
+    index = parent;
+  }
+  async_loop_set_task_heap_entry_locked(loop, index, &entry);
+}
+
+static void async_loop_sift_task_down_locked(async_loop_t* loop, size_t index) {
+  task_heap_entry_t entry = loop->task_heap[index];
+  for (;;) {
+    size_t child = index * 2u + 1u;
+    if (child >= loop->task_heap_count)
+      break;
+    if (child + 1u < loop->task_heap_count &&
+        task_heap_entry_before(&loop->task_heap[child + 1u], &loop->task_heap[child]))
+      child++;
+    if (!task_heap_entry_before(&loop->task_heap[child], &entry))
       break;
+    async_loop_set_task_heap_entry_locked(loop, index, &loop->task_heap[child]);
+    index = child;
   }
-  list_add_after(node, task_to_node(task));
+  async_loop_set_task_heap_entry_locked(loop, index, &entry);
+}
+
+static bool async_loop_resize_task_heap_locked(async_loop_t* loop, size_t capacity) {
+  task_heap_entry_t* heap = realloc(loop->task_heap, capacity * sizeof(task_heap_entry_t));
+  if (!heap)
+    return false;
+  loop->task_heap = heap;
+  loop->task_heap_capacity = capacity;
+  return true;
+}
+
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+  if (loop->task_heap_count == loop->task_heap_capacity) {
+    size_t capacity = loop->task_heap_capacity ? loop->task_heap_capacity * 2u
+                                               : TASK_HEAP_MIN_CAPACITY;
+    if (!async_loop_resize_task_heap_locked(loop, capacity))
+      return ZX_ERR_NO_MEMORY;
+  }
+
+  // Tasks are mostly posted in quasi-monotonic order, in which case they stay at the bottom of the
+  // heap and insertion takes no more than a step or two.
+  task_to_heap_node(task)->zero = 0u;
+  task_heap_entry_t entry = {
+      .deadline = task->deadline, .sequence = loop->task_sequence++, .task = task};
+  size_t index = loop->task_heap_count++;
+  async_loop_set_task_heap_entry_locked(loop, index, &entry);
+  async_loop_sift_task_up_locked(loop, index);
+  return ZX_OK;
+}
+
+// Removes the task at |index| from the heap, and returns it.
+static async_task_t* async_loop_remove_task_locked(async_loop_t* loop, size_t index) {
+  ZX_DEBUG_ASSERT(index < loop->task_heap_count);
+  async_task_t* task = loop->task_heap[index].task;
+  task_to_heap_node(task)->index = 0u;
+
+  size_t last = --loop->task_heap_count;
+  if (index != last) {
+    async_loop_set_task_heap_entry_locked(loop, index, &loop->task_heap[last]);
+    if (index > 0u &&
+        task_heap_entry_before(&loop->task_heap[index], &loop->task_heap[(index - 1u) / 2u])) {
+      async_loop_sift_task_up_locked(loop, index);
+    } else {
+      async_loop_sift_task_down_locked(loop, index);
+    }
+  }
+
+  // Give back the memory of a burst of tasks once most of them are gone. Failing to shrink the
+  // heap is harmless.
+  if (loop->task_heap_capacity > TASK_HEAP_MIN_CAPACITY &&
+      loop->task_heap_count <= loop->task_heap_capacity / 4u) {
+    async_loop_resize_task_heap_locked(loop, loop->task_heap_capacity / 2u);
+  }
+  return task;
 }
 
 static zx_time_t async_loop_next_deadline_locked(async_loop_t* loop) {
   if (list_is_empty(&loop->due_list)) {
-    list_node_t* head = list_peek_head(&loop->task_list);
-    if (!head)
-      return ZX_TIME_INFINITE;
-    async_task_t* task = node_to_task(head);
-    if (task->deadline == ZX_TIME_INFINITE)
+    if (loop->task_heap_count == 0u)
       return ZX_TIME_INFINITE;
-    else
-      return task->deadline;
+    return loop->task_heap[0].deadline;
   }
   // Fire now.
   return 0ULL;
@@ -31,6 +31,7 @@
 #include <random>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
@@ -876,6 +877,45 @@ TEST(Loop, TaskShutdown) {
   EXPECT_EQ(0u, task8.run_count, "run count 8");
 }
 
+// Tasks run in deadline order, and tasks with the same deadline run in the order they were posted,
+// however they are posted and canceled.
+TEST(Loop, TaskOrder) {
+  constexpr size_t kNumTasks = 1000;
+  async::Loop loop(&kAsyncLoopConfigNoAttachToCurrentThread);
+  std::default_random_engine random(zxtest::Runner::GetInstance()->random_seed());
+  std::uniform_int_distribution<int64_t> delay_distribution(0, 50);
+
+  std::vector<size_t> order;
+  std::vector<async::TaskClosure> tasks(kNumTasks);
+  std::vector<zx::time> deadlines(kNumTasks);
+  zx::time start_time = async::Now(loop.dispatcher());
+  for (size_t i = 0; i < kNumTasks; i++) {
+    tasks[i].set_handler([&order, i] { order.push_back(i); });
+    // All of the deadlines are in the past, so that every task is due when the loop runs.
+    deadlines[i] = start_time - zx::nsec(delay_distribution(random));
+    ASSERT_OK(tasks[i].PostForTime(loop.dispatcher(), deadlines[i]));
+  }
+  for (size_t i = 0; i < kNumTasks; i += 3) {
+    ASSERT_OK(tasks[i].Cancel());
+  }
+  EXPECT_STATUS(tasks[0].Cancel(), ZX_ERR_NOT_FOUND);
+
+  EXPECT_OK(loop.RunUntilIdle());
+
+  std::vector<size_t> expected;
+  for (size_t i = 0; i < kNumTasks; i++) {
+    if (i % 3 != 0) {
+      expected.push_back(i);
+    }
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [&deadlines](size_t a, size_t b) { return deadlines[a] < deadlines[b]; });
+  EXPECT_TRUE(order == expected);
+  for (size_t i = 0; i < kNumTasks; i++) {
+    EXPECT_FALSE(tasks[i].is_pending());
+  }
+}
+
 TEST(Loop, Receiver) {
   const zx_packet_user_t data1{.u64 = {11, 12, 13, 14}};
   const zx_packet_user_t data2{.u64 = {21, 22, 23, 24}};
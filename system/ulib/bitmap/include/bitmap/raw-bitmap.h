@@ -16,6 +16,7 @@
 
 #include <bitmap/bitmap.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/macros.h>
 
 namespace bitmap {
@@ -78,11 +79,47 @@ class RawBitmapBase : public Bitmap<size_t> {
   // Clear all bits in the bitmap.
   void ClearAll() override;
 
+  // Maintains a summary alongside the bitmap so that scans, and the finds built on them, skip
+  // over long stretches of set or clear bits without reading them. The summary records, for each
+  // word of the bitmap, whether it is entirely set and whether it is entirely clear. It takes an
+  // extra 1/32 of the bitmap's memory, and makes Set() and Clear() do slightly more work.
+  //
+  // Returns ZX_ERR_NO_MEMORY, leaving the summary off, if it cannot be allocated. The summary is
+  // kept up to date by Reset() and Grow(). Since it is only an optimization, if it cannot be
+  // resized they turn it off instead of failing; has_summary() tells whether it is still on.
+  // Changes made to the bitmap's storage directly through StorageUnsafe() are not reflected in
+  // the summary until EnableSummary() is called again.
+  zx_status_t EnableSummary();
+  bool has_summary() const { return summarize_; }
+
  protected:
+  // Reallocates the summary, if enabled, to cover the current size of the bitmap, or turns it off
+  // if that fails. The summary must then be rebuilt, or the bitmap cleared, before it is used.
+  void ResizeSummary();
+
+  // Recomputes the summary, if enabled, from the contents of the bitmap.
+  void RebuildSummary();
+
   // The size of this bitmap, in bits.
   size_t size_ = 0;
   // Owned by bits_, cached
   size_t* data_ = nullptr;
+
+ private:
+  // Returns the index of the first (or last, for ReverseSkipWords) word in [begin, end) whose
+  // bits are not all |is_set|, or |end| if there is none.
+  size_t SkipWords(size_t begin, size_t end, bool is_set) const;
+  size_t ReverseSkipWords(size_t begin, size_t end, bool is_set) const;
+
+  // Updates the summary of the words in [first_idx, last_idx] after their bits in between
+  // have all been set or cleared.
+  void SummarizeRange(size_t first_idx, size_t last_idx, bool is_set);
+  void SummarizeWord(size_t idx);
+
+  bool summarize_ = false;
+  // Bit N of these is set if word N of the bitmap has all of its bits set, or clear, respectively.
+  fbl::Array<size_t> full_words_;
+  fbl::Array<size_t> empty_words_;
 };
 
 // A simple bitmap backed by generic storage.
@@ -129,6 +166,9 @@ class RawBitmapGeneric final : public RawBitmapBase {
     data_ = static_cast<size_t*>(bits_.GetData());
     size_ = size;
 
+    ResizeSummary();
+    RebuildSummary();
+
     // Clear the partial bits not included in the new "size_t"s.
     Clear(old_size, std::min(old_len * kBits, size_));
     return ZX_OK;
@@ -145,6 +185,7 @@ class RawBitmapGeneric final : public RawBitmapBase {
     size_ = size;
     if (size_ == 0) {
       data_ = nullptr;
+      ResizeSummary();
       return ZX_OK;
     }
     size_t last_idx = LastIdx(size);
@@ -153,6 +194,7 @@ class RawBitmapGeneric final : public RawBitmapBase {
       return status;
     }
     data_ = static_cast<size_t*>(bits_.GetData());
+    ResizeSummary();
     ClearAll();
     return ZX_OK;
   }
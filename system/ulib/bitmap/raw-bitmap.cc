@@ -11,6 +11,7 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/macros.h>
 
 namespace bitmap {
@@ -70,6 +71,105 @@ size_t MaskBits(size_t data, size_t idx, size_t bitoff, size_t bitmax, bool is_s
 #error "Unsupported size_t length"
 #endif
 
+// Number of words compared at a time by FindWordNot() and ReverseFindWordNot().
+constexpr size_t kWordStride = 4;
+
+// Returns the index of the first word in [begin, end) that is not equal to
+// |value|, or |end| if there is none.  Words are compared several at a time,
+// which lets long runs of equal words be skipped with fewer branches, and
+// with vector instructions where the compiler is able to use them.
+size_t FindWordNot(const size_t* words, size_t begin, size_t end, size_t value) {
+  size_t i = begin;
+  for (; end - i >= kWordStride; i += kWordStride) {
+    size_t diff = (words[i] ^ value) | (words[i + 1] ^ value) | (words[i + 2] ^ value) |
+                  (words[i + 3] ^ value);
+    if (diff != 0) {
+      break;
+    }
+  }
+  while (i < end && words[i] == value) {
+    ++i;
+  }
+  return i;
+}
+
+// Returns the index of the last word in [begin, end) that is not equal to
+// |value|, or |end| if there is none.
+size_t ReverseFindWordNot(const size_t* words, size_t begin, size_t end, size_t value) {
+  size_t i = end;
+  for (; i - begin >= kWordStride; i -= kWordStride) {
+    size_t diff = (words[i - 1] ^ value) | (words[i - 2] ^ value) | (words[i - 3] ^ value) |
+                  (words[i - 4] ^ value);
+    if (diff != 0) {
+      break;
+    }
+  }
+  while (i > begin && words[i - 1] == value) {
+    --i;
+  }
+  return (i == begin) ? end : i - 1;
+}
+
+// Returns the first (or last, for ReverseFindClearBit) clear bit of |words|
+// in [bitoff, bitmax), or |bitmax| if there is none.
+size_t FindClearBit(const size_t* words, size_t bitoff, size_t bitmax) {
+  const size_t ones = ~size_t(0);
+  size_t i = FirstIdx(bitoff);
+  size_t last = LastIdx(bitmax);
+  size_t bits = ~words[i] & GetMask(true, false, bitoff, bitmax);
+  while (bits == 0) {
+    if (i == last) {
+      return bitmax;
+    }
+    i = FindWordNot(words, i + 1, last + 1, ones);
+    if (i > last) {
+      return bitmax;
+    }
+    bits = ~words[i];
+  }
+  return std::min(i * kBits + CTZ(bits), bitmax);
+}
+
+size_t ReverseFindClearBit(const size_t* words, size_t bitoff, size_t bitmax) {
+  const size_t ones = ~size_t(0);
+  size_t first = FirstIdx(bitoff);
+  size_t i = LastIdx(bitmax);
+  size_t bits = ~words[i] & GetMask(false, true, bitoff, bitmax);
+  while (bits == 0) {
+    if (i == first) {
+      return bitmax;
+    }
+    size_t next = ReverseFindWordNot(words, first, i, ones);
+    if (next == i) {
+      return bitmax;
+    }
+    i = next;
+    bits = ~words[i];
+  }
+  size_t bit = (i + 1) * kBits - (CLZ(bits) + 1);
+  return (bit >= bitoff) ? bit : bitmax;
+}
+
+// Sets, or clears, the bits of |words| in [bitoff, bitmax).
+void SetBits(size_t* words, size_t bitoff, size_t bitmax) {
+  size_t first_idx = FirstIdx(bitoff);
+  size_t last_idx = LastIdx(bitmax);
+  for (size_t i = first_idx; i <= last_idx; ++i) {
+    words[i] |= GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+  }
+}
+
+void ClearBits(size_t* words, size_t bitoff, size_t bitmax) {
+  size_t first_idx = FirstIdx(bitoff);
+  size_t last_idx = LastIdx(bitmax);
+  for (size_t i = first_idx; i <= last_idx; ++i) {
+    words[i] &= ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+  }
+}
+
+// Returns the number of words needed to hold |bits| bits.
+constexpr size_t WordCount(size_t bits) { return (bits == 0) ? 0 : LastIdx(bits) + 1; }
+
 }  // namespace
 
 zx_status_t RawBitmapBase::Shrink(size_t size) {
@@ -86,6 +186,7 @@ bool RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set, size_t* out)
     return true;
   }
   size_t i = FirstIdx(bitoff);
+  const size_t last_idx = LastIdx(bitmax);
   while (true) {
     size_t masked = MaskBits(data_[i], i, bitoff, bitmax, is_set);
     if (masked != 0) {
@@ -94,10 +195,12 @@ bool RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set, size_t* out)
       }
       return false;
     }
-    if (i == LastIdx(bitmax)) {
+    if (i == last_idx) {
       return true;
     }
-    ++i;
+    // Skip the whole words that match. The last word may be partial, so it is
+    // always checked with its mask.
+    i = SkipWords(i + 1, last_idx, is_set);
   }
 }
 
@@ -107,6 +210,7 @@ bool RawBitmapBase::ReverseScan(size_t bitoff, size_t bitmax, bool is_set, size_
     return true;
   }
   size_t i = LastIdx(bitmax);
+  const size_t first_idx = FirstIdx(bitoff);
   while (true) {
     size_t masked = MaskBits(data_[i], i, bitoff, bitmax, is_set);
     if (masked != 0) {
@@ -115,10 +219,11 @@ bool RawBitmapBase::ReverseScan(size_t bitoff, size_t bitmax, bool is_set, size_
       }
       return false;
     }
-    if (i == FirstIdx(bitoff)) {
+    if (i == first_idx) {
       return true;
     }
-    --i;
+    size_t next = ReverseSkipWords(first_idx + 1, i, is_set);
+    i = (next == i) ? first_idx : next;
   }
 }
 
@@ -176,10 +281,9 @@ zx_status_t RawBitmapBase::Set(size_t bitoff, size_t bitmax) {
   if (bitoff == bitmax) {
     return ZX_OK;
   }
-  size_t first_idx = FirstIdx(bitoff);
-  size_t last_idx = LastIdx(bitmax);
-  for (size_t i = first_idx; i <= last_idx; ++i) {
-    data_[i] |= GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+  SetBits(data_, bitoff, bitmax);
+  if (summarize_) {
+    SummarizeRange(FirstIdx(bitoff), LastIdx(bitmax), true);
   }
   return ZX_OK;
 }
@@ -191,10 +295,9 @@ zx_status_t RawBitmapBase::Clear(size_t bitoff, size_t bitmax) {
   if (bitoff == bitmax) {
     return ZX_OK;
   }
-  size_t first_idx = FirstIdx(bitoff);
-  size_t last_idx = LastIdx(bitmax);
-  for (size_t i = first_idx; i <= last_idx; ++i) {
-    data_[i] &= ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+  ClearBits(data_, bitoff, bitmax);
+  if (summarize_) {
+    SummarizeRange(FirstIdx(bitoff), LastIdx(bitmax), false);
   }
   return ZX_OK;
 }
@@ -207,6 +310,106 @@ void RawBitmapBase::ClearAll() {
   for (size_t i = 0; i <= last_idx; ++i) {
     data_[i] = 0;
   }
+  if (summarize_) {
+    ClearBits(full_words_.data(), 0, last_idx + 1);
+    SetBits(empty_words_.data(), 0, last_idx + 1);
+  }
+}
+
+zx_status_t RawBitmapBase::EnableSummary() {
+  summarize_ = true;
+  ResizeSummary();
+  if (!summarize_) {
+    return ZX_ERR_NO_MEMORY;
+  }
+  RebuildSummary();
+  return ZX_OK;
+}
+
+void RawBitmapBase::ResizeSummary() {
+  if (!summarize_) {
+    return;
+  }
+  size_t len = WordCount(WordCount(size_));
+  if (len == full_words_.size()) {
+    return;
+  }
+  fbl::AllocChecker ac;
+  fbl::Array<size_t> full(new (&ac) size_t[len](), len);
+  if (ac.check()) {
+    fbl::Array<size_t> empty(new (&ac) size_t[len](), len);
+    if (ac.check()) {
+      full_words_ = std::move(full);
+      empty_words_ = std::move(empty);
+      return;
+    }
+  }
+  summarize_ = false;
+  full_words_.reset();
+  empty_words_.reset();
+}
+
+void RawBitmapBase::RebuildSummary() {
+  if (!summarize_) {
+    return;
+  }
+  size_t count = WordCount(size_);
+  for (size_t i = 0; i < count; ++i) {
+    SummarizeWord(i);
+  }
+}
+
+size_t RawBitmapBase::SkipWords(size_t begin, size_t end, bool is_set) const {
+  if (begin >= end) {
+    return end;
+  }
+  if (summarize_) {
+    return FindClearBit(is_set ? full_words_.data() : empty_words_.data(), begin, end);
+  }
+  return FindWordNot(data_, begin, end, is_set ? ~size_t(0) : 0);
+}
+
+size_t RawBitmapBase::ReverseSkipWords(size_t begin, size_t end, bool is_set) const {
+  if (begin >= end) {
+    return end;
+  }
+  if (summarize_) {
+    return ReverseFindClearBit(is_set ? full_words_.data() : empty_words_.data(), begin, end);
+  }
+  return ReverseFindWordNot(data_, begin, end, is_set ? ~size_t(0) : 0);
+}
+
+void RawBitmapBase::SummarizeRange(size_t first_idx, size_t last_idx, bool is_set) {
+  SummarizeWord(first_idx);
+  if (last_idx == first_idx) {
+    return;
+  }
+  SummarizeWord(last_idx);
+  // The words in between are now entirely set, or entirely clear.
+  if (last_idx - first_idx > 1) {
+    if (is_set) {
+      SetBits(full_words_.data(), first_idx + 1, last_idx);
+      ClearBits(empty_words_.data(), first_idx + 1, last_idx);
+    } else {
+      ClearBits(full_words_.data(), first_idx + 1, last_idx);
+      SetBits(empty_words_.data(), first_idx + 1, last_idx);
+    }
+  }
+}
+
+void RawBitmapBase::SummarizeWord(size_t idx) {
+  size_t word = data_[idx];
+  size_t bit = size_t(1) << (idx % kBits);
+  if (word == ~size_t(0)) {
+    full_words_[FirstIdx(idx)] |= bit;
+  } else {
+    full_words_[FirstIdx(idx)] &= ~bit;
+  }
+  if (word == 0) {
+    empty_words_[FirstIdx(idx)] |= bit;
+  } else {
+    empty_words_[FirstIdx(idx)] &= ~bit;
+  }
 }
 
 }  // namespace bitmap
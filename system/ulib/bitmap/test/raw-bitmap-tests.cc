@@ -494,6 +494,85 @@ static void GrowFailure(void) {
   EXPECT_EQ(bitmap.Grow(8 * zx_system_get_page_size()), ZX_ERR_NO_RESOURCES);
 }
 
+// Checks that scans and finds give the same answers with and without the summary, over a
+// bitmap with long runs of set and clear bits.
+template <typename RawBitmap>
+static void SummaryMatchesScan(void) {
+  constexpr size_t kSize = 64 * 1024 + 37;
+  RawBitmap plain;
+  RawBitmap summarized;
+  ASSERT_EQ(plain.Reset(kSize), ZX_OK);
+  ASSERT_EQ(summarized.Reset(kSize), ZX_OK);
+  EXPECT_FALSE(summarized.has_summary());
+  ASSERT_EQ(summarized.EnableSummary(), ZX_OK);
+  EXPECT_TRUE(summarized.has_summary());
+
+  uint64_t seed = 0x9e3779b97f4a7c15;
+  auto next = [&seed](size_t max) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    return static_cast<size_t>((seed >> 33) % max);
+  };
+
+  for (int round = 0; round < 2000; ++round) {
+    size_t bitoff = next(kSize);
+    // Mostly short ranges, with the occasional one spanning many words.
+    size_t len =
+        (round % 8 == 0) ? next(kSize - bitoff) : next(std::min<size_t>(300, kSize - bitoff));
+    size_t bitmax = bitoff + len;
+    if (round % 2 == 0) {
+      ASSERT_EQ(plain.Set(bitoff, bitmax), ZX_OK);
+      ASSERT_EQ(summarized.Set(bitoff, bitmax), ZX_OK);
+    } else {
+      ASSERT_EQ(plain.Clear(bitoff, bitmax), ZX_OK);
+      ASSERT_EQ(summarized.Clear(bitoff, bitmax), ZX_OK);
+    }
+
+    for (int query = 0; query < 4; ++query) {
+      size_t off = next(kSize);
+      size_t max = off + next(kSize - off + 1);
+      bool is_set = query % 2 == 0;
+      size_t expected = 0, actual = 0;
+      EXPECT_EQ(plain.Scan(off, max, is_set, &expected),
+                summarized.Scan(off, max, is_set, &actual));
+      EXPECT_EQ(expected, actual);
+      expected = actual = 0;
+      EXPECT_EQ(plain.ReverseScan(off, max, is_set, &expected),
+                summarized.ReverseScan(off, max, is_set, &actual));
+      EXPECT_EQ(expected, actual);
+
+      size_t run_len = 1 + next(200);
+      expected = actual = 0;
+      EXPECT_EQ(plain.Find(is_set, off, max, run_len, &expected),
+                summarized.Find(is_set, off, max, run_len, &actual));
+      EXPECT_EQ(expected, actual);
+      expected = actual = 0;
+      EXPECT_EQ(plain.ReverseFind(is_set, off, max, run_len, &expected),
+                summarized.ReverseFind(is_set, off, max, run_len, &actual));
+      EXPECT_EQ(expected, actual);
+    }
+  }
+
+  // The summary survives clearing and resizing the bitmap.
+  summarized.ClearAll();
+  size_t out;
+  EXPECT_TRUE(summarized.Scan(0, kSize, false, &out));
+  ASSERT_EQ(summarized.Set(100, 5000), ZX_OK);
+  EXPECT_FALSE(summarized.Scan(0, kSize, false, &out));
+  EXPECT_EQ(out, 100u);
+  EXPECT_FALSE(summarized.Scan(100, kSize, true, &out));
+  EXPECT_EQ(out, 5000u);
+  EXPECT_FALSE(summarized.ReverseScan(0, kSize, false, &out));
+  EXPECT_EQ(out, 4999u);
+
+  ASSERT_EQ(summarized.Reset(kSize * 2), ZX_OK);
+  EXPECT_TRUE(summarized.has_summary());
+  EXPECT_TRUE(summarized.Scan(0, kSize * 2, false, &out));
+  ASSERT_EQ(summarized.Set(kSize, kSize * 2), ZX_OK);
+  EXPECT_FALSE(summarized.Scan(0, kSize * 2, false, &out));
+  EXPECT_EQ(out, kSize);
+  EXPECT_TRUE(summarized.Scan(kSize, kSize * 2, true, &out));
+}
+
 #define TEMPLATIZED_TEST(test, specialization) \
   TEST(RawBitmapTests, test##_##specialization) { test<RawBitmapGeneric<specialization>>(); }
 
@@ -510,7 +589,8 @@ static void GrowFailure(void) {
   TEMPLATIZED_TEST(ClearAll, specialization)            \
   TEMPLATIZED_TEST(SetOutOfOrder, specialization)       \
   TEMPLATIZED_TEST(MoveConstructorTest, specialization) \
-  TEMPLATIZED_TEST(MoveAssignmentTest, specialization)
+  TEMPLATIZED_TEST(MoveAssignmentTest, specialization)  \
+  TEMPLATIZED_TEST(SummaryMatchesScan, specialization)
 
 ALL_TESTS(DefaultStorage)
 ALL_TESTS(VmoStorage)
@@ -25,7 +25,8 @@ namespace internal {
 // heap using the least amount of physical memory to
 // satisfy requests.
 //
-// This class is not thread safe.
+// This class is not thread safe. The whole VMO is mapped up front, so the
+// address of a block never changes while the heap is alive.
 class Heap final {
  public:
   // Create a new heap that allocates out of the given |vmo|.
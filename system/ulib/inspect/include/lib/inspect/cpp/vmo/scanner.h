@@ -9,9 +9,17 @@
 #include <lib/inspect/cpp/vmo/block.h>
 #include <zircon/types.h>
 
+#include <vector>
+
 namespace inspect {
 namespace internal {
 
+// A range of blocks, from index |begin| up to but not including index |end|.
+struct BlockRange final {
+  BlockIndex begin;
+  BlockIndex end;
+};
+
 // Read blocks out of the buffer.
 //
 // For each block that it found, this function calls the callback function
@@ -23,6 +31,19 @@ namespace internal {
 zx_status_t ScanBlocks(const uint8_t* buffer, size_t size,
                        fit::function<bool(BlockIndex, const Block*)> callback);
 
+// Read only the blocks of the buffer that lie in |ranges|, such as the
+// blocks that a delta snapshot reports as changed, and skip the rest.
+//
+// The ranges must be in order and must not overlap. Each range must start
+// on a block boundary, which is the case for any range that starts on a
+// multiple of the largest block size. Ranges that extend past the end of
+// the buffer are cut short.
+//
+// Returns values and calls the callback in the same way as ScanBlocks above,
+// with the index of each block relative to the start of the buffer.
+zx_status_t ScanBlocks(const uint8_t* buffer, size_t size, const std::vector<BlockRange>& ranges,
+                       fit::function<bool(BlockIndex, const Block*)> callback);
+
 }  // namespace internal
 }  // namespace inspect
 
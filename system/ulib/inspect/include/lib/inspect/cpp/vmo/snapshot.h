@@ -7,6 +7,7 @@
 
 #include <lib/fit/function.h>
 #include <lib/inspect/cpp/vmo/block.h>
+#include <lib/inspect/cpp/vmo/scanner.h>
 #include <lib/stdcompat/variant.h>
 #include <lib/zx/vmar.h>
 #include <lib/zx/vmo.h>
@@ -61,6 +62,12 @@ class BackingBuffer final {
 //   {.read_attempts = 1024, .skip_consistency_check = false},
 //   std::make_unique<TestCallback>(),
 //   &snapshot);
+//
+// Readers that poll a VMO can instead take each snapshot as a delta from the
+// previous one, and only parse the blocks that changed:
+// std::vector<internal::BlockRange> changed;
+// zx_status_t status = Snapshot::CreateDelta(vmo, previous, &snapshot, &changed);
+// internal::ScanBlocks(snapshot.data(), snapshot.size(), changed, callback);
 class Snapshot final {
  public:
   struct Options final {
@@ -89,6 +96,29 @@ class Snapshot final {
   static zx_status_t Create(const zx::vmo& vmo, Options options, ReadObserver read_observer,
                             Snapshot* out_snapshot);
 
+  // Create a new snapshot of the given VMO, and fill in |out_changed| with the ranges of blocks
+  // that may differ from |previous|, an earlier snapshot of the same VMO. All other blocks are
+  // the same as in |previous|. |previous| may be empty, in which case every block is included.
+  //
+  // If nothing has been written to the VMO since |previous| was taken, the new snapshot shares
+  // |previous|'s buffer and |out_changed| is empty, so polling an idle VMO does not copy it.
+  // Otherwise the ranges start and end on multiples of the largest block size, so that they
+  // can be passed to internal::ScanBlocks.
+  static zx_status_t CreateDelta(const zx::vmo& vmo, const Snapshot& previous,
+                                 Snapshot* out_snapshot,
+                                 std::vector<internal::BlockRange>* out_changed);
+
+  // Create a new delta snapshot of the given VMO using the given options.
+  static zx_status_t CreateDelta(const zx::vmo& vmo, const Snapshot& previous, Options options,
+                                 Snapshot* out_snapshot,
+                                 std::vector<internal::BlockRange>* out_changed);
+
+  // Create a new delta snapshot of the given VMO using the given options, and use the
+  // read_observer for observing snapshot operations.
+  static zx_status_t CreateDelta(const zx::vmo& vmo, const Snapshot& previous, Options options,
+                                 ReadObserver read_observer, Snapshot* out_snapshot,
+                                 std::vector<internal::BlockRange>* out_changed);
+
   // Create a new snapshot over the supplied buffer. If the buffer cannot be interpreted as a
   // snapshot, an error status is returned. There are no observers or writers involved.
   static zx_status_t Create(BackingBuffer&& buffer, Snapshot* out_snapshot);
@@ -18,6 +18,7 @@
 #include <lib/stdcompat/string_view.h>
 #include <zircon/types.h>
 
+#include <atomic>
 #include <cstdint>
 #include <iterator>
 #include <map>
@@ -39,6 +40,12 @@ class AutoGenerationIncrement;
 //
 // This class should not be used directly, prefer to use |Inspector|.
 // |State| writes version 2 of the Inspect Format.
+//
+// All operations are thread-safe. Setting or updating the value of a numeric property or array
+// slot does not take the state's lock: the value is written atomically in place, so that many
+// threads can update values at once. Every writer, locked or not, is counted while it changes the
+// VMO, and the generation count is kept odd while any writer is counted, so readers never accept a
+// snapshot taken in the middle of an update.
 class State final {
  public:
   // Create a new State wrapping the given Heap.
@@ -278,6 +285,17 @@ class State final {
   std::unique_ptr<AutoGenerationIncrement> MaybeFreezeAndIncrementGeneration() const
       __TA_REQUIRES(mutex_);
 
+  // Returns the block at |index| for updating a numeric value without holding |mutex_|.
+  Block* GetBlockForUpdate(BlockIndex index) const {
+    return reinterpret_cast<Block*>(blocks_ + index * kMinOrderSize);
+  }
+
+  // Calls |update| to write a numeric value without holding |mutex_|, with the generation count
+  // kept odd around it. If the VMO is being copied, waits for the copy and makes the update
+  // holding |mutex_| instead.
+  template <typename Update>
+  void UpdateWithoutLock(Update update) __TA_EXCLUDES(mutex_);
+
   // Helper method for creating a new VALUE block type.
   zx_status_t InnerCreateValue(BorrowedStringValue name, BlockType type, BlockIndex parent_index,
                                BlockIndex* out_name, BlockIndex* out_value,
@@ -320,6 +338,15 @@ class State final {
   template <typename WrapperType>
   void InnerFreePropertyWithExtents(WrapperType* property);
 
+  // Helper function to set the value of a numeric property.
+  template <typename NumericType, typename WrapperType, BlockType BlockTypeValue>
+  void InnerSetValue(WrapperType* property, NumericType value);
+
+  // Helper function to perform an operation on the value of a numeric property.
+  template <typename NumericType, typename WrapperType, BlockType BlockTypeValue,
+            typename Operation>
+  void InnerOperationValue(WrapperType* property, NumericType value);
+
   // Helper function to set the value of a specific index in an array.
   template <typename NumericType, typename WrapperType, BlockType BlockTypeValue>
   void InnerSetArray(WrapperType* property, size_t index, NumericType value);
@@ -382,6 +409,11 @@ class State final {
   // to increment
   BlockIndex header_ FIT_GUARDED(mutex_);
 
+  // The start of the heap's buffer, and the generation count in its header block. The heap never
+  // moves its buffer, so these are used to update numeric values without holding the mutex.
+  uint8_t* const blocks_;
+  uint64_t* const generation_count_;
+
   // The next unique ID to give out from UniqueName.
   //
   // Uses the fastest available atomic uint64 type for fetch_and_add.
@@ -398,6 +430,13 @@ class State final {
   uint32_t transaction_count_ FIT_GUARDED(mutex_);
   std::unique_ptr<AutoGenerationIncrement> transaction_gen_ FIT_GUARDED(mutex_);
 
+  // The number of writers in the middle of changing the VMO, with flags for the generation count
+  // being turned and for writers being stopped while the VMO is copied. Writers that hold the
+  // mutex are counted as well, so that the count is made even only once they all are done.
+  //
+  // Mutable so that copies of the VMO, which are const, can stop writers.
+  mutable std::atomic<uint64_t> writers_;
+
   // Map StringReference.ID to an index in the VMO and vice-versa.
   class {
    public:
@@ -0,0 +1,67 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/inspect/cpp/inspect.h>
+
+#include <vector>
+
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to add to a uint property while the test's other threads do the same,
+// either to the same property or to a property of their own. Either way, the threads still
+// share the VMO's generation count.
+bool UintAddTest(perftest::MultiThreadState* state, bool shared) {
+  inspect::Inspector inspector;
+  std::vector<inspect::UintProperty> properties;
+  for (uint32_t i = 0; i < (shared ? 1 : state->thread_count()); i++) {
+    auto name = fbl::StringPrintf("value%u", i);
+    properties.push_back(inspector.GetRoot().CreateUint(name.c_str(), 0));
+  }
+
+  return state->RunThreads([&](perftest::RepeatState* thread_state, uint32_t thread_index) {
+    inspect::UintProperty& property = properties[shared ? 0 : thread_index];
+    while (thread_state->KeepRunning()) {
+      property.Add(1);
+    }
+    return true;
+  });
+}
+
+// Measure the time taken to set a double array slot while the test's other threads set other
+// slots of the same array.
+bool DoubleArraySetTest(perftest::MultiThreadState* state) {
+  inspect::Inspector inspector;
+  inspect::DoubleArray array =
+      inspector.GetRoot().CreateDoubleArray("array", state->thread_count());
+
+  return state->RunThreads([&](perftest::RepeatState* thread_state, uint32_t thread_index) {
+    double value = 0;
+    while (thread_state->KeepRunning()) {
+      array.Set(thread_index, value);
+      value += 1;
+    }
+    return true;
+  });
+}
+
+void RegisterTests() {
+  for (uint32_t thread_count : {1, 2, 4, 8}) {
+    auto name = fbl::StringPrintf("Inspect/UintProperty/Add/Shared/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, UintAddTest, true);
+
+    name = fbl::StringPrintf("Inspect/UintProperty/Add/PerThread/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, UintAddTest, false);
+
+    name = fbl::StringPrintf("Inspect/DoubleArray/Set/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, DoubleArraySetTest);
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
+
+int main(int argc, char** argv) { return perftest::PerfTestMain(argc, argv, "fuchsia.inspect"); }
@@ -5,6 +5,8 @@
 #include <lib/inspect/cpp/vmo/scanner.h>
 #include <zircon/types.h>
 
+#include <vector>
+
 #include <zxtest/zxtest.h>
 
 namespace {
@@ -12,6 +14,7 @@ namespace {
 using inspect::internal::Block;
 using inspect::internal::BlockFields;
 using inspect::internal::BlockIndex;
+using inspect::internal::BlockRange;
 using inspect::internal::BlockType;
 using inspect::internal::kMinOrderSize;
 using inspect::internal::ScanBlocks;
@@ -83,4 +86,43 @@ TEST(Scanner, ReadOutOfBounds) {
   EXPECT_EQ(0u, count);
 }
 
+TEST(Scanner, ReadRanges) {
+  uint8_t buf[1024];
+  memset(buf, 0, 1024);
+
+  std::vector<BlockIndex> indices;
+  const std::vector<BlockRange> ranges = {{.begin = 1, .end = 3}, {.begin = 10, .end = 11}};
+  EXPECT_OK(ScanBlocks(buf, 1024, ranges, [&indices](BlockIndex index, const Block* block) {
+    indices.push_back(index);
+    return true;
+  }));
+  EXPECT_EQ((std::vector<BlockIndex>{1, 2, 10}), indices);
+}
+
+TEST(Scanner, ReadRangesPastEnd) {
+  uint8_t buf[1024];
+  memset(buf, 0, 1024);
+
+  size_t count = 0;
+  const std::vector<BlockRange> ranges = {{.begin = 60, .end = 100}, {.begin = 200, .end = 300}};
+  EXPECT_OK(ScanBlocks(buf, 1024, ranges, [&count](BlockIndex index, const Block* block) {
+    count++;
+    return true;
+  }));
+  EXPECT_EQ(1024 / kMinOrderSize - 60, count);
+}
+
+TEST(Scanner, ReadRangesCancel) {
+  uint8_t buf[1024];
+  memset(buf, 0, 1024);
+
+  size_t count = 0;
+  const std::vector<BlockRange> ranges = {{.begin = 0, .end = 2}, {.begin = 4, .end = 6}};
+  EXPECT_OK(ScanBlocks(buf, 1024, ranges, [&count](BlockIndex index, const Block* block) {
+    count++;
+    return false;
+  }));
+  EXPECT_EQ(1u, count);
+}
+
 }  // namespace
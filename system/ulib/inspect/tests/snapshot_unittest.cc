@@ -14,11 +14,13 @@ namespace {
 using inspect::BackingBuffer;
 using inspect::Snapshot;
 using inspect::internal::Block;
+using inspect::internal::BlockRange;
 using inspect::internal::BlockType;
 using inspect::internal::FreeBlockFields;
 using inspect::internal::GetBlock;
 using inspect::internal::HeaderBlockFields;
 using inspect::internal::kMagicNumber;
+using inspect::internal::kMaxOrderSize;
 using inspect::internal::kMaxVmoSize;
 using inspect::internal::kMinOrderSize;
 using inspect::internal::kMinVmoSize;
@@ -349,4 +351,100 @@ TEST(Snapshot, HeaderWithoutSizeInfo) {
   EXPECT_EQ(0, memcmp(snapshot.data() + kVmoHeaderBlockSize, buf.data(), buf.size()));
 }
 
+// Writes a valid header, with a generation count of 0, to the start of |vmo|.
+void WriteHeader(fzl::OwnedVmoMapper* vmo) {
+  Block* header = reinterpret_cast<Block*>(vmo->start());
+  header->header = HeaderBlockFields::Order::Make(kVmoHeaderOrder) |
+                   HeaderBlockFields::Type::Make(BlockType::kHeader) |
+                   HeaderBlockFields::Version::Make(0);
+  memcpy(&header->header_data[4], kMagicNumber, 4);
+  header->payload.u64 = 0;
+  SetHeaderVmoSize(header, vmo->size());
+}
+
+TEST(Snapshot, DeltaOfUnchangedVmoSharesBuffer) {
+  fzl::OwnedVmoMapper vmo;
+  ASSERT_OK(vmo.CreateAndMap(4096, "test"));
+  WriteHeader(&vmo);
+
+  Snapshot first;
+  ASSERT_OK(Snapshot::Create(vmo.vmo(), &first));
+
+  Snapshot second;
+  std::vector<BlockRange> changed;
+  ASSERT_OK(Snapshot::CreateDelta(vmo.vmo(), first, &second, &changed));
+  EXPECT_EQ(first.data(), second.data());
+  EXPECT_EQ(first.size(), second.size());
+  EXPECT_TRUE(changed.empty());
+}
+
+TEST(Snapshot, DeltaReportsChangedBlocks) {
+  fzl::OwnedVmoMapper vmo;
+  const size_t size = 8 * kMaxOrderSize;
+  ASSERT_OK(vmo.CreateAndMap(size, "test"));
+  WriteHeader(&vmo);
+
+  Snapshot first;
+  ASSERT_OK(Snapshot::Create(vmo.vmo(), &first));
+
+  // Change two adjacent chunks and one further on, as a writer would.
+  auto* header = reinterpret_cast<Block*>(vmo.start());
+  header->payload.u64 += 2;
+  auto* data = reinterpret_cast<uint8_t*>(vmo.start());
+  data[3 * kMaxOrderSize + 100] = 'a';
+  data[4 * kMaxOrderSize] = 'b';
+  data[7 * kMaxOrderSize - 1] = 'c';
+
+  Snapshot second;
+  std::vector<BlockRange> changed;
+  ASSERT_OK(Snapshot::CreateDelta(vmo.vmo(), first, &second, &changed));
+  ASSERT_EQ(size, second.size());
+  EXPECT_EQ(0, memcmp(second.data(), vmo.start(), size));
+
+  constexpr size_t kBlocksPerChunk = kMaxOrderSize / kMinOrderSize;
+  ASSERT_EQ(3u, changed.size());
+  // The header always changes, with the generation count.
+  EXPECT_EQ(0u, changed[0].begin);
+  EXPECT_EQ(kBlocksPerChunk, changed[0].end);
+  EXPECT_EQ(3 * kBlocksPerChunk, changed[1].begin);
+  EXPECT_EQ(5 * kBlocksPerChunk, changed[1].end);
+  EXPECT_EQ(6 * kBlocksPerChunk, changed[2].begin);
+  EXPECT_EQ(7 * kBlocksPerChunk, changed[2].end);
+}
+
+TEST(Snapshot, DeltaFromEmptySnapshot) {
+  fzl::OwnedVmoMapper vmo;
+  ASSERT_OK(vmo.CreateAndMap(4096, "test"));
+  WriteHeader(&vmo);
+
+  Snapshot snapshot;
+  std::vector<BlockRange> changed;
+  ASSERT_OK(Snapshot::CreateDelta(vmo.vmo(), Snapshot(), &snapshot, &changed));
+  ASSERT_EQ(4096u, snapshot.size());
+  ASSERT_EQ(1u, changed.size());
+  EXPECT_EQ(0u, changed[0].begin);
+  EXPECT_EQ(4096 / kMinOrderSize, changed[0].end);
+}
+
+TEST(Snapshot, DeltaRetriesOnGenerationChange) {
+  fzl::OwnedVmoMapper vmo;
+  ASSERT_OK(vmo.CreateAndMap(4096, "test"));
+  WriteHeader(&vmo);
+
+  Snapshot first;
+  ASSERT_OK(Snapshot::Create(vmo.vmo(), &first));
+
+  auto* header = reinterpret_cast<Block*>(vmo.start());
+  header->payload.u64 += 2;
+  Snapshot second;
+  std::vector<BlockRange> changed;
+  EXPECT_EQ(ZX_ERR_INTERNAL, Snapshot::CreateDelta(
+                                 vmo.vmo(), first, Snapshot::kDefaultOptions,
+                                 [header](const uint8_t* buffer, size_t buffer_size) {
+                                   header->payload.u64 += 2;
+                                 },
+                                 &second, &changed));
+  EXPECT_TRUE(changed.empty());
+}
+
 }  // namespace
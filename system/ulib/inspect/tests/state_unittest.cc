@@ -15,10 +15,13 @@
 #include <zircon/errors.h>
 #include <zircon/rights.h>
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/vector.h>
@@ -1686,6 +1689,96 @@ TEST(State, MultithreadingTest) {
   CompareBlock(blocks.find(5)->block, MakeInlinedOrder0StringReferenceBlock("root"));
 }
 
+TEST(State, ConcurrentNumericUpdates) {
+  auto state = InitState(4096);
+  ASSERT_TRUE(state != NULL);
+
+  DoubleProperty d = state->CreateDoubleProperty("d", 0, 0);
+  UintArray array = state->CreateUintArray("a", 0, 2, ArrayBlockFormat::kDefault);
+
+  // Numeric updates do not take the state's lock, so make sure that none are lost, including those
+  // made while the VMO is frozen for a copy.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([&] {
+      for (size_t j = 0; j < kThreadTimes; j++) {
+        d.Add(0.5);
+        array.Add(1, 1);
+      }
+    });
+  }
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_TRUE(state->FrozenVmoCopy().has_value());
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  fbl::WAVLTree<BlockIndex, std::unique_ptr<ScannedBlock>> blocks;
+  size_t free_blocks, allocated_blocks;
+  auto snapshot = SnapshotAndScan(state->GetVmo(), &blocks, &free_blocks, &allocated_blocks);
+  ASSERT_TRUE(snapshot);
+
+  // Two creations, and two updates by each thread each time.
+  CompareBlock(blocks.find(0)->block, MakeHeader(2 * 2 + 4 * kThreadTimes * 2 * 2));
+  const Block* double_block = nullptr;
+  const Block* array_block = nullptr;
+  for (const auto& scanned : blocks) {
+    if (GetType(scanned.block) == BlockType::kDoubleValue) {
+      double_block = scanned.block;
+    } else if (GetType(scanned.block) == BlockType::kArrayValue) {
+      array_block = scanned.block;
+    }
+  }
+  ASSERT_NOT_NULL(double_block);
+  ASSERT_NOT_NULL(array_block);
+  EXPECT_EQ(static_cast<double>(4 * kThreadTimes) / 2, double_block->payload.f64);
+  uint64_t array_values[] = {0, 4 * kThreadTimes};
+  CompareArray(array_block, array_values, 2);
+}
+
+TEST(State, SnapshotsSkipConcurrentNumericUpdates) {
+  auto state = InitState(4096);
+  ASSERT_TRUE(state != NULL);
+
+  // Property "a" is at index 2.
+  UintProperty metric = state->CreateUintProperty("a", 0, 0);
+  const size_t offset = 2 * inspect::internal::kMinOrderSize;
+
+  // Every value written has equal halves, so a value copied while it was being written shows up as
+  // halves that differ. No snapshot that a reader accepts may hold one.
+  std::atomic<bool> done = false;
+  std::vector<std::thread> threads;
+  for (uint64_t i = 1; i <= 2; i++) {
+    threads.emplace_back([&, i] {
+      for (uint64_t j = 0; j < kThreadTimes; j++) {
+        metric.Set((i << 16 | j) * 0x100000001);
+      }
+    });
+  }
+  std::thread reader([&] {
+    while (!done) {
+      Snapshot snapshot;
+      if (Snapshot::Create(state->GetVmo(), &snapshot) != ZX_OK) {
+        continue;
+      }
+      ASSERT_GT(snapshot.size(), offset + sizeof(Block));
+      const auto* block = reinterpret_cast<const Block*>(snapshot.data() + offset);
+      EXPECT_EQ(block->payload.u64 >> 32, block->payload.u64 & 0xffffffff);
+    }
+  });
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  reader.join();
+
+  // One creation, and one update by each thread each time.
+  std::vector<uint8_t> buffer;
+  ASSERT_TRUE(state->CopyBytes(&buffer));
+  CompareBlock(reinterpret_cast<const Block*>(buffer.data()), MakeHeader(2 + 2 * kThreadTimes * 2));
+}
+
 TEST(State, OutOfOrderDeletion) {
   // Ensure that deleting properties after their parent does not cause a crash.
   auto state = State::CreateWithSize(4096);
@@ -5,15 +5,19 @@
 #include <lib/inspect/cpp/vmo/limits.h>
 #include <lib/inspect/cpp/vmo/scanner.h>
 
+#include <algorithm>
+
 namespace inspect {
 namespace internal {
 
-zx_status_t ScanBlocks(const uint8_t* buffer, size_t size,
-                       fit::function<bool(BlockIndex, const Block*)> callback) {
-  size_t offset = 0;
-  while (offset < size) {
+namespace {
+
+// Scans the blocks from |offset| up to |end|. Sets |stop| if the callback asks to stop.
+zx_status_t ScanRange(const uint8_t* buffer, size_t offset, size_t end,
+                      const fit::function<bool(BlockIndex, const Block*)>& callback, bool* stop) {
+  while (offset < end) {
     auto* block = reinterpret_cast<const Block*>(buffer + offset);
-    if (size - offset < sizeof(Block)) {
+    if (end - offset < sizeof(Block)) {
       // Block header does not fit in remaining space.
       return ZX_ERR_OUT_OF_RANGE;
     }
@@ -21,13 +25,14 @@ zx_status_t ScanBlocks(const uint8_t* buffer, size_t size,
     if (order > kMaxOrderShift) {
       return ZX_ERR_OUT_OF_RANGE;
     }
-    if (size - offset < OrderToSize(order)) {
+    if (end - offset < OrderToSize(order)) {
       // Block header specifies an order that is too large to fit
       // in the remainder of the buffer.
       return ZX_ERR_OUT_OF_RANGE;
     }
 
     if (!callback(IndexForOffset(offset), block)) {
+      *stop = true;
       return ZX_OK;
     }
     offset += OrderToSize(order);
@@ -36,5 +41,31 @@ zx_status_t ScanBlocks(const uint8_t* buffer, size_t size,
   return ZX_OK;
 }
 
+}  // namespace
+
+zx_status_t ScanBlocks(const uint8_t* buffer, size_t size,
+                       fit::function<bool(BlockIndex, const Block*)> callback) {
+  bool stop = false;
+  return ScanRange(buffer, 0, size, callback, &stop);
+}
+
+zx_status_t ScanBlocks(const uint8_t* buffer, size_t size, const std::vector<BlockRange>& ranges,
+                       fit::function<bool(BlockIndex, const Block*)> callback) {
+  for (const BlockRange& range : ranges) {
+    size_t begin = range.begin * kMinOrderSize;
+    size_t end = std::min<size_t>(range.end * kMinOrderSize, size);
+    if (begin >= end) {
+      break;
+    }
+    bool stop = false;
+    zx_status_t status = ScanRange(buffer, begin, end, callback, &stop);
+    if (status != ZX_OK || stop) {
+      return status;
+    }
+  }
+
+  return ZX_OK;
+}
+
 }  // namespace internal
 }  // namespace inspect
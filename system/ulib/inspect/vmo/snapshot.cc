@@ -12,11 +12,14 @@
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
 
+#include <algorithm>
 #include <cstdint>
 
 using inspect::internal::Block;
 using inspect::internal::BlockIndex;
+using inspect::internal::BlockRange;
 using inspect::internal::IndexForOffset;
+using inspect::internal::kMaxOrderSize;
 using inspect::internal::kMinOrderSize;
 using inspect::internal::kVmoHeaderBlockSize;
 
@@ -151,6 +154,80 @@ zx_status_t Snapshot::Create(const zx::vmo& vmo, Options options, ReadObserver r
   return ZX_ERR_INTERNAL;
 }
 
+zx_status_t Snapshot::CreateDelta(const zx::vmo& vmo, const Snapshot& previous,
+                                  Snapshot* out_snapshot, std::vector<BlockRange>* out_changed) {
+  return Snapshot::CreateDelta(vmo, previous, kDefaultOptions, out_snapshot, out_changed);
+}
+
+zx_status_t Snapshot::CreateDelta(const zx::vmo& vmo, const Snapshot& previous, Options options,
+                                  Snapshot* out_snapshot, std::vector<BlockRange>* out_changed) {
+  return Snapshot::CreateDelta(vmo, previous, options, nullptr, out_snapshot, out_changed);
+}
+
+zx_status_t Snapshot::CreateDelta(const zx::vmo& vmo, const Snapshot& previous, Options options,
+                                  ReadObserver read_observer, Snapshot* out_snapshot,
+                                  std::vector<BlockRange>* out_changed) {
+  ZX_ASSERT(out_snapshot);
+  ZX_ASSERT(out_changed);
+  out_changed->clear();
+
+  // Every write moves the generation count, so if it has not moved since |previous| was taken,
+  // and |previous| was consistent, there is nothing new to copy.
+  uint64_t previous_generation;
+  if (!options.skip_consistency_check && previous &&
+      Snapshot::ParseHeader(previous.data(), &previous_generation) == ZX_OK &&
+      previous_generation % 2 == 0) {
+    uint8_t header[kVmoHeaderBlockSize];
+    zx_status_t status = Snapshot::Read(vmo, kVmoHeaderBlockSize, header);
+    if (status != ZX_OK) {
+      return status;
+    }
+    if (read_observer) {
+      read_observer(header, sizeof(Block));
+    }
+    uint64_t generation;
+    status = Snapshot::ParseHeader(header, &generation);
+    if (status != ZX_OK) {
+      return status;
+    }
+    size_t size;
+    status = DetermineSnapshotSize(vmo, &size);
+    if (status != ZX_OK) {
+      return status;
+    }
+    if (generation == previous_generation && size == previous.size()) {
+      *out_snapshot = previous;
+      return ZX_OK;
+    }
+  }
+
+  Snapshot snapshot;
+  zx_status_t status = Snapshot::Create(vmo, options, std::move(read_observer), &snapshot);
+  if (status != ZX_OK) {
+    return status;
+  }
+
+  // Compare the snapshots a chunk of the largest block size at a time. No block straddles a
+  // multiple of that size, so each range of changed chunks is also a range of whole blocks.
+  for (size_t offset = 0; offset < snapshot.size(); offset += kMaxOrderSize) {
+    size_t length = std::min(kMaxOrderSize, snapshot.size() - offset);
+    if (offset + length <= previous.size() &&
+        memcmp(snapshot.data() + offset, previous.data() + offset, length) == 0) {
+      continue;
+    }
+    BlockIndex begin = IndexForOffset(offset);
+    BlockIndex end = IndexForOffset(offset + length);
+    if (!out_changed->empty() && out_changed->back().end == begin) {
+      out_changed->back().end = end;
+    } else {
+      out_changed->push_back({.begin = begin, .end = end});
+    }
+  }
+
+  *out_snapshot = std::move(snapshot);
+  return ZX_OK;
+}
+
 zx_status_t Snapshot::Read(const zx::vmo& vmo, size_t size, uint8_t* buffer) {
   memset(buffer, 0, size);
   return vmo.read(buffer, 0, size);
@@ -15,11 +15,13 @@
 #include <zircon/errors.h>
 #include <zircon/types.h>
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace inspect {
@@ -31,12 +33,149 @@ namespace {
 struct Freeze_t {
 } Freeze;
 
+// Every writer of the VMO, whether it holds the state's lock or not, is counted in a gate word kept
+// beside the generation count. The first writer in makes the count odd and the last one out makes
+// it even again, so the count stays odd for as long as any value may be half written, however
+// many writers overlap. The low bits of the gate word hold the number of writers in, and these
+// flags are kept in its top bits.
+//
+// Set while the first writer in is making the count odd, or the last one out is making it even.
+// Other writers wait for this to clear, so that none of them writes while the count is even.
+constexpr uint64_t kGateTurning = uint64_t{1} << 63;
+// Set while the VMO is being copied or frozen. Writers that do not hold the state's lock take it
+// instead, as the copy holds the lock until it is done.
+constexpr uint64_t kGateStopped = uint64_t{1} << 62;
+constexpr uint64_t kGateWriters = kGateStopped - 1;
+
+// Counts a writer in, and returns true once the generation count is odd. Each writer moves the
+// count on by two in all, so it still counts updates. Returns false, without counting the writer
+// in, if writers are stopped.
+bool EnterWriters(std::atomic<uint64_t>* gate, uint64_t* generation_count) {
+  uint64_t current = gate->load(std::memory_order_relaxed);
+  while (true) {
+    if (current & kGateStopped) {
+      return false;
+    }
+    if (current & kGateTurning) {
+      current = gate->load(std::memory_order_relaxed);
+      continue;
+    }
+    if (current == 0) {
+      if (gate->compare_exchange_weak(current, kGateTurning, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        __atomic_fetch_add(generation_count, 1, __ATOMIC_ACQ_REL);
+        gate->store(1, std::memory_order_release);
+        break;
+      }
+    } else if (gate->compare_exchange_weak(current, current + 1, std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+      __atomic_fetch_add(generation_count, 2, __ATOMIC_RELAXED);
+      break;
+    }
+  }
+  // Readers that see any of this writer's changes must also see the count odd.
+  std::atomic_thread_fence(std::memory_order_release);
+  return true;
+}
+
+// Counts a writer out, and makes the generation count even again if it was the last one in.
+void LeaveWriters(std::atomic<uint64_t>* gate, uint64_t* generation_count) {
+  uint64_t current = gate->load(std::memory_order_relaxed);
+  while (true) {
+    ZX_DEBUG_ASSERT((current & kGateWriters) != 0);
+    if ((current & kGateWriters) == 1) {
+      // Keep the stopped flag, so that a copy waiting for this writer sees the gate close.
+      const uint64_t stopped = current & kGateStopped;
+      if (gate->compare_exchange_weak(current, stopped | kGateTurning, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+        __atomic_fetch_add(generation_count, 1, __ATOMIC_RELEASE);
+        gate->store(stopped, std::memory_order_release);
+        return;
+      }
+    } else if (gate->compare_exchange_weak(current, current - 1, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+// Stops writers that do not hold the state's lock, and waits for those already in to leave. The
+// caller holds the state's lock, so no other writer is in or can come in.
+void StopWriters(std::atomic<uint64_t>* gate) {
+  // Expecting the turning flag to be clear keeps this from setting the stopped flag while the
+  // last writer out is closing the gate.
+  uint64_t current = gate->load(std::memory_order_relaxed);
+  do {
+    current &= ~kGateTurning;
+  } while (!gate->compare_exchange_weak(current, current | kGateStopped,
+                                        std::memory_order_relaxed, std::memory_order_relaxed));
+  while (gate->load(std::memory_order_acquire) != kGateStopped) {
+    std::this_thread::yield();
+  }
+}
+
+void ResumeWriters(std::atomic<uint64_t>* gate) { gate->store(0, std::memory_order_release); }
+
+// Helper class to support RAII stopping of writers while the VMO is copied.
+class AutoStopWriters final {
+ public:
+  explicit AutoStopWriters(std::atomic<uint64_t>* gate) : gate_(gate) { StopWriters(gate_); }
+  ~AutoStopWriters() { ResumeWriters(gate_); }
+
+  // Disallow copy assign and move.
+  AutoStopWriters(AutoStopWriters&&) = delete;
+  AutoStopWriters(const AutoStopWriters&) = delete;
+  AutoStopWriters& operator=(AutoStopWriters&&) = delete;
+  AutoStopWriters& operator=(const AutoStopWriters&) = delete;
+
+ private:
+  std::atomic<uint64_t>* gate_;
+};
+
+// Numeric values may be updated by several threads at once without holding the state's lock, so
+// their slots are only ever written atomically. Relaxed ordering is enough, as the writer leaving
+// the gate publishes the update to readers.
+template <typename T>
+void AtomicStore(T* slot, T value) {
+  __atomic_store(slot, &value, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+void AtomicApply(T* slot, T value, std::plus<T>) {
+  __atomic_fetch_add(slot, value, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+void AtomicApply(T* slot, T value, std::minus<T>) {
+  __atomic_fetch_sub(slot, value, __ATOMIC_RELAXED);
+}
+
+// There is no atomic add for doubles, so swap in the result until no other update gets in first.
+template <typename Operation>
+void AtomicApplyDouble(double* slot, double value, Operation operation) {
+  double current;
+  __atomic_load(slot, &current, __ATOMIC_RELAXED);
+  double result;
+  do {
+    result = operation(current, value);
+  } while (!__atomic_compare_exchange(slot, &current, &result, /*weak=*/true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED));
+}
+
+inline void AtomicApply(double* slot, double value, std::plus<double> operation) {
+  AtomicApplyDouble(slot, value, operation);
+}
+
+inline void AtomicApply(double* slot, double value, std::minus<double> operation) {
+  AtomicApplyDouble(slot, value, operation);
+}
+
 }  // namespace
 
 // Helper class to support RAII locking of the generation count.
 class AutoGenerationIncrement final {
  public:
-  AutoGenerationIncrement(BlockIndex target, Heap* heap);
+  AutoGenerationIncrement(BlockIndex target, Heap* heap, std::atomic<uint64_t>* writers);
 
   // This version of `AutoGenerationIncrement` puts RAII semantics on freezing a
   // VMO. I.e. it will write kVmoFrozen to the `target_`'s payload at the beginning
@@ -44,7 +183,7 @@ class AutoGenerationIncrement final {
   //
   // This is used over directly writing to the frozen VMO duplicate because
   // we want the duplicate to be read-only.
-  AutoGenerationIncrement(Freeze_t, BlockIndex target, Heap* heap);
+  AutoGenerationIncrement(Freeze_t, BlockIndex target, Heap* heap, std::atomic<uint64_t>* writers);
   ~AutoGenerationIncrement();
 
   // Disallow copy assign and move.
@@ -55,63 +194,86 @@ class AutoGenerationIncrement final {
 
  private:
   // Acquire the generation count lock.
-  // This consists of atomically incrementing the count using
-  // acquire-release ordering, ensuring readers see this increment before
-  // any changes to the buffer.
+  // This consists of counting this writer in at `writers_`, which leaves the
+  // count odd, ensuring readers see the count odd before any changes to the buffer.
   void Acquire(Block* block);
 
-  // Set the generation count to kVmoFrozen.
+  // Stop the writers that do not hold the state's lock, wait for those in the
+  // middle of an update, and set the generation count to kVmoFrozen.
   void Acquire(Freeze_t, Block* block);
 
   // Release the generation count lock.
-  // This consists of either a) atomically incrementing the count using release
-  // ordering, if the VMO was not frozen, or b) resetting the generation count
-  // to last_gen_count_. The memory ordering will ensure readers see this increment
+  // This consists of either a) counting this writer out at `writers_`, which
+  // makes the count even again if no other writer is in, if the VMO was not frozen,
+  // or b) resetting the generation count to last_gen_count_ and letting writers
+  // in again. The memory ordering will ensure readers see this increment
   // after all changes to the buffer are committed.
   void Release(Block* block);
 
   cpp17::optional<uint64_t> last_gen_count_;
   BlockIndex target_;
   Heap* heap_;
+  std::atomic<uint64_t>* writers_;
 };
 
-AutoGenerationIncrement::AutoGenerationIncrement(BlockIndex target, Heap* heap)
-    : target_(target), heap_(heap) {
+AutoGenerationIncrement::AutoGenerationIncrement(BlockIndex target, Heap* heap,
+                                                 std::atomic<uint64_t>* writers)
+    : target_(target), heap_(heap), writers_(writers) {
   Acquire(heap_->GetBlock(target_));
 }
 AutoGenerationIncrement::~AutoGenerationIncrement() { Release(heap_->GetBlock(target_)); }
 
-AutoGenerationIncrement::AutoGenerationIncrement(Freeze_t, BlockIndex target, Heap* heap)
-    : target_(target), heap_(heap) {
+AutoGenerationIncrement::AutoGenerationIncrement(Freeze_t, BlockIndex target, Heap* heap,
+                                                 std::atomic<uint64_t>* writers)
+    : target_(target), heap_(heap), writers_(writers) {
   Acquire(Freeze, heap_->GetBlock(target_));
 }
 
 void AutoGenerationIncrement::Acquire(Freeze_t, Block* block) {
   uint64_t* ptr = &block->payload.u64;
-  last_gen_count_ = block->payload.u64;
-  __atomic_store_n(ptr, kVmoFrozen, __ATOMIC_SEQ_CST);
+  StopWriters(writers_);
+  last_gen_count_ = __atomic_exchange_n(ptr, kVmoFrozen, __ATOMIC_SEQ_CST);
 }
 
 void AutoGenerationIncrement::Acquire(Block* block) {
-  uint64_t* ptr = &block->payload.u64;
-  __atomic_fetch_add(ptr, 1, __ATOMIC_ACQ_REL);
+  // Only writers that do not hold the state's lock are ever stopped.
+  bool entered = EnterWriters(writers_, &block->payload.u64);
+  ZX_DEBUG_ASSERT(entered);
 }
 
 void AutoGenerationIncrement::Release(Block* block) {
   uint64_t* ptr = &block->payload.u64;
   if (last_gen_count_.has_value()) {
     __atomic_store_n(ptr, last_gen_count_.value(), __ATOMIC_SEQ_CST);
+    ResumeWriters(writers_);
   } else {
-    __atomic_fetch_add(ptr, 1, __ATOMIC_RELEASE);
+    LeaveWriters(writers_, ptr);
   }
 }
 
 State::State(std::unique_ptr<Heap> heap, BlockIndex header)
     : heap_(std::move(heap)),
       header_(header),
+      blocks_(reinterpret_cast<uint8_t*>(heap_->GetBlock(0))),
+      generation_count_(&heap_->GetBlock(header)->payload.u64),
       next_unique_id_(0),
       next_unique_link_number_(0),
-      transaction_count_(0) {}
+      transaction_count_(0),
+      writers_(0) {}
+
+template <typename Update>
+void State::UpdateWithoutLock(Update update) {
+  if (EnterWriters(&writers_, generation_count_)) {
+    update();
+    LeaveWriters(&writers_, generation_count_);
+    return;
+  }
+  // The VMO is being copied, which holds |mutex_| until writers may come in again. Wait for that,
+  // and then make this update like any other.
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
+  update();
+}
 
 template <typename WrapperType, BlockType BlockTypeValue>
 WrapperType State::InnerCreateArray(BorrowedStringValue name, BlockIndex parent, size_t slots,
@@ -150,6 +312,26 @@ WrapperType State::InnerCreateArray(BorrowedStringValue name, BlockIndex parent,
 template <typename ValueType, typename WrapperType, BlockType BlockTypeValue>
 void State::InnerSetArray(WrapperType* metric, size_t index_into_array, ValueType value) {
   ZX_ASSERT(metric->state_.get() == this);
+  if (BlockTypeValue != BlockType::kStringReference) {
+    auto* block = GetBlockForUpdate(metric->value_index_);
+    ZX_ASSERT(GetType(block) == BlockType::kArrayValue);
+    auto entry_type = ArrayBlockPayload::EntryType::Get<BlockType>(block->payload.u64);
+    ZX_ASSERT(entry_type == BlockTypeValue);
+    auto* slot = GetArraySlot<ValueType>(block, index_into_array);
+    UpdateWithoutLock([slot, value] {
+      if (slot != nullptr) {
+        AtomicStore(slot, value);
+      }
+    });
+    return;
+  }
+
+  // compile time check that the static_cast used below is legal
+  static_assert(BlockTypeValue == BlockType::kStringReference
+                    ? std::is_same<ValueType, BlockIndex>::value
+                    : true,
+                "Invalid type set in string array");
+
   std::lock_guard<std::mutex> lock(mutex_);
   std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
 
@@ -157,41 +339,51 @@ void State::InnerSetArray(WrapperType* metric, size_t index_into_array, ValueTyp
   ZX_ASSERT(GetType(block) == BlockType::kArrayValue);
   auto entry_type = ArrayBlockPayload::EntryType::Get<BlockType>(block->payload.u64);
   ZX_ASSERT(entry_type == BlockTypeValue);
-  if (BlockTypeValue == BlockType::kStringReference) {
-    // compile time check that the static_cast used below is legal
-    static_assert(BlockTypeValue == BlockType::kStringReference
-                      ? std::is_same<ValueType, BlockIndex>::value
-                      : true,
-                  "Invalid type set in string array");
-    auto current_value = GetArraySlotForString(block, index_into_array);
-    if (current_value.has_value() && *current_value != kEmptyStringSlotIndex) {
-      InnerReleaseStringReference(*current_value);
-    }
-    // static_cast to get rid of incorrect lint errors
-    auto index_of_string_ref_block = static_cast<BlockIndex>(value);
-    SetArraySlotForString(block, index_into_array, index_of_string_ref_block);
-  } else {
-    auto* slot = GetArraySlot<ValueType>(block, index_into_array);
-    if (slot != nullptr) {
-      *slot = value;
-    }
+  auto current_value = GetArraySlotForString(block, index_into_array);
+  if (current_value.has_value() && *current_value != kEmptyStringSlotIndex) {
+    InnerReleaseStringReference(*current_value);
   }
+  // static_cast to get rid of incorrect lint errors
+  auto index_of_string_ref_block = static_cast<BlockIndex>(value);
+  SetArraySlotForString(block, index_into_array, index_of_string_ref_block);
 }
 
 template <typename NumericType, typename WrapperType, BlockType BlockTypeValue, typename Operation>
 void State::InnerOperationArray(WrapperType* metric, size_t index, NumericType value) {
   ZX_ASSERT(metric->state_.get() == this);
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
 
-  auto* block = heap_->GetBlock(metric->value_index_);
+  auto* block = GetBlockForUpdate(metric->value_index_);
   ZX_ASSERT(GetType(block) == BlockType::kArrayValue);
   auto entry_type = ArrayBlockPayload::EntryType::Get<BlockType>(block->payload.u64);
   ZX_ASSERT(entry_type == BlockTypeValue);
   auto* slot = GetArraySlot<NumericType>(block, index);
-  if (slot != nullptr) {
-    *slot = Operation()(*slot, value);
-  }
+  UpdateWithoutLock([slot, value] {
+    if (slot != nullptr) {
+      AtomicApply(slot, value, Operation());
+    }
+  });
+}
+
+template <typename NumericType, typename WrapperType, BlockType BlockTypeValue>
+void State::InnerSetValue(WrapperType* metric, NumericType value) {
+  ZX_ASSERT(metric->state_.get() == this);
+
+  auto* block = GetBlockForUpdate(metric->value_index_);
+  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockTypeValue, "Expected %d metric, got %d",
+                      static_cast<int>(BlockTypeValue), static_cast<int>(GetType(block)));
+  auto* slot = reinterpret_cast<NumericType*>(&block->payload);
+  UpdateWithoutLock([slot, value] { AtomicStore(slot, value); });
+}
+
+template <typename NumericType, typename WrapperType, BlockType BlockTypeValue, typename Operation>
+void State::InnerOperationValue(WrapperType* metric, NumericType value) {
+  ZX_ASSERT(metric->state_.get() == this);
+
+  auto* block = GetBlockForUpdate(metric->value_index_);
+  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockTypeValue, "Expected %d metric, got %d",
+                      static_cast<int>(BlockTypeValue), static_cast<int>(GetType(block)));
+  auto* slot = reinterpret_cast<NumericType*>(&block->payload);
+  UpdateWithoutLock([slot, value] { AtomicApply(slot, value, Operation()); });
 }
 
 template <typename WrapperType>
@@ -302,6 +494,9 @@ bool State::Copy(zx::vmo* vmo) const {
     return false;
   }
 
+  // Numeric values are updated without |mutex_|, so also wait for those in the middle of an update.
+  AutoStopWriters stopped(&writers_);
+
   size_t size = heap_->size();
   if (zx::vmo::create(size, 0, vmo) != ZX_OK) {
     return false;
@@ -321,6 +516,9 @@ bool State::CopyBytes(std::vector<uint8_t>* out) const {
     return false;
   }
 
+  // Numeric values are updated without |mutex_|, so also wait for those in the middle of an update.
+  AutoStopWriters stopped(&writers_);
+
   size_t size = heap_->size();
   if (size == 0) {
     return false;
@@ -545,49 +743,19 @@ Node State::CreateNode(BorrowedStringValue name, BlockIndex parent) {
 }
 
 void State::SetIntProperty(IntProperty* metric, int64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kIntValue, "Expected int metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.i64 = value;
+  InnerSetValue<int64_t, IntProperty, BlockType::kIntValue>(metric, value);
 }
 
 void State::SetUintProperty(UintProperty* metric, uint64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kUintValue, "Expected uint metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.u64 = value;
+  InnerSetValue<uint64_t, UintProperty, BlockType::kUintValue>(metric, value);
 }
 
 void State::SetDoubleProperty(DoubleProperty* metric, double value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kDoubleValue, "Expected double metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.f64 = value;
+  InnerSetValue<double, DoubleProperty, BlockType::kDoubleValue>(metric, value);
 }
 
 void State::SetBoolProperty(BoolProperty* metric, bool value) {
-  ZX_ASSERT(metric->state_.get() == this);
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kBoolValue, "Expected bool metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.u64 = value;
+  InnerSetValue<uint64_t, BoolProperty, BlockType::kBoolValue>(metric, value);
 }
 
 void State::SetIntArray(IntArray* array, size_t index, int64_t value) {
@@ -609,75 +777,33 @@ void State::SetStringArray(StringArray* array, size_t index, BorrowedStringValue
 }
 
 void State::AddIntProperty(IntProperty* metric, int64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kIntValue, "Expected int metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.i64 += value;
+  InnerOperationValue<int64_t, IntProperty, BlockType::kIntValue, std::plus<int64_t>>(metric,
+                                                                                      value);
 }
 
 void State::AddUintProperty(UintProperty* metric, uint64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kUintValue, "Expected uint metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.u64 += value;
+  InnerOperationValue<uint64_t, UintProperty, BlockType::kUintValue, std::plus<uint64_t>>(metric,
+                                                                                          value);
 }
 
 void State::AddDoubleProperty(DoubleProperty* metric, double value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kDoubleValue, "Expected double metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.f64 += value;
+  InnerOperationValue<double, DoubleProperty, BlockType::kDoubleValue, std::plus<double>>(metric,
+                                                                                          value);
 }
 
 void State::SubtractIntProperty(IntProperty* metric, int64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kIntValue, "Expected int metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.i64 -= value;
+  InnerOperationValue<int64_t, IntProperty, BlockType::kIntValue, std::minus<int64_t>>(metric,
+                                                                                       value);
 }
 
 void State::SubtractUintProperty(UintProperty* metric, uint64_t value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kUintValue, "Expected uint metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.u64 -= value;
+  InnerOperationValue<uint64_t, UintProperty, BlockType::kUintValue, std::minus<uint64_t>>(metric,
+                                                                                           value);
 }
 
 void State::SubtractDoubleProperty(DoubleProperty* metric, double value) {
-  ZX_ASSERT(metric->state_.get() == this);
-
-  std::lock_guard<std::mutex> lock(mutex_);
-  std::unique_ptr<AutoGenerationIncrement> gen = MaybeIncrementGeneration();
-
-  auto* block = heap_->GetBlock(metric->value_index_);
-  ZX_DEBUG_ASSERT_MSG(GetType(block) == BlockType::kDoubleValue, "Expected double metric, got %d",
-                      static_cast<int>(GetType(block)));
-  block->payload.f64 -= value;
+  InnerOperationValue<double, DoubleProperty, BlockType::kDoubleValue, std::minus<double>>(metric,
+                                                                                           value);
 }
 
 void State::AddIntArray(IntArray* array, size_t index, int64_t value) {
@@ -782,14 +908,14 @@ std::unique_ptr<AutoGenerationIncrement> State::MaybeIncrementGeneration() {
   if (transaction_count_ > 0) {
     return nullptr;
   }
-  return std::make_unique<AutoGenerationIncrement>(header_, heap_.get());
+  return std::make_unique<AutoGenerationIncrement>(header_, heap_.get(), &writers_);
 }
 
 std::unique_ptr<AutoGenerationIncrement> State::MaybeFreezeAndIncrementGeneration() const {
   if (transaction_count_ > 0) {
     return nullptr;
   }
-  return std::make_unique<AutoGenerationIncrement>(Freeze, header_, heap_.get());
+  return std::make_unique<AutoGenerationIncrement>(Freeze, header_, heap_.get(), &writers_);
 }
 
 void State::FreeIntProperty(IntProperty* metric) {
@@ -1026,7 +1152,7 @@ void State::InnerReadExtents(BlockIndex head_extent, size_t remaining_length,
 void State::BeginTransaction() {
   std::lock_guard<std::mutex> lock(mutex_);
   if (transaction_count_ == 0) {
-    transaction_gen_ = std::make_unique<AutoGenerationIncrement>(header_, heap_.get());
+    transaction_gen_ = std::make_unique<AutoGenerationIncrement>(header_, heap_.get(), &writers_);
   }
   transaction_count_++;
 }
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <zircon/types.h>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -18,6 +19,7 @@
 #include <io-scheduler/scheduler-client.h>
 #include <io-scheduler/stream-op.h>
 #include <io-scheduler/stream.h>
+#include <io-scheduler/work-queue.h>
 #include <io-scheduler/worker.h>
 
 namespace ioscheduler {
@@ -45,10 +47,15 @@ constexpr uint32_t kOptionFullyOutOfOrder =
 
 // Maximum priority for a stream.
 constexpr uint32_t kMaxPriority = 31;
+static_assert(kMaxPriority < kWorkQueuePriorities);
 
 // Suggested default priority for a stream.
 constexpr uint32_t kDefaultPriority = 8;
 
+// Maximum number of ops a worker fetches from a stream before servicing other streams, including
+// ops merged into other ops.
+constexpr uint32_t kMaxOpsPerTurn = 8;
+
 class Scheduler {
  public:
   Scheduler() = default;
@@ -81,8 +88,22 @@ class Scheduler {
   // an error.
   zx_status_t StreamClose(uint32_t id) __TA_EXCLUDES(lock_);
 
+  // Set the deadline and budget of an open stream. By default streams have neither, and are
+  // serviced in priority order only.
+  // Returns:
+  // ZX_OK on success.
+  // ZX_ERR_NOT_FOUND if no stream with |id| is open.
+  // ZX_ERR_INVALID_ARGS if the deadline is not positive.
+  zx_status_t StreamSetParams(uint32_t id, const StreamParams& params) __TA_EXCLUDES(lock_);
+
+  // Get the statistics of an open stream, including the latency histogram of its ops.
+  // Returns:
+  // ZX_OK on success.
+  // ZX_ERR_NOT_FOUND if no stream with |id| is open.
+  zx_status_t StreamGetStats(uint32_t id, StreamStats* out) __TA_EXCLUDES(lock_);
+
   // Begin scheduler service. This creates the worker threads that will invoke
-  // the callbacks in SchedulerCallbacks.
+  // the callbacks in SchedulerCallbacks, one per CPU within fixed limits.
   zx_status_t Serve() __TA_EXCLUDES(lock_);
 
   // End scheduler service. This function blocks until all outstanding ops in
@@ -103,7 +124,15 @@ class Scheduler {
   // --------------------------------
   SchedulerClient* client() { return client_; }
 
-  // Insert a list of ops into the scheduler queue.
+  // Called by a worker before it acquires ops. Returns true if the worker may block in the
+  // client's Acquire() callback, in which case it must call EndBlockingAcquire() once Acquire()
+  // returns. One worker is always kept out of Acquire() so that it can release ops completed by
+  // AsyncComplete() while the others wait for new ops.
+  bool BeginBlockingAcquire();
+  void EndBlockingAcquire();
+
+  // Insert a list of ops into the scheduler queue. The streams the ops are inserted into are
+  // queued for service by the workers without blocking them.
   //
   // Ownership:
   //    Ops are retained by the Scheduler if they were successfully enqueued. They are held until
@@ -113,7 +142,14 @@ class Scheduler {
   // |in_list| and |out_list| may point to the same buffer.
   zx_status_t Enqueue(UniqueOp* in_list, size_t in_count, UniqueOp* out_list, size_t* out_actual);
 
-  // Remove an op from the scheduler queue for execution.
+  // Remove an op from the scheduler queue for execution by the worker |worker_id|.
+  //
+  // Each worker services the next stream in its own queue, see WorkQueue::Pop(), and steals
+  // streams from the other workers' queues when its own is empty. A worker keeps fetching ops from
+  // the same stream until it has fetched kMaxOpsPerTurn ops, the stream has none left or has
+  // spent its budget, and no other worker fetches ops from that stream in the meantime, so ops
+  // are issued in stream order. The ops following a fetched op are offered to the client to be
+  // merged into it, see SchedulerClient::Merge().
   //
   // Ownership:
   //    Ownership of the op is maintained by the scheduler.
@@ -121,8 +157,8 @@ class Scheduler {
   // If no ops are available:
   //      returns ZX_ERR_CANCELED if shutdown has started.
   //      returns ZX_ERR_SHOULD_WAIT if |wait| is false.
-  //      otherwise returns ZX_ERR_SHOULD_WAIT.
-  zx_status_t Dequeue(bool wait, UniqueOp* out) __TA_EXCLUDES(lock_);
+  //      otherwise blocks until ops are available or shutdown has started.
+  zx_status_t Dequeue(uint32_t worker_id, bool wait, UniqueOp* out) __TA_EXCLUDES(lock_);
 
   // Returns ownership of an op to the client.
   // This call is required for all ops that were inserted via Enqueue(), including those fetched
@@ -133,28 +169,51 @@ class Scheduler {
   // Find an open stream by ID.
   zx_status_t FindLocked(uint32_t id, StreamRef* out = nullptr) __TA_REQUIRES(lock_);
 
-  // Insert a single op into a stream.
-  zx_status_t InsertOp(UniqueOp op, UniqueOp* op_err) __TA_EXCLUDES(lock_);
+  // Dispatch state of one worker.
+  struct Dispatch {
+    WorkQueue queue;  // Streams waiting to be serviced by this worker.
+    // The stream the worker is fetching ops from, and the number of ops fetched from it so far.
+    // Only accessed by the worker.
+    StreamRef stream;
+    uint32_t fetched = 0;
+  };
+
+  // Queue |stream| for service, unless it is already queued. |since| is the insertion time of
+  // the oldest op waiting in the stream, from which its deadline is counted.
+  // Returns true if it was queued, in which case the caller should call WakeWorker().
+  bool QueueStream(StreamRef stream, zx_time_t since);
+
+  // Wake a worker blocked in Dequeue(), if there is one.
+  void WakeWorker() __TA_EXCLUDES(lock_);
 
-  // Mark an op as deferred for later completion by a worker thread.
-  // This function is intended to be called by async callbacks.
-  void DeferOp(UniqueOp op) __TA_EXCLUDES(lock_);
+  // Take a stream to service from |worker_id|'s queue, or failing that from another worker's.
+  StreamRef FindStream(uint32_t worker_id);
+
+  // Stop servicing the current stream of |dispatch|, and requeue it if it has more ops.
+  void YieldStream(Dispatch* dispatch);
+
+  // True if any worker's queue holds a stream.
+  bool HasQueuedStreams();
 
   SchedulerClient* client_ = nullptr;  // Client-supplied callback interface.
   uint32_t options_ = 0;               // Ordering options.
 
   fbl::Mutex lock_;
   // Set when shutdown has been called and workers should exit.
-  bool shutdown_initiated_ __TA_GUARDED(lock_) = true;
+  std::atomic<bool> shutdown_initiated_ = true;
 
   // Map of id to stream ref.
   Stream::WAVLTreeSortById all_streams_ __TA_GUARDED(lock_);
 
-  // List of all streams that have ops ready to be issued, in priority order.
-  Stream::ReadyStreamList ready_streams_ __TA_GUARDED(lock_);
+  // Per-worker dispatch state, indexed by worker id.
+  std::unique_ptr<Dispatch[]> dispatch_;
+  uint32_t num_workers_ = 0;
+
+  // Number of workers blocked on ops_available_.
+  std::atomic<uint32_t> idle_workers_ = 0;
 
-  // List of streams that have deferred ops, in fifo order.
-  Stream::DeferredStreamList deferred_streams_ __TA_GUARDED(lock_);
+  // Number of workers that may block in Acquire().
+  std::atomic<uint32_t> blocking_acquirers_ = 0;
 
   // Event notifying waiters that there are ops ready for processing.
   fbl::ConditionVariable ops_available_ __TA_GUARDED(lock_);
@@ -45,6 +45,21 @@ class SchedulerClient {
   virtual zx_status_t Acquire(StreamOp** sop_list, size_t list_count, size_t* actual_count,
                               bool wait) = 0;
 
+  // Merge
+  //   Combine two ops so that both are carried out by issuing the first,
+  // for example by extending a transfer over adjacent blocks. Called just
+  // before |first| is issued, with |second| being the op that follows
+  // |first| and any ops already merged into it in the same stream. Neither
+  // op has been issued.
+  // Args:
+  //   first - op to be issued.
+  //   second - op to merge into |first|.
+  // Returns:
+  //   true if |second| has been merged into |first|. |second| will not be
+  // issued, and is released along with |first|, with the same result.
+  //   false if the ops cannot be merged. This is the default.
+  virtual bool Merge(StreamOp* first, StreamOp* second) { return false; }
+
   // Issue
   //   Deliver an op to the IO hardware for immediate execution. This
   // function may block until the op is completed. If it does not block,
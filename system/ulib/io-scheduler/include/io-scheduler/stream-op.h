@@ -137,7 +137,7 @@ class StreamOp
   using OpList = fbl::TaggedDoublyLinkedList<StreamOp*, OpListTag>;
   using DeferredList = fbl::TaggedDoublyLinkedList<StreamOp*, DeferredListTag>;
 
-  StreamOp() { StreamOp(OpType::kOpTypeUnknown, 0, kOpGroupNone, 0, nullptr); }
+  StreamOp() : StreamOp(OpType::kOpTypeUnknown, 0, kOpGroupNone, 0, nullptr) {}
 
   StreamOp(OpType type, uint32_t stream_id, uint32_t group_id, uint32_t group_members, void* cookie)
       : type_(type),
@@ -146,7 +146,8 @@ class StreamOp
         group_members_(group_members),
         result_(ZX_OK),
         cookie_(cookie),
-        flags_(0) {}
+        flags_(0),
+        cost_(1) {}
 
   DISALLOW_COPY_ASSIGN_AND_MOVE(StreamOp);
 
@@ -172,7 +173,24 @@ class StreamOp
   void set_flags(uint32_t flags) { flags_ = flags; }
   bool is_deferred() { return flags_ & kOpFlagDeferred; }
 
+  // Cost of the op charged against its stream's budget, in units chosen by the client, for
+  // example bytes or blocks. Defaults to 1.
+  uint64_t cost() { return cost_; }
+  void set_cost(uint64_t cost) { cost_ = cost; }
+
+  // The stream holding the op, from when it is inserted into a stream until it is completed.
+  Stream* stream() { return stream_; }
+
+  // Time at which the op was inserted into its stream.
+  zx_time_t enqueue_time() { return enqueue_time_; }
+
+  // First of the ops that the client merged into this one, see SchedulerClient::Merge().
+  StreamOp* merged() { return merged_; }
+
  private:
+  friend class Scheduler;
+  friend class Stream;
+
   OpType type_;             // Type of operation.
   uint32_t stream_id_;      // Stream into which this op is queued.
   uint32_t group_id_;       // Group of operations.
@@ -180,6 +198,13 @@ class StreamOp
   zx_status_t result_;      // Status code of the released operation.
   void* cookie_;            // User-defined per-op cookie.
   uint32_t flags_;
+  uint64_t cost_;           // Cost charged against the stream's budget.
+  Stream* stream_ = nullptr;
+  zx_time_t enqueue_time_ = 0;
+  StreamOp* next_ = nullptr;  // Link in a stream's lock-free intake or completion list.
+  // Ops merged into this one, in stream order, linked through |merge_next_|.
+  StreamOp* merged_ = nullptr;
+  StreamOp* merge_next_ = nullptr;
 };
 
 }  // namespace ioscheduler
@@ -5,8 +5,11 @@
 #ifndef IO_SCHEDULER_STREAM_H_
 #define IO_SCHEDULER_STREAM_H_
 
+#include <zircon/time.h>
 #include <zircon/types.h>
 
+#include <atomic>
+
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
@@ -21,8 +24,37 @@ namespace ioscheduler {
 constexpr uint32_t kStreamFlagIsClosed = (1u << 0);
 constexpr uint32_t kStreamFlagHasDeferred = (1u << 1);
 
+// Length of the periods over which a stream's budget is accounted.
+constexpr zx_duration_t kBudgetPeriod = ZX_MSEC(100);
+
+// Number of buckets in a stream's latency histogram.
+constexpr uint32_t kLatencyBuckets = 24;
+
+// Service parameters of a stream, in addition to its priority.
+struct StreamParams {
+  // How long an op may wait before the stream is serviced ahead of streams of higher priority,
+  // or ZX_TIME_INFINITE if the stream has no deadline.
+  zx_duration_t deadline = ZX_TIME_INFINITE;
+
+  // Total cost of the ops, see StreamOp::cost(), the stream may issue in each kBudgetPeriod.
+  // Once the budget is spent the stream is only serviced when no other stream is waiting, until
+  // the period ends. 0 if the stream has no budget.
+  uint64_t budget = 0;
+};
+
+// Statistics on the ops of a stream.
+struct StreamStats {
+  uint64_t released_ops = 0;  // Ops released to the client.
+  uint64_t merged_ops = 0;    // Ops merged into other ops rather than issued.
+  // Latency histogram of the released ops, from insertion until release. Bucket 0 counts ops
+  // that took less than 1us, bucket N those that took at least 2^(N-1)us but less than 2^Nus,
+  // and the last bucket also counts all slower ops.
+  uint64_t latency[kLatencyBuckets] = {};
+};
+
 class Scheduler;
 class Stream;
+class WorkQueue;
 using StreamRef = fbl::RefPtr<Stream>;
 
 // Tag Types used to manage the different intrusive containers that a Stream can
@@ -30,16 +62,18 @@ using StreamRef = fbl::RefPtr<Stream>;
 namespace internal {
 struct StreamMapTag {};
 struct StreamReadyListTag {};
-struct StreamDeferredListTag {};
+struct StreamDeadlineListTag {};
 }  // namespace internal
 
 // Stream - a logical sequence of ops.
-// The Stream class is not thread safe, streams depend on the scheduler for synchronization.
+// Ops may be inserted into and deferred on a stream from any thread, without locking. Only one
+// thread at a time may fetch ops from a stream; the scheduler guarantees this by queueing each
+// stream at most once, see MarkQueued(). The flags are synchronized by the scheduler's lock.
 class Stream : public fbl::RefCounted<Stream>,
                public fbl::ContainableBaseClasses<
                    fbl::TaggedWAVLTreeContainable<StreamRef, internal::StreamMapTag>,
                    fbl::TaggedDoublyLinkedListable<StreamRef, internal::StreamReadyListTag>,
-                   fbl::TaggedDoublyLinkedListable<StreamRef, internal::StreamDeferredListTag>> {
+                   fbl::TaggedDoublyLinkedListable<Stream*, internal::StreamDeadlineListTag>> {
  public:
   struct KeyTraitsSortById {
     static const uint32_t& GetKey(const Stream& s) { return s.id_; }
@@ -49,11 +83,11 @@ class Stream : public fbl::RefCounted<Stream>,
 
   using MapTag = internal::StreamMapTag;
   using ReadyListTag = internal::StreamReadyListTag;
-  using DeferredListTag = internal::StreamDeferredListTag;
+  using DeadlineListTag = internal::StreamDeadlineListTag;
 
   using WAVLTreeSortById = fbl::TaggedWAVLTree<uint32_t, StreamRef, MapTag, KeyTraitsSortById>;
   using ReadyStreamList = fbl::TaggedDoublyLinkedList<StreamRef, ReadyListTag>;
-  using DeferredStreamList = fbl::TaggedDoublyLinkedList<StreamRef, DeferredListTag>;
+  using DeadlineStreamList = fbl::TaggedDoublyLinkedList<Stream*, DeadlineListTag>;
 
   Stream() = delete;
   Stream(uint32_t id, uint32_t pri);
@@ -68,9 +102,54 @@ class Stream : public fbl::RefCounted<Stream>,
   inline void set_flags(uint32_t flags) { flags_ |= flags; }
   inline void clear_flags(uint32_t flags) { flags_ &= ~flags; }
 
-  inline bool IsEmpty() { return ready_ops_.is_empty() && issued_ops_.is_empty(); }
-  inline bool HasReady() { return !ready_ops_.is_empty(); }
-  inline bool HasDefered() { return !deferred_ops_.is_empty(); }
+  // True if every op inserted into the stream has been completed.
+  inline bool IsEmpty() { return pending_ops_.load() == 0; }
+  // These may only be called by the thread fetching ops from the stream.
+  inline bool HasReady() { return !ready_ops_.is_empty() || (intake_.load() != nullptr); }
+  inline bool HasDefered() { return !deferred_ops_.is_empty() || (completions_.load() != nullptr); }
+
+  // True if ops have been inserted or deferred but not yet moved to the lists that are only
+  // accessed by the thread fetching ops. Safe to call from any thread. The loads, like the
+  // accesses to the queued flag, must stay seq_cst; see PushOp().
+  inline bool HasIncoming() {
+    return (intake_.load() != nullptr) || (completions_.load() != nullptr);
+  }
+
+  // Mark the stream as queued for service. Returns true if it was not already queued, in which
+  // case the caller must queue it.
+  inline bool MarkQueued() { return !queued_.exchange(true); }
+  // Mark the stream as no longer queued, after which ops may no longer be fetched from it until
+  // it is queued again.
+  inline void ClearQueued() { queued_.store(false); }
+
+  // Set the service parameters. Safe to call from any thread, and takes effect the next time the
+  // stream is queued.
+  void SetParams(const StreamParams& params);
+  StreamParams params();
+
+  // Set the deadline of the stream, given that its oldest op waiting to be fetched was inserted
+  // at |since|. May only be called by the thread that is about to queue the stream.
+  void SetDeadline(zx_time_t since);
+
+  // Insertion time of the op that would be fetched next. Ops whose completion has been deferred
+  // are fetched first. May only be called by the thread fetching ops from the stream.
+  zx_time_t HeadTime();
+
+  // Charge the cost of fetched ops against the budget. Returns false if this spent the budget for
+  // the current period, after which the stream should yield to other streams. May only be called
+  // by the thread fetching ops from the stream.
+  bool Charge(uint64_t cost);
+
+  // Offer the ops following |op| to the client for merging into it, and take those that are
+  // merged, up to |max_ops|. Returns the number of ops merged. May only be called by the thread
+  // fetching ops from the stream.
+  uint32_t Merge(StreamOp* op, SchedulerClient* client, uint32_t max_ops);
+
+  // Record the release of an op that was inserted |latency| ago. Safe to call from any thread.
+  void RecordRelease(zx_duration_t latency);
+
+  // Copy the statistics of the stream to |out|.
+  void GetStats(StreamStats* out);
 
   // Close a stream.
   // Returns:
@@ -79,9 +158,10 @@ class Stream : public fbl::RefCounted<Stream>,
   //       or the shutdown routine.
   zx_status_t Close();
 
-  // Insert an op into the tail of the stream (subject to reordering).
+  // Insert an op into the tail of the stream (subject to reordering), recording |now| as its
+  // insertion time.
   // On error op's error status is set and it is moved to |*op_err|.
-  zx_status_t Insert(UniqueOp op, UniqueOp* op_err);
+  zx_status_t Insert(UniqueOp op, UniqueOp* op_err, zx_time_t now = 0);
 
   // Fetch a pointer to an op from the head of the stream.
   // The stream maintains ownership of the op. All fetched op must be returned via ReleaseOp().
@@ -94,19 +174,51 @@ class Stream : public fbl::RefCounted<Stream>,
   void GetDeferred(UniqueOp* op_out);
 
   // Marks an op obtained via GetNext() or GetDeferred() as complete.
-  // Op is not consumed.
-  void Complete(StreamOp* op);
+  // Op is not consumed. Returns true if it was the last op in the stream.
+  bool Complete(StreamOp* op);
 
  private:
   friend struct KeyTraitsSortById;
+  friend class WorkQueue;
+
+  static void PushOp(std::atomic<StreamOp*>* list, StreamOp* op);
+
+  // Move newly inserted and deferred ops to the lists accessed by the fetching thread.
+  void TakeIntake();
+  void TakeCompletions();
 
   uint32_t id_;
   uint32_t priority_;
 
   uint32_t flags_ = 0;
+  std::atomic<bool> queued_ = false;
+  std::atomic<uint32_t> pending_ops_ = 0;  // Ops inserted but not yet completed.
+
+  // Ops inserted and deferred since ops were last fetched, most recent first.
+  std::atomic<StreamOp*> intake_ = nullptr;
+  std::atomic<StreamOp*> completions_ = nullptr;
+
   StreamOp::OpList ready_ops_;           // Ops ready to be issued.
-  StreamOp::OpList issued_ops_;          // Issued ops pending completion.
   StreamOp::DeferredList deferred_ops_;  // Ops whose completion has been deferred.
+
+  Stream* queue_next_ = nullptr;  // Link in a WorkQueue's lock-free inbox.
+
+  // Service parameters.
+  std::atomic<zx_duration_t> deadline_ = ZX_TIME_INFINITE;
+  std::atomic<uint64_t> budget_ = 0;
+
+  // Dispatch state, owned by the thread queueing or fetching ops from the stream. The WorkQueue
+  // services the stream ahead of its priority from |deadline_time_|, and behind all other streams
+  // until |throttled_until_|.
+  zx_time_t deadline_time_ = ZX_TIME_INFINITE;
+  zx_time_t throttled_until_ = 0;
+  zx_time_t period_start_ = 0;  // Start of the current budget period.
+  uint64_t period_cost_ = 0;    // Cost of the ops fetched in the current period.
+
+  // Statistics.
+  std::atomic<uint64_t> released_ops_ = 0;
+  std::atomic<uint64_t> merged_ops_ = 0;
+  std::atomic<uint64_t> latency_[kLatencyBuckets] = {};
 };
 
 }  // namespace ioscheduler
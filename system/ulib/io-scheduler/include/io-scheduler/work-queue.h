@@ -0,0 +1,76 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef IO_SCHEDULER_WORK_QUEUE_H_
+#define IO_SCHEDULER_WORK_QUEUE_H_
+
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+#include <atomic>
+
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <io-scheduler/stream.h>
+
+namespace ioscheduler {
+
+// Number of distinct stream priorities, from 0 to kMaxPriority.
+constexpr uint32_t kWorkQueuePriorities = 32;
+
+// WorkQueue - the streams waiting to be serviced by one worker.
+// Any thread may push a stream without taking a lock. Streams are popped in priority order by the
+// owning worker, or stolen by other workers that have run out of streams of their own.
+//
+// Priority order is overridden in two cases, so that a busy stream of high priority cannot starve
+// the others. Streams whose deadline has passed are popped first, and streams that have spent
+// their budget for the current period are only popped when no other stream is waiting.
+class WorkQueue {
+ public:
+  WorkQueue() = default;
+  ~WorkQueue();
+  DISALLOW_COPY_ASSIGN_AND_MOVE(WorkQueue);
+
+  // Add a stream to the queue. The stream must have been marked as queued by the caller.
+  void Push(StreamRef stream);
+
+  // Remove the next stream to service from the queue: the stream whose deadline passed first, or
+  // else the highest priority stream that is not throttled, or else the throttled stream pushed
+  // first. Streams of equal priority are popped in the order they were pushed. Returns nullptr if
+  // the queue is empty.
+  StreamRef Pop() __TA_EXCLUDES(lock_);
+
+  // Number of streams in the queue. May be stale by the time it is returned.
+  uint32_t size() { return size_.load(); }
+
+ private:
+  // Move streams from the inbox into the priority lists.
+  void DrainInboxLocked() __TA_REQUIRES(lock_);
+
+  // Add |stream| to the tail of its priority list, or remove it from there.
+  void InsertReadyLocked(StreamRef stream) __TA_REQUIRES(lock_);
+  StreamRef RemoveReadyLocked(Stream* stream) __TA_REQUIRES(lock_);
+
+  // Return throttled streams whose budget has been replenished to their priority lists, and pop
+  // the stream whose deadline passed first, if any.
+  StreamRef PopExpiredLocked() __TA_REQUIRES(lock_);
+
+  std::atomic<uint32_t> size_ = 0;
+
+  // Streams pushed since the last Pop(), most recent first.
+  std::atomic<Stream*> inbox_ = nullptr;
+
+  fbl::Mutex lock_;
+  // Bit N is set if ready_[N] is not empty.
+  uint32_t ready_mask_ __TA_GUARDED(lock_) = 0;
+  Stream::ReadyStreamList ready_[kWorkQueuePriorities] __TA_GUARDED(lock_);
+  // The streams in the priority lists that have a deadline.
+  Stream::DeadlineStreamList deadlines_ __TA_GUARDED(lock_);
+  // Streams that have spent their budget, in the order they were pushed.
+  Stream::ReadyStreamList throttled_ __TA_GUARDED(lock_);
+};
+
+}  // namespace ioscheduler
+
+#endif  // IO_SCHEDULER_WORK_QUEUE_H_
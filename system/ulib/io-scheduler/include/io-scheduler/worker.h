@@ -31,8 +31,8 @@ class Worker {
 
   static int ThreadEntry(void* arg);
   void WorkerLoop();   // Main worker loop.
-  void DoAcquire();    // Acquire new ops.
-  void ExecuteLoop();  // Issue available ops.
+  bool DoAcquire();             // Acquire new ops. Returns true if any were acquired.
+  void ExecuteLoop(bool wait);  // Issue available ops, first waiting for some if |wait|.
 
   Scheduler* sched_ = nullptr;
   uint32_t id_;
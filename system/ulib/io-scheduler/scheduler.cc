@@ -3,7 +3,9 @@
 // found in the LICENSE file.
 
 #include <stdio.h>
+#include <zircon/syscalls.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <fbl/auto_lock.h>
@@ -11,11 +13,19 @@
 
 namespace ioscheduler {
 
+namespace {
+
+// Bounds on the number of worker threads. There must be at least two, so that one can service
+// the queues while the other blocks in Acquire().
+constexpr uint32_t kMinWorkers = 2;
+constexpr uint32_t kMaxWorkers = 8;
+
+}  // namespace
+
 Scheduler::~Scheduler() {
   Shutdown();
   ZX_DEBUG_ASSERT(all_streams_.is_empty());
-  ZX_DEBUG_ASSERT(ready_streams_.is_empty());
-  ZX_DEBUG_ASSERT(deferred_streams_.is_empty());
+  ZX_DEBUG_ASSERT(dispatch_ == nullptr);
   ZX_DEBUG_ASSERT(workers_.is_empty());
 }
 
@@ -51,6 +61,10 @@ void Scheduler::Shutdown() {
   // Block until all worker threads exit.
   workers_.reset();
 
+  // Drop the streams that are still queued.
+  dispatch_.reset();
+  num_workers_ = 0;
+
   {
     fbl::AutoLock lock(&lock_);
     // Delete any existing stream in the case where no worker threads were launched.
@@ -98,13 +112,45 @@ zx_status_t Scheduler::StreamClose(uint32_t id) {
   return ZX_OK;
 }
 
+zx_status_t Scheduler::StreamSetParams(uint32_t id, const StreamParams& params) {
+  if (params.deadline <= 0) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+  fbl::AutoLock lock(&lock_);
+  StreamRef stream;
+  zx_status_t status = FindLocked(id, &stream);
+  if (status != ZX_OK) {
+    return status;
+  }
+  stream->SetParams(params);
+  return ZX_OK;
+}
+
+zx_status_t Scheduler::StreamGetStats(uint32_t id, StreamStats* out) {
+  fbl::AutoLock lock(&lock_);
+  StreamRef stream;
+  zx_status_t status = FindLocked(id, &stream);
+  if (status != ZX_OK) {
+    return status;
+  }
+  stream->GetStats(out);
+  return ZX_OK;
+}
+
 zx_status_t Scheduler::Serve() {
   if (client_ == nullptr) {
     return ZX_ERR_BAD_STATE;
   }
 
-  // Create a single thread for now.
-  const uint32_t num_workers = 1;
+  const uint32_t num_workers = std::clamp(zx_system_get_num_cpus(), kMinWorkers, kMaxWorkers);
+
+  // All queues must exist before the first worker starts, since any worker may steal from them.
+  fbl::AllocChecker ac;
+  dispatch_.reset(new (&ac) Dispatch[num_workers]);
+  if (!ac.check()) {
+    return ZX_ERR_NO_MEMORY;
+  }
+  num_workers_ = num_workers;
 
   for (uint32_t i = 0; i < num_workers; i++) {
     std::unique_ptr<Worker> worker;
@@ -119,72 +165,94 @@ zx_status_t Scheduler::Serve() {
   return ZX_OK;
 }
 
-void Scheduler::AsyncComplete(StreamOp* sop) { DeferOp(UniqueOp(sop)); }
-
-zx_status_t Scheduler::InsertOp(UniqueOp op, UniqueOp* op_err) {
-  fbl::AutoLock lock(&lock_);
-  StreamRef stream;
-  zx_status_t status = FindLocked(op->stream_id(), &stream);
-  if (status != ZX_OK) {
-    op->set_result(ZX_ERR_INVALID_ARGS);
-    *op_err = std::move(op);
-    return status;
-  }
-  bool was_ready = stream->HasReady();
-  status = stream->Insert(std::move(op), op_err);
-  if (status != ZX_OK) {
-    // Insertion failed. Op result is set by Insert().
-    return status;
+void Scheduler::AsyncComplete(StreamOp* sop) {
+  ZX_DEBUG_ASSERT(!sop->is_deferred());
+  // The stream is kept alive by the op until the op is released.
+  StreamRef stream(sop->stream());
+  if (stream == nullptr) {
+    fprintf(stderr, "Scheduler: Deferring op with invalid stream id\n");
+    client_->Fatal();
+    return;
   }
-  if (!was_ready) {
-    ready_streams_.push_back(std::move(stream));
+  zx_time_t since = sop->enqueue_time();
+  stream->Defer(UniqueOp(sop));
+  if (QueueStream(std::move(stream), since)) {
+    WakeWorker();
   }
-  ops_available_.Signal();
-  return ZX_OK;
 }
 
 // Enqueue - file a list of ops into their respective streams and schedule those streams.
 zx_status_t Scheduler::Enqueue(UniqueOp* in_list, size_t in_count, UniqueOp* out_list,
                                size_t* out_actual) {
   size_t out_num = 0;
-  for (size_t i = 0; i < in_count; i++) {
-    UniqueOp op = std::move(in_list[i]);
-    // Initialize op fields modified by scheduler.
-    op->set_result(ZX_OK);
-    zx_status_t status = InsertOp(std::move(op), &out_list[out_num]);
-    if (status != ZX_OK) {
-      // Op was added to out_list with an error result.
-      out_num++;
+  bool queued = false;
+  zx_time_t now = zx_clock_get_monotonic();
+  {
+    // Streams cannot be opened or closed while the batch is being inserted.
+    fbl::AutoLock lock(&lock_);
+    StreamRef stream;
+    for (size_t i = 0; i < in_count; i++) {
+      UniqueOp op = std::move(in_list[i]);
+      // Initialize op fields modified by scheduler.
+      op->set_result(ZX_OK);
+      // Consecutive ops usually belong to the same stream.
+      if ((stream == nullptr) || (stream->id() != op->stream_id())) {
+        stream.reset();
+        if (FindLocked(op->stream_id(), &stream) != ZX_OK) {
+          op->set_result(ZX_ERR_INVALID_ARGS);
+          out_list[out_num++] = std::move(op);
+          continue;
+        }
+      }
+      if (stream->Insert(std::move(op), &out_list[out_num], now) != ZX_OK) {
+        // Op was added to out_list with an error result.
+        out_num++;
+        continue;
+      }
+      queued |= QueueStream(stream, now);
     }
   }
+  if (queued) {
+    WakeWorker();
+  }
   *out_actual = out_num;
   return ZX_OK;
 }
 
-zx_status_t Scheduler::Dequeue(bool wait, UniqueOp* out) {
-    fbl::AutoLock lock(&lock_);
+zx_status_t Scheduler::Dequeue(uint32_t worker_id, bool wait, UniqueOp* out) {
+  ZX_DEBUG_ASSERT(worker_id < num_workers_);
+  Dispatch* dispatch = &dispatch_[worker_id];
   for (;;) {
-    StreamRef stream = deferred_streams_.pop_front();
-    if (stream != nullptr) {
-      stream->GetDeferred(out);
-      ZX_DEBUG_ASSERT(*out != nullptr);
-      // Temporary relisting on the deferred stream until deferred list can hold multiple entries
-      // per stream.
-      if (stream->HasDefered()) {
-        deferred_streams_.push_back(std::move(stream));
-      }
-      return ZX_OK;
+    if (dispatch->stream == nullptr) {
+      dispatch->stream = FindStream(worker_id);
+      dispatch->fetched = 0;
     }
 
-    stream = ready_streams_.pop_front();
+    StreamRef& stream = dispatch->stream;
     if (stream != nullptr) {
-      stream->GetNext(out);
-      ZX_DEBUG_ASSERT(*out != nullptr);
-      if (stream->HasReady()) {
-        // Stream has more ops, return to tail of ready stream queue.
-        ready_streams_.push_back(std::move(stream));
+      // Release completed ops before issuing more.
+      if (stream->HasDefered()) {
+        stream->GetDeferred(out);
+        ZX_DEBUG_ASSERT(*out != nullptr);
+        return ZX_OK;
+      }
+      if (stream->HasReady() && (dispatch->fetched < kMaxOpsPerTurn)) {
+        stream->GetNext(out);
+        ZX_DEBUG_ASSERT(*out != nullptr);
+        StreamOp* op = out->get();
+        dispatch->fetched += 1 + stream->Merge(op, client_, kMaxOpsPerTurn - dispatch->fetched - 1);
+        uint64_t cost = op->cost();
+        for (StreamOp* merged = op->merged(); merged != nullptr; merged = merged->merge_next_) {
+          cost += merged->cost();
+        }
+        if (!stream->Charge(cost)) {
+          // The budget is spent. Let other streams go first.
+          dispatch->fetched = kMaxOpsPerTurn;
+        }
+        return ZX_OK;
       }
-      return ZX_OK;
+      YieldStream(dispatch);
+      continue;
     }
 
     // No more ops available.
@@ -194,53 +262,118 @@ zx_status_t Scheduler::Dequeue(bool wait, UniqueOp* out) {
     if (!wait) {
       return ZX_ERR_SHOULD_WAIT;
     }
-    ops_available_.Wait(&lock_);
+    fbl::AutoLock lock(&lock_);
+    // Announce this worker as idle before checking the queues, so that a stream queued after the
+    // check is guaranteed to wake it.
+    idle_workers_.fetch_add(1);
+    if (!shutdown_initiated_ && !HasQueuedStreams()) {
+      ops_available_.Wait(&lock_);
+    }
+    idle_workers_.fetch_sub(1);
   }
 }
 
-void Scheduler::DeferOp(UniqueOp op) {
-  ZX_DEBUG_ASSERT((op->is_deferred()) == 0);
-  fbl::AutoLock lock(&lock_);
-  StreamRef stream;
-  zx_status_t status = FindLocked(op->stream_id(), &stream);
-  ZX_DEBUG_ASSERT(status == ZX_OK);
+void Scheduler::ReleaseOp(UniqueOp op) {
+  Stream* stream = op->stream();
   if (stream == nullptr) {
-      fprintf(stderr, "Scheduler: Deferring op with invalid stream id\n");
-      client_->Fatal();
-      return;
+    fprintf(stderr, "Scheduler: Releasing op with invalid stream id\n");
+    client_->Fatal();
+    return;
+  }
+  // The stream may be deleted once its last op is complete.
+  uint32_t sid = stream->id();
+  zx_time_t now = zx_clock_get_monotonic();
+  StreamOp* merged = op->merged_;
+  op->merged_ = nullptr;
+  stream->RecordRelease(now - op->enqueue_time());
+  bool stream_done = stream->Complete(op.get());
+  zx_status_t result = op->result();
+  client_->Release(op.release());
+
+  // Ops merged into this one share its result.
+  while (merged != nullptr) {
+    StreamOp* next = merged->merge_next_;
+    merged->merge_next_ = nullptr;
+    merged->set_result(result);
+    stream->RecordRelease(now - merged->enqueue_time());
+    stream_done |= stream->Complete(merged);
+    client_->Release(merged);
+    merged = next;
+  }
+
+  if (stream_done) {
+    fbl::AutoLock lock(&lock_);
+    StreamRef closed;
+    if ((FindLocked(sid, &closed) == ZX_OK) && closed->is_closed() && closed->IsEmpty()) {
+      all_streams_.erase(sid);
+    }
+  }
+}
+
+bool Scheduler::BeginBlockingAcquire() {
+  uint32_t acquirers = blocking_acquirers_.load();
+  do {
+    if (acquirers + 1 >= num_workers_) {
+      return false;
+    }
+  } while (!blocking_acquirers_.compare_exchange_weak(acquirers, acquirers + 1));
+  return true;
+}
+
+void Scheduler::EndBlockingAcquire() { blocking_acquirers_.fetch_sub(1); }
+
+bool Scheduler::QueueStream(StreamRef stream, zx_time_t since) {
+  if (!stream->MarkQueued()) {
+    return false;  // Already queued or being serviced.
   }
-  bool was_deferred = stream->HasDefered();
-  stream->Defer(std::move(op));
-  if (!was_deferred) {
-    deferred_streams_.push_back(std::move(stream));
+  stream->SetDeadline(since);
+  // Streams always start out on the same worker's queue, which keeps their ops on one thread
+  // unless that worker falls behind and others steal from it.
+  dispatch_[stream->id() % num_workers_].queue.Push(std::move(stream));
+  return true;
+}
+
+void Scheduler::WakeWorker() {
+  if (idle_workers_.load() == 0) {
+    return;
   }
+  fbl::AutoLock lock(&lock_);
   ops_available_.Signal();
 }
 
-void Scheduler::ReleaseOp(UniqueOp op) {
-  bool stream_done = false;
-  uint32_t sid;
-  {
-    fbl::AutoLock lock(&lock_);
-    StreamRef stream;
-    sid = op->stream_id();
-    zx_status_t status = FindLocked(sid, &stream);
-    ZX_DEBUG_ASSERT(status == ZX_OK);
-    if (stream == nullptr) {
-      fprintf(stderr, "Scheduler: Releasing op with invalid stream id\n");
-      client_->Fatal();
-      return;
+StreamRef Scheduler::FindStream(uint32_t worker_id) {
+  for (uint32_t i = 0; i < num_workers_; i++) {
+    StreamRef stream = dispatch_[(worker_id + i) % num_workers_].queue.Pop();
+    if (stream != nullptr) {
+      return stream;
     }
-    stream->Complete(op.get());
-    stream_done = stream->is_closed() && stream->IsEmpty();
   }
+  return nullptr;
+}
 
-  client_->Release(op.release());
+void Scheduler::YieldStream(Dispatch* dispatch) {
+  StreamRef stream = std::move(dispatch->stream);
+  if (stream->HasReady() || stream->HasDefered()) {
+    // Return to the tail of this worker's queue so that streams of the same priority take turns.
+    stream->SetDeadline(stream->HeadTime());
+    dispatch->queue.Push(std::move(stream));
+    return;
+  }
+  stream->ClearQueued();
+  // Ops may have been inserted or deferred after the check above, in which case the thread that
+  // did so saw the stream as queued and did not queue it.
+  if (stream->HasIncoming() && QueueStream(stream, zx_clock_get_monotonic())) {
+    WakeWorker();
+  }
+}
 
-  if (stream_done) {
-    fbl::AutoLock lock(&lock_);
-    all_streams_.erase(sid);
+bool Scheduler::HasQueuedStreams() {
+  for (uint32_t i = 0; i < num_workers_; i++) {
+    if (dispatch_[i].queue.size() != 0) {
+      return true;
+    }
   }
+  return false;
 }
 
 zx_status_t Scheduler::FindLocked(uint32_t id, StreamRef* out) {
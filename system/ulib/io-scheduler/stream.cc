@@ -2,18 +2,51 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <zircon/syscalls.h>
+
+#include <algorithm>
+
 #include <fbl/auto_lock.h>
 #include <io-scheduler/io-scheduler.h>
 #include <io-scheduler/stream.h>
 
 namespace ioscheduler {
 
+namespace {
+
+// Index of the latency histogram bucket that counts ops released |latency| after insertion.
+uint32_t LatencyBucket(zx_duration_t latency) {
+  uint64_t us = (latency > 0) ? static_cast<uint64_t>(latency / ZX_USEC(1)) : 0;
+  if (us == 0) {
+    return 0;
+  }
+  return std::min(64u - static_cast<uint32_t>(__builtin_clzll(us)), kLatencyBuckets - 1);
+}
+
+}  // namespace
+
+// Push |op| onto the head of a lock-free list.
+//
+// The push is sequentially consistent. The pushing thread then calls MarkQueued(), while a worker
+// giving up the stream calls ClearQueued() and then HasIncoming(). Only if all four accesses are
+// seq_cst is at least one of the two threads guaranteed to see the other's write, so that the op
+// is never left in a stream that nobody queues.
+void Stream::PushOp(std::atomic<StreamOp*>* list, StreamOp* op) {
+  StreamOp* head = list->load(std::memory_order_relaxed);
+  do {
+    op->next_ = head;
+  } while (!list->compare_exchange_weak(head, op, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed));
+}
+
 Stream::Stream(uint32_t id, uint32_t pri) : id_(id), priority_(pri) {}
 
 Stream::~Stream() {
   ZX_DEBUG_ASSERT(is_closed());
+  ZX_DEBUG_ASSERT(IsEmpty());
+  ZX_DEBUG_ASSERT(intake_.load() == nullptr);
+  ZX_DEBUG_ASSERT(completions_.load() == nullptr);
   ZX_DEBUG_ASSERT(ready_ops_.is_empty());
-  ZX_DEBUG_ASSERT(issued_ops_.is_empty());
   ZX_DEBUG_ASSERT(deferred_ops_.is_empty());
 }
 
@@ -25,43 +58,165 @@ zx_status_t Stream::Close() {
   return ZX_ERR_SHOULD_WAIT;
 }
 
-zx_status_t Stream::Insert(UniqueOp op, UniqueOp* op_err) {
+zx_status_t Stream::Insert(UniqueOp op, UniqueOp* op_err, zx_time_t now) {
   ZX_DEBUG_ASSERT(op != nullptr);
   if (is_closed()) {
     op->set_result(ZX_ERR_BAD_STATE);
     *op_err = std::move(op);
     return ZX_ERR_BAD_STATE;
   }
-  ready_ops_.push_back(op.release());
+  pending_ops_.fetch_add(1);
+  op->stream_ = this;
+  op->enqueue_time_ = now;
+  PushOp(&intake_, op.release());
   return ZX_OK;
 }
 
+void Stream::TakeIntake() {
+  // The intake holds the most recent op first. Reverse it onto the ready list.
+  StreamOp* op = intake_.exchange(nullptr, std::memory_order_acquire);
+  for (; op != nullptr; op = op->next_) {
+    ready_ops_.push_front(op);
+  }
+}
+
+void Stream::TakeCompletions() {
+  StreamOp* op = completions_.exchange(nullptr, std::memory_order_acquire);
+  for (; op != nullptr; op = op->next_) {
+    deferred_ops_.push_front(op);
+  }
+}
+
 void Stream::GetNext(UniqueOp* op_out) {
   ZX_DEBUG_ASSERT(!IsEmpty());
   ZX_DEBUG_ASSERT(HasReady());
+  if (ready_ops_.is_empty()) {
+    TakeIntake();
+  }
   UniqueOp op(ready_ops_.pop_front());
   ZX_DEBUG_ASSERT(op != nullptr);
-  issued_ops_.push_back(op.get());  // Add to issued list.
   *op_out = std::move(op);
 }
 
+uint32_t Stream::Merge(StreamOp* op, SchedulerClient* client, uint32_t max_ops) {
+  ZX_DEBUG_ASSERT(op->merged_ == nullptr);
+  StreamOp* tail = nullptr;
+  uint32_t merged = 0;
+  while (merged < max_ops) {
+    if (ready_ops_.is_empty()) {
+      TakeIntake();
+      if (ready_ops_.is_empty()) {
+        break;
+      }
+    }
+    StreamOp* next = &ready_ops_.front();
+    if (!client->Merge(op, next)) {
+      break;
+    }
+    ready_ops_.pop_front();
+    if (tail == nullptr) {
+      op->merged_ = next;
+    } else {
+      tail->merge_next_ = next;
+    }
+    tail = next;
+    merged++;
+  }
+  if (merged != 0) {
+    merged_ops_.fetch_add(merged, std::memory_order_relaxed);
+  }
+  return merged;
+}
+
 void Stream::Defer(UniqueOp op) {
   ZX_DEBUG_ASSERT(!IsEmpty());
   ZX_DEBUG_ASSERT(op != nullptr);
   ZX_DEBUG_ASSERT(op->stream_id() == id_);
   op->set_flags(kOpFlagDeferred);
-  deferred_ops_.push_back(op.release());
+  PushOp(&completions_, op.release());
 }
 
 void Stream::GetDeferred(UniqueOp* op_out) {
-  ZX_DEBUG_ASSERT(!deferred_ops_.is_empty());
+  ZX_DEBUG_ASSERT(HasDefered());
+  if (deferred_ops_.is_empty()) {
+    TakeCompletions();
+  }
   *op_out = UniqueOp(deferred_ops_.pop_front());
 }
 
-void Stream::Complete(StreamOp* op) {
+bool Stream::Complete(StreamOp* op) {
   ZX_DEBUG_ASSERT(!IsEmpty());
   ZX_DEBUG_ASSERT(op->stream_id() == id_);
-  issued_ops_.erase(*op);
+  op->stream_ = nullptr;
+  return pending_ops_.fetch_sub(1) == 1;
+}
+
+void Stream::SetParams(const StreamParams& params) {
+  deadline_.store(params.deadline, std::memory_order_relaxed);
+  budget_.store(params.budget, std::memory_order_relaxed);
+}
+
+StreamParams Stream::params() {
+  StreamParams params;
+  params.deadline = deadline_.load(std::memory_order_relaxed);
+  params.budget = budget_.load(std::memory_order_relaxed);
+  return params;
+}
+
+void Stream::SetDeadline(zx_time_t since) {
+  deadline_time_ = zx_time_add_duration(since, deadline_.load(std::memory_order_relaxed));
+}
+
+zx_time_t Stream::HeadTime() {
+  if (deferred_ops_.is_empty()) {
+    TakeCompletions();
+  }
+  if (!deferred_ops_.is_empty()) {
+    return deferred_ops_.front().enqueue_time_;
+  }
+  if (ready_ops_.is_empty()) {
+    TakeIntake();
+  }
+  if (!ready_ops_.is_empty()) {
+    return ready_ops_.front().enqueue_time_;
+  }
+  return ZX_TIME_INFINITE;
+}
+
+bool Stream::Charge(uint64_t cost) {
+  uint64_t budget = budget_.load(std::memory_order_relaxed);
+  if (budget == 0) {
+    throttled_until_ = 0;
+    return true;
+  }
+  zx_time_t now = zx_clock_get_monotonic();
+  if (now >= zx_time_add_duration(period_start_, kBudgetPeriod)) {
+    period_start_ = now;
+    period_cost_ = 0;
+    throttled_until_ = 0;
+  }
+  // Only report the budget as spent once per period, so that a stream serviced while throttled
+  // is given a full turn.
+  bool had_budget = period_cost_ < budget;
+  period_cost_ += cost;
+  if (had_budget && (period_cost_ >= budget)) {
+    throttled_until_ = zx_time_add_duration(period_start_, kBudgetPeriod);
+    return false;
+  }
+  return true;
+}
+
+void Stream::RecordRelease(zx_duration_t latency) {
+  released_ops_.fetch_add(1, std::memory_order_relaxed);
+  latency_[LatencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stream::GetStats(StreamStats* out) {
+  out->released_ops = released_ops_.load(std::memory_order_relaxed);
+  out->merged_ops = merged_ops_.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < kLatencyBuckets; i++) {
+    out->latency[i] = latency_[i].load(std::memory_order_relaxed);
+  }
 }
 
 }  // namespace ioscheduler
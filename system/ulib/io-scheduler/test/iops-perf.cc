@@ -0,0 +1,197 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+#include <zircon/assert.h>
+
+#include <memory>
+
+#include <fbl/auto_lock.h>
+#include <fbl/condition_variable.h>
+#include <fbl/mutex.h>
+#include <fbl/string_printf.h>
+#include <io-scheduler/io-scheduler.h>
+#include <perftest/perftest.h>
+
+namespace ioscheduler {
+namespace {
+
+// Number of ops pushed through the scheduler in each run. The IOPS figure is this divided by the
+// time per run.
+constexpr uint32_t kOpsPerRun = 1000;
+
+// A client whose ops do no IO, so that the benchmarks measure the cost of scheduling alone.
+// Ops are spread evenly over the streams. Async ops are completed by a separate thread, the way
+// an interrupt thread would complete them.
+class FakeClient : public SchedulerClient {
+ public:
+  FakeClient(Scheduler* sched, uint32_t num_streams, bool async)
+      : sched_(sched), async_(async), ops_(new StreamOp[kOpsPerRun]) {
+    for (uint32_t i = 0; i < kOpsPerRun; i++) {
+      ops_[i].set_stream_id(i % num_streams);
+    }
+    if (async_) {
+      ZX_ASSERT(thrd_create_with_name(&completer_, CompleterEntry, this, "fake-completer") ==
+                thrd_success);
+    }
+  }
+
+  ~FakeClient() {
+    if (async_) {
+      {
+        fbl::AutoLock lock(&lock_);
+        exit_completer_ = true;
+        issued_avail_.Signal();
+      }
+      thrd_join(completer_, nullptr);
+    }
+  }
+
+  // Make all of the ops available to Acquire() and block until they have all been released.
+  void RunOps() {
+    fbl::AutoLock lock(&lock_);
+    for (uint32_t i = 0; i < kOpsPerRun; i++) {
+      ops_[i].set_flags(0);
+    }
+    acquired_ = 0;
+    released_ = 0;
+    in_avail_.Broadcast();
+    while (released_ < kOpsPerRun) {
+      released_all_.Wait(&lock_);
+    }
+  }
+
+  bool CanReorder(StreamOp* first, StreamOp* second) override { return false; }
+
+  zx_status_t Acquire(StreamOp** sop_list, size_t list_count, size_t* actual_count,
+                      bool wait) override {
+    fbl::AutoLock lock(&lock_);
+    while (acquired_ == kOpsPerRun) {
+      if (cancelled_) {
+        return ZX_ERR_CANCELED;
+      }
+      if (!wait) {
+        return ZX_ERR_SHOULD_WAIT;
+      }
+      in_avail_.Wait(&lock_);
+    }
+    size_t count = 0;
+    for (; (count < list_count) && (acquired_ < kOpsPerRun); count++) {
+      sop_list[count] = &ops_[acquired_++];
+    }
+    *actual_count = count;
+    return ZX_OK;
+  }
+
+  zx_status_t Issue(StreamOp* sop) override {
+    sop->set_result(ZX_OK);
+    if (!async_) {
+      return ZX_OK;
+    }
+    fbl::AutoLock lock(&lock_);
+    issued_[num_issued_++] = sop;
+    issued_avail_.Signal();
+    return ZX_ERR_ASYNC;
+  }
+
+  void Release(StreamOp* sop) override {
+    fbl::AutoLock lock(&lock_);
+    if (++released_ == kOpsPerRun) {
+      released_all_.Signal();
+    }
+  }
+
+  void CancelAcquire() override {
+    fbl::AutoLock lock(&lock_);
+    cancelled_ = true;
+    in_avail_.Broadcast();
+  }
+
+  void Fatal() override { ZX_PANIC("Unexpected scheduler failure\n"); }
+
+ private:
+  static int CompleterEntry(void* arg) {
+    static_cast<FakeClient*>(arg)->CompleterLoop();
+    return 0;
+  }
+
+  void CompleterLoop() {
+    StreamOp* batch[kOpsPerRun];
+    for (;;) {
+      size_t count;
+      {
+        fbl::AutoLock lock(&lock_);
+        while ((num_issued_ == 0) && !exit_completer_) {
+          issued_avail_.Wait(&lock_);
+        }
+        if (num_issued_ == 0) {
+          return;
+        }
+        count = num_issued_;
+        for (size_t i = 0; i < count; i++) {
+          batch[i] = issued_[i];
+        }
+        num_issued_ = 0;
+      }
+      for (size_t i = 0; i < count; i++) {
+        sched_->AsyncComplete(batch[i]);
+      }
+    }
+  }
+
+  Scheduler* const sched_;
+  const bool async_;
+  std::unique_ptr<StreamOp[]> ops_;
+  thrd_t completer_;
+
+  fbl::Mutex lock_;
+  uint32_t acquired_ __TA_GUARDED(lock_) = kOpsPerRun;
+  uint32_t released_ __TA_GUARDED(lock_) = 0;
+  bool cancelled_ __TA_GUARDED(lock_) = false;
+  fbl::ConditionVariable in_avail_;
+  fbl::ConditionVariable released_all_;
+
+  // Ops issued but not yet handed to the completer thread.
+  StreamOp* issued_[kOpsPerRun] __TA_GUARDED(lock_);
+  size_t num_issued_ __TA_GUARDED(lock_) = 0;
+  bool exit_completer_ __TA_GUARDED(lock_) = false;
+  fbl::ConditionVariable issued_avail_;
+};
+
+// Measure the time taken to acquire, issue and release kOpsPerRun ops spread over |num_streams|
+// streams.
+bool IopsTest(perftest::RepeatState* state, uint32_t num_streams, bool async) {
+  Scheduler sched;
+  FakeClient client(&sched, num_streams, async);
+  ZX_ASSERT(sched.Init(&client, kOptionStrictlyOrdered) == ZX_OK);
+  for (uint32_t i = 0; i < num_streams; i++) {
+    ZX_ASSERT(sched.StreamOpen(i, kDefaultPriority) == ZX_OK);
+  }
+  ZX_ASSERT(sched.Serve() == ZX_OK);
+
+  while (state->KeepRunning()) {
+    client.RunOps();
+  }
+
+  sched.Shutdown();
+  return true;
+}
+
+void RegisterTests() {
+  for (uint32_t num_streams : {1, 4, 16}) {
+    for (bool async : {false, true}) {
+      auto name = fbl::StringPrintf("IoScheduler/Iops/%ustreams/%s", num_streams,
+                                    async ? "Async" : "Sync");
+      perftest::RegisterTest(name.c_str(), IopsTest, num_streams, async);
+    }
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
+}  // namespace ioscheduler
+
+int main(int argc, char** argv) {
+  return perftest::PerfTestMain(argc, argv, "fuchsia.io_scheduler");
+}
@@ -79,10 +79,12 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
     fbl::AutoLock lock(&lock_);
     ASSERT_EQ(sched_, nullptr);
     end_requested_ = false;
+    merge_ops_ = false;
     end_of_stream_ = false;
     in_total_ = 0;
     acquired_total_ = 0;
     issued_total_ = 0;
+    merged_total_ = 0;
     completed_total_ = 0;
     released_total_ = 0;
     sched_.reset(new Scheduler());
@@ -105,6 +107,7 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
   bool RandomBool(uint32_t percent);
 
   void DoServeTest(uint32_t ops, bool async, uint32_t fail_random);
+  void DoMergeTest(bool async);
   void DoMultistreamTest(uint32_t async_pct);
   void DoInvalidStreamTest(uint32_t async_pct);
 
@@ -113,6 +116,9 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
   // Wait until all inserted ops have been acquired.
   void WaitAcquire();
 
+  // Wait until all acquired ops have been released. Must follow WaitAcquire().
+  void WaitRelease();
+
   // Complete pending async requests.
   void CompleteAsync();
   bool CompleteOneAsync();
@@ -122,6 +128,7 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
 
   // Callback methods.
   bool CanReorder(StreamOp* first, StreamOp* second) override { return false; }
+  bool Merge(StreamOp* first, StreamOp* second) override;
 
   zx_status_t Acquire(StreamOp** sop_list, size_t list_count, size_t* actual_count,
                       bool wait) override;
@@ -136,6 +143,7 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
   void EndStreamLocked() __TA_REQUIRES(lock_);
 
   fbl::Mutex lock_;
+  bool merge_ops_ __TA_GUARDED(lock_) = false;      // Accept requests to merge ops.
   bool end_requested_ __TA_GUARDED(lock_) = false;  // Request closing the stream.
   bool end_of_stream_ __TA_GUARDED(lock_) = false;  // Stream has been closed.
 
@@ -150,6 +158,9 @@ class IOSchedTestFixture : public zxtest::Test, public SchedulerClient {
   // Number of ops seen via the Issue callback.
   uint32_t issued_total_ __TA_GUARDED(lock_) = 0;
 
+  // Number of ops merged into others via the Merge callback, which are never issued.
+  uint32_t merged_total_ __TA_GUARDED(lock_) = 0;
+
   // Number of ops whose status has been reported as completed, either synchronously through Issue
   // return or via an AsyncComplete call.
   uint32_t completed_total_ __TA_GUARDED(lock_) = 0;
@@ -199,9 +210,9 @@ void IOSchedTestFixture::InsertOp(TopRef top) {
 }
 
 void IOSchedTestFixture::EndStreamLocked() {
-  // Request exit.
+  // Request exit. Every worker may be blocked in Acquire().
   end_requested_ = true;
-  in_avail_.Signal();
+  in_avail_.Broadcast();
 }
 
 bool IOSchedTestFixture::RandomBool(uint32_t percent) {
@@ -223,6 +234,11 @@ void IOSchedTestFixture::WaitAcquire() {
   }
   ZX_DEBUG_ASSERT(in_list_.is_empty());
   ZX_DEBUG_ASSERT(in_total_ == acquired_total_);
+  // Other workers may still be enqueueing the ops they acquired. Wait for them to be issued (or
+  // released if they could not be enqueued) so that the test can safely close the streams.
+  while (!acquired_list_.is_empty()) {
+    issued_all_.Wait(&lock_);
+  }
 }
 
 bool IOSchedTestFixture::CompleteOneAsync() {
@@ -257,12 +273,13 @@ void IOSchedTestFixture::CompleteAsync() {
   // Mark all pending async ops as complete.
   while (CompleteOneAsync()) {}
 
-  {
-    // Wait for all ops to be released.
-    fbl::AutoLock lock(&lock_);
-    while (released_total_ != acquired_total_) {
-      released_all_.Wait(&lock_);
-    }
+  WaitRelease();
+}
+
+void IOSchedTestFixture::WaitRelease() {
+  fbl::AutoLock lock(&lock_);
+  while (released_total_ != acquired_total_) {
+    released_all_.Wait(&lock_);
   }
 }
 
@@ -271,8 +288,8 @@ void IOSchedTestFixture::CheckExpectedResult() { CheckExpectedResultWithFailures
 void IOSchedTestFixture::CheckExpectedResultWithFailures(uint32_t acquire_failures) {
   fbl::AutoLock lock(&lock_);
   ASSERT_EQ(in_total_, acquired_total_);
-  ASSERT_EQ(in_total_, issued_total_ + acquire_failures);
-  ASSERT_EQ(in_total_, completed_total_ + acquire_failures);
+  ASSERT_EQ(in_total_, issued_total_ + merged_total_ + acquire_failures);
+  ASSERT_EQ(in_total_, completed_total_ + merged_total_ + acquire_failures);
   ASSERT_EQ(in_total_, released_total_);
   ASSERT_TRUE(in_list_.is_empty());
   ASSERT_TRUE(acquired_list_.is_empty());
@@ -317,6 +334,28 @@ zx_status_t IOSchedTestFixture::Acquire(StreamOp** sop_list, size_t list_count,
   return ZX_OK;
 }
 
+bool IOSchedTestFixture::Merge(StreamOp* first, StreamOp* second) {
+  fbl::AutoLock lock(&lock_);
+  if (!merge_ops_) {
+    return false;
+  }
+  // Merged ops share the result of the op they are merged into.
+  TestOp* first_top = static_cast<TestOp*>(first->cookie());
+  TestOp* second_top = static_cast<TestOp*>(second->cookie());
+  if (first_top->should_fail() != second_top->should_fail()) {
+    return false;
+  }
+  // The op is carried out along with |first|, so it is no longer waiting to be issued.
+  TopRef top = acquired_list_.erase(*second_top);
+  top->set_stage(Stage::kStageCompleted);
+  completed_list_.push_back(std::move(top));
+  merged_total_++;
+  if (end_of_stream_ && acquired_list_.is_empty()) {
+    issued_all_.Broadcast();
+  }
+  return true;
+}
+
 zx_status_t IOSchedTestFixture::Issue(StreamOp* sop) {
   bool early_complete = false;
   zx_status_t status = ZX_OK;
@@ -339,7 +378,7 @@ zx_status_t IOSchedTestFixture::Issue(StreamOp* sop) {
     completed_total_++;
   }
   // Signal if all ops have been issued.
-  if (end_of_stream_ && (acquired_total_ == issued_total_)) {
+  if (end_of_stream_ && acquired_list_.is_empty()) {
     issued_all_.Broadcast();
   }
   lock.release();
@@ -358,6 +397,10 @@ void IOSchedTestFixture::Release(StreamOp* sop) {
   switch (stage) {
     case Stage::kStageAcquired:
       ref = acquired_list_.erase(*top);
+      // Ops that fail to be enqueued are never issued.
+      if (end_of_stream_ && acquired_list_.is_empty()) {
+        issued_all_.Broadcast();
+      }
       break;
     case Stage::kStageIssued:
       ref = issued_list_.erase(*top);
@@ -459,6 +502,77 @@ TEST_F(IOSchedTestFixture, ServeTestMultiAsync) { DoServeTest(193, true, 0); }
 TEST_F(IOSchedTestFixture, ServeTestMultiFailures) { DoServeTest(197, false, 10); }
 TEST_F(IOSchedTestFixture, ServeTestMultiFailuresAsync) { DoServeTest(199, true, 10); }
 
+void IOSchedTestFixture::DoMergeTest(bool async) {
+  const uint32_t num_ops = 101;
+  zx_status_t status = sched_->Init(this, kOptionStrictlyOrdered);
+  ASSERT_OK(status, "Failed to init scheduler");
+  status = sched_->StreamOpen(0, kDefaultPriority);
+  ASSERT_OK(status, "Failed to open stream");
+
+  for (uint32_t i = 0; i < num_ops; i++) {
+    TopRef top = fbl::AdoptRef(new TestOp(i, 0));
+    top->set_should_fail(RandomBool(10));
+    top->set_async(async);
+    InsertOp(std::move(top));
+  }
+  {
+    fbl::AutoLock lock(&lock_);
+    merge_ops_ = true;
+  }
+  ASSERT_OK(sched_->Serve(), "Failed to begin service");
+
+  WaitAcquire();
+  if (async) {
+    CompleteAsync();
+  } else {
+    // Ops are released by the workers after they have been issued, which may be after
+    // WaitAcquire() returns. The scheduler records an op's release before releasing it.
+    WaitRelease();
+  }
+
+  // Every op is accounted for in the stream's statistics, merged or not.
+  StreamStats stats;
+  ASSERT_OK(sched_->StreamGetStats(0, &stats));
+  ASSERT_EQ(stats.released_ops, num_ops);
+  uint64_t histogram_total = 0;
+  for (uint64_t count : stats.latency) {
+    histogram_total += count;
+  }
+  ASSERT_EQ(histogram_total, num_ops);
+  {
+    fbl::AutoLock lock(&lock_);
+    ASSERT_EQ(stats.merged_ops, merged_total_);
+  }
+
+  ASSERT_OK(sched_->StreamClose(0), "Failed to close stream");
+  sched_->Shutdown();
+
+  CheckExpectedResult();
+}
+
+TEST_F(IOSchedTestFixture, ServeTestMerge) { DoMergeTest(false); }
+TEST_F(IOSchedTestFixture, ServeTestMergeAsync) { DoMergeTest(true); }
+
+// Stream parameters can only be set on open streams, and deadlines must be positive.
+TEST_F(IOSchedTestFixture, StreamParamsTest) {
+  ASSERT_OK(sched_->Init(this, kOptionStrictlyOrdered));
+  StreamParams params;
+  params.deadline = ZX_MSEC(5);
+  params.budget = 1024;
+  ASSERT_EQ(sched_->StreamSetParams(0, params), ZX_ERR_NOT_FOUND);
+  ASSERT_OK(sched_->StreamOpen(0, kDefaultPriority));
+  ASSERT_OK(sched_->StreamSetParams(0, params));
+  params.deadline = 0;
+  ASSERT_EQ(sched_->StreamSetParams(0, params), ZX_ERR_INVALID_ARGS);
+
+  StreamStats stats;
+  ASSERT_OK(sched_->StreamGetStats(0, &stats));
+  ASSERT_EQ(stats.released_ops, 0);
+  ASSERT_OK(sched_->StreamClose(0));
+  ASSERT_EQ(sched_->StreamGetStats(0, &stats), ZX_ERR_NOT_FOUND);
+  sched_->Shutdown();
+}
+
 // Test a race condition between issue and completion.
 TEST_F(IOSchedTestFixture, AsyncCompletionRaceTest) {
   zx_status_t status = sched_->Init(this, kOptionStrictlyOrdered);
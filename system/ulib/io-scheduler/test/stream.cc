@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <iterator>
+
 #include <io-scheduler/io-scheduler.h>
 #include <zxtest/zxtest.h>
 
@@ -40,4 +42,104 @@ TEST(StreamTest, StreamDrain) {
   ASSERT_OK(status, "Stream failed to close");
 }
 
+namespace {
+
+// Client that merges every op into the one before it, except for those marked as unmergeable.
+class MergeClient : public SchedulerClient {
+ public:
+  bool CanReorder(StreamOp* first, StreamOp* second) override { return false; }
+  bool Merge(StreamOp* first, StreamOp* second) override { return second->cookie() == nullptr; }
+  zx_status_t Acquire(StreamOp** sop_list, size_t list_count, size_t* actual_count,
+                      bool wait) override {
+    return ZX_ERR_CANCELED;
+  }
+  zx_status_t Issue(StreamOp* sop) override { return ZX_OK; }
+  void Release(StreamOp* sop) override {}
+  void CancelAcquire() override {}
+  void Fatal() override {}
+};
+
+}  // namespace
+
+TEST(StreamTest, StreamMerge) {
+  MergeClient client;
+  Stream stream(5, 0);
+  int unmergeable;
+  StreamOp ops[6];
+  for (uint32_t i = 0; i < std::size(ops); i++) {
+    ops[i].set_stream_id(5);
+    if (i == 3) {
+      ops[i].set_cookie(&unmergeable);
+    }
+    UniqueOp err;
+    ASSERT_OK(stream.Insert(UniqueOp(&ops[i]), &err));
+  }
+
+  // Ops 1 and 2 are merged into op 0, and op 3 stops the merge.
+  UniqueOp op;
+  stream.GetNext(&op);
+  ASSERT_EQ(op.get(), &ops[0]);
+  ASSERT_EQ(stream.Merge(op.get(), &client, 8), 2);
+  ASSERT_EQ(op->merged(), &ops[1]);
+  ASSERT_TRUE(stream.HasReady());
+  op.release();
+
+  // No more than the requested number of ops is merged.
+  stream.GetNext(&op);
+  ASSERT_EQ(op.get(), &ops[3]);
+  ASSERT_EQ(stream.Merge(op.get(), &client, 1), 1);
+  ASSERT_EQ(op->merged(), &ops[4]);
+  op.release();
+
+  stream.GetNext(&op);
+  ASSERT_EQ(op.get(), &ops[5]);
+  ASSERT_EQ(stream.Merge(op.get(), &client, 8), 0);
+  ASSERT_FALSE(stream.HasReady());
+  op.release();
+
+  StreamStats stats;
+  stream.GetStats(&stats);
+  ASSERT_EQ(stats.merged_ops, 3);
+  for (StreamOp& sop : ops) {
+    stream.Complete(&sop);
+  }
+  ASSERT_OK(stream.Close());
+}
+
+TEST(StreamTest, StreamBudget) {
+  Stream stream(5, 0);
+  // Streams without a budget are never throttled.
+  ASSERT_TRUE(stream.Charge(1000));
+
+  StreamParams params;
+  params.budget = 3;
+  stream.SetParams(params);
+  ASSERT_TRUE(stream.Charge(1));
+  ASSERT_TRUE(stream.Charge(1));
+  // The budget is reported spent only once per period.
+  ASSERT_FALSE(stream.Charge(1));
+  ASSERT_TRUE(stream.Charge(1));
+  ASSERT_EQ(stream.params().budget, 3);
+  ASSERT_OK(stream.Close());
+}
+
+TEST(StreamTest, StreamLatencyHistogram) {
+  Stream stream(5, 0);
+  stream.RecordRelease(0);
+  stream.RecordRelease(ZX_USEC(1));
+  stream.RecordRelease(ZX_USEC(3));
+  stream.RecordRelease(ZX_USEC(4));
+  stream.RecordRelease(ZX_SEC(3600));
+
+  StreamStats stats;
+  stream.GetStats(&stats);
+  ASSERT_EQ(stats.released_ops, 5);
+  ASSERT_EQ(stats.latency[0], 1);
+  ASSERT_EQ(stats.latency[1], 1);
+  ASSERT_EQ(stats.latency[2], 1);
+  ASSERT_EQ(stats.latency[3], 1);
+  ASSERT_EQ(stats.latency[kLatencyBuckets - 1], 1);
+  ASSERT_OK(stream.Close());
+}
+
 }  // namespace ioscheduler
@@ -0,0 +1,111 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/syscalls.h>
+
+#include <io-scheduler/io-scheduler.h>
+#include <zxtest/zxtest.h>
+
+namespace ioscheduler {
+namespace {
+
+// Create a stream marked as queued, as the scheduler does before pushing it.
+StreamRef MakeStream(uint32_t id, uint32_t priority) {
+  StreamRef stream = fbl::AdoptRef(new Stream(id, priority));
+  // Streams must be closed before they are destroyed.
+  stream->Close();
+  EXPECT_TRUE(stream->MarkQueued());
+  return stream;
+}
+
+}  // namespace
+
+TEST(WorkQueueTest, PopEmpty) {
+  WorkQueue queue;
+  ASSERT_NULL(queue.Pop());
+  ASSERT_EQ(queue.size(), 0);
+}
+
+TEST(WorkQueueTest, PopByPriority) {
+  WorkQueue queue;
+  queue.Push(MakeStream(0, kDefaultPriority));
+  queue.Push(MakeStream(1, kMaxPriority));
+  queue.Push(MakeStream(2, 0));
+  queue.Push(MakeStream(3, kDefaultPriority));
+  ASSERT_EQ(queue.size(), 4);
+
+  // Streams of equal priority come out in the order they went in.
+  const uint32_t expected[] = {1, 0, 3, 2};
+  for (uint32_t id : expected) {
+    StreamRef stream = queue.Pop();
+    ASSERT_NOT_NULL(stream);
+    ASSERT_EQ(stream->id(), id);
+  }
+  ASSERT_NULL(queue.Pop());
+}
+
+TEST(WorkQueueTest, PushWhileQueued) {
+  WorkQueue queue;
+  queue.Push(MakeStream(0, 1));
+  queue.Push(MakeStream(1, 1));
+  StreamRef stream = queue.Pop();
+  ASSERT_EQ(stream->id(), 0);
+  // A stream pushed back after being serviced goes behind those already waiting.
+  queue.Push(std::move(stream));
+  ASSERT_EQ(queue.Pop()->id(), 1);
+  ASSERT_EQ(queue.Pop()->id(), 0);
+}
+
+TEST(WorkQueueTest, PopExpiredFirst) {
+  WorkQueue queue;
+  StreamParams params;
+  params.deadline = 1;
+  StreamRef expired = MakeStream(0, 0);
+  expired->SetParams(params);
+  expired->SetDeadline(0);
+  params.deadline = ZX_SEC(3600);
+  StreamRef waiting = MakeStream(1, 1);
+  waiting->SetParams(params);
+  waiting->SetDeadline(zx_clock_get_monotonic());
+  queue.Push(MakeStream(2, kMaxPriority));
+  queue.Push(std::move(waiting));
+  queue.Push(std::move(expired));
+
+  // Only the stream whose deadline has passed jumps ahead of higher priority streams.
+  const uint32_t expected[] = {0, 2, 1};
+  for (uint32_t id : expected) {
+    StreamRef stream = queue.Pop();
+    ASSERT_NOT_NULL(stream);
+    ASSERT_EQ(stream->id(), id);
+  }
+  ASSERT_NULL(queue.Pop());
+}
+
+TEST(WorkQueueTest, PopThrottledLast) {
+  WorkQueue queue;
+  StreamParams params;
+  params.budget = 2;
+  StreamRef throttled = MakeStream(0, kMaxPriority);
+  throttled->SetParams(params);
+  ASSERT_FALSE(throttled->Charge(3));
+  queue.Push(std::move(throttled));
+  queue.Push(MakeStream(1, 0));
+
+  ASSERT_EQ(queue.Pop()->id(), 1);
+  // Throttled streams are still serviced when there is nothing else to do.
+  ASSERT_EQ(queue.Pop()->id(), 0);
+  ASSERT_NULL(queue.Pop());
+}
+
+// Streams left in the queue are released when it is destroyed.
+TEST(WorkQueueTest, DestroyNonEmpty) {
+  StreamRef stream = MakeStream(0, 1);
+  {
+    WorkQueue queue;
+    queue.Push(stream);
+  }
+  ASSERT_TRUE(stream->MarkQueued());
+}
+
+}  // namespace ioscheduler
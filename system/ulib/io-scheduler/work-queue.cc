@@ -0,0 +1,119 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <fbl/auto_lock.h>
+#include <io-scheduler/work-queue.h>
+
+namespace ioscheduler {
+
+WorkQueue::~WorkQueue() {
+  // Drop the references to any streams that were never serviced.
+  while (StreamRef stream = Pop()) {
+    stream->ClearQueued();
+  }
+}
+
+void WorkQueue::Push(StreamRef stream) {
+  ZX_DEBUG_ASSERT(stream->priority() < kWorkQueuePriorities);
+  size_.fetch_add(1);
+  // The inbox holds the reference until the stream is drained into a priority list.
+  Stream* raw = fbl::ExportToRawPtr(&stream);
+  Stream* head = inbox_.load(std::memory_order_relaxed);
+  do {
+    raw->queue_next_ = head;
+  } while (!inbox_.compare_exchange_weak(head, raw, std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+StreamRef WorkQueue::Pop() {
+  if (size_.load() == 0) {
+    return nullptr;
+  }
+  fbl::AutoLock lock(&lock_);
+  DrainInboxLocked();
+  StreamRef stream = PopExpiredLocked();
+  if ((stream == nullptr) && (ready_mask_ != 0)) {
+    uint32_t priority = 31 - __builtin_clz(ready_mask_);
+    stream = RemoveReadyLocked(&ready_[priority].front());
+  }
+  if (stream == nullptr) {
+    stream = throttled_.pop_front();
+    if (stream == nullptr) {
+      return nullptr;
+    }
+  }
+  size_.fetch_sub(1);
+  return stream;
+}
+
+StreamRef WorkQueue::PopExpiredLocked() {
+  if (deadlines_.is_empty() && throttled_.is_empty()) {
+    return nullptr;
+  }
+  zx_time_t now = zx_clock_get_monotonic();
+  for (auto iter = throttled_.begin(); iter != throttled_.end();) {
+    auto current = iter++;
+    if (current->throttled_until_ <= now) {
+      StreamRef stream = throttled_.erase(current);
+      stream->throttled_until_ = 0;
+      InsertReadyLocked(std::move(stream));
+    }
+  }
+  Stream* expired = nullptr;
+  for (Stream& stream : deadlines_) {
+    if ((stream.deadline_time_ <= now) &&
+        ((expired == nullptr) || (stream.deadline_time_ < expired->deadline_time_))) {
+      expired = &stream;
+    }
+  }
+  if (expired == nullptr) {
+    return nullptr;
+  }
+  return RemoveReadyLocked(expired);
+}
+
+void WorkQueue::InsertReadyLocked(StreamRef stream) {
+  uint32_t priority = stream->priority();
+  if (stream->deadline_time_ != ZX_TIME_INFINITE) {
+    deadlines_.push_back(stream.get());
+  }
+  ready_[priority].push_back(std::move(stream));
+  ready_mask_ |= (1u << priority);
+}
+
+StreamRef WorkQueue::RemoveReadyLocked(Stream* stream) {
+  uint32_t priority = stream->priority();
+  if (stream->deadline_time_ != ZX_TIME_INFINITE) {
+    deadlines_.erase(*stream);
+  }
+  StreamRef removed = ready_[priority].erase(*stream);
+  if (ready_[priority].is_empty()) {
+    ready_mask_ &= ~(1u << priority);
+  }
+  return removed;
+}
+
+void WorkQueue::DrainInboxLocked() {
+  Stream* raw = inbox_.exchange(nullptr, std::memory_order_acquire);
+  // Reverse the inbox so that streams keep the order in which they were pushed.
+  Stream::ReadyStreamList pushed;
+  while (raw != nullptr) {
+    Stream* next = raw->queue_next_;
+    raw->queue_next_ = nullptr;
+    pushed.push_front(fbl::ImportFromRawPtr(raw));
+    raw = next;
+  }
+  while (StreamRef stream = pushed.pop_front()) {
+    if (stream->throttled_until_ != 0) {
+      throttled_.push_back(std::move(stream));
+    } else {
+      InsertReadyLocked(std::move(stream));
+    }
+  }
+}
+
+}  // namespace ioscheduler
@@ -44,24 +44,31 @@ int Worker::ThreadEntry(void* arg) {
   return 0;
 }
 
-void Worker::DoAcquire() {
+bool Worker::DoAcquire() {
   ZX_DEBUG_ASSERT(!input_closed_);
   SchedulerClient* client = sched_->client();
   const size_t max_ops = 10;
   zx_status_t status;
   size_t acquire_count = 0;
   StreamOp* op_list[max_ops];
-  status = client->Acquire(op_list, max_ops, &acquire_count, true);
+  bool wait = sched_->BeginBlockingAcquire();
+  status = client->Acquire(op_list, max_ops, &acquire_count, wait);
+  if (wait) {
+    sched_->EndBlockingAcquire();
+  }
+  if (status == ZX_ERR_SHOULD_WAIT) {
+    return false;
+  }
   if (status == ZX_ERR_CANCELED) {
     // No more ops to read. Drain the streams and exit.
     input_closed_ = true;
-    return;
+    return false;
   }
   if (status != ZX_OK) {
     fprintf(stderr, "ioworker %u: Unexpected return status from Acquire() %d\n", id_, status);
     client->Fatal();
     input_closed_ = true;
-    return;
+    return false;
   }
 
   // Containerize all ops for safety.
@@ -77,17 +84,19 @@ void Worker::DoAcquire() {
   for (size_t i = 0; i < num_error; i++) {
     client->Release(uop_list[i].release());
   }
+  return true;
 }
 
-void Worker::ExecuteLoop() {
+void Worker::ExecuteLoop(bool wait) {
   ZX_DEBUG_ASSERT(!cancelled_);
   SchedulerClient* client = sched_->client();
   zx_status_t status;
 
   for (;;) {
-    // Fetch an op.
+    // Fetch an op. Once the op source has been closed there is nothing else to do but wait for
+    // ops to complete.
     UniqueOp op;
-    status = sched_->Dequeue(false, &op);
+    status = sched_->Dequeue(id_, wait || input_closed_, &op);
     if (status == ZX_ERR_SHOULD_WAIT) {
       // No more ops in scheduler, acquire more.
       break;
@@ -97,6 +106,8 @@ void Worker::ExecuteLoop() {
       break;
     }
     ZX_DEBUG_ASSERT(status == ZX_OK);
+    // Go back to acquiring ops once these run out.
+    wait = false;
 
     if (op->is_deferred()) {
       // Op completion has been deferred. Release it now.
@@ -124,12 +135,14 @@ void Worker::ExecuteLoop() {
 void Worker::WorkerLoop() {
   while ((!input_closed_) || (!cancelled_)) {
     // Fetch ops from the client.
+    bool acquired = false;
     if (!input_closed_) {
-      DoAcquire();
+      acquired = DoAcquire();
     }
-    // Drain the priority queue.
+    // Drain the priority queue. If there was nothing to acquire without blocking, wait for
+    // other workers to queue ops or for ops to complete.
     if (!cancelled_) {
-      ExecuteLoop();
+      ExecuteLoop(!acquired);
     }
   }
 }
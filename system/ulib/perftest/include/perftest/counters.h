@@ -0,0 +1,65 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PERFTEST_COUNTERS_H_
+#define PERFTEST_COUNTERS_H_
+
+#include <stdint.h>
+#include <zircon/types.h>
+
+#include <memory>
+
+#include <fbl/string.h>
+#include <fbl/vector.h>
+
+namespace perftest {
+
+// A source of event counts, such as CPU cycles or cache misses, which the
+// runner can collect for each test alongside the times of its runs.  This
+// helps tell whether a regression comes from executing more instructions,
+// from cache misses, or from something else entirely.
+//
+// Counting starts just before a test's first run and stops just after its
+// last run, so that the counts cover all of the runs but none of the test's
+// setup or teardown.  Starting and stopping the counters is usually far too
+// slow to do around each run, so each count is reported as an average per
+// run, as the test case "<test name>.<counter name>" with the unit "count".
+// Counts are not broken down by step, and are not collected for
+// multi-threaded tests.
+class CounterSource {
+ public:
+  virtual ~CounterSource() = default;
+
+  // The names of the counters, e.g. "cycles".
+  virtual const fbl::Vector<fbl::String>& counter_names() const = 0;
+
+  // Starts counting from zero.  Returns false on failure.
+  virtual bool Start() = 0;
+
+  // Stops counting, and fills in |counts| with the count of each counter,
+  // in the same order as counter_names().  Returns false on failure.
+  virtual bool Stop(fbl::Vector<uint64_t>* counts) = 0;
+};
+
+// Sets the counters that the runner collects for each test.  Passing null
+// stops the runner from collecting counters, which is the default.
+void SetCounterSource(std::unique_ptr<CounterSource> source);
+
+#if defined(__Fuchsia__)
+// Creates a CounterSource that uses the CPU's performance monitoring unit,
+// through zx_mtrace_control(), to count cycles, instructions retired, last
+// level cache misses and mispredicted branches.  |debug_resource| must be
+// the debug resource, and is not taken over.
+//
+// The PMU counts events on every CPU, so the counts include anything that
+// runs concurrently with the test.  This fails with ZX_ERR_NOT_SUPPORTED
+// where the kernel has no PMU support (e.g. on most emulators) or debugging
+// syscalls are disabled.
+zx_status_t CreatePmuCounterSource(zx_handle_t debug_resource,
+                                   std::unique_ptr<CounterSource>* out);
+#endif
+
+}  // namespace perftest
+
+#endif  // PERFTEST_COUNTERS_H_
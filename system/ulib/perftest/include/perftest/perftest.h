@@ -16,8 +16,8 @@
 // This is a library for writing performance tests.  It supports
 // performance tests that involve running an operation repeatedly,
 // sequentially, and recording the times taken by each run of the
-// operation.  (It does not yet support other types of performance test,
-// such as where we run an operation concurrently in multiple threads.)
+// operation.  It also supports running such an operation concurrently in
+// multiple threads (see "Multi-threaded tests" below).
 //
 // There are two ways to implement a test:
 //
@@ -91,6 +91,44 @@
 // state->NextStep() between each step.
 //
 //
+// ## Multi-threaded tests
+//
+// A multi-threaded test measures an operation while several threads do it
+// at once, either contending on a shared object (e.g. N threads writing to
+// one channel) or cooperating (e.g. producer/consumer pairs).  The test
+// function sets up any fixtures that the threads share, and then calls
+// RunThreads() with a function that each thread runs, with its own
+// RepeatState:
+//
+//   // Measure the time taken to lock and unlock a mutex that 4 threads
+//   // are contending on.
+//   bool MutexContendedTest(perftest::MultiThreadState* state) {
+//       mtx_t mutex = MTX_INIT;  // Fixture shared by all threads.
+//       return state->RunThreads(
+//           [&mutex](perftest::RepeatState* thread_state, uint32_t thread_index) {
+//               while (thread_state->KeepRunning()) {
+//                   mtx_lock(&mutex);
+//                   mtx_unlock(&mutex);
+//               }
+//               return true;
+//           });
+//   }
+//   void RegisterTests() {
+//       perftest::RegisterMultiThreadTest("MutexContended", 4, MutexContendedTest);
+//   }
+//
+// Each thread may set up its own fixtures before its first call to
+// KeepRunning(), which waits for all of the threads to get there, so that
+// their test runs start together.  Threads can tell each other apart by
+// |thread_index|, which goes from 0 to the thread count minus 1.  Every
+// thread does the same number of runs, with the same steps.
+//
+// The times taken by each run (or step) are reported as for a
+// single-threaded test, merged across all the threads.  The test also
+// reports its throughput, as the number of runs completed by all the
+// threads per second of wall-clock time, under the test's name plus
+// ".throughput".
+//
 // ## Test coding style
 //
 // ### Comments
@@ -176,6 +214,36 @@ void RegisterSimpleTest(const char* test_name) {
   RegisterTest(test_name, std::move(wrapper_func));
 }
 
+// This object is passed to multi-threaded test functions.
+//
+// This is a pure virtual interface for the same reason as RepeatState.
+class MultiThreadState {
+ public:
+  typedef bool ThreadFunc(RepeatState* state, uint32_t thread_index);
+
+  // The number of threads that the test runs on.
+  virtual uint32_t thread_count() const = 0;
+
+  // Runs |thread_func| on each of the test's threads, and returns once all
+  // of them have returned.  Returns false if any of them failed.  This
+  // must be called exactly once by the test function.
+  virtual bool RunThreads(fit::function<ThreadFunc> thread_func) = 0;
+};
+
+typedef bool MultiThreadTestFunc(MultiThreadState* state);
+
+void RegisterMultiThreadTest(const char* name, uint32_t thread_count,
+                             fit::function<MultiThreadTestFunc> test_func);
+
+// Convenience routine for registering parameterized multi-threaded perf
+// tests.
+template <typename Func, typename Arg, typename... Args>
+void RegisterMultiThreadTest(const char* name, uint32_t thread_count, Func test_func, Arg arg,
+                             Args... args) {
+  auto wrapper_func = [=](MultiThreadState* state) { return test_func(state, arg, args...); };
+  RegisterMultiThreadTest(name, thread_count, wrapper_func);
+}
+
 // Entry point for the perf test runner that a test executable should call
 // from main().  This will run the registered perf tests and/or unit tests,
 // based on the command line arguments.  (See the "--help" output for more
@@ -195,6 +263,12 @@ bool RunTest(const char* test_suite, const char* test_name,
              const fit::function<TestFunc>& test_func, uint32_t run_count, ResultsSet* results_set,
              fbl::String* error_out);
 
+// Same as RunTest(), for a multi-threaded test running on |thread_count|
+// threads.
+bool RunMultiThreadTest(const char* test_suite, const char* test_name, uint32_t thread_count,
+                        const fit::function<MultiThreadTestFunc>& test_func, uint32_t run_count,
+                        ResultsSet* results_set, fbl::String* error_out);
+
 // DoNotOptimize() can be used to prevent the computation of |value| from
 // being optimized away by the compiler.  It also prevents the compiler
 // from optimizing away reads or writes to memory that |value| points to
@@ -32,6 +32,9 @@ struct SummaryStatistics {
   double mean;
   double std_dev;
   double median;
+  // Tail latencies, using the nearest-rank method.
+  double p99;
+  double p999;
 };
 
 // This represents the results for a particular test case.  It contains a
@@ -6,6 +6,8 @@
 #define PERFTEST_RUNNER_H_
 
 #include <lib/fit/function.h>
+#include <stdio.h>
+#include <zircon/types.h>
 
 #include <fbl/string.h>
 #include <fbl/vector.h>
@@ -20,6 +22,9 @@ namespace internal {
 struct NamedTest {
   fbl::String name;
   fit::function<TestFunc> test_func;
+  // Set instead of |test_func| for multi-threaded tests.
+  uint32_t thread_count = 0;
+  fit::function<MultiThreadTestFunc> multi_thread_test_func;
 };
 
 typedef fbl::Vector<NamedTest> TestList;
@@ -38,11 +43,19 @@ struct CommandArgs {
 #if defined(__Fuchsia__)
   bool enable_tracing = false;
   double startup_delay_seconds = 0;
+  bool enable_pmu = false;
 #endif
 };
 
 void ParseCommandArgs(int argc, char** argv, CommandArgs* dest);
 
+#if defined(__Fuchsia__)
+// Makes the runner collect PMU counters for each test, using |debug_resource|,
+// which must outlive the counters.  Logs the reason to |log_stream| and
+// returns false if the counters are not available.
+bool EnablePmuCounters(zx_handle_t debug_resource, FILE* log_stream);
+#endif
+
 }  // namespace internal
 }  // namespace perftest
 
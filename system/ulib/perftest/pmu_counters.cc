@@ -0,0 +1,273 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zircon-internal/device/cpu-trace/perf-mon.h>
+#include <lib/zircon-internal/mtrace.h>
+#include <zircon/syscalls.h>
+
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include <perftest/counters.h>
+
+#if defined(__x86_64__)
+#include <lib/zircon-internal/device/cpu-trace/intel-pm.h>
+#elif defined(__aarch64__)
+#include <lib/zircon-internal/device/cpu-trace/arm64-pm.h>
+#endif
+
+namespace perftest {
+namespace {
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+// The order of the counters in kCounterNames and in the event id arrays.
+enum Counter { kCycles, kInstructions, kLlcMisses, kBranchMisses, kCounterCount };
+
+constexpr const char* kCounterNames[kCounterCount] = {
+    "cycles",
+    "instructions",
+    "llc_misses",
+    "branch_misses",
+};
+
+// Each CPU's buffer only receives the final value of each counter when the
+// counters are stopped, as none of them are set up to interrupt.
+constexpr size_t kBufferSize = 16 * 1024;
+
+constexpr uint32_t kCountFlags = perfmon::kPmuConfigFlagOs | perfmon::kPmuConfigFlagUser;
+
+#if defined(__x86_64__)
+
+using PmuProperties = perfmon::X86PmuProperties;
+using PmuConfig = perfmon::X86PmuConfig;
+
+// Fills in |config| to count the architectural events that we want, and
+// |event_ids| with the id that identifies each counter's records.
+zx_status_t MakeConfig(const PmuProperties& props, PmuConfig* config,
+                       perfmon::EventId event_ids[kCounterCount]) {
+  if (props.common.max_num_fixed_events < 2 || props.common.max_num_programmable_events < 2) {
+    return ZX_ERR_NOT_SUPPORTED;
+  }
+
+  // See intel-pm-events.inc for the event ids and event numbers.
+  event_ids[kInstructions] = perfmon::MakeEventId(perfmon::kGroupFixed, 1);
+  event_ids[kCycles] = perfmon::MakeEventId(perfmon::kGroupFixed, 2);
+  event_ids[kLlcMisses] = perfmon::MakeEventId(perfmon::kGroupArch, 4);
+  event_ids[kBranchMisses] = perfmon::MakeEventId(perfmon::kGroupArch, 6);
+
+  // Instructions retired and unhalted core cycles are fixed counters 0 and 1.
+  config->fixed_events[0] = event_ids[kInstructions];
+  config->fixed_events[1] = event_ids[kCycles];
+  for (unsigned i = 0; i < 2; ++i) {
+    config->fixed_flags[i] = kCountFlags;
+    // Count in both rings 0 and 3, without interrupting on overflow.
+    config->fixed_ctrl |= IA32_FIXED_CTR_CTRL_EN_MASK(i);
+    config->global_ctrl |= IA32_PERF_GLOBAL_CTRL_FIXED_EN_MASK(i);
+  }
+
+  const uint64_t event_select_bits =
+      IA32_PERFEVTSEL_USR_MASK | IA32_PERFEVTSEL_OS_MASK | IA32_PERFEVTSEL_EN_MASK;
+  config->programmable_events[0] = event_ids[kLlcMisses];
+  config->programmable_hw_events[0] =
+      0x2e | (0x41 << IA32_PERFEVTSEL_UMASK_SHIFT) | event_select_bits;
+  config->programmable_events[1] = event_ids[kBranchMisses];
+  config->programmable_hw_events[1] = 0xc5 | event_select_bits;
+  for (unsigned i = 0; i < 2; ++i) {
+    config->programmable_flags[i] = kCountFlags;
+    config->global_ctrl |= IA32_PERF_GLOBAL_CTRL_PMC_EN_MASK(i);
+  }
+  return ZX_OK;
+}
+
+#elif defined(__aarch64__)
+
+using PmuProperties = perfmon::Arm64PmuProperties;
+using PmuConfig = perfmon::Arm64PmuConfig;
+
+// Fills in |config| to count the architectural events that we want, and
+// |event_ids| with the id that identifies each counter's records.
+zx_status_t MakeConfig(const PmuProperties& props, PmuConfig* config,
+                       perfmon::EventId event_ids[kCounterCount]) {
+  if (props.common.max_num_fixed_events < 1 || props.common.max_num_programmable_events < 3) {
+    return ZX_ERR_NOT_SUPPORTED;
+  }
+
+  // The cycle counter is the only fixed counter.
+  event_ids[kCycles] = perfmon::MakeEventId(perfmon::kGroupFixed, 1);
+  config->fixed_events[0] = event_ids[kCycles];
+  config->fixed_flags[0] = kCountFlags;
+
+  // See arm64-pm-events.inc for the event numbers.  The event ids are the
+  // event numbers plus one.
+  const struct {
+    Counter counter;
+    uint32_t event;
+  } programmable[] = {
+      {kInstructions, 0x08},
+      // There is no common architectural event for last level cache misses,
+      // so count L2 data cache refills, which is the last level on many cores.
+      {kLlcMisses, 0x17},
+      {kBranchMisses, 0x10},
+  };
+  for (unsigned i = 0; i < std::size(programmable); ++i) {
+    perfmon::EventId id =
+        perfmon::MakeEventId(perfmon::kGroupArch, static_cast<uint16_t>(programmable[i].event + 1));
+    event_ids[programmable[i].counter] = id;
+    config->programmable_events[i] = id;
+    config->programmable_hw_events[i] = programmable[i].event;
+    config->programmable_flags[i] = kCountFlags;
+  }
+  return ZX_OK;
+}
+
+#endif
+
+// Returns the size of the record that starts with |header|, or 0 if it is
+// not a record that we expect to find.
+size_t GetRecordSize(const perfmon::RecordHeader* header) {
+  switch (header->type) {
+    case perfmon::kRecordTypeTime:
+      return sizeof(perfmon::TimeRecord);
+    case perfmon::kRecordTypeTick:
+      return sizeof(perfmon::TickRecord);
+    case perfmon::kRecordTypeCount:
+      return sizeof(perfmon::CountRecord);
+    case perfmon::kRecordTypeValue:
+      return sizeof(perfmon::ValueRecord);
+    default:
+      return 0;
+  }
+}
+
+class PmuCounterSource : public CounterSource {
+ public:
+  explicit PmuCounterSource(zx_handle_t debug_resource)
+      : debug_resource_(debug_resource), data_(new char[kBufferSize]) {
+    for (const char* name : kCounterNames) {
+      counter_names_.push_back(name);
+    }
+  }
+
+  ~PmuCounterSource() override {
+    if (initialized_) {
+      Control(MTRACE_PERFMON_FINI, 0, nullptr, 0);
+    }
+    for (zx_handle_t buffer : buffers_) {
+      zx_handle_close(buffer);
+    }
+  }
+
+  zx_status_t Init() {
+    PmuProperties props;
+    zx_status_t status = Control(MTRACE_PERFMON_GET_PROPERTIES, 0, &props, sizeof(props));
+    if (status != ZX_OK) {
+      return status;
+    }
+    PmuConfig config = {};
+    if ((status = MakeConfig(props, &config, event_ids_)) != ZX_OK) {
+      return status;
+    }
+
+    // This fails if the PMU is already in use.
+    if ((status = Control(MTRACE_PERFMON_INIT, 0, nullptr, 0)) != ZX_OK) {
+      return status;
+    }
+    initialized_ = true;
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    for (uint32_t cpu = 0; cpu < num_cpus; ++cpu) {
+      zx_pmu_buffer_t buffer;
+      if ((status = zx_vmo_create(kBufferSize, 0, &buffer.vmo)) != ZX_OK) {
+        return status;
+      }
+      buffers_.push_back(buffer.vmo);
+      status = Control(MTRACE_PERFMON_ASSIGN_BUFFER, MTRACE_PERFMON_OPTIONS(cpu), &buffer,
+                       sizeof(buffer));
+      if (status != ZX_OK) {
+        return status;
+      }
+    }
+    return Control(MTRACE_PERFMON_STAGE_CONFIG, 0, &config, sizeof(config));
+  }
+
+  const fbl::Vector<fbl::String>& counter_names() const override { return counter_names_; }
+
+  bool Start() override { return Control(MTRACE_PERFMON_START, 0, nullptr, 0) == ZX_OK; }
+
+  bool Stop(fbl::Vector<uint64_t>* counts) override {
+    if (Control(MTRACE_PERFMON_STOP, 0, nullptr, 0) != ZX_OK) {
+      return false;
+    }
+
+    counts->reset();
+    for (size_t i = 0; i < kCounterCount; ++i) {
+      counts->push_back(0);
+    }
+    // Sum up the final value of each counter on each CPU.
+    for (zx_handle_t buffer : buffers_) {
+      char* data = data_.get();
+      if (zx_vmo_read(buffer, data, 0, kBufferSize) != ZX_OK) {
+        return false;
+      }
+      auto* header = reinterpret_cast<const perfmon::BufferHeader*>(data);
+      if ((header->flags & perfmon::BufferHeader::kBufferFlagFull) ||
+          header->capture_end > kBufferSize) {
+        return false;
+      }
+      size_t offset = sizeof(*header);
+      while (offset + sizeof(perfmon::RecordHeader) <= header->capture_end) {
+        auto* record = reinterpret_cast<const perfmon::RecordHeader*>(data + offset);
+        size_t size = GetRecordSize(record);
+        if (size == 0 || offset + size > header->capture_end) {
+          return false;
+        }
+        if (record->type == perfmon::kRecordTypeCount) {
+          auto* count_record = reinterpret_cast<const perfmon::CountRecord*>(record);
+          for (size_t i = 0; i < kCounterCount; ++i) {
+            if (count_record->header.event == event_ids_[i]) {
+              (*counts)[i] += count_record->count;
+            }
+          }
+        }
+        offset += size;
+      }
+    }
+    return true;
+  }
+
+ private:
+  zx_status_t Control(uint32_t action, uint32_t options, void* arg, size_t size) {
+    return zx_mtrace_control(debug_resource_, MTRACE_KIND_PERFMON, action, options, arg, size);
+  }
+
+  const zx_handle_t debug_resource_;
+  fbl::Vector<fbl::String> counter_names_;
+  perfmon::EventId event_ids_[kCounterCount] = {};
+  fbl::Vector<zx_handle_t> buffers_;
+  // Where the contents of each buffer are read to.
+  std::unique_ptr<char[]> data_;
+  bool initialized_ = false;
+};
+
+#endif
+
+}  // namespace
+
+zx_status_t CreatePmuCounterSource(zx_handle_t debug_resource,
+                                   std::unique_ptr<CounterSource>* out) {
+#if defined(__x86_64__) || defined(__aarch64__)
+  auto source = std::make_unique<PmuCounterSource>(debug_resource);
+  zx_status_t status = source->Init();
+  if (status != ZX_OK) {
+    return status;
+  }
+  *out = std::move(source);
+  return ZX_OK;
+#else
+  return ZX_ERR_NOT_SUPPORTED;
+#endif
+}
+
+}  // namespace perftest
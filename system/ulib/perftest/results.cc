@@ -51,21 +51,30 @@ int CompareDoubles(const void* ptr1, const void* ptr2) {
   return 0;
 }
 
-double Median(const fbl::Vector<double>& values) {
-  // Make a sorted copy of the vector.
+fbl::Vector<double> SortedCopy(const fbl::Vector<double>& values) {
   fbl::Vector<double> copy;
   copy.reserve(values.size());
   for (double value : values) {
     copy.push_back(value);
   }
   qsort(copy.data(), copy.size(), sizeof(copy[0]), CompareDoubles);
+  return copy;
+}
 
-  size_t index = copy.size() / 2;
+double Median(const fbl::Vector<double>& sorted) {
+  size_t index = sorted.size() / 2;
   // Interpolate two values if necessary.
-  if (copy.size() % 2 == 0) {
-    return (copy[index - 1] + copy[index]) / 2;
+  if (sorted.size() % 2 == 0) {
+    return (sorted[index - 1] + sorted[index]) / 2;
   }
-  return copy[index];
+  return sorted[index];
+}
+
+// Returns the smallest value that is greater than or equal to |percentile|
+// percent of the values (the nearest-rank method).
+double Percentile(const fbl::Vector<double>& sorted, double percentile) {
+  size_t rank = static_cast<size_t>(ceil(percentile * static_cast<double>(sorted.size()) / 100));
+  return sorted[std::max(rank, size_t{1}) - 1];
 }
 
 }  // namespace
@@ -73,12 +82,15 @@ double Median(const fbl::Vector<double>& values) {
 SummaryStatistics TestCaseResults::GetSummaryStatistics() const {
   ZX_ASSERT(values.size() > 0);
   double mean = Mean(values);
+  fbl::Vector<double> sorted = SortedCopy(values);
   return SummaryStatistics{
       .min = Min(values),
       .max = Max(values),
       .mean = mean,
       .std_dev = StdDev(values, mean),
-      .median = Median(values),
+      .median = Median(sorted),
+      .p99 = Percentile(sorted, 99),
+      .p999 = Percentile(sorted, 99.9),
   };
 }
 
@@ -167,15 +179,16 @@ bool ResultsSet::WriteJSONFile(const char* output_filename) const {
 
 void ResultsSet::PrintSummaryStatistics(FILE* out_file) const {
   // Print table headings row.
-  fprintf(out_file, "%10s %10s %10s %10s %10s %-12s %s\n", "Mean", "Std dev", "Min", "Max",
-          "Median", "Unit", "Test case");
+  fprintf(out_file, "%10s %10s %10s %10s %10s %10s %10s %-12s %s\n", "Mean", "Std dev", "Min",
+          "Max", "Median", "p99", "p99.9", "Unit", "Test case");
   if (results_.size() == 0) {
     fprintf(out_file, "(No test results)\n");
   }
   for (const auto& test : results_) {
     SummaryStatistics stats = test.GetSummaryStatistics();
-    fprintf(out_file, "%10.0f %10.0f %10.0f %10.0f %10.0f %-12s", stats.mean, stats.std_dev,
-            stats.min, stats.max, stats.median, test.unit.c_str());
+    fprintf(out_file, "%10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %-12s", stats.mean,
+            stats.std_dev, stats.min, stats.max, stats.median, stats.p99, stats.p999,
+            test.unit.c_str());
     fprintf(out_file, " %s\n", test.label.c_str());
   }
 }
@@ -5,9 +5,13 @@
 #include <getopt.h>
 
 #if defined(__Fuchsia__)
+#include <fidl/fuchsia.kernel/cpp/wire.h>
+#include <lib/component/incoming/cpp/protocol.h>
 #include <lib/trace-provider/start.h>
 #include <lib/trace/event.h>
+#include <lib/zx/resource.h>
 #include <zircon/assert.h>
+#include <zircon/status.h>
 #include <zircon/syscalls.h>
 #else
 #define TRACE_DURATION(...)
@@ -18,13 +22,17 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
+#include <thread>
 
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
 #include <fbl/vector.h>
+#include <perftest/counters.h>
 #include <perftest/runner.h>
 #include <re2/re2.h>
 
@@ -52,10 +60,42 @@ double GetDurationNanos(Timestamp t1, Timestamp t2) {
 // We don't want g_tests to have a constructor that might get run after
 // items have been added to the list, because that would clobber the list.
 internal::TestList* g_tests;
+std::unique_ptr<CounterSource> g_counter_source;
+
+// Lets the threads of a multi-threaded test start their test runs together.
+class StartBarrier {
+ public:
+  explicit StartBarrier(uint32_t thread_count) : remaining_(thread_count) {}
+
+  // Waits until every other thread has either arrived or left.
+  void Arrive() {
+    std::unique_lock lock(mutex_);
+    if (--remaining_ == 0) {
+      all_arrived_.notify_all();
+      return;
+    }
+    all_arrived_.wait(lock, [this] { return remaining_ == 0; });
+  }
+
+  // Called by a thread that is never going to arrive, e.g. because its
+  // test function failed before its first call to KeepRunning().
+  void Leave() {
+    std::lock_guard lock(mutex_);
+    if (--remaining_ == 0) {
+      all_arrived_.notify_all();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable all_arrived_;
+  uint32_t remaining_;
+};
 
 class RepeatStateImpl : public RepeatState {
  public:
-  explicit RepeatStateImpl(uint32_t run_count) : run_count_(run_count) {}
+  explicit RepeatStateImpl(uint32_t run_count, StartBarrier* start_barrier = nullptr)
+      : run_count_(run_count), start_barrier_(start_barrier) {}
 
   void DeclareStep(const char* name) override {
     if (started_) {
@@ -105,6 +145,16 @@ class RepeatStateImpl : public RepeatState {
       next_idx_ = 1;
       end_of_run_idx_ = step_count_;
       started_ = true;
+      if (start_barrier_) {
+        start_barrier_->Arrive();
+      }
+      if (counters_ && run_count_ != 0) {
+        if (!counters_->Start()) {
+          SetError("Failed to start counters");
+          return false;
+        }
+        counters_running_ = true;
+      }
       timestamps_[0] = Now();
       return run_count_ != 0;
     }
@@ -116,6 +166,7 @@ class RepeatStateImpl : public RepeatState {
       }
       timestamps_[next_idx_] = timestamp;
       finished_ = true;
+      StopCounters();
       return false;
     }
     timestamps_[next_idx_] = timestamp;
@@ -124,22 +175,32 @@ class RepeatStateImpl : public RepeatState {
     return true;
   }
 
+  // Collects |counters| over the test runs.  Must be called before the
+  // test starts.
+  void set_counters(CounterSource* counters) { counters_ = counters; }
+
   // Returns nullptr on success, or an error string on failure.
   const char* RunTestFunc(const char* test_name, const fit::function<TestFunc>& test_func) {
     TRACE_DURATION("perftest", "test_group", "test_name", test_name);
     overall_start_time_ = Now();
     bool result = test_func(this);
     overall_end_time_ = Now();
-    if (error_) {
-      return error_;
-    }
-    if (!finished_) {
-      return "Too few calls to KeepRunning()";
-    }
-    if (!result) {
-      return "Test function returned false";
+    // The counters are still running if the test failed part way through.
+    StopCounters();
+    return CheckResult(result);
+  }
+
+  // Same as RunTestFunc(), for one of the threads of a multi-threaded test.
+  const char* RunThreadFunc(const fit::function<MultiThreadState::ThreadFunc>& thread_func,
+                            uint32_t thread_index) {
+    overall_start_time_ = Now();
+    bool result = thread_func(this, thread_index);
+    overall_end_time_ = Now();
+    if (start_barrier_ && !started_) {
+      // Don't leave the other threads waiting for us.
+      start_barrier_->Leave();
     }
-    return nullptr;
+    return CheckResult(result);
   }
 
   void CopyTimeResults(const char* test_suite, const char* test_name, ResultsSet* dest) const {
@@ -157,6 +218,37 @@ class RepeatStateImpl : public RepeatState {
     }
   }
 
+  // Report the average count of each counter per test run.
+  void CopyCounterResults(const char* test_suite, const char* test_name, ResultsSet* dest) const {
+    if (!counters_ || run_count_ == 0) {
+      return;
+    }
+    const fbl::Vector<fbl::String>& names = counters_->counter_names();
+    ZX_ASSERT(counts_.size() == names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      fbl::String name = fbl::StringPrintf("%s.%s", test_name, names[i].c_str());
+      TestCaseResults* results = dest->AddTestCase(test_suite, name, "count");
+      results->AppendValue(static_cast<double>(counts_[i]) / run_count_);
+    }
+  }
+
+  uint32_t step_count() const { return step_count_; }
+  const fbl::Vector<fbl::String>& step_names() const { return step_names_; }
+
+  // Start time of the first run, and end time of the last run.
+  Timestamp first_run_start_time() const { return timestamps_[0]; }
+  Timestamp last_run_end_time() const { return timestamps_[timestamps_size_ - 1]; }
+
+  void CopyStepTimes(uint32_t start_step_index, uint32_t end_step_index,
+                     TestCaseResults* results) const {
+    // Copy the timing results, converting timestamps to elapsed times.
+    results->values.reserve(results->values.size() + run_count_);
+    for (uint32_t run = 0; run < run_count_; ++run) {
+      results->AppendValue(
+          GetDurationNanos(GetTimestamp(run, start_step_index), GetTimestamp(run, end_step_index)));
+    }
+  }
+
   // Output a trace event for each of the test runs.  Since we do this
   // after the test runs took place (using the timestamps we recorded),
   // we avoid incurring the overhead of the tracing system on each test
@@ -209,6 +301,31 @@ class RepeatStateImpl : public RepeatState {
     }
   }
 
+  void StopCounters() {
+    if (!counters_running_) {
+      return;
+    }
+    counters_running_ = false;
+    if (!counters_->Stop(&counts_)) {
+      SetError("Failed to stop counters");
+    } else if (counts_.size() != counters_->counter_names().size()) {
+      SetError("Counter source returned the wrong number of counts");
+    }
+  }
+
+  const char* CheckResult(bool result) const {
+    if (error_) {
+      return error_;
+    }
+    if (!finished_) {
+      return "Too few calls to KeepRunning()";
+    }
+    if (!result) {
+      return "Test function returned false";
+    }
+    return nullptr;
+  }
+
   // The start and end times of run R are GetTimestamp(R, 0) and
   // GetTimestamp(R+1, 0).
   // The start and end times of step S within run R are GetTimestamp(R,
@@ -220,16 +337,6 @@ class RepeatStateImpl : public RepeatState {
     return timestamps_[index];
   }
 
-  void CopyStepTimes(uint32_t start_step_index, uint32_t end_step_index,
-                     TestCaseResults* results) const {
-    // Copy the timing results, converting timestamps to elapsed times.
-    results->values.reserve(run_count_);
-    for (uint32_t run = 0; run < run_count_; ++run) {
-      results->AppendValue(
-          GetDurationNanos(GetTimestamp(run, start_step_index), GetTimestamp(run, end_step_index)));
-    }
-  }
-
   void CheckStepNamesForDuplicates() {
     // Duplicate step names would result in duplicate test name keys in the
     // output, which would fail to upload to the Catapult Dashboard, so
@@ -251,6 +358,13 @@ class RepeatStateImpl : public RepeatState {
 
   // Number of test runs that we intend to do.
   uint32_t run_count_;
+  // For multi-threaded tests, the barrier that the first call to
+  // KeepRunning() waits on.
+  StartBarrier* start_barrier_;
+  // Counters to collect over the test runs, if any, and their counts.
+  CounterSource* counters_ = nullptr;
+  bool counters_running_ = false;
+  fbl::Vector<uint64_t> counts_;
   // Number of steps per test run.  Once initialized, this is >= 1.
   uint32_t step_count_;
   // Names for steps.  May be empty if the test has only one step.
@@ -277,6 +391,122 @@ class RepeatStateImpl : public RepeatState {
   Timestamp overall_end_time_;
 };
 
+class MultiThreadStateImpl : public MultiThreadState {
+ public:
+  MultiThreadStateImpl(uint32_t thread_count, uint32_t run_count)
+      : thread_count_(thread_count), run_count_(run_count), start_barrier_(thread_count) {}
+
+  uint32_t thread_count() const override { return thread_count_; }
+
+  bool RunThreads(fit::function<ThreadFunc> thread_func) override {
+    if (ran_threads_) {
+      SetError("RunThreads() was called more than once");
+      return false;
+    }
+    ran_threads_ = true;
+
+    fbl::Vector<const char*> errors;
+    for (uint32_t i = 0; i < thread_count_; ++i) {
+      states_.push_back(std::make_unique<RepeatStateImpl>(run_count_, &start_barrier_));
+      errors.push_back(nullptr);
+    }
+    fbl::Vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count_; ++i) {
+      threads.push_back(std::thread(
+          [&, i] { errors[i] = states_[i]->RunThreadFunc(thread_func, i); }));
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    for (const char* error : errors) {
+      if (error) {
+        SetError(error);
+      }
+    }
+    if (!error_) {
+      // The results of each step are merged across threads, so every
+      // thread must have the same steps.
+      for (const auto& state : states_) {
+        if (state->step_count() != states_[0]->step_count() ||
+            state->step_names().size() != states_[0]->step_names().size()) {
+          SetError("Threads declared different numbers of steps");
+          break;
+        }
+        for (uint32_t step = 0; step < state->step_names().size(); ++step) {
+          if (state->step_names()[step] != states_[0]->step_names()[step]) {
+            SetError("Threads declared different step names");
+            break;
+          }
+        }
+      }
+    }
+    return !error_;
+  }
+
+  // Returns nullptr on success, or an error string on failure.
+  const char* RunTestFunc(const char* test_name,
+                          const fit::function<MultiThreadTestFunc>& test_func) {
+    TRACE_DURATION("perftest", "test_group", "test_name", test_name);
+    bool result = test_func(this);
+    if (error_) {
+      return error_;
+    }
+    if (!ran_threads_) {
+      return "RunThreads() was not called";
+    }
+    if (!result) {
+      return "Test function returned false";
+    }
+    return nullptr;
+  }
+
+  void CopyTimeResults(const char* test_suite, const char* test_name, ResultsSet* dest) const {
+    const RepeatStateImpl& first = *states_[0];
+    if (first.step_count() == 1) {
+      TestCaseResults* results = dest->AddTestCase(test_suite, test_name, "nanoseconds");
+      for (const auto& state : states_) {
+        state->CopyStepTimes(0, 1, results);
+      }
+    } else {
+      for (uint32_t step = 0; step < first.step_count(); ++step) {
+        fbl::String name = fbl::StringPrintf("%s.%s", test_name, first.step_names()[step].c_str());
+        TestCaseResults* results = dest->AddTestCase(test_suite, name, "nanoseconds");
+        for (const auto& state : states_) {
+          state->CopyStepTimes(step, step + 1, results);
+        }
+      }
+    }
+
+    // The threads start together, but may well finish at different times.
+    Timestamp start = first.first_run_start_time();
+    Timestamp end = first.last_run_end_time();
+    for (const auto& state : states_) {
+      start = std::min(start, state->first_run_start_time());
+      end = std::max(end, state->last_run_end_time());
+    }
+    double total_runs = static_cast<double>(thread_count_) * static_cast<double>(run_count_);
+    fbl::String name = fbl::StringPrintf("%s.throughput", test_name);
+    TestCaseResults* results = dest->AddTestCase(test_suite, name, "runs/second");
+    results->AppendValue(total_runs * 1e9 / GetDurationNanos(start, end));
+  }
+
+ private:
+  void SetError(const char* str) {
+    if (!error_) {
+      error_ = str;
+    }
+  }
+
+  const uint32_t thread_count_;
+  const uint32_t run_count_;
+  StartBarrier start_barrier_;
+  fbl::Vector<std::unique_ptr<RepeatStateImpl>> states_;
+  bool ran_threads_ = false;
+  // error_ is set to non-null if an error occurs.
+  const char* error_ = nullptr;
+};
+
 bool CompareTestNames(internal::NamedTest* test1, internal::NamedTest* test2) {
   return test1->name < test2->name;
 }
@@ -295,6 +525,7 @@ bool RunTest(const char* test_suite, const char* test_name,
              const fit::function<TestFunc>& test_func, uint32_t run_count, ResultsSet* results_set,
              fbl::String* error_out) {
   RepeatStateImpl state(run_count);
+  state.set_counters(g_counter_source.get());
   const char* error = state.RunTestFunc(test_name, test_func);
   if (error) {
     if (error_out) {
@@ -304,10 +535,44 @@ bool RunTest(const char* test_suite, const char* test_name,
   }
 
   state.CopyTimeResults(test_suite, test_name, results_set);
+  state.CopyCounterResults(test_suite, test_name, results_set);
   state.WriteTraceEvents();
   return true;
 }
 
+void SetCounterSource(std::unique_ptr<CounterSource> source) {
+  g_counter_source = std::move(source);
+}
+
+void RegisterMultiThreadTest(const char* name, uint32_t thread_count,
+                             fit::function<MultiThreadTestFunc> test_func) {
+  ZX_ASSERT(thread_count > 0);
+  if (!g_tests) {
+    g_tests = new internal::TestList;
+  }
+  internal::NamedTest new_test{
+      .name = name, .thread_count = thread_count, .multi_thread_test_func = std::move(test_func)};
+  g_tests->push_back(std::move(new_test));
+}
+
+bool RunMultiThreadTest(const char* test_suite, const char* test_name, uint32_t thread_count,
+                        const fit::function<MultiThreadTestFunc>& test_func, uint32_t run_count,
+                        ResultsSet* results_set, fbl::String* error_out) {
+  // Trace events are not written for multi-threaded tests: writing them
+  // for one thread once it is done could disturb the others.
+  MultiThreadStateImpl state(thread_count, run_count);
+  const char* error = state.RunTestFunc(test_name, test_func);
+  if (error) {
+    if (error_out) {
+      *error_out = error;
+    }
+    return false;
+  }
+
+  state.CopyTimeResults(test_suite, test_name, results_set);
+  return true;
+}
+
 namespace internal {
 
 bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
@@ -362,8 +627,13 @@ bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
     }
 
     fbl::String error_string;
-    if (!RunTest(test_suite, test_name, test_case->test_func, run_count, results_set,
-                 &error_string)) {
+    bool passed = test_case->multi_thread_test_func
+                      ? RunMultiThreadTest(test_suite, test_name, test_case->thread_count,
+                                           test_case->multi_thread_test_func, run_count,
+                                           results_set, &error_string)
+                      : RunTest(test_suite, test_name, test_case->test_func, run_count,
+                                results_set, &error_string);
+    if (!passed) {
       fprintf(log_stream, "Error: %s\n", error_string.c_str());
       fprintf(log_stream, "[  FAILED  ] %s\n", test_name);
       fflush(log_stream);
@@ -395,6 +665,7 @@ void ParseCommandArgs(int argc, char** argv, CommandArgs* dest) {
 #if defined(__Fuchsia__)
     {"enable-tracing", no_argument, nullptr, 't'},
     {"startup-delay", required_argument, nullptr, 'd'},
+    {"pmu", no_argument, nullptr, 'c'},
 #endif
   };
   optind = 1;
@@ -444,6 +715,9 @@ void ParseCommandArgs(int argc, char** argv, CommandArgs* dest) {
         dest->startup_delay_seconds = val;
         break;
       }
+      case 'c':
+        dest->enable_pmu = true;
+        break;
 #endif
       default:
         // getopt_long() will have printed an error already.
@@ -456,8 +730,36 @@ void ParseCommandArgs(int argc, char** argv, CommandArgs* dest) {
   }
 }
 
+#if defined(__Fuchsia__)
+bool EnablePmuCounters(zx_handle_t debug_resource, FILE* log_stream) {
+  std::unique_ptr<CounterSource> source;
+  zx_status_t status = CreatePmuCounterSource(debug_resource, &source);
+  if (status != ZX_OK) {
+    fprintf(log_stream, "PMU counters are not available: %s\n", zx_status_get_string(status));
+    return false;
+  }
+  SetCounterSource(std::move(source));
+  return true;
+}
+#endif
+
 }  // namespace internal
 
+#if defined(__Fuchsia__)
+static zx_status_t GetDebugResource(zx::resource* out) {
+  zx::result client = component::Connect<fuchsia_kernel::DebugResource>();
+  if (client.is_error()) {
+    return client.status_value();
+  }
+  fidl::WireResult result = fidl::WireCall(*client)->Get();
+  if (!result.ok()) {
+    return result.status();
+  }
+  *out = std::move(result.value().resource);
+  return ZX_OK;
+}
+#endif
+
 static bool PerfTestMode(const char* test_suite, int argc, char** argv) {
   internal::CommandArgs args;
   internal::ParseCommandArgs(argc, argv, &args);
@@ -468,6 +770,20 @@ static bool PerfTestMode(const char* test_suite, int argc, char** argv) {
   }
   zx_duration_t duration = static_cast<zx_duration_t>(ZX_SEC(1) * args.startup_delay_seconds);
   zx_nanosleep(zx_deadline_after(duration));
+
+  if (args.enable_pmu) {
+    zx::resource debug_resource;
+    zx_status_t status = GetDebugResource(&debug_resource);
+    if (status != ZX_OK) {
+      fprintf(stderr, "Getting the debug resource failed: %s\n", zx_status_get_string(status));
+      return false;
+    }
+    // The counters use the resource until they are destroyed at exit, so it
+    // is deliberately never closed.
+    if (!internal::EnablePmuCounters(debug_resource.release(), stderr)) {
+      return false;
+    }
+  }
 #endif
 
   ResultsSet results;
@@ -536,6 +852,13 @@ int PerfTestMain(int argc, char** argv, const char* test_suite) {
         "a TraceProvider.  This allows working around a race condition "
         "where tracing misses initial events from newly-registered "
         "TraceProviders (see https://fxbug.dev/42096938).\n"
+        "  --pmu\n"
+        "      Also report the cycles, instructions retired, last level "
+        "cache misses and mispredicted branches of each single-threaded "
+        "test, as averages per run, using the CPU's performance monitoring "
+        "unit.  This needs the fuchsia.kernel.DebugResource protocol, and "
+        "fails where the kernel has no PMU support.  The counts cover "
+        "every CPU, so they include any other activity on the system.\n"
 #endif
         ,
         argv[0], argv[0]);
@@ -61,6 +61,29 @@ TEST(PerfTestResults, TestSummaryStatistics) {
   EXPECT_EQ(stats.median, 110);
 }
 
+TEST(PerfTestResults, TestPercentiles) {
+  perftest::ResultsSet results;
+  perftest::TestCaseResults* test_case =
+      results.AddTestCase("results_test", "ExampleNullSyscall", "nanoseconds");
+  // Add the values 1 to 1000 in a non-sorted order.
+  for (int i = 0; i < 1000; ++i) {
+    test_case->AppendValue((i * 7) % 1000 + 1);
+  }
+
+  perftest::SummaryStatistics stats = test_case->GetSummaryStatistics();
+  EXPECT_EQ(stats.p99, 990);
+  EXPECT_EQ(stats.p999, 999);
+
+  // With few values, the tail percentiles are the maximum.
+  perftest::TestCaseResults* small_case =
+      results.AddTestCase("results_test", "ExampleSmall", "nanoseconds");
+  small_case->AppendValue(5);
+  small_case->AppendValue(3);
+  stats = small_case->GetSummaryStatistics();
+  EXPECT_EQ(stats.p99, 5);
+  EXPECT_EQ(stats.p999, 5);
+}
+
 // Test escaping special characters in strings in JSON output.
 TEST(PerfTestResults, TestJsonStringEscaping) {
   char buf[1000];
@@ -6,11 +6,13 @@
 
 #include <algorithm>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <fbl/algorithm.h>
+#include <perftest/counters.h>
 #include <perftest/perftest.h>
 #include <perftest/runner.h>
 #include <zxtest/zxtest.h>
@@ -162,6 +164,153 @@ TEST(PerfTestRunner, TestMultistepTest) {
   }
 }
 
+static bool MultiThreadTest(perftest::MultiThreadState* state) {
+  return state->RunThreads([](perftest::RepeatState* state, uint32_t thread_index) {
+    state->DeclareStep("step1");
+    state->DeclareStep("step2");
+    while (state->KeepRunning()) {
+      state->NextStep();
+    }
+    return true;
+  });
+}
+
+// Test that the results of the threads of a multi-threaded test are
+// merged, and that a throughput figure is reported.
+TEST(PerfTestRunner, TestMultiThreadTest) {
+  const uint32_t kThreadCount = 3;
+  perftest::internal::TestList test_list;
+  perftest::internal::NamedTest test{.name = "example_test",
+                                     .thread_count = kThreadCount,
+                                     .multi_thread_test_func = MultiThreadTest};
+  test_list.push_back(std::move(test));
+
+  const uint32_t kRunCount = 7;
+  perftest::ResultsSet results;
+  DummyOutputStream out;
+  EXPECT_TRUE(
+      perftest::internal::RunTests("test-suite", &test_list, kRunCount, "", out.fp(), &results));
+  ASSERT_EQ(results.results()->size(), 3);
+  EXPECT_STREQ((*results.results())[0].label.c_str(), "example_test.step1");
+  EXPECT_STREQ((*results.results())[1].label.c_str(), "example_test.step2");
+  for (size_t i = 0; i < 2; ++i) {
+    auto* test_case = &(*results.results())[i];
+    EXPECT_EQ(test_case->values.size(), kRunCount * kThreadCount);
+    EXPECT_TRUE(check_times(test_case));
+  }
+  auto* throughput = &(*results.results())[2];
+  EXPECT_STREQ(throughput->label.c_str(), "example_test.throughput");
+  EXPECT_STREQ(throughput->unit.c_str(), "runs/second");
+  ASSERT_EQ(throughput->values.size(), 1);
+  EXPECT_GT(throughput->values[0], 0);
+}
+
+// Test that a failure in any one thread fails the whole test, without
+// leaving the other threads stuck waiting to start.
+TEST(PerfTestRunner, TestFailingMultiThreadTest) {
+  auto test_func = [](perftest::MultiThreadState* state) {
+    return state->RunThreads([](perftest::RepeatState* state, uint32_t thread_index) {
+      if (thread_index == 1) {
+        return false;
+      }
+      while (state->KeepRunning()) {
+      }
+      return true;
+    });
+  };
+
+  perftest::internal::TestList test_list;
+  perftest::internal::NamedTest test{
+      .name = "example_test", .thread_count = 4, .multi_thread_test_func = test_func};
+  test_list.push_back(std::move(test));
+
+  const uint32_t kRunCount = 7;
+  perftest::ResultsSet results;
+  DummyOutputStream out;
+  EXPECT_FALSE(
+      perftest::internal::RunTests("test-suite", &test_list, kRunCount, "", out.fp(), &results));
+  EXPECT_EQ(results.results()->size(), 0);
+}
+
+// Software stand-in for hardware event counters, for testing the counter
+// plumbing.  It counts the events that tests report by incrementing
+// g_fake_events.
+static uint64_t g_fake_events;
+
+class FakeCounterSource : public perftest::CounterSource {
+ public:
+  explicit FakeCounterSource(bool fail_start = false) : fail_start_(fail_start) {
+    names_.push_back("events");
+  }
+
+  const fbl::Vector<fbl::String>& counter_names() const override { return names_; }
+
+  bool Start() override {
+    start_value_ = g_fake_events;
+    return !fail_start_;
+  }
+
+  bool Stop(fbl::Vector<uint64_t>* counts) override {
+    counts->reset();
+    counts->push_back(g_fake_events - start_value_);
+    return true;
+  }
+
+ private:
+  fbl::Vector<fbl::String> names_;
+  bool fail_start_;
+  uint64_t start_value_ = 0;
+};
+
+static bool CountingTest(perftest::RepeatState* state) {
+  // Events during setup and teardown should not be counted.
+  g_fake_events += 100;
+  while (state->KeepRunning()) {
+    g_fake_events += 3;
+  }
+  g_fake_events += 100;
+  return true;
+}
+
+// Test that counters are reported as an average per run.
+TEST(PerfTestRunner, TestCounters) {
+  perftest::SetCounterSource(std::make_unique<FakeCounterSource>());
+  perftest::internal::TestList test_list;
+  perftest::internal::NamedTest test{"example_test", CountingTest};
+  test_list.push_back(std::move(test));
+
+  const uint32_t kRunCount = 7;
+  perftest::ResultsSet results;
+  DummyOutputStream out;
+  EXPECT_TRUE(
+      perftest::internal::RunTests("test-suite", &test_list, kRunCount, "", out.fp(), &results));
+  perftest::SetCounterSource(nullptr);
+
+  ASSERT_EQ(results.results()->size(), 2);
+  EXPECT_STREQ((*results.results())[0].label.c_str(), "example_test");
+  auto* counter_case = &(*results.results())[1];
+  EXPECT_STREQ(counter_case->label.c_str(), "example_test.events");
+  EXPECT_STREQ(counter_case->unit.c_str(), "count");
+  ASSERT_EQ(counter_case->values.size(), 1);
+  EXPECT_EQ(counter_case->values[0], 3);
+}
+
+// Test that a test fails if its counters cannot be started.
+TEST(PerfTestRunner, TestCountersFailToStart) {
+  perftest::SetCounterSource(std::make_unique<FakeCounterSource>(/*fail_start=*/true));
+  perftest::internal::TestList test_list;
+  perftest::internal::NamedTest test{"example_test", CountingTest};
+  test_list.push_back(std::move(test));
+
+  const uint32_t kRunCount = 7;
+  perftest::ResultsSet results;
+  DummyOutputStream out;
+  EXPECT_FALSE(
+      perftest::internal::RunTests("test-suite", &test_list, kRunCount, "", out.fp(), &results));
+  perftest::SetCounterSource(nullptr);
+  EXPECT_EQ(results.results()->size(), 0);
+}
+
 static bool MultistepTestWithDuplicateNames(perftest::RepeatState* state) {
   // These duplicate names should be caught as an error.
   state->DeclareStep("step1");
@@ -331,7 +480,8 @@ TEST(PerfTestRunner, TestParsingCommandArgs) {
     "--quiet",
 #if defined(__Fuchsia__)
     "--enable-tracing",
-    "--startup-delay=456"
+    "--startup-delay=456",
+    "--pmu",
 #endif
   };
   perftest::internal::CommandArgs args;
@@ -343,5 +493,22 @@ TEST(PerfTestRunner, TestParsingCommandArgs) {
 #if defined(__Fuchsia__)
   EXPECT_TRUE(args.enable_tracing);
   EXPECT_EQ(args.startup_delay_seconds, 456);
+  EXPECT_TRUE(args.enable_pmu);
 #endif
 }
+
+#if defined(__Fuchsia__)
+// Test that asking for PMU counters without the debug resource fails cleanly,
+// and leaves the runner collecting no counters.
+TEST(PerfTestRunner, TestPmuCountersNeedDebugResource) {
+  DummyOutputStream out;
+  EXPECT_FALSE(perftest::internal::EnablePmuCounters(ZX_HANDLE_INVALID, out.fp()));
+
+  perftest::internal::TestList test_list;
+  perftest::internal::NamedTest test{"example_test", NoOpTest};
+  test_list.push_back(std::move(test));
+  perftest::ResultsSet results;
+  EXPECT_TRUE(perftest::internal::RunTests("test-suite", &test_list, 3, "", out.fp(), &results));
+  EXPECT_EQ(results.results()->size(), 1);
+}
+#endif
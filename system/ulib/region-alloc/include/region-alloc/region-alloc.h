@@ -5,6 +5,7 @@
 #ifndef REGION_ALLOC_REGION_ALLOC_H_
 #define REGION_ALLOC_REGION_ALLOC_H_
 
+#include <lib/stdcompat/bit.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <zircon/compiler.h>
@@ -20,6 +21,7 @@
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/slab_allocator.h>
+#include <fbl/wavl_tree_best_node_observer.h>
 
 // RegionAllocator
 //
@@ -147,6 +149,10 @@ class RegionAllocator {
  public:
   static constexpr uint64_t kRegionPoolSlabSize = (4u << 10);
 
+  // The number of regions AllocPolicy::AlignedFit checks in size order before
+  // falling back to its index of base address alignment.
+  static constexpr size_t kAlignedFitProbes = 8;
+
   // An enum which selects which set of regions to test against when testing for
   // intersection or containment.  See TestRegionIntersect and
   // TestRegionContains for examples.
@@ -167,6 +173,35 @@ class RegionAllocator {
     Yes,
   };
 
+  // Selects how GetRegion(size, alignment) chooses among the available
+  // regions.  See SetAllocPolicy.
+  enum class AllocPolicy {
+    // Use the smallest available region which can hold the allocation once
+    // its base has been aligned.  Finding it may mean visiting every
+    // available region which is large enough to hold the allocation, but not
+    // once aligned, so this can be slow when the available space is
+    // fragmented into many small, misaligned regions.
+    BestFit,
+
+    // A fast approximation of BestFit, for allocators whose available space
+    // is split into many small, misaligned regions.
+    //
+    // The first kAlignedFitProbes regions which are large enough are checked
+    // in size order, just as BestFit would check them, and the first which can
+    // hold the allocation once aligned is used.  If none of them can, the
+    // smaller of two regions is used: the smallest region whose base address
+    // is already aligned, and the smallest region of at least
+    // |size + alignment - 1| bytes, which can hold the allocation however its
+    // base is aligned.  Both are found in O(log n) time using an index of base
+    // address alignment kept alongside the size index.
+    //
+    // The fallback skips misaligned regions which are too small to hold the
+    // allocation whatever their alignment, but which BestFit could still use,
+    // so it may use a much larger region than BestFit.  AlignedFit succeeds
+    // whenever BestFit does.
+    AlignedFit,
+  };
+
   class Region;
   using RegionSlabTraits =
       fbl::ManualDeleteSlabAllocatorTraits<Region*, kRegionPoolSlabSize, fbl::Mutex,
@@ -186,6 +221,17 @@ class RegionAllocator {
    private:
     using KeyTraitsSortByBase = fbl::DefaultKeyedObjectTraits<uint64_t, Region>;
 
+    // Maintains, for each node of the size index, the largest base address
+    // alignment (as a power of two) of any region in its subtree.  This lets
+    // AlignedFit find the first sufficiently aligned region in O(log n).
+    struct SubtreeMaxAlignTraits {
+      static uint8_t GetValue(const Region& r) { return r.BaseAlignment(); }
+      static uint8_t GetSubtreeBest(const Region& r) { return r.subtree_max_align_; }
+      static bool Compare(uint8_t a, uint8_t b) { return a > b; }
+      static void AssignBest(Region& r, uint8_t val) { r.subtree_max_align_ = val; }
+      static void ResetBest(Region& r) {}
+    };
+
     struct KeyTraitsSortBySize {
       static const ralloc_region_t& GetKey(const Region& r) { return r; }
 
@@ -227,16 +273,22 @@ class RegionAllocator {
     using WAVLTreeSortByBase =
         fbl::TaggedWAVLTree<uint64_t, Region*, SortByBaseTag, KeyTraitsSortByBase>;
     using WAVLTreeSortBySize =
-        fbl::TaggedWAVLTree<ralloc_region_t, Region*, SortBySizeTag, KeyTraitsSortBySize>;
+        fbl::TaggedWAVLTree<ralloc_region_t, Region*, SortBySizeTag, KeyTraitsSortBySize,
+                            fbl::WAVLTreeBestNodeObserver<SubtreeMaxAlignTraits>>;
 
     // Used by SortByBase key traits
     uint64_t GetKey() const { return base; }
 
+    // Returns log2 of the largest power of two which divides base, or 64 if
+    // base is zero.
+    uint8_t BaseAlignment() const { return static_cast<uint8_t>(cpp20::countr_zero(base)); }
+
     // So many friends!  I'm the most popular class in the build!!
     friend class RegionAllocator;
     friend class RegionPool;
     friend KeyTraitsSortByBase;
     friend struct KeyTraitsSortBySize;
+    friend struct SubtreeMaxAlignTraits;
     friend class fbl::SlabAllocator<RegionSlabTraits>;
 
     // Regions can only be either placement new'ed by the RegionPool slab
@@ -248,6 +300,8 @@ class RegionAllocator {
     DISALLOW_COPY_ASSIGN_AND_MOVE(Region);
 
     RegionAllocator* owner_;
+    // Only meaningful while the region is in the available size index.
+    uint8_t subtree_max_align_ = 0;
   };
 
   class RegionPool : public fbl::RefCounted<RegionPool>,
@@ -298,6 +352,13 @@ class RegionAllocator {
     return (region_pool_ != nullptr);
   }
 
+  // Set the policy used to choose a region for size/alignment based
+  // allocations.  The default is AllocPolicy::BestFit.
+  void SetAllocPolicy(AllocPolicy policy) __TA_EXCLUDES(alloc_lock_) {
+    fbl::AutoLock alloc_lock(&alloc_lock_);
+    alloc_policy_ = policy;
+  }
+
   // Reset allocator.  Releases all available regions, but has no effect on
   // currently allocated regions.
   void Reset() __TA_EXCLUDES(alloc_lock_);
@@ -349,7 +410,8 @@ class RegionAllocator {
 
   // Get a region out of the set of currently available regions which has a
   // specified size and alignment.  Note; the alignment must be a power of
-  // two.  Pass 1 if alignment does not matter.
+  // two.  Pass 1 if alignment does not matter.  The available region it is
+  // taken from is chosen according to the allocator's AllocPolicy.
   //
   // Possible return values
   // ++ ZX_ERR_NO_MEMORY : not enough bookkeeping memory available in our
@@ -482,6 +544,19 @@ class RegionAllocator {
   void AddRegionToAvailLocked(Region* region, AllowOverlap allow_overlap = AllowOverlap::No)
       __TA_REQUIRES(alloc_lock_);
 
+  // Returns the available region chosen by AllocPolicy::AlignedFit for an
+  // allocation of |size| bytes aligned to |alignment|, or an invalid iterator
+  // if there is none.
+  Region::WAVLTreeSortBySize::iterator FindAlignedFitLocked(uint64_t size, uint64_t alignment)
+      __TA_REQUIRES(alloc_lock_);
+
+  // Returns the first region in the size index which sorts at or after |key|
+  // and whose base is aligned to at least 2^|align_log2|, or an invalid
+  // iterator if there is none.
+  Region::WAVLTreeSortBySize::iterator FindFirstAlignedLocked(const ralloc_region_t& key,
+                                                              uint8_t align_log2)
+      __TA_REQUIRES(alloc_lock_);
+
   zx_status_t AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
                                    Region::UPtr& out_region, uint64_t base, uint64_t size)
       __TA_REQUIRES(alloc_lock_);
@@ -517,6 +592,7 @@ class RegionAllocator {
   Region::WAVLTreeSortByBase avail_regions_by_base_ __TA_GUARDED(alloc_lock_);
   Region::WAVLTreeSortBySize avail_regions_by_size_ __TA_GUARDED(alloc_lock_);
   RegionPool::RefPtr region_pool_ __TA_GUARDED(alloc_lock_);
+  AllocPolicy alloc_policy_ __TA_GUARDED(alloc_lock_) = AllocPolicy::BestFit;
 };
 
 #endif  // REGION_ALLOC_REGION_ALLOC_H_
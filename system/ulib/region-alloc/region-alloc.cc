@@ -293,6 +293,14 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size, uint64_t alignment,
   uint64_t mask = alignment - 1;
   uint64_t inv_mask = ~mask;
 
+  if (alloc_policy_ == AllocPolicy::AlignedFit) {
+    auto iter = FindAlignedFitLocked(size, alignment);
+    if (!iter.IsValid()) {
+      return ZX_ERR_NOT_FOUND;
+    }
+    return AllocFromAvailLocked(iter, out_region, (iter->base + mask) & inv_mask, size);
+  }
+
   // Start by using our size index to look up the first available region which
   // is large enough to hold this allocation (if any)
   auto iter = avail_regions_by_size_.lower_bound({.base = 0, .size = size});
@@ -407,6 +415,93 @@ void RegionAllocator::ReleaseRegion(Region* region) {
   AddRegionToAvailLocked(region);
 }
 
+RegionAllocator::Region::WAVLTreeSortBySize::iterator RegionAllocator::FindAlignedFitLocked(
+    uint64_t size, uint64_t alignment) {
+  uint64_t mask = alignment - 1;
+  auto fits = [size, mask](const Region& r) {
+    uint64_t aligned_base = (r.base + mask) & ~mask;
+    return (aligned_base >= r.base) && (aligned_base - r.base <= r.size - size);
+  };
+
+  // Check the smallest few regions which are large enough, as BestFit would.
+  // The first of them which fits is exactly the region BestFit would use.
+  auto iter = avail_regions_by_size_.lower_bound({.base = 0, .size = size});
+  for (size_t i = 0; i < kAlignedFitProbes && iter.IsValid(); ++i, ++iter) {
+    if (fits(*iter)) {
+      return iter;
+    }
+  }
+  if (!iter.IsValid()) {
+    return iter;
+  }
+
+  // Otherwise, use the first region (in size order) which either has an
+  // aligned base, or is so large that it will hold the allocation no matter
+  // how its base is aligned.  Look for each of them and take whichever comes
+  // first.  Both sort after the regions checked above, since they would have
+  // fit.
+  auto aligned = FindFirstAlignedLocked({.base = 0, .size = size},
+                                        static_cast<uint8_t>(cpp20::countr_zero(alignment)));
+  auto any = avail_regions_by_size_.end();
+  if (size + mask >= size) {
+    any = avail_regions_by_size_.lower_bound({.base = 0, .size = size + mask});
+    ZX_DEBUG_ASSERT(!any.IsValid() || fits(*any));
+  }
+
+  if (!aligned.IsValid()) {
+    return any;
+  }
+  if (!any.IsValid()) {
+    return aligned;
+  }
+  return Region::KeyTraitsSortBySize::LessThan(*aligned, *any) ? aligned : any;
+}
+
+RegionAllocator::Region::WAVLTreeSortBySize::iterator RegionAllocator::FindFirstAlignedLocked(
+    const ralloc_region_t& key, uint8_t align_log2) {
+  // Walk down the search path for |key|.  Each time we go left, the node we
+  // leave and its right subtree sort after |key|, and before any candidate
+  // we have already recorded.  Remember the first of them which holds an
+  // aligned region: either the node itself, or its right subtree.
+  auto node = avail_regions_by_size_.root();
+  auto found = avail_regions_by_size_.end();
+  bool found_subtree = false;
+  while (node.IsValid()) {
+    if (Region::KeyTraitsSortBySize::LessThan(*node, key)) {
+      node = node.right();
+      continue;
+    }
+
+    if (node->BaseAlignment() >= align_log2) {
+      found = node;
+      found_subtree = false;
+    } else if (auto right = node.right();
+               right.IsValid() && (right->subtree_max_align_ >= align_log2)) {
+      found = right;
+      found_subtree = true;
+    }
+    node = node.left();
+  }
+
+  if (!found_subtree) {
+    return found;
+  }
+
+  // Every region in the subtree we found sorts after |key|, so we just need
+  // its first aligned region.
+  node = found;
+  while (true) {
+    ZX_DEBUG_ASSERT(node.IsValid() && (node->subtree_max_align_ >= align_log2));
+    if (auto left = node.left(); left.IsValid() && (left->subtree_max_align_ >= align_log2)) {
+      node = left;
+    } else if (node->BaseAlignment() >= align_log2) {
+      return node;
+    } else {
+      node = node.right();
+    }
+  }
+}
+
 zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
                                                   Region::UPtr& out_region, uint64_t base,
                                                   uint64_t size) {
@@ -0,0 +1,115 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/assert.h>
+
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+#include <region-alloc/region-alloc.h>
+
+namespace {
+
+// Number of available regions the address space is fragmented into.
+constexpr uint32_t kNumRegions = 100000;
+
+constexpr uint64_t kPageSize = 4096;
+
+// How the available regions are laid out.
+enum class Layout {
+  // Every region is two pages long and starts one page past a 64 page
+  // boundary, so none of them can hold a page sized allocation aligned to 64
+  // pages.  Only the last region, which is larger and aligned, can.  This is
+  // the worst case for a search which visits the candidates in size order.
+  Misaligned,
+  // Regions of between one and 64 pages, at page aligned bases.
+  Random,
+};
+
+// Fills |alloc| with kNumRegions regions laid out according to |layout|.
+void Fragment(RegionAllocator* alloc, Layout layout) {
+  uint64_t seed = 0x853c49e6748fea9b;
+  auto next = [&seed](uint64_t max) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    return (seed >> 33) % max;
+  };
+
+  uint64_t base = 0x100000000;
+  for (uint32_t i = 0; i < kNumRegions; i++) {
+    ralloc_region_t region;
+    if (layout == Layout::Misaligned) {
+      if (i == kNumRegions - 1) {
+        region = {.base = base, .size = 128 * kPageSize};
+      } else {
+        region = {.base = base + kPageSize, .size = 2 * kPageSize};
+      }
+      base += 64 * kPageSize;
+    } else {
+      region = {.base = base + next(64) * kPageSize, .size = (next(64) + 1) * kPageSize};
+      // Leave a gap after each region, so that they do not merge.
+      base = region.base + region.size + kPageSize;
+    }
+    ZX_ASSERT(alloc->AddRegion(region) == ZX_OK);
+  }
+}
+
+// Measure the time taken to allocate, and then free, a region from an address space fragmented
+// according to |layout|.
+bool GetRegionTest(perftest::RepeatState* state, Layout layout,
+                   RegionAllocator::AllocPolicy policy) {
+  state->DeclareStep("get");
+  state->DeclareStep("put");
+
+  RegionAllocator alloc;
+  alloc.SetAllocPolicy(policy);
+  Fragment(&alloc, layout);
+
+  uint64_t seed = 0xda3e39cb94b95bdb;
+  while (state->KeepRunning()) {
+    uint64_t size = kPageSize;
+    uint64_t alignment = 64 * kPageSize;
+    if (layout == Layout::Random) {
+      seed = seed * 6364136223846793005 + 1442695040888963407;
+      size = ((seed >> 33) % 16 + 1) * kPageSize;
+      alignment = kPageSize << ((seed >> 40) % 5);
+    }
+    RegionAllocator::Region::UPtr region;
+    ZX_ASSERT(alloc.GetRegion(size, alignment, region) == ZX_OK);
+    state->NextStep();
+    region.reset();
+  }
+
+  alloc.Reset();
+  return true;
+}
+
+void RegisterTests() {
+  static const struct {
+    Layout layout;
+    const char* name;
+  } kLayouts[] = {
+      {Layout::Misaligned, "Misaligned"},
+      {Layout::Random, "Random"},
+  };
+  static const struct {
+    RegionAllocator::AllocPolicy policy;
+    const char* name;
+  } kPolicies[] = {
+      {RegionAllocator::AllocPolicy::BestFit, "BestFit"},
+      {RegionAllocator::AllocPolicy::AlignedFit, "AlignedFit"},
+  };
+  for (const auto& layout : kLayouts) {
+    for (const auto& policy : kPolicies) {
+      auto name = fbl::StringPrintf("RegionAlloc/GetRegion/%s/%uregions/%s", layout.name,
+                                    kNumRegions, policy.name);
+      perftest::RegisterTest(name.c_str(), GetRegionTest, layout.layout, policy.policy);
+    }
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  return perftest::PerfTestMain(argc, argv, "fuchsia.region_alloc");
+}
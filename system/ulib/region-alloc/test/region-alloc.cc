@@ -499,4 +499,147 @@ TEST(RegionAllocCppApiTestCase, TestRegionFromHeap) {
   ASSERT_NO_FAILURES(TestRegionHelper(TestFlavor::UseHeap));
 }
 
+TEST(RegionAllocCppApiTestCase, AlignedFitPolicy) {
+  RegionAllocator best_fit;
+  RegionAllocator aligned_fit;
+  aligned_fit.SetAllocPolicy(RegionAllocator::AllocPolicy::AlignedFit);
+
+  const ralloc_region_t regions[] = {
+      // Too small to hold a 64KB aligned allocation of 4KB.
+      {.base = 0x51000, .size = 0x1000},
+      // Misaligned, but just large enough.
+      {.base = 0x1f800, .size = 0x1800},
+      // Aligned.
+      {.base = 0x40000, .size = 0x2000},
+      // Large enough for any alignment.
+      {.base = 0x101000, .size = 0x20000},
+  };
+  for (const auto& region : regions) {
+    ASSERT_OK(best_fit.AddRegion(region));
+    ASSERT_OK(aligned_fit.AddRegion(region));
+  }
+
+  {
+    // When the smallest region which is large enough fits, both use it.
+    RegionAllocator::Region::UPtr r1, r2;
+    ASSERT_OK(best_fit.GetRegion(0x1000, 0x1000, r1));
+    EXPECT_EQ(0x51000u, r1->base);
+    ASSERT_OK(aligned_fit.GetRegion(0x1000, 0x1000, r2));
+    EXPECT_EQ(0x51000u, r2->base);
+  }
+
+  // The misaligned region is among the first few checked, so both use it.
+  RegionAllocator::Region::UPtr r1, r2;
+  ASSERT_OK(best_fit.GetRegion(0x1000, 0x10000, r1));
+  EXPECT_EQ(0x20000u, r1->base);
+  ASSERT_OK(aligned_fit.GetRegion(0x1000, 0x10000, r2));
+  EXPECT_EQ(0x20000u, r2->base);
+
+  RegionAllocator::Region::UPtr r3;
+  ASSERT_OK(aligned_fit.GetRegion(0x1000, 0x10000, r3));
+  EXPECT_EQ(0x40000u, r3->base);
+
+  RegionAllocator::Region::UPtr r4;
+  ASSERT_OK(aligned_fit.GetRegion(0x1000, 0x10000, r4));
+  EXPECT_EQ(0x110000u, r4->base);
+
+  RegionAllocator::Region::UPtr r5;
+  EXPECT_EQ(ZX_ERR_NOT_FOUND, aligned_fit.GetRegion(0x1000, 0x1000000, r5));
+  EXPECT_NULL(r5.get());
+}
+
+// Compares AlignedFit against BestFit over a fragmented set of regions.
+// AlignedFit must succeed whenever BestFit does, and can never pick a smaller
+// region than BestFit.
+TEST(RegionAllocCppApiTestCase, AlignedFitMatchesBestFit) {
+  RegionAllocator best_fit;
+  RegionAllocator aligned_fit;
+  aligned_fit.SetAllocPolicy(RegionAllocator::AllocPolicy::AlignedFit);
+
+  uint64_t seed = 0x2545f4914f6cdd1d;
+  auto next = [&seed](uint64_t max) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    return (seed >> 33) % max;
+  };
+
+  uint64_t base = 0x100000;
+  for (int i = 0; i < 500; ++i) {
+    // Leave a gap after each region so that none of them merge.
+    ralloc_region_t region = {.base = base + (next(64) << 8), .size = (next(64) + 1) << 8};
+    ASSERT_OK(best_fit.AddRegion(region));
+    ASSERT_OK(aligned_fit.AddRegion(region));
+    base = region.base + region.size + 0x100;
+  }
+
+  // Returns the available region of |alloc| which contains |region|.
+  auto source_of = [](const RegionAllocator& alloc, const ralloc_region_t& region) {
+    ralloc_region_t source = {};
+    alloc.WalkAvailableRegions([&](const ralloc_region_t* avail) {
+      if (region_contains_region(avail, &region)) {
+        source = *avail;
+        return false;
+      }
+      return true;
+    });
+    return source;
+  };
+
+  for (int i = 0; i < 2000; ++i) {
+    uint64_t size = (next(64) + 1) << 6;
+    uint64_t alignment = uint64_t{1} << next(16);
+
+    RegionAllocator::Region::UPtr best, aligned;
+    zx_status_t best_res = best_fit.GetRegion(size, alignment, best);
+    zx_status_t aligned_res = aligned_fit.GetRegion(size, alignment, aligned);
+    ASSERT_EQ(best_res, aligned_res);
+    if (best_res != ZX_OK) {
+      continue;
+    }
+
+    EXPECT_EQ(0u, aligned->base & (alignment - 1));
+    EXPECT_EQ(size, aligned->size);
+
+    // Look up where each allocation came from, now that both have been
+    // released back into the available regions they were taken from.
+    ralloc_region_t best_region = *best;
+    ralloc_region_t aligned_region = *aligned;
+    best.reset();
+    aligned.reset();
+    uint64_t best_source = source_of(best_fit, best_region).size;
+    uint64_t aligned_source = source_of(aligned_fit, aligned_region).size;
+    ASSERT_NE(0u, best_source);
+    ASSERT_NE(0u, aligned_source);
+    EXPECT_LE(best_source, aligned_source);
+  }
+}
+
+// AlignedFit checks the first kAlignedFitProbes regions which are large
+// enough, as BestFit would.  Only when none of them fits does it skip the
+// misaligned regions which are too small to hold an allocation whatever their
+// alignment, and then it can use a much larger region than BestFit.
+TEST(RegionAllocCppApiTestCase, AlignedFitProbesSmallMisalignedRegions) {
+  constexpr size_t kProbes = RegionAllocator::kAlignedFitProbes;
+
+  // Returns the base of the 64KB aligned allocation of 4KB made by |policy|,
+  // after |misfits| regions which are large enough but cannot fit it.
+  auto alloc_base = [](RegionAllocator::AllocPolicy policy, size_t misfits) {
+    RegionAllocator alloc;
+    alloc.SetAllocPolicy(policy);
+    for (size_t i = 0; i < misfits; ++i) {
+      EXPECT_OK(alloc.AddRegion({.base = 0x1800 + i * 0x20000, .size = 0x1800}));
+    }
+    // Fits, and sorts after the misfits.
+    EXPECT_OK(alloc.AddRegion({.base = 0x1000f800, .size = 0x1800}));
+    EXPECT_OK(alloc.AddRegion({.base = 0x20001000, .size = 0x100000}));
+
+    RegionAllocator::Region::UPtr region;
+    EXPECT_OK(alloc.GetRegion(0x1000, 0x10000, region));
+    return region ? region->base : 0;
+  };
+
+  EXPECT_EQ(0x10010000u, alloc_base(RegionAllocator::AllocPolicy::BestFit, kProbes));
+  EXPECT_EQ(0x10010000u, alloc_base(RegionAllocator::AllocPolicy::AlignedFit, kProbes - 1));
+  EXPECT_EQ(0x20010000u, alloc_base(RegionAllocator::AllocPolicy::AlignedFit, kProbes));
+}
+
 }  // namespace
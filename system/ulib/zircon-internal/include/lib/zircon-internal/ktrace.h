@@ -5,6 +5,9 @@
 #ifndef LIB_ZIRCON_INTERNAL_KTRACE_H_
 #define LIB_ZIRCON_INTERNAL_KTRACE_H_
 
+#include <stdint.h>
+#include <zircon/types.h>
+
 // clang-format off
 
 // Category bits.
@@ -42,5 +45,56 @@ enum {
 #define KTRACE_ACTION_REWIND         3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE      4 // options ignored, ptr = name
 #define KTRACE_ACTION_START_CIRCULAR 5 // options = grpmask, 0 = all
+#define KTRACE_ACTION_START_STREAMING 6 // options = grpmask, 0 = all, ptr = ktrace_stream_t
+
+// clang-format on
+
+// The argument of KTRACE_ACTION_START_STREAMING.
+//
+// A streaming trace is drained by the kernel into a ring of records in a VMO
+// shared with the consumer, while tracing stays active.  The VMO starts with a
+// ktrace_stream_header_t, and the ring of records starts at
+// KTRACE_STREAM_RING_OFFSET.
+typedef struct ktrace_stream {
+  // In: The size of the ring, in bytes.  Must be a non-zero multiple of the
+  // page size.
+  uint32_t ring_size;
+  // In: The event is signaled when at least this many bytes of the ring are
+  // unread.  Zero selects half of the ring.
+  uint32_t watermark;
+  // Out: The VMO holding the stream header and the ring.
+  zx_handle_t vmo;
+  // Out: An event which is signaled (ZX_EVENT_SIGNALED) when the watermark is
+  // reached, and when the stream stops.  The kernel never clears the signal.
+  zx_handle_t event;
+} ktrace_stream_t;
+
+#define KTRACE_STREAM_RING_OFFSET 4096u
+
+// Set in ktrace_stream_header_t::flags once the trace has been stopped and
+// every record the kernel could drain has been written to the ring.
+#define KTRACE_STREAM_FLAG_STOPPED (1u << 0)
+
+// The header of a streaming trace's VMO.
+//
+// |write_offset| and |read_offset| count the bytes written to and consumed
+// from the ring since the stream started; the byte at offset N of the stream
+// is at offset (N % ring_size) of the ring.  The stream is a sequence of FXT
+// records, starting with the FXT magic number and initialization record, and
+// records may wrap around the end of the ring.
+//
+// The kernel stores |write_offset| with release semantics after writing the
+// records it covers.  The consumer stores |read_offset| with release
+// semantics once it is done with the bytes it covers; the kernel never
+// overwrites unread bytes.
+typedef struct ktrace_stream_header {
+  uint64_t write_offset;
+  uint64_t read_offset;
+  // The number of records which were dropped because the trace buffer of the
+  // CPU they were written on was full.
+  uint64_t dropped_records;
+  uint32_t ring_size;
+  uint32_t flags;
+} ktrace_stream_header_t;
 
 #endif  // LIB_ZIRCON_INTERNAL_KTRACE_H_
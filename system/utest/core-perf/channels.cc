@@ -0,0 +1,144 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/channel.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <thread>
+#include <vector>
+
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+constexpr uint32_t kMessageSizes[] = {64, 1024, 32 * 1024, 64 * 1024};
+
+// Measure the time taken to write a message to a channel and read it back out, on a single thread,
+// optionally carrying a handle.
+bool ChannelWriteReadTest(perftest::RepeatState* state, uint32_t message_size,
+                          uint32_t handle_count) {
+  state->DeclareStep("write");
+  state->DeclareStep("read");
+
+  zx::channel channel1, channel2;
+  ZX_ASSERT(zx::channel::create(0, &channel1, &channel2) == ZX_OK);
+  std::vector<uint8_t> buffer(message_size);
+  std::vector<zx_handle_t> handles(handle_count);
+  for (zx_handle_t& handle : handles) {
+    ZX_ASSERT(zx_event_create(0, &handle) == ZX_OK);
+  }
+
+  while (state->KeepRunning()) {
+    ZX_ASSERT(channel1.write(0, buffer.data(), message_size, handles.data(), handle_count) ==
+              ZX_OK);
+    state->NextStep();
+    uint32_t actual_bytes;
+    uint32_t actual_handles;
+    ZX_ASSERT(channel2.read(0, buffer.data(), handles.data(), message_size, handle_count,
+                            &actual_bytes, &actual_handles) == ZX_OK);
+    ZX_ASSERT(actual_bytes == message_size);
+    ZX_ASSERT(actual_handles == handle_count);
+  }
+
+  for (zx_handle_t handle : handles) {
+    zx_handle_close(handle);
+  }
+  return true;
+}
+
+// Measure the time taken by a zx_channel_call() round trip to a server thread that echoes each
+// message back, which includes two context switches.
+bool ChannelCallTest(perftest::RepeatState* state, uint32_t message_size) {
+  zx::channel client, server;
+  ZX_ASSERT(zx::channel::create(0, &client, &server) == ZX_OK);
+
+  std::thread server_thread([&server, message_size] {
+    std::vector<uint8_t> buffer(message_size);
+    for (;;) {
+      zx_signals_t observed;
+      ZX_ASSERT(server.wait_one(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                zx::time::infinite(), &observed) == ZX_OK);
+      if (!(observed & ZX_CHANNEL_READABLE)) {
+        return;
+      }
+      uint32_t actual_bytes;
+      ZX_ASSERT(server.read(0, buffer.data(), nullptr, message_size, 0, &actual_bytes, nullptr) ==
+                ZX_OK);
+      ZX_ASSERT(server.write(0, buffer.data(), actual_bytes, nullptr, 0) == ZX_OK);
+    }
+  });
+
+  // The first four bytes of a message are its transaction ID, which zx_channel_call() fills in.
+  std::vector<uint8_t> request(message_size);
+  std::vector<uint8_t> reply(message_size);
+  zx_channel_call_args_t args = {
+      .wr_bytes = request.data(),
+      .wr_handles = nullptr,
+      .rd_bytes = reply.data(),
+      .rd_handles = nullptr,
+      .wr_num_bytes = message_size,
+      .wr_num_handles = 0,
+      .rd_num_bytes = message_size,
+      .rd_num_handles = 0,
+  };
+  while (state->KeepRunning()) {
+    uint32_t actual_bytes;
+    uint32_t actual_handles;
+    ZX_ASSERT(client.call(0, zx::time::infinite(), &args, &actual_bytes, &actual_handles) ==
+              ZX_OK);
+    ZX_ASSERT(actual_bytes == message_size);
+  }
+
+  client.reset();
+  server_thread.join();
+  return true;
+}
+
+// Measure the time taken to write a message to a channel and read one back out, while
+// |thread_count| threads do the same with the same channel.
+//
+// Each thread reads only after it has written, so there is always a message to read, though not
+// necessarily the one that the thread wrote.
+bool ChannelContendedWriteReadTest(perftest::MultiThreadState* state, uint32_t message_size) {
+  zx::channel channel1, channel2;
+  ZX_ASSERT(zx::channel::create(0, &channel1, &channel2) == ZX_OK);
+
+  return state->RunThreads([&](perftest::RepeatState* thread_state, uint32_t thread_index) {
+    thread_state->DeclareStep("write");
+    thread_state->DeclareStep("read");
+
+    std::vector<uint8_t> buffer(message_size);
+    while (thread_state->KeepRunning()) {
+      ZX_ASSERT(channel1.write(0, buffer.data(), message_size, nullptr, 0) == ZX_OK);
+      thread_state->NextStep();
+      uint32_t actual_bytes;
+      ZX_ASSERT(channel2.read(0, buffer.data(), nullptr, message_size, 0, &actual_bytes,
+                              nullptr) == ZX_OK);
+      ZX_ASSERT(actual_bytes == message_size);
+    }
+    return true;
+  });
+}
+
+void RegisterTests() {
+  for (uint32_t message_size : kMessageSizes) {
+    for (uint32_t handle_count : {0u, 1u}) {
+      auto name = fbl::StringPrintf("Channel/WriteRead/%ubytes/%uhandles", message_size,
+                                    handle_count);
+      perftest::RegisterTest(name.c_str(), ChannelWriteReadTest, message_size, handle_count);
+    }
+    auto name = fbl::StringPrintf("Channel/CallRoundTrip/%ubytes", message_size);
+    perftest::RegisterTest(name.c_str(), ChannelCallTest, message_size);
+  }
+  for (uint32_t thread_count : {2u, 4u, 8u}) {
+    auto name = fbl::StringPrintf("Channel/WriteRead/Contended/64bytes/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, ChannelContendedWriteReadTest,
+                                      64u);
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
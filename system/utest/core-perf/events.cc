@@ -0,0 +1,63 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/event.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to set and clear a signal on an event that nobody is waiting on.
+bool EventSignalTest(perftest::RepeatState* state) {
+  state->DeclareStep("set");
+  state->DeclareStep("clear");
+
+  zx::event event;
+  ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+  while (state->KeepRunning()) {
+    ZX_ASSERT(event.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+    state->NextStep();
+    ZX_ASSERT(event.signal(ZX_EVENT_SIGNALED, 0) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to wait on an event that is already signaled, which does not block.
+bool EventWaitSignaledTest(perftest::RepeatState* state) {
+  zx::event event;
+  ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+  ZX_ASSERT(event.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+  while (state->KeepRunning()) {
+    ZX_ASSERT(event.wait_one(ZX_EVENT_SIGNALED, zx::time::infinite(), nullptr) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken by zx_object_wait_many() on a set of events, one of which is signaled.
+bool EventWaitManyTest(perftest::RepeatState* state, uint32_t count) {
+  zx::event events[ZX_WAIT_MANY_MAX_ITEMS];
+  zx_wait_item_t items[ZX_WAIT_MANY_MAX_ITEMS];
+  for (uint32_t i = 0; i < count; ++i) {
+    ZX_ASSERT(zx::event::create(0, &events[i]) == ZX_OK);
+    items[i] = {.handle = events[i].get(), .waitfor = ZX_EVENT_SIGNALED, .pending = 0};
+  }
+  ZX_ASSERT(events[count - 1].signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+  while (state->KeepRunning()) {
+    ZX_ASSERT(zx_object_wait_many(items, count, ZX_TIME_INFINITE) == ZX_OK);
+  }
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterTest("Event/Signal", EventSignalTest);
+  perftest::RegisterTest("Event/WaitOne/Signaled", EventWaitSignaledTest);
+  perftest::RegisterTest("Event/WaitMany/1", EventWaitManyTest, 1u);
+  perftest::RegisterTest("Event/WaitMany/8", EventWaitManyTest, 8u);
+  perftest::RegisterTest("Event/WaitMany/64", EventWaitManyTest, 64u);
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
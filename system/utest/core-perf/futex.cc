@@ -0,0 +1,75 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <atomic>
+#include <thread>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to wake a futex that has no waiters.
+bool FutexWakeNoWaitersTest() {
+  zx_futex_t futex = 0;
+  ZX_ASSERT(zx_futex_wake(&futex, 1) == ZX_OK);
+  return true;
+}
+
+// Measure the time taken by a futex wait that returns right away because the futex no longer
+// holds the expected value, which is the common case for a lost race in a mutex.
+bool FutexWaitValueMismatchTest() {
+  zx_futex_t futex = 1;
+  ZX_ASSERT(zx_futex_wait(&futex, 0, ZX_HANDLE_INVALID, ZX_TIME_INFINITE) == ZX_ERR_BAD_STATE);
+  return true;
+}
+
+// Measure the time taken to wake a thread blocked on a futex and for it to wake us back up, which
+// includes two context switches.
+bool FutexPingPongTest(perftest::RepeatState* state) {
+  // Each thread waits for |turn| to move away from the other thread's number, and hands it back.
+  // Turn 2 tells the other thread to exit.
+  std::atomic<zx_futex_t> turn = 0;
+  auto wait_while = [&turn](zx_futex_t value) {
+    while (turn.load() == value) {
+      zx_status_t status = zx_futex_wait(reinterpret_cast<zx_futex_t*>(&turn), value,
+                                         ZX_HANDLE_INVALID, ZX_TIME_INFINITE);
+      ZX_ASSERT(status == ZX_OK || status == ZX_ERR_BAD_STATE);
+    }
+  };
+  auto give_turn = [&turn](zx_futex_t value) {
+    turn.store(value);
+    ZX_ASSERT(zx_futex_wake(reinterpret_cast<zx_futex_t*>(&turn), 1) == ZX_OK);
+  };
+
+  std::thread thread([&] {
+    for (;;) {
+      wait_while(0);
+      if (turn.load() == 2) {
+        return;
+      }
+      give_turn(0);
+    }
+  });
+
+  while (state->KeepRunning()) {
+    give_turn(1);
+    wait_while(1);
+  }
+
+  give_turn(2);
+  thread.join();
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterSimpleTest<FutexWakeNoWaitersTest>("Futex/WakeNoWaiters");
+  perftest::RegisterSimpleTest<FutexWaitValueMismatchTest>("Futex/WaitValueMismatch");
+  perftest::RegisterTest("Futex/PingPong", FutexPingPongTest);
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
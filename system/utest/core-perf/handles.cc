@@ -0,0 +1,62 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/event.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to duplicate a handle and to close the duplicate.
+bool HandleDuplicateCloseTest(perftest::RepeatState* state) {
+  state->DeclareStep("duplicate");
+  state->DeclareStep("close");
+
+  zx::event event;
+  ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+  while (state->KeepRunning()) {
+    zx_handle_t dup;
+    ZX_ASSERT(zx_handle_duplicate(event.get(), ZX_RIGHT_SAME_RIGHTS, &dup) == ZX_OK);
+    state->NextStep();
+    ZX_ASSERT(zx_handle_close(dup) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to replace a handle with one that has the same rights. Keeping the
+// rights lets each iteration replace the handle produced by the previous one.
+bool HandleReplaceTest(perftest::RepeatState* state) {
+  zx::event event;
+  ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+  while (state->KeepRunning()) {
+    ZX_ASSERT(event.replace(ZX_RIGHT_SAME_RIGHTS, &event) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to close the last handle to an object, which also destroys the object,
+// along with the time taken to create it.
+bool HandleCreateCloseTest(perftest::RepeatState* state) {
+  state->DeclareStep("create");
+  state->DeclareStep("close");
+
+  while (state->KeepRunning()) {
+    zx_handle_t event;
+    ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+    state->NextStep();
+    ZX_ASSERT(zx_handle_close(event) == ZX_OK);
+  }
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterTest("Handle/DuplicateClose", HandleDuplicateCloseTest);
+  perftest::RegisterTest("Handle/Replace", HandleReplaceTest);
+  perftest::RegisterTest("Handle/CreateClose/Event", HandleCreateCloseTest);
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
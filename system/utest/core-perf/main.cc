@@ -0,0 +1,9 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+
+int main(int argc, char** argv) {
+  return perftest::PerfTestMain(argc, argv, "fuchsia.zircon.core_perf");
+}
@@ -0,0 +1,92 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/event.h>
+#include <lib/zx/port.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <thread>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to queue a user packet on a port and to dequeue it, on a single thread.
+bool PortQueueWaitTest(perftest::RepeatState* state) {
+  state->DeclareStep("queue");
+  state->DeclareStep("wait");
+
+  zx::port port;
+  ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+  const zx_port_packet_t packet = {.key = 1, .type = ZX_PKT_TYPE_USER, .status = ZX_OK};
+  while (state->KeepRunning()) {
+    ZX_ASSERT(port.queue(&packet) == ZX_OK);
+    state->NextStep();
+    zx_port_packet_t received;
+    ZX_ASSERT(port.wait(zx::time::infinite_past(), &received) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to register an async wait on an event that is already signaled, and to
+// dequeue the packet it produces.
+bool PortWaitAsyncTest(perftest::RepeatState* state) {
+  state->DeclareStep("wait_async");
+  state->DeclareStep("wait");
+
+  zx::port port;
+  ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+  zx::event event;
+  ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+  ZX_ASSERT(event.signal(0, ZX_EVENT_SIGNALED) == ZX_OK);
+  while (state->KeepRunning()) {
+    ZX_ASSERT(event.wait_async(port, 1, ZX_EVENT_SIGNALED, 0) == ZX_OK);
+    state->NextStep();
+    zx_port_packet_t received;
+    ZX_ASSERT(port.wait(zx::time::infinite_past(), &received) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to pass a packet to another thread blocked on a port and to get one back,
+// which includes two context switches.
+bool PortPingPongTest(perftest::RepeatState* state) {
+  zx::port ping, pong;
+  ZX_ASSERT(zx::port::create(0, &ping) == ZX_OK);
+  ZX_ASSERT(zx::port::create(0, &pong) == ZX_OK);
+
+  // A packet with a key of 0 tells the other thread to exit.
+  std::thread thread([&ping, &pong] {
+    for (;;) {
+      zx_port_packet_t packet;
+      ZX_ASSERT(ping.wait(zx::time::infinite(), &packet) == ZX_OK);
+      if (packet.key == 0) {
+        return;
+      }
+      ZX_ASSERT(pong.queue(&packet) == ZX_OK);
+    }
+  });
+
+  zx_port_packet_t packet = {.key = 1, .type = ZX_PKT_TYPE_USER, .status = ZX_OK};
+  while (state->KeepRunning()) {
+    ZX_ASSERT(ping.queue(&packet) == ZX_OK);
+    ZX_ASSERT(pong.wait(zx::time::infinite(), &packet) == ZX_OK);
+  }
+
+  packet.key = 0;
+  ZX_ASSERT(ping.queue(&packet) == ZX_OK);
+  thread.join();
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterTest("Port/QueueWait", PortQueueWaitTest);
+  perftest::RegisterTest("Port/WaitAsyncWait", PortWaitAsyncTest);
+  perftest::RegisterTest("Port/PingPong", PortPingPongTest);
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -0,0 +1,60 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/stream.h>
+#include <lib/zx/vmo.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <vector>
+
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+constexpr size_t kReadPages = 4;
+constexpr uint32_t kMaxThreads = 8;
+
+// Measure the time taken by a positional read from a stream, while the test's other threads
+// read from the same stream. With |disjoint| each thread reads its own part of the VMO, otherwise
+// all of them read the same part.
+bool StreamConcurrentReadAtTest(perftest::MultiThreadState* state, bool disjoint) {
+  const size_t read_size = zx_system_get_page_size() * kReadPages;
+  const size_t vmo_size = read_size * kMaxThreads;
+
+  zx::vmo vmo;
+  ZX_ASSERT(zx::vmo::create(vmo_size, 0, &vmo) == ZX_OK);
+  std::vector<char> fill(vmo_size, 'a');
+  ZX_ASSERT(vmo.write(fill.data(), 0, vmo_size) == ZX_OK);
+
+  zx::stream stream;
+  ZX_ASSERT(zx::stream::create(ZX_STREAM_MODE_READ, vmo, 0, &stream) == ZX_OK);
+
+  return state->RunThreads([&](perftest::RepeatState* thread_state, uint32_t thread_index) {
+    const uint64_t offset = disjoint ? thread_index * read_size : 0;
+    std::vector<char> buffer(read_size);
+    zx_iovec_t vec = {.buffer = buffer.data(), .capacity = buffer.size()};
+    while (thread_state->KeepRunning()) {
+      size_t actual;
+      ZX_ASSERT(stream.readv_at(0, offset, &vec, 1, &actual) == ZX_OK);
+      ZX_ASSERT(actual == read_size);
+    }
+    return true;
+  });
+}
+
+void RegisterTests() {
+  for (uint32_t thread_count = 1; thread_count <= kMaxThreads; thread_count *= 2) {
+    auto name = fbl::StringPrintf("Stream/ReadAt/Disjoint/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, StreamConcurrentReadAtTest, true);
+
+    name = fbl::StringPrintf("Stream/ReadAt/Overlapping/%uthreads", thread_count);
+    perftest::RegisterMultiThreadTest(name.c_str(), thread_count, StreamConcurrentReadAtTest,
+                                      false);
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
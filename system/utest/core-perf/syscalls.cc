@@ -0,0 +1,40 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/testonly-syscalls.h>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken by a syscall that does nothing, which is the fixed cost of entering and
+// leaving the kernel.
+bool SyscallNullTest() {
+  ZX_ASSERT(zx_syscall_test_0() == ZX_OK);
+  return true;
+}
+
+// Measure the same with the largest number of arguments a syscall takes.
+bool SyscallManyArgsTest() {
+  int result = zx_syscall_test_8(1, 2, 3, 4, 5, 6, 7, 8);
+  ZX_ASSERT(result == 36);
+  return true;
+}
+
+// Measure the time taken by a syscall that is handled entirely in the vDSO.
+bool SyscallVdsoTest() {
+  perftest::DoNotOptimize(zx_clock_get_monotonic());
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterSimpleTest<SyscallNullTest>("Syscall/Null");
+  perftest::RegisterSimpleTest<SyscallManyArgsTest>("Syscall/ManyArgs");
+  perftest::RegisterSimpleTest<SyscallVdsoTest>("Syscall/Vdso/ClockGetMonotonic");
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
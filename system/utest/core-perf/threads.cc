@@ -0,0 +1,53 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/process.h>
+#include <lib/zx/thread.h>
+#include <threads.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measure the time taken to create a C11 thread that does nothing and to join it. This includes
+// setting up and tearing down the thread's stacks and TLS, as well as the kernel thread itself.
+bool ThreadCreateJoinTest() {
+  thrd_t thread;
+  ZX_ASSERT(thrd_create(&thread, [](void*) { return 0; }, nullptr) == thrd_success);
+  int result;
+  ZX_ASSERT(thrd_join(thread, &result) == thrd_success);
+  return true;
+}
+
+// Measure the time taken to create a kernel thread object and to destroy it without starting it,
+// which is the kernel's part of the cost above.
+bool ThreadCreateCloseTest(perftest::RepeatState* state) {
+  state->DeclareStep("create");
+  state->DeclareStep("close");
+
+  while (state->KeepRunning()) {
+    zx::thread thread;
+    ZX_ASSERT(zx::thread::create(*zx::process::self(), "perf", 4, 0, &thread) == ZX_OK);
+    state->NextStep();
+    thread.reset();
+  }
+  return true;
+}
+
+// Measure the time taken by a thread to give up the CPU when no other thread is runnable.
+bool ThreadYieldTest() {
+  ZX_ASSERT(zx_thread_legacy_yield(0) == ZX_OK);
+  return true;
+}
+
+void RegisterTests() {
+  perftest::RegisterSimpleTest<ThreadCreateJoinTest>("Thread/CreateJoin");
+  perftest::RegisterTest("Thread/CreateClose", ThreadCreateCloseTest);
+  perftest::RegisterSimpleTest<ThreadYieldTest>("Thread/Yield");
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -0,0 +1,139 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include <vector>
+
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+constexpr size_t kKiB = 1024;
+constexpr size_t kMiB = 1024 * kKiB;
+constexpr size_t kVmoSizes[] = {4 * kKiB, 64 * kKiB, 1 * kMiB};
+
+// Measure the time taken to create a VMO and to destroy it, without ever committing any pages.
+bool VmoCreateCloseTest(perftest::RepeatState* state, size_t size) {
+  state->DeclareStep("create");
+  state->DeclareStep("close");
+
+  while (state->KeepRunning()) {
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+    state->NextStep();
+    vmo.reset();
+  }
+  return true;
+}
+
+// Measure the time taken to copy data into and out of a VMO whose pages are already committed.
+bool VmoReadWriteTest(perftest::RepeatState* state, size_t size) {
+  state->DeclareStep("write");
+  state->DeclareStep("read");
+
+  zx::vmo vmo;
+  ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+  std::vector<uint8_t> buffer(size, 0x5a);
+  ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+
+  while (state->KeepRunning()) {
+    ZX_ASSERT(vmo.write(buffer.data(), 0, size) == ZX_OK);
+    state->NextStep();
+    ZX_ASSERT(vmo.read(buffer.data(), 0, size) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to map a VMO and to unmap it. With |map_range| the mapping is populated
+// up front, so this includes the cost of filling in the page tables.
+bool VmoMapUnmapTest(perftest::RepeatState* state, size_t size, bool map_range) {
+  state->DeclareStep("map");
+  state->DeclareStep("unmap");
+
+  zx::vmo vmo;
+  ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+  ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+  const zx_vm_option_t options =
+      ZX_VM_PERM_READ | ZX_VM_PERM_WRITE | (map_range ? ZX_VM_MAP_RANGE : 0);
+
+  while (state->KeepRunning()) {
+    zx_vaddr_t addr;
+    ZX_ASSERT(zx::vmar::root_self()->map(options, 0, vmo, 0, size, &addr) == ZX_OK);
+    state->NextStep();
+    ZX_ASSERT(zx::vmar::root_self()->unmap(addr, size) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to fault in every page of a fresh mapping of a VMO, which is what a
+// process pays for touching memory it has just mapped. The VMO's pages are committed already, so
+// this does not include allocating and zeroing them.
+bool VmoMapFaultTest(perftest::RepeatState* state, size_t size) {
+  state->DeclareStep("map");
+  state->DeclareStep("fault");
+  state->DeclareStep("unmap");
+
+  zx::vmo vmo;
+  ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+  ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+  const size_t page_size = zx_system_get_page_size();
+
+  while (state->KeepRunning()) {
+    zx_vaddr_t addr;
+    ZX_ASSERT(zx::vmar::root_self()->map(ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, vmo, 0, size,
+                                         &addr) == ZX_OK);
+    state->NextStep();
+    for (size_t offset = 0; offset < size; offset += page_size) {
+      reinterpret_cast<volatile uint8_t*>(addr)[offset] = 1;
+    }
+    state->NextStep();
+    ZX_ASSERT(zx::vmar::root_self()->unmap(addr, size) == ZX_OK);
+  }
+  return true;
+}
+
+// Measure the time taken to create a copy-on-write snapshot of a VMO whose pages are committed,
+// and to destroy it.
+bool VmoCloneTest(perftest::RepeatState* state, size_t size) {
+  state->DeclareStep("clone");
+  state->DeclareStep("close");
+
+  zx::vmo vmo;
+  ZX_ASSERT(zx::vmo::create(size, 0, &vmo) == ZX_OK);
+  ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0) == ZX_OK);
+
+  while (state->KeepRunning()) {
+    zx::vmo clone;
+    ZX_ASSERT(vmo.create_child(ZX_VMO_CHILD_SNAPSHOT, 0, size, &clone) == ZX_OK);
+    state->NextStep();
+    clone.reset();
+  }
+  return true;
+}
+
+void RegisterTests() {
+  for (size_t size : kVmoSizes) {
+    const size_t kbytes = size / kKiB;
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/CreateClose/%zukbytes", kbytes).c_str(),
+                           VmoCreateCloseTest, size);
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/ReadWrite/%zukbytes", kbytes).c_str(),
+                           VmoReadWriteTest, size);
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/MapUnmap/%zukbytes", kbytes).c_str(),
+                           VmoMapUnmapTest, size, false);
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/MapUnmap/MapRange/%zukbytes", kbytes).c_str(),
+                           VmoMapUnmapTest, size, true);
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/MapFault/%zukbytes", kbytes).c_str(),
+                           VmoMapFaultTest, size);
+    perftest::RegisterTest(fbl::StringPrintf("Vmo/Clone/%zukbytes", kbytes).c_str(), VmoCloneTest,
+                           size);
+  }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -4,6 +4,9 @@
 
 #include <lib/zx/clock.h>
 #include <lib/zx/time.h>
+#include <lib/zx/vmar.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/syscalls/clock.h>
 
 #include <array>
 #include <utility>
@@ -48,4 +51,89 @@ TEST(ClockTest, DeadlineAfter) {
   }
 }
 
+// Maps a clock created with ZX_CLOCK_OPT_MAPPABLE into the root VMAR.
+zx_vaddr_t MapClock(const zx::clock& clock) {
+  zx_vaddr_t addr = 0;
+  EXPECT_OK(zx_vmar_map_clock(zx::vmar::root_self()->get(), ZX_VM_PERM_READ, 0, clock.get(),
+                              zx_system_get_page_size(), &addr));
+  return addr;
+}
+
+TEST(ClockTest, MappedClockMatchesRead) {
+  zx::clock clock;
+  ASSERT_OK(zx::clock::create(ZX_CLOCK_OPT_MAPPABLE | ZX_CLOCK_OPT_AUTO_START, nullptr, &clock));
+  const zx_vaddr_t addr = MapClock(clock);
+  ASSERT_NE(addr, 0u);
+  const void* mapped = reinterpret_cast<const void*>(addr);
+
+  // A mapped read must be bracketed by the syscall reads on either side of it,
+  // before and after the clock is updated.
+  for (int pass = 0; pass < 2; ++pass) {
+    zx_time_t before, now, after;
+    ASSERT_OK(clock.read(&before));
+    ASSERT_OK(zx_clock_read_mapped(mapped, &now));
+    ASSERT_OK(clock.read(&after));
+    EXPECT_LE(before, now);
+    EXPECT_LE(now, after);
+
+    zx::clock::update_args args;
+    args.set_value(zx::time(ZX_SEC(1000))).set_rate_adjust(-500);
+    ASSERT_OK(clock.update(args));
+  }
+
+  EXPECT_OK(zx::vmar::root_self()->unmap(addr, zx_system_get_page_size()));
+}
+
+TEST(ClockTest, MappedClockBeforeStart) {
+  constexpr zx_time_t kBackstop = ZX_SEC(12345);
+  zx_clock_create_args_v1_t args{.backstop_time = kBackstop};
+  zx::clock clock;
+  ASSERT_OK(zx::clock::create(ZX_CLOCK_ARGS_VERSION(1) | ZX_CLOCK_OPT_MAPPABLE, &args, &clock));
+  const zx_vaddr_t addr = MapClock(clock);
+  ASSERT_NE(addr, 0u);
+
+  // Stopped clocks read as their backstop time.
+  zx_time_t now;
+  ASSERT_OK(zx_clock_read_mapped(reinterpret_cast<const void*>(addr), &now));
+  EXPECT_EQ(now, kBackstop);
+
+  EXPECT_OK(zx::vmar::root_self()->unmap(addr, zx_system_get_page_size()));
+}
+
+TEST(ClockTest, MapClockRequiresMappableClock) {
+  zx::clock clock;
+  ASSERT_OK(zx::clock::create(ZX_CLOCK_OPT_AUTO_START, nullptr, &clock));
+  zx_vaddr_t addr;
+  EXPECT_STATUS(zx_vmar_map_clock(zx::vmar::root_self()->get(), ZX_VM_PERM_READ, 0, clock.get(),
+                                  zx_system_get_page_size(), &addr),
+                ZX_ERR_BAD_STATE);
+}
+
+TEST(ClockTest, MapClockRequiresPageSize) {
+  zx::clock clock;
+  ASSERT_OK(zx::clock::create(ZX_CLOCK_OPT_MAPPABLE | ZX_CLOCK_OPT_AUTO_START, nullptr, &clock));
+  zx_vaddr_t addr;
+  for (size_t len : {size_t{0}, size_t{1}, size_t{zx_system_get_page_size()} * 2}) {
+    EXPECT_STATUS(zx_vmar_map_clock(zx::vmar::root_self()->get(), ZX_VM_PERM_READ, 0, clock.get(),
+                                    len, &addr),
+                  ZX_ERR_INVALID_ARGS);
+  }
+}
+
+TEST(ClockTest, MapClockIsReadOnly) {
+  zx::clock clock;
+  ASSERT_OK(zx::clock::create(ZX_CLOCK_OPT_MAPPABLE | ZX_CLOCK_OPT_AUTO_START, nullptr, &clock));
+  zx_vaddr_t addr;
+  EXPECT_STATUS(zx_vmar_map_clock(zx::vmar::root_self()->get(),
+                                  ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, clock.get(),
+                                  zx_system_get_page_size(), &addr),
+                ZX_ERR_ACCESS_DENIED);
+
+  zx::clock no_read;
+  ASSERT_OK(clock.duplicate(ZX_RIGHT_WRITE, &no_read));
+  EXPECT_STATUS(zx_vmar_map_clock(zx::vmar::root_self()->get(), ZX_VM_PERM_READ, 0,
+                                  no_read.get(), zx_system_get_page_size(), &addr),
+                ZX_ERR_ACCESS_DENIED);
+}
+
 }  // namespace
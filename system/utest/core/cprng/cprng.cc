@@ -0,0 +1,77 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/syscalls.h>
+
+#include <array>
+
+#include <zxtest/zxtest.h>
+
+namespace {
+
+struct alignas(8) CprngState {
+  uint8_t bytes[ZX_CPRNG_STATE_SIZE] = {};
+};
+
+size_t CountZeros(const uint8_t* buf, size_t len) {
+  size_t zeros = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (buf[i] == 0) {
+      zeros++;
+    }
+  }
+  return zeros;
+}
+
+TEST(CprngWithStateTest, DrawSuccess) {
+  CprngState state;
+  uint8_t buf[ZX_CPRNG_DRAW_MAX_LEN] = {};
+  zx_cprng_draw_with_state(&state, buf, sizeof(buf));
+
+  // The probability of getting more than 16 zeros if the buf is 256 bytes
+  // is 6.76 * 10^-16, so probably not gonna happen.
+  EXPECT_LE(CountZeros(buf, sizeof(buf)), 16u, "buffer wasn't written to");
+}
+
+TEST(CprngWithStateTest, LargeDraw) {
+  // Much larger than the generator's internal batch, so that it has to refill
+  // many times within one call.
+  static std::array<uint8_t, 64 * 1024> buf;
+  buf.fill(0);
+  CprngState state;
+  zx_cprng_draw_with_state(&state, buf.data(), buf.size());
+
+  // The expected number of zeros is 256. Allow for a generous margin.
+  EXPECT_LE(CountZeros(buf.data(), buf.size()), 512u);
+}
+
+TEST(CprngWithStateTest, SuccessiveDrawsDiffer) {
+  CprngState state;
+  uint8_t first[32];
+  uint8_t second[32];
+  zx_cprng_draw_with_state(&state, first, sizeof(first));
+  zx_cprng_draw_with_state(&state, second, sizeof(second));
+  EXPECT_NE(memcmp(first, second, sizeof(first)), 0);
+}
+
+TEST(CprngWithStateTest, IndependentStatesDiffer) {
+  CprngState state1;
+  CprngState state2;
+  uint8_t first[32];
+  uint8_t second[32];
+  zx_cprng_draw_with_state(&state1, first, sizeof(first));
+  zx_cprng_draw_with_state(&state2, second, sizeof(second));
+  EXPECT_NE(memcmp(first, second, sizeof(first)), 0);
+}
+
+TEST(CprngWithStateTest, ZeroLengthDraw) {
+  CprngState state;
+  uint8_t buf[1] = {0xa5};
+  zx_cprng_draw_with_state(&state, buf, 0);
+  EXPECT_EQ(buf[0], 0xa5);
+}
+
+}  // namespace
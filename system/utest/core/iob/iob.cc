@@ -14,8 +14,10 @@
 #include <zircon/time.h>
 #include <zircon/types.h>
 
+#include <array>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include <zxtest/zxtest.h>
 
@@ -859,4 +861,265 @@ TEST(Iob, IdAllocatorMediatedErrors) {
                              reinterpret_cast<zx_vaddr_t>(bytes.data()), bytes.size(), nullptr, 0));
 }
 
+// A minimal consumer of a ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER region, following
+// the protocol described in <zircon/syscalls-next.h>.
+class RingConsumer {
+ public:
+  explicit RingConsumer(cpp20::span<std::byte> region)
+      : header_(reinterpret_cast<zx_iob_ring_header_t*>(region.data())),
+        data_(region.subspan(sizeof(zx_iob_ring_header_t))) {}
+
+  const zx_iob_ring_header_t& header() const { return *header_; }
+
+  // Reads the next committed data record into |out|, skipping padding.
+  // Returns false if there is none.
+  bool Read(std::vector<std::byte>& out) {
+    while (true) {
+      uint64_t head = __atomic_load_n(&header_->consume, __ATOMIC_RELAXED);
+      std::byte* record = &data_[head % header_->capacity];
+      uint64_t word = __atomic_load_n(reinterpret_cast<uint64_t*>(record), __ATOMIC_ACQUIRE);
+      zx_iob_ring_record_t record_header;
+      memcpy(&record_header, &word, sizeof(word));
+      if ((record_header.flags & ZX_IOB_RING_RECORD_COMMITTED) == 0) {
+        return false;
+      }
+      const uint64_t record_size =
+          (sizeof(zx_iob_ring_record_t) + record_header.size + ZX_IOB_RING_RECORD_ALIGN - 1) &
+          ~(ZX_IOB_RING_RECORD_ALIGN - 1);
+      const bool padding = (record_header.flags & ZX_IOB_RING_RECORD_PADDING) != 0;
+      if (!padding) {
+        std::byte* payload = record + sizeof(zx_iob_ring_record_t);
+        out.assign(payload, payload + record_header.size);
+      }
+      memset(record, 0, record_size);
+      __atomic_store_n(&header_->consume, head + record_size, __ATOMIC_RELEASE);
+      if (!padding) {
+        return true;
+      }
+    }
+  }
+
+ private:
+  zx_iob_ring_header_t* header_;
+  cpp20::span<std::byte> data_;
+};
+
+zx_iob_region_t RingBufferRegion(zx_iob_access_t access, uint64_t watermark) {
+  return {
+      .type = ZX_IOB_REGION_TYPE_PRIVATE,
+      .access = access,
+      .size = ZX_PAGE_SIZE,
+      .discipline =
+          zx_iob_discipline_t{
+              .type = ZX_IOB_DISCIPLINE_TYPE_RING_BUFFER,
+              .ring_buffer = {.watermark = watermark},
+          },
+      .private_region = {.options = 0},
+  };
+}
+
+cpp20::span<std::byte> MapRegion(zx_handle_t ep, uint32_t region_index) {
+  zx_vaddr_t addr = 0;
+  EXPECT_OK(zx_vmar_map_iob(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, ep,
+                            region_index, 0, ZX_PAGE_SIZE, &addr));
+  return {reinterpret_cast<std::byte*>(addr), addr == 0 ? 0 : ZX_PAGE_SIZE};
+}
+
+TEST(Iob, RingBufferMediatedWrite) {
+  constexpr zx_iob_write_record_options_t kOptions = 0;
+  constexpr uint64_t kWatermark = 256;
+  constexpr uint64_t kCapacity = ZX_PAGE_SIZE - sizeof(zx_iob_ring_header_t);
+
+  // Endpoint 0 will be the mapped consumer, while endpoint 1 will produce
+  // through mediated writes.
+  zx_handle_t ep0, ep1;
+  zx_iob_region_t config[]{
+      RingBufferRegion(kIoBufferEp0OnlyRwMap | ZX_IOB_ACCESS_EP1_CAN_MEDIATED_WRITE, kWatermark),
+  };
+  ASSERT_OK(zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+
+  cpp20::span<std::byte> bytes = MapRegion(ep0, 0);
+  ASSERT_FALSE(bytes.empty());
+  RingConsumer consumer(bytes);
+  EXPECT_EQ(kCapacity, consumer.header().capacity);
+  EXPECT_EQ(kWatermark, consumer.header().watermark);
+
+  // Write records of varying sizes, enough to wrap around the ring several
+  // times, and check that they are read back intact and in order.
+  std::vector<std::byte> record;
+  uint64_t written = 0;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    std::vector<std::byte> expected(i % 97, std::byte(i));
+    ASSERT_OK(zx_iob_write_record(ep1, kOptions, 0, expected.data(), expected.size()));
+    written += expected.size();
+
+    ASSERT_TRUE(consumer.Read(record));
+    EXPECT_EQ(expected.size(), record.size());
+    EXPECT_BYTES_EQ(expected.data(), record.data(), expected.size());
+    EXPECT_FALSE(consumer.Read(record));
+  }
+  EXPECT_GT(written, 4 * kCapacity);
+
+  // Nothing has been left unread for long enough to reach the watermark.
+  zx_signals_t pending = 0;
+  EXPECT_EQ(ZX_ERR_TIMED_OUT,
+            zx_object_wait_one(ep0, ZX_IOB_RING_WATERMARK, ZX_TIME_INFINITE_PAST, &pending));
+
+  // Fill the ring past the watermark without consuming anything.
+  std::array<std::byte, 64> payload{};
+  uint64_t unread = 0;
+  while (unread < kWatermark) {
+    ASSERT_OK(zx_iob_write_record(ep1, kOptions, 0, payload.data(), payload.size()));
+    unread += sizeof(zx_iob_ring_record_t) + payload.size();
+  }
+  EXPECT_OK(zx_object_wait_one(ep0, ZX_IOB_RING_WATERMARK, ZX_TIME_INFINITE_PAST, &pending));
+
+  // The consumer clears the signal itself before draining the ring.
+  EXPECT_OK(zx_object_signal(ep0, ZX_IOB_RING_WATERMARK, 0));
+  while (consumer.Read(record)) {
+    EXPECT_EQ(payload.size(), record.size());
+  }
+  EXPECT_EQ(ZX_ERR_TIMED_OUT,
+            zx_object_wait_one(ep0, ZX_IOB_RING_WATERMARK, ZX_TIME_INFINITE_PAST, &pending));
+
+  // Keep writing until the ring is full.
+  zx_status_t status;
+  do {
+    status = zx_iob_write_record(ep1, kOptions, 0, payload.data(), payload.size());
+  } while (status == ZX_OK);
+  EXPECT_EQ(ZX_ERR_SHOULD_WAIT, status);
+
+  // Consuming a record makes room for another.
+  ASSERT_TRUE(consumer.Read(record));
+  EXPECT_OK(zx_iob_write_record(ep1, kOptions, 0, payload.data(), payload.size()));
+
+  zx_handle_close(ep0);
+  zx_handle_close(ep1);
+}
+
+TEST(Iob, RingBufferMediatedErrors) {
+  constexpr std::array<std::byte, 10> kData{std::byte{'a'}};
+  constexpr zx_iob_write_record_options_t kOptions = 0;
+  constexpr uint32_t kRingIdx = 0;
+
+  zx_handle_t ep0, ep1;
+  zx_iob_region_t config[]{
+      RingBufferRegion(kIoBufferEp0OnlyRwMap | ZX_IOB_ACCESS_EP1_CAN_MEDIATED_WRITE, 128),
+      {
+          .type = ZX_IOB_REGION_TYPE_PRIVATE,
+          .access = kIoBufferEpRwMap,
+          .size = ZX_PAGE_SIZE,
+          .discipline = zx_iob_discipline_t{.type = ZX_IOB_DISCIPLINE_TYPE_NONE},
+          .private_region = {.options = 0},
+      },
+  };
+  ASSERT_OK(zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+
+  cpp20::span<std::byte> bytes = MapRegion(ep0, kRingIdx);
+  ASSERT_FALSE(bytes.empty());
+
+  // ZX_ERR_OUT_OF_RANGE (region index too large)
+  EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, zx_iob_write_record(ep1, kOptions, 2, kData.data(), kData.size()));
+
+  // ZX_ERR_WRONG_TYPE (region not of RING_BUFFER discipline)
+  EXPECT_EQ(ZX_ERR_WRONG_TYPE, zx_iob_write_record(ep1, kOptions, 1, kData.data(), kData.size()));
+
+  // ZX_ERR_INVALID_ARGS (invalid options)
+  EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+            zx_iob_write_record(ep1, -1, kRingIdx, kData.data(), kData.size()));
+
+  // ZX_ERR_INVALID_ARGS (record larger than the ring)
+  {
+    std::vector<std::byte> huge(ZX_PAGE_SIZE);
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              zx_iob_write_record(ep1, kOptions, kRingIdx, huge.data(), huge.size()));
+  }
+
+  // ZX_ERR_INVALID_ARGS (bad data pointer). The reserved space is still
+  // committed, as padding, so the ring stays usable.
+  {
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_write_record(ep1, kOptions, kRingIdx,
+                                                       reinterpret_cast<void*>(4), kData.size()));
+    EXPECT_OK(zx_iob_write_record(ep1, kOptions, kRingIdx, kData.data(), kData.size()));
+    RingConsumer consumer(bytes);
+    std::vector<std::byte> record;
+    ASSERT_TRUE(consumer.Read(record));
+    EXPECT_BYTES_EQ(kData.data(), record.data(), kData.size());
+    EXPECT_FALSE(consumer.Read(record));
+  }
+
+  // ZX_ERR_ACCESS_DENIED (endpoint not mediated-writable)
+  EXPECT_EQ(ZX_ERR_ACCESS_DENIED,
+            zx_iob_write_record(ep0, kOptions, kRingIdx, kData.data(), kData.size()));
+
+  // ZX_ERR_IO_DATA_INTEGRITY (corrupted header)
+  {
+    auto* header = reinterpret_cast<zx_iob_ring_header_t*>(bytes.data());
+    header->consume = header->reserve + 8;
+    EXPECT_EQ(ZX_ERR_IO_DATA_INTEGRITY,
+              zx_iob_write_record(ep1, kOptions, kRingIdx, kData.data(), kData.size()));
+  }
+
+  // The whole region should be pinned, so decommitting should result in
+  // ZX_ERR_BAD_STATE.
+  EXPECT_EQ(ZX_ERR_BAD_STATE,
+            zx_vmar_op_range(zx_vmar_root_self(), ZX_VMAR_OP_DECOMMIT,
+                             reinterpret_cast<zx_vaddr_t>(bytes.data()), bytes.size(), nullptr, 0));
+
+  zx_handle_close(ep0);
+  zx_handle_close(ep1);
+}
+
+TEST(Iob, RingBufferBadConfig) {
+  constexpr uint64_t kCapacity = ZX_PAGE_SIZE - sizeof(zx_iob_ring_header_t);
+  constexpr zx_iob_access_t kAccess =
+      kIoBufferEp0OnlyRwMap | ZX_IOB_ACCESS_EP1_CAN_MEDIATED_WRITE;
+  zx_handle_t ep0, ep1;
+
+  // A zero watermark.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(kAccess, 0)};
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+  }
+
+  // A watermark larger than the ring.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(kAccess, kCapacity + 1)};
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+  }
+
+  // Nonzero reserved configuration.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(kAccess, kCapacity)};
+    config[0].discipline.ring_buffer.reserved[0] = 1;
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+  }
+
+  // No endpoint can map the ring to consume it.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(
+        ZX_IOB_ACCESS_EP0_CAN_MAP_READ | ZX_IOB_ACCESS_EP1_CAN_MEDIATED_WRITE, kCapacity)};
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+  }
+
+  // Mediated access that does not admit writes.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(
+        kIoBufferEp0OnlyRwMap | ZX_IOB_ACCESS_EP1_CAN_MEDIATED_READ, kCapacity)};
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+  }
+
+  // A ring without mediated access is fine, for producers that all write
+  // through mappings.
+  {
+    zx_iob_region_t config[]{RingBufferRegion(kIoBufferEpRwMap, kCapacity)};
+    ASSERT_OK(zx_iob_create(0, config, std::size(config), &ep0, &ep1));
+    cpp20::span<std::byte> bytes = MapRegion(ep1, 0);
+    ASSERT_FALSE(bytes.empty());
+    EXPECT_EQ(kCapacity, RingConsumer(bytes).header().capacity);
+    zx_handle_close(ep0);
+    zx_handle_close(ep1);
+  }
+}
+
 }  // namespace
@@ -7,11 +7,17 @@
 #include <lib/zx/bti.h>
 #include <lib/zx/job.h>
 #include <lib/zx/pager.h>
+#include <lib/zx/result.h>
+#include <lib/zx/stream.h>
 #include <lib/zx/vmo.h>
+#include <string.h>
+#include <zircon/assert.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/iommu.h>
 #include <zircon/syscalls/object.h>
 
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <zxtest/zxtest.h>
@@ -422,4 +428,137 @@ TEST_F(KernelStatsGetInfoTest, GuestStatsArraySize) {
   TestArraySize<ZX_INFO_GUEST_STATS, zx_info_guest_stats_t>();
 }
 
+TEST_F(KernelStatsGetInfoTest, LockContentionBadHandleType) {
+  zx_info_lock_contention_t buffer;
+  size_t actual, avail;
+  ASSERT_EQ(zx_object_get_info(zx::job::default_job()->get(), ZX_INFO_LOCK_CONTENTION, &buffer,
+                               sizeof(buffer), &actual, &avail),
+            ZX_ERR_WRONG_TYPE);
+}
+
+TEST_F(KernelStatsGetInfoTest, LockContention) {
+  if (!system_resource_->is_valid()) {
+    ZXTEST_SKIP("System resource not available, skipping");
+  }
+
+  zx::result<zx::resource> result =
+      maybe_standalone::GetSystemResourceWithBase(system_resource_, ZX_RSRC_SYSTEM_INFO_BASE);
+  ASSERT_OK(result.status_value());
+  zx::resource info_resource = std::move(result.value());
+
+  size_t actual, avail;
+  zx_status_t status = zx_object_get_info(info_resource.get(), ZX_INFO_LOCK_CONTENTION, nullptr,
+                                          0, &actual, &avail);
+  if (status == ZX_ERR_NOT_SUPPORTED) {
+    ZXTEST_SKIP("Kernel lock stats not enabled, skipping");
+  }
+  ASSERT_OK(status);
+  EXPECT_EQ(actual, 0u);
+
+  // More classes may have been profiled since the probe, so leave some room.
+  std::vector<zx_info_lock_contention_t> records(avail + 16);
+  ASSERT_OK(zx_object_get_info(info_resource.get(), ZX_INFO_LOCK_CONTENTION, records.data(),
+                               records.size() * sizeof(zx_info_lock_contention_t), &actual,
+                               &avail));
+  EXPECT_LE(actual, avail);
+
+  for (size_t i = 0; i < actual; i++) {
+    const zx_info_lock_contention_t& record = records[i];
+    EXPECT_LT(strnlen(record.name, sizeof(record.name)), sizeof(record.name));
+    for (size_t j = 1; j < ZX_INFO_LOCK_CONTENTION_CALL_SITES; j++) {
+      EXPECT_LE(record.call_site_counts[j], record.call_site_counts[j - 1]);
+    }
+  }
+}
+
+// Reads all of the lock contention records.
+zx::result<std::vector<zx_info_lock_contention_t>> GetLockContention(
+    const zx::resource& info_resource) {
+  size_t actual, avail;
+  zx_status_t status = zx_object_get_info(info_resource.get(), ZX_INFO_LOCK_CONTENTION, nullptr,
+                                          0, &actual, &avail);
+  if (status != ZX_OK) {
+    return zx::error(status);
+  }
+
+  // More classes may have been profiled since the probe, so leave some room.
+  std::vector<zx_info_lock_contention_t> records(avail + 16);
+  status = zx_object_get_info(info_resource.get(), ZX_INFO_LOCK_CONTENTION, records.data(),
+                              records.size() * sizeof(zx_info_lock_contention_t), &actual, &avail);
+  if (status != ZX_OK) {
+    return zx::error(status);
+  }
+  records.resize(actual);
+  return zx::ok(std::move(records));
+}
+
+TEST_F(KernelStatsGetInfoTest, LockContentionCountsWaits) {
+  if (!system_resource_->is_valid()) {
+    ZXTEST_SKIP("System resource not available, skipping");
+  }
+  if (num_cpus_ < 2) {
+    ZXTEST_SKIP("Contending a lock needs at least two CPUs, skipping");
+  }
+
+  zx::result<zx::resource> result =
+      maybe_standalone::GetSystemResourceWithBase(system_resource_, ZX_RSRC_SYSTEM_INFO_BASE);
+  ASSERT_OK(result.status_value());
+  zx::resource info_resource = std::move(result.value());
+
+  // Seeking a stream takes the stream's seek lock, whose lock class is named
+  // after the declaring class and line.
+  constexpr std::string_view kLockClassPrefix = "StreamDispatcher:";
+  bool names_available = false;
+  auto GetWaitCount = [&](uint64_t* wait_count) {
+    zx::result<std::vector<zx_info_lock_contention_t>> records = GetLockContention(info_resource);
+    ASSERT_OK(records.status_value());
+    *wait_count = 0;
+    for (const zx_info_lock_contention_t& record : *records) {
+      const std::string_view name(record.name, strnlen(record.name, sizeof(record.name)));
+      names_available |= !name.empty();
+      if (name.substr(0, kLockClassPrefix.size()) == kLockClassPrefix) {
+        *wait_count += record.wait_count;
+      }
+    }
+  };
+
+  size_t actual, avail;
+  zx_status_t status = zx_object_get_info(info_resource.get(), ZX_INFO_LOCK_CONTENTION, nullptr,
+                                          0, &actual, &avail);
+  if (status == ZX_ERR_NOT_SUPPORTED) {
+    ZXTEST_SKIP("Kernel lock stats not enabled, skipping");
+  }
+  ASSERT_OK(status);
+
+  uint64_t initial_waits;
+  ASSERT_NO_FATAL_FAILURE(GetWaitCount(&initial_waits));
+
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(zx_system_get_page_size(), 0, &vmo));
+  zx::stream stream;
+  ASSERT_OK(zx::stream::create(ZX_STREAM_MODE_READ, vmo, 0, &stream));
+
+  // Two threads seeking the same stream will eventually find its seek lock
+  // held by the other, and each such wait must be counted.
+  constexpr int kRounds = 100;
+  constexpr int kSeeksPerRound = 10000;
+  uint64_t waits = initial_waits;
+  for (int round = 0; round < kRounds && waits == initial_waits; round++) {
+    auto Seek = [&stream]() {
+      for (int i = 0; i < kSeeksPerRound; i++) {
+        ZX_ASSERT(stream.seek(ZX_STREAM_SEEK_ORIGIN_START, 0, nullptr) == ZX_OK);
+      }
+    };
+    std::thread other(Seek);
+    Seek();
+    other.join();
+    ASSERT_NO_FATAL_FAILURE(GetWaitCount(&waits));
+  }
+
+  if (!names_available) {
+    ZXTEST_SKIP("Kernel lock class names not available, skipping");
+  }
+  EXPECT_GT(waits, initial_waits);
+}
+
 }  // namespace
@@ -16,6 +16,7 @@
 #include <zircon/testonly-syscalls.h>
 #include <zircon/threads.h>
 
+#include <atomic>
 #include <mutex>
 #include <thread>
 
@@ -33,6 +34,8 @@ extern "C" void store_one();
 extern "C" void wait_then_syscall();
 extern "C" void load_fpu_registers(void* in);
 extern "C" void store_fpu_registers(void* out);
+extern "C" void upcall_spin();
+extern "C" void upcall_spin_handler();
 
 // The normal-mode view of restricted-mode state will change slightly depending on
 // if the exit to normal-mode was caused by a syscall or an exception.
@@ -642,99 +645,214 @@ void ReadExceptionFromChannel(const zx::channel& exception_channel,
       exception.set_property(ZX_PROP_EXCEPTION_STATE, &kExceptionState, sizeof(kExceptionState)));
 }
 
-// This is a simple benchmark test that prints some rough performance numbers.
-TEST(RestrictedMode, Bench) {
-  // Run the test 5 times to help filter out noise.
-  for (auto i = 0; i < 5; i++) {
-    zx::vmo vmo;
-    ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
-    auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+// The benchmarks below print rough numbers for the cost of each kind of transition between normal
+// and restricted mode. Each one is run a few times to help filter out noise.
+constexpr int kBenchRuns = 5;
 
-    // Set the state.
+#if defined(__x86_64__)
+constexpr char kBenchArch[] = "x64";
+#elif defined(__aarch64__)
+constexpr char kBenchArch[] = "arm64";
+#elif defined(__riscv)
+constexpr char kBenchArch[] = "riscv64";
+#endif
+
+void PrintBenchResult(const char* name, zx::ticks elapsed, int iter) {
+  printf("[%s] %s: %ld ns per round trip (%ld raw ticks), %d iters\n", kBenchArch, name,
+         elapsed / iter * ZX_SEC(1) / zx::ticks::per_second(), elapsed.get(), iter);
+}
+
+// Calls |round_trip| repeatedly for a second and prints the average time it took.
+template <typename F>
+void RunBench(const char* name, F round_trip) {
+  auto t = zx::ticks::now();
+  auto deadline = t + zx::ticks::per_second();
+  int iter = 0;
+  while (zx::ticks::now() <= deadline) {
+    ASSERT_NO_FATAL_FAILURE(round_trip());
+    iter++;
+  }
+  PrintBenchResult(name, zx::ticks::now() - t, iter);
+}
+
+// Binds a restricted state to the current thread and points it at |pc|, in the scope of an object.
+class BenchState {
+ public:
+  explicit BenchState(void (*pc)()) {
+    ZX_ASSERT(zx_restricted_bind_state(0, vmo_.reset_and_get_address()) == ZX_OK);
     ArchRegisterState state;
     state.InitializeRegisters();
-    state.set_pc(reinterpret_cast<uintptr_t>(syscall_bounce));
-    ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+    state.set_pc(reinterpret_cast<uintptr_t>(pc));
+    ZX_ASSERT(vmo_.write(&state.restricted_state(), 0, sizeof(state.restricted_state())) == ZX_OK);
+  }
+  ~BenchState() { EXPECT_OK(zx_restricted_unbind_state(0)); }
 
-    // Go through a full restricted syscall entry/exit cycle iter times and show the time.
-    {
+ private:
+  zx::vmo vmo_;
+};
+
+// A restricted mode syscall, which is what a runtime forwarding guest syscalls pays for each one.
+TEST(RestrictedMode, BenchSyscall) {
+  for (int i = 0; i < kBenchRuns; i++) {
+    BenchState bench_state(syscall_bounce);
+    RunBench("restricted syscall", []() {
       zx_restricted_reason_t reason_code;
-      auto t = zx::ticks::now();
-      auto deadline = t + zx::ticks::per_second();
-      int iter = 0;
-      while (zx::ticks::now() <= deadline) {
-        ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
-        iter++;
-      }
-      t = zx::ticks::now() - t;
+      ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+      ASSERT_EQ(reason_code, ZX_RESTRICTED_REASON_SYSCALL);
+    });
 
-      printf("restricted call %ld ns per round trip (%ld raw ticks), %d iters\n",
-             t / iter * ZX_SEC(1) / zx::ticks::per_second(), t.get(), iter);
-    }
+    // For way of comparison, time a null syscall.
+    RunBench("test syscall", []() { ASSERT_OK(zx_syscall_test_0()); });
+  }
+}
 
-    {
-      // For way of comparison, time a null syscall.
-      auto t = zx::ticks::now();
+// A restricted mode exception handled in-thread, in normal mode.
+TEST(RestrictedMode, BenchInThreadException) {
+  for (int i = 0; i < kBenchRuns; i++) {
+    BenchState bench_state(exception_bounce_exception_address);
+    RunBench("in-thread exception", []() {
+      zx_restricted_reason_t reason_code;
+      ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+      ASSERT_EQ(reason_code, ZX_RESTRICTED_REASON_EXCEPTION);
+    });
+  }
+}
+
+// A restricted mode exception handled through an exception channel, by another thread.
+TEST(RestrictedMode, BenchChannelException) {
+  for (int i = 0; i < kBenchRuns; i++) {
+    BenchState bench_state(exception_bounce_exception_address);
+
+    zx::ticks t;
+    int iter = 0;
+    zx::channel exception_channel;
+    ASSERT_OK(zx::process::self()->create_exception_channel(0, &exception_channel));
+    std::thread exception_handler([&]() {
+      t = zx::ticks::now();
       auto deadline = t + zx::ticks::per_second();
-      int iter = 0;
-      while (zx::ticks::now() <= deadline) {
-        ASSERT_OK(zx_syscall_test_0());
+      bool done;
+      do {
+        auto now = zx::ticks::now();
+        done = now > deadline;
+        zx_thread_state_general_regs_t general_regs = {};
+        ReadExceptionFromChannel(exception_channel, general_regs, done);
         iter++;
-      }
+      } while (!done);
       t = zx::ticks::now() - t;
+    });
+    // Iteration happens in the handler thread; we only have a single restricted_enter
+    // when using channel-based exception handling.
+    zx_restricted_reason_t reason_code;
+    ASSERT_OK(restricted_enter_wrapper(ZX_RESTRICTED_OPT_EXCEPTION_CHANNEL, (uintptr_t)vectab,
+                                       &reason_code));
+    exception_handler.join();
 
-      printf("test syscall %ld ns per call (%ld raw ticks), %d iters\n",
-             t / iter * ZX_SEC(1) / zx::ticks::per_second(), t.get(), iter);
-    }
+    PrintBenchResult("channel-based exception", t, iter);
+  }
+}
 
-    // Perform channel-based exception handling.
-    {
-      zx::ticks t;
-      int iter = 0;
+// An entry that is turned around by a pending kick, which returns to normal mode without running
+// any restricted mode code.
+TEST(RestrictedMode, BenchKickedEnter) {
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  for (int i = 0; i < kBenchRuns; i++) {
+    BenchState bench_state(syscall_bounce);
+    RunBench("kicked enter", [&current_thread]() {
+      ASSERT_OK(zx_restricted_kick(current_thread->get(), 0));
       zx_restricted_reason_t reason_code;
+      ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+      ASSERT_EQ(reason_code, ZX_RESTRICTED_REASON_KICK);
+    });
+  }
+}
 
-      zx::channel exception_channel;
-      ZX_ASSERT(zx::process::self()->create_exception_channel(0, &exception_channel) == ZX_OK);
-      std::thread exception_handler([&]() {
-        t = zx::ticks::now();
-        auto deadline = t + zx::ticks::per_second();
-        bool done;
-        do {
-          auto now = zx::ticks::now();
-          done = now > deadline;
-          zx_thread_state_general_regs_t general_regs = {};
-          ReadExceptionFromChannel(exception_channel, general_regs, done);
-          iter++;
-        } while (!done);
-        t = zx::ticks::now() - t;
-      });
-      state.set_pc(reinterpret_cast<uintptr_t>(exception_bounce_exception_address));
+// Maps the upcall mailbox of a restricted state VMO, in the scope of an object. Restricted mode
+// shares the normal mode address space in these tests, so both see the mailbox at the same address.
+class UpcallMailbox {
+ public:
+  explicit UpcallMailbox(const zx::vmo& vmo) {
+    ZX_ASSERT(zx::vmar::root_self()->map(ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, vmo, 0,
+                                         zx_system_get_page_size(), &addr_) == ZX_OK);
+  }
+  ~UpcallMailbox() { EXPECT_OK(zx::vmar::root_self()->unmap(addr_, zx_system_get_page_size())); }
+
+  zx_restricted_upcall_mailbox_t* get() const {
+    return reinterpret_cast<zx_restricted_upcall_mailbox_t*>(addr_ +
+                                                             ZX_RESTRICTED_UPCALL_MAILBOX_OFFSET);
+  }
+
+  void set_handler(void (*handler)()) {
+    std::atomic_ref(get()->handler).store(reinterpret_cast<uintptr_t>(handler));
+  }
+  uint64_t interrupted_pc() const { return std::atomic_ref(get()->interrupted_pc).load(); }
+  uint32_t active() const { return std::atomic_ref(get()->active).load(); }
+
+ private:
+  zx_vaddr_t addr_ = 0;
+};
+
+// Points |state| at upcall_spin, with the arguments it expects.
+void SetUpcallSpinArgs(ArchRegisterState& state, UpcallMailbox& mailbox,
+                       std::atomic<uint64_t>& counter) {
+  state.set_pc(reinterpret_cast<uintptr_t>(upcall_spin));
+#if defined(__x86_64__)
+  state.restricted_state().rdi = reinterpret_cast<uint64_t>(mailbox.get());
+  state.restricted_state().rsi = reinterpret_cast<uint64_t>(&counter);
+#elif defined(__aarch64__)  // defined(__x86_64__)
+  state.restricted_state().x[0] = reinterpret_cast<uint64_t>(mailbox.get());
+  state.restricted_state().x[1] = reinterpret_cast<uint64_t>(&counter);
+#elif defined(__riscv)      // defined(__aarch64__)
+  state.restricted_state().a0 = reinterpret_cast<uint64_t>(mailbox.get());
+  state.restricted_state().a1 = reinterpret_cast<uint64_t>(&counter);
+#endif                      // defined(__riscv)
+}
+
+// The latency of getting a thread that is running in restricted mode to react to an event raised
+// by another thread, through an upcall and, for comparison, through a kick and a new entry.
+TEST(RestrictedMode, BenchUpcall) {
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  for (int i = 0; i < kBenchRuns; i++) {
+    for (const bool upcall : {true, false}) {
+      zx::vmo vmo;
+      ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
+      auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+      UpcallMailbox mailbox(vmo);
+      mailbox.set_handler(upcall_spin_handler);
+
+      std::atomic<uint64_t> counter = 0;
+      ArchRegisterState state;
+      state.InitializeRegisters();
+      SetUpcallSpinArgs(state, mailbox, counter);
       ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
-      // Iteration happens in the handler thread; we only have a single restricted_enter
-      // when using channel-based exception handling.
-      ASSERT_OK(restricted_enter_wrapper(ZX_RESTRICTED_OPT_EXCEPTION_CHANNEL, (uintptr_t)vectab,
-                                         &reason_code));
-      exception_handler.join();
-
-      printf("channel-based exceptions %ld ns per round trip (%ld raw ticks) %d iters\n",
-             t / iter * ZX_SEC(1) / zx::ticks::per_second(), t.get(), iter);
-    }
 
-    // In-thread exception handling
-    auto t = zx::ticks::now();
-    auto deadline = t + zx::ticks::per_second();
-    int iter = 0;
-    zx_restricted_reason_t reason_code;
-    state.set_pc(reinterpret_cast<uintptr_t>(exception_bounce_exception_address));
-    ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
-    while (zx::ticks::now() <= deadline) {
-      ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
-      iter++;
-    }
-    t = zx::ticks::now() - t;
+      std::atomic_bool done = false;
+      std::thread sender([&]() {
+        RunBench(upcall ? "upcall" : "kick and re-enter", [&]() {
+          const uint64_t before = counter.load();
+          ASSERT_OK(zx_restricted_kick(current_thread->get(),
+                                       upcall ? ZX_RESTRICTED_KICK_OPT_UPCALL : 0));
+          while (counter.load() == before) {
+          }
+        });
+        done = true;
+        // Kick the thread out of restricted mode for good.
+        ASSERT_OK(zx_restricted_kick(current_thread->get(), 0));
+      });
 
-    printf("in-thread exceptions %ld ns per round trip (%ld raw ticks) %d iters\n",
-           t / iter * ZX_SEC(1) / zx::ticks::per_second(), t.get(), iter);
+      // In the kick variant, it is the normal mode side of this thread that counts the events. The
+      // sender only sets |done| once the last of those has been counted, so the kick that follows
+      // is the one we see with |done| set.
+      while (true) {
+        zx_restricted_reason_t reason_code;
+        ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+        ASSERT_EQ(reason_code, ZX_RESTRICTED_REASON_KICK);
+        if (done) {
+          break;
+        }
+        counter++;
+      }
+      sender.join();
+    }
   }
 }
 
@@ -1165,3 +1283,115 @@ TEST(RestrictedMode, KickJustBeforeSyscall) {
   EXPECT_EQ(ZX_RESTRICTED_REASON_KICK, reason_code);
   kicker.join();
 }
+
+// An upcall to a thread without an upcall handler is delivered as a kick.
+TEST(RestrictedMode, UpcallWithoutHandlerIsAKick) {
+  zx::vmo vmo;
+  ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
+  auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+
+  ArchRegisterState state;
+  state.InitializeRegisters();
+  state.set_pc(reinterpret_cast<uintptr_t>(syscall_bounce));
+  ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  ASSERT_OK(zx_restricted_kick(current_thread->get(), ZX_RESTRICTED_KICK_OPT_UPCALL));
+
+  zx_restricted_reason_t reason_code = 99;
+  ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+  EXPECT_EQ(reason_code, ZX_RESTRICTED_REASON_KICK);
+
+  // The upcall was consumed by the kick.
+  ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+  EXPECT_EQ(reason_code, ZX_RESTRICTED_REASON_SYSCALL);
+}
+
+// An upcall raised while the thread is in normal mode runs the handler as the thread next enters
+// restricted mode.
+TEST(RestrictedMode, UpcallBeforeEnter) {
+  zx::vmo vmo;
+  ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
+  auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+  UpcallMailbox mailbox(vmo);
+  mailbox.set_handler(syscall_bounce);
+
+  ArchRegisterState state;
+  state.InitializeRegisters();
+  state.set_pc(reinterpret_cast<uintptr_t>(store_one));
+  ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  ASSERT_OK(zx_restricted_kick(current_thread->get(), ZX_RESTRICTED_KICK_OPT_UPCALL));
+
+  zx_restricted_reason_t reason_code = 99;
+  ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+  EXPECT_EQ(reason_code, ZX_RESTRICTED_REASON_SYSCALL);
+
+  // The handler ran instead of store_one, and was told where the thread was headed.
+  ASSERT_OK(vmo.read(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+  EXPECT_EQ(state.pc(), reinterpret_cast<uintptr_t>(syscall_bounce_post_syscall));
+  EXPECT_EQ(mailbox.interrupted_pc(), reinterpret_cast<uintptr_t>(store_one));
+  EXPECT_EQ(mailbox.active(), 1u);
+}
+
+// Upcalls are not delivered while the handler is still active.
+TEST(RestrictedMode, UpcallWhileActiveIsDropped) {
+  zx::vmo vmo;
+  ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
+  auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+  UpcallMailbox mailbox(vmo);
+  mailbox.set_handler(exception_bounce_exception_address);
+  std::atomic_ref(mailbox.get()->active).store(1);
+
+  ArchRegisterState state;
+  state.InitializeRegisters();
+  state.set_pc(reinterpret_cast<uintptr_t>(syscall_bounce));
+  ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  ASSERT_OK(zx_restricted_kick(current_thread->get(), ZX_RESTRICTED_KICK_OPT_UPCALL));
+
+  zx_restricted_reason_t reason_code = 99;
+  ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+  EXPECT_EQ(reason_code, ZX_RESTRICTED_REASON_SYSCALL);
+  EXPECT_EQ(mailbox.interrupted_pc(), 0u);
+  EXPECT_EQ(mailbox.active(), 1u);
+}
+
+// Upcalls interrupt a thread running in restricted mode without it leaving restricted mode.
+TEST(RestrictedMode, UpcallWhileRunning) {
+  zx::vmo vmo;
+  ASSERT_OK(zx_restricted_bind_state(0, vmo.reset_and_get_address()));
+  auto cleanup = fit::defer([]() { EXPECT_OK(zx_restricted_unbind_state(0)); });
+  UpcallMailbox mailbox(vmo);
+  mailbox.set_handler(upcall_spin_handler);
+
+  std::atomic<uint64_t> counter = 0;
+  ArchRegisterState state;
+  state.InitializeRegisters();
+  SetUpcallSpinArgs(state, mailbox, counter);
+  ASSERT_OK(vmo.write(&state.restricted_state(), 0, sizeof(state.restricted_state())));
+
+  zx::unowned<zx::thread> current_thread(thrd_get_zx_handle(thrd_current()));
+  constexpr uint64_t kUpcalls = 100;
+  std::thread sender([&counter, &current_thread] {
+    // Wait for each upcall to be handled before raising the next, as upcalls raised while the
+    // handler is active are dropped.
+    for (uint64_t i = 0; i < kUpcalls; i++) {
+      ASSERT_OK(zx_restricted_kick(current_thread->get(), ZX_RESTRICTED_KICK_OPT_UPCALL));
+      while (counter.load() == i) {
+      }
+    }
+    ASSERT_OK(zx_restricted_kick(current_thread->get(), 0));
+  });
+
+  zx_restricted_reason_t reason_code = 99;
+  ASSERT_OK(restricted_enter_wrapper(0, (uintptr_t)vectab, &reason_code));
+  EXPECT_EQ(reason_code, ZX_RESTRICTED_REASON_KICK);
+  sender.join();
+
+  // Every upcall was handled within the one entry.
+  EXPECT_EQ(counter.load(), kUpcalls);
+  EXPECT_EQ(mailbox.active(), 0u);
+}
@@ -0,0 +1,185 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/vmo.h>
+#include <zircon/errors.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/syscalls.h>
+
+#include <array>
+#include <numeric>
+#include <vector>
+
+#include <zxtest/zxtest.h>
+
+namespace {
+
+// Creates a VMO of |size| bytes where the byte at each offset holds the low bits of that offset.
+zx::vmo CreatePatternVmo(size_t size) {
+  zx::vmo vmo;
+  EXPECT_OK(zx::vmo::create(size, 0, &vmo));
+  std::vector<uint8_t> data(size);
+  std::iota(data.begin(), data.end(), 0);
+  EXPECT_OK(vmo.write(data.data(), 0, size));
+  return vmo;
+}
+
+TEST(VmoVectorTest, ReadGathersRanges) {
+  const size_t kPageSize = zx_system_get_page_size();
+  zx::vmo vmo = CreatePatternVmo(kPageSize * 4);
+
+  std::array<uint8_t, 8> a;
+  std::array<uint8_t, 16> b;
+  std::array<uint8_t, 4> c;
+  // Out of order, and with one range straddling a page boundary.
+  const zx_vmo_io_t vec[] = {
+      {.offset = kPageSize * 3 + 5, .buffer = a.data(), .length = a.size()},
+      {.offset = kPageSize - 8, .buffer = b.data(), .length = b.size()},
+      {.offset = 1, .buffer = c.data(), .length = c.size()},
+  };
+  ASSERT_OK(zx_vmo_read_vector(vmo.get(), 0, vec, std::size(vec)));
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a[i], static_cast<uint8_t>(kPageSize * 3 + 5 + i));
+  }
+  for (size_t i = 0; i < b.size(); ++i) {
+    EXPECT_EQ(b[i], static_cast<uint8_t>(kPageSize - 8 + i));
+  }
+  for (size_t i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(c[i], static_cast<uint8_t>(1 + i));
+  }
+}
+
+TEST(VmoVectorTest, WriteScattersRanges) {
+  const size_t kPageSize = zx_system_get_page_size();
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(kPageSize * 4, 0, &vmo));
+
+  std::array<uint8_t, 3> a = {1, 2, 3};
+  std::array<uint8_t, 2> b = {4, 5};
+  const zx_vmo_io_t vec[] = {
+      {.offset = kPageSize * 2, .buffer = a.data(), .length = a.size()},
+      {.offset = 10, .buffer = b.data(), .length = b.size()},
+  };
+  ASSERT_OK(zx_vmo_write_vector(vmo.get(), 0, vec, std::size(vec)));
+
+  std::array<uint8_t, 3> got_a;
+  ASSERT_OK(vmo.read(got_a.data(), kPageSize * 2, got_a.size()));
+  EXPECT_BYTES_EQ(got_a.data(), a.data(), a.size());
+  std::array<uint8_t, 4> got_b;
+  ASSERT_OK(vmo.read(got_b.data(), 9, got_b.size()));
+  const std::array<uint8_t, 4> expected_b = {0, 4, 5, 0};
+  EXPECT_BYTES_EQ(got_b.data(), expected_b.data(), expected_b.size());
+}
+
+TEST(VmoVectorTest, OverlappingWritesApplyInOrder) {
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(zx_system_get_page_size(), 0, &vmo));
+
+  std::array<uint8_t, 4> first = {1, 1, 1, 1};
+  std::array<uint8_t, 2> second = {2, 2};
+  const zx_vmo_io_t vec[] = {
+      {.offset = 0, .buffer = first.data(), .length = first.size()},
+      {.offset = 1, .buffer = second.data(), .length = second.size()},
+  };
+  ASSERT_OK(zx_vmo_write_vector(vmo.get(), 0, vec, std::size(vec)));
+
+  std::array<uint8_t, 4> got;
+  ASSERT_OK(vmo.read(got.data(), 0, got.size()));
+  const std::array<uint8_t, 4> expected = {1, 2, 2, 1};
+  EXPECT_BYTES_EQ(got.data(), expected.data(), expected.size());
+}
+
+// The kernel copies the vector in in batches, so make sure a long one is processed in full.
+TEST(VmoVectorTest, LongVector) {
+  constexpr size_t kCount = 100;
+  zx::vmo vmo = CreatePatternVmo(zx_system_get_page_size());
+
+  std::array<uint8_t, kCount> bytes;
+  std::vector<zx_vmo_io_t> vec;
+  for (size_t i = 0; i < kCount; ++i) {
+    // Read every other byte, last to first.
+    vec.push_back({.offset = (kCount - 1 - i) * 2, .buffer = &bytes[i], .length = 1});
+  }
+  ASSERT_OK(zx_vmo_read_vector(vmo.get(), 0, vec.data(), vec.size()));
+  for (size_t i = 0; i < kCount; ++i) {
+    EXPECT_EQ(bytes[i], static_cast<uint8_t>((kCount - 1 - i) * 2));
+  }
+
+  bytes.fill(0xff);
+  ASSERT_OK(zx_vmo_write_vector(vmo.get(), 0, vec.data(), vec.size()));
+  std::array<uint8_t, kCount * 2> got;
+  ASSERT_OK(vmo.read(got.data(), 0, got.size()));
+  for (size_t i = 0; i < got.size(); ++i) {
+    EXPECT_EQ(got[i], i % 2 == 0 ? 0xff : static_cast<uint8_t>(i));
+  }
+}
+
+TEST(VmoVectorTest, EmptyVector) {
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(zx_system_get_page_size(), 0, &vmo));
+  EXPECT_OK(zx_vmo_read_vector(vmo.get(), 0, nullptr, 0));
+  EXPECT_OK(zx_vmo_write_vector(vmo.get(), 0, nullptr, 0));
+}
+
+TEST(VmoVectorTest, StopsAtFirstFailure) {
+  const size_t kPageSize = zx_system_get_page_size();
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(kPageSize, 0, &vmo));
+
+  std::array<uint8_t, 2> data = {7, 7};
+  const zx_vmo_io_t vec[] = {
+      {.offset = 0, .buffer = data.data(), .length = data.size()},
+      {.offset = kPageSize - 1, .buffer = data.data(), .length = data.size()},
+      {.offset = 4, .buffer = data.data(), .length = data.size()},
+  };
+  EXPECT_STATUS(zx_vmo_write_vector(vmo.get(), 0, vec, std::size(vec)), ZX_ERR_OUT_OF_RANGE);
+
+  std::array<uint8_t, 6> got;
+  ASSERT_OK(vmo.read(got.data(), 0, got.size()));
+  const std::array<uint8_t, 6> expected = {7, 7, 0, 0, 0, 0};
+  EXPECT_BYTES_EQ(got.data(), expected.data(), expected.size());
+
+  EXPECT_STATUS(zx_vmo_read_vector(vmo.get(), 0, vec, std::size(vec)), ZX_ERR_OUT_OF_RANGE);
+}
+
+TEST(VmoVectorTest, BadArguments) {
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(zx_system_get_page_size(), 0, &vmo));
+
+  uint8_t byte = 0;
+  zx_vmo_io_t vec = {.offset = 0, .buffer = &byte, .length = 1};
+  EXPECT_STATUS(zx_vmo_read_vector(vmo.get(), 1, &vec, 1), ZX_ERR_INVALID_ARGS);
+  EXPECT_STATUS(zx_vmo_write_vector(vmo.get(), 1, &vec, 1), ZX_ERR_INVALID_ARGS);
+
+  EXPECT_STATUS(zx_vmo_read_vector(vmo.get(), 0, nullptr, 1), ZX_ERR_INVALID_ARGS);
+  EXPECT_STATUS(zx_vmo_write_vector(vmo.get(), 0, nullptr, 1), ZX_ERR_INVALID_ARGS);
+
+  vec.buffer = nullptr;
+  EXPECT_NOT_OK(zx_vmo_read_vector(vmo.get(), 0, &vec, 1));
+  EXPECT_NOT_OK(zx_vmo_write_vector(vmo.get(), 0, &vec, 1));
+
+  EXPECT_STATUS(zx_vmo_read_vector(ZX_HANDLE_INVALID, 0, nullptr, 0), ZX_ERR_BAD_HANDLE);
+}
+
+TEST(VmoVectorTest, Rights) {
+  zx::vmo vmo;
+  ASSERT_OK(zx::vmo::create(zx_system_get_page_size(), 0, &vmo));
+
+  uint8_t byte = 0;
+  const zx_vmo_io_t vec = {.offset = 0, .buffer = &byte, .length = 1};
+
+  zx::vmo read_only;
+  ASSERT_OK(vmo.duplicate(ZX_RIGHTS_BASIC | ZX_RIGHT_READ, &read_only));
+  EXPECT_OK(zx_vmo_read_vector(read_only.get(), 0, &vec, 1));
+  EXPECT_STATUS(zx_vmo_write_vector(read_only.get(), 0, &vec, 1), ZX_ERR_ACCESS_DENIED);
+
+  zx::vmo write_only;
+  ASSERT_OK(vmo.duplicate(ZX_RIGHTS_BASIC | ZX_RIGHT_WRITE, &write_only));
+  EXPECT_STATUS(zx_vmo_read_vector(write_only.get(), 0, &vec, 1), ZX_ERR_ACCESS_DENIED);
+  EXPECT_OK(zx_vmo_write_vector(write_only.get(), 0, &vec, 1));
+}
+
+}  // namespace
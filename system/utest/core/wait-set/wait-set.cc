@@ -0,0 +1,292 @@
+// Copyright 2024 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/channel.h>
+#include <lib/zx/event.h>
+#include <lib/zx/eventpair.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/time.h>
+#include <zircon/errors.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls-next.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <vector>
+
+#include <zxtest/zxtest.h>
+
+namespace {
+
+zx::handle CreateWaitSet() {
+  zx::handle wait_set;
+  EXPECT_OK(zx_wait_set_create(0, wait_set.reset_and_get_address()));
+  return wait_set;
+}
+
+// Waits on |wait_set| without blocking, and returns the keys reported.
+std::vector<uint64_t> PollKeys(const zx::handle& wait_set, size_t count) {
+  std::vector<zx_wait_set_result_t> results(count);
+  size_t actual = 0;
+  zx_status_t status = zx_wait_set_wait(wait_set.get(), 0, results.data(), count, &actual);
+  std::vector<uint64_t> keys;
+  if (status == ZX_OK) {
+    for (size_t i = 0; i < actual; ++i) {
+      keys.push_back(results[i].key);
+    }
+  } else {
+    EXPECT_STATUS(status, ZX_ERR_TIMED_OUT);
+  }
+  return keys;
+}
+
+TEST(WaitSetTest, CreateRejectsOptions) {
+  zx::handle wait_set;
+  EXPECT_STATUS(zx_wait_set_create(1, wait_set.reset_and_get_address()), ZX_ERR_INVALID_ARGS);
+}
+
+TEST(WaitSetTest, AddAndRemove) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+  EXPECT_STATUS(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0),
+                ZX_ERR_ALREADY_EXISTS);
+  // The same object may be registered under several keys.
+  EXPECT_OK(zx_wait_set_add(wait_set.get(), event.get(), 2, ZX_EVENT_SIGNALED, 0));
+
+  EXPECT_OK(zx_wait_set_remove(wait_set.get(), 1));
+  EXPECT_STATUS(zx_wait_set_remove(wait_set.get(), 1), ZX_ERR_NOT_FOUND);
+  EXPECT_OK(zx_wait_set_remove(wait_set.get(), 2));
+}
+
+TEST(WaitSetTest, BadArguments) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+
+  EXPECT_STATUS(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 1),
+                ZX_ERR_INVALID_ARGS);
+  EXPECT_STATUS(zx_wait_set_add(wait_set.get(), ZX_HANDLE_INVALID, 1, ZX_EVENT_SIGNALED, 0),
+                ZX_ERR_BAD_HANDLE);
+  EXPECT_STATUS(zx_wait_set_add(event.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0),
+                ZX_ERR_WRONG_TYPE);
+
+  // Wait sets themselves cannot be waited on, and so cannot be nested.
+  zx::handle other = CreateWaitSet();
+  EXPECT_STATUS(zx_wait_set_add(wait_set.get(), other.get(), 1, ZX_SIGNAL_NONE, 0),
+                ZX_ERR_ACCESS_DENIED);
+
+  zx::event no_wait;
+  ASSERT_OK(event.duplicate(ZX_DEFAULT_EVENT_RIGHTS & ~ZX_RIGHT_WAIT, &no_wait));
+  EXPECT_STATUS(zx_wait_set_add(wait_set.get(), no_wait.get(), 1, ZX_EVENT_SIGNALED, 0),
+                ZX_ERR_ACCESS_DENIED);
+
+  zx::handle read_only;
+  ASSERT_OK(wait_set.duplicate(ZX_RIGHT_READ, &read_only));
+  EXPECT_STATUS(zx_wait_set_add(read_only.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0),
+                ZX_ERR_ACCESS_DENIED);
+  EXPECT_STATUS(zx_wait_set_remove(read_only.get(), 1), ZX_ERR_ACCESS_DENIED);
+
+  zx_wait_set_result_t result;
+  size_t actual;
+  EXPECT_STATUS(zx_wait_set_wait(wait_set.get(), 0, &result, 0, &actual), ZX_ERR_INVALID_ARGS);
+
+  zx::handle write_only;
+  ASSERT_OK(wait_set.duplicate(ZX_RIGHT_WRITE, &write_only));
+  EXPECT_STATUS(zx_wait_set_wait(write_only.get(), 0, &result, 1, &actual),
+                ZX_ERR_ACCESS_DENIED);
+}
+
+TEST(WaitSetTest, WaitTimesOutWhenNothingIsReady) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+
+  zx_wait_set_result_t result;
+  size_t actual;
+  EXPECT_STATUS(zx_wait_set_wait(wait_set.get(), zx::deadline_after(zx::msec(1)).get(), &result,
+                                 1, &actual),
+                ZX_ERR_TIMED_OUT);
+
+  // An empty set simply times out as well.
+  zx::handle empty = CreateWaitSet();
+  EXPECT_STATUS(zx_wait_set_wait(empty.get(), 0, &result, 1, &actual), ZX_ERR_TIMED_OUT);
+}
+
+TEST(WaitSetTest, ReportsOnlyReadyEntries) {
+  constexpr size_t kNumEvents = 256;
+  zx::handle wait_set = CreateWaitSet();
+  std::vector<zx::event> events(kNumEvents);
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    ASSERT_OK(zx::event::create(0, &events[i]));
+    ASSERT_OK(zx_wait_set_add(wait_set.get(), events[i].get(), i, ZX_EVENT_SIGNALED, 0));
+  }
+
+  // An entry is only reported for the signals it was registered for.
+  ASSERT_OK(events[7].signal(0, ZX_USER_SIGNAL_0));
+  EXPECT_TRUE(PollKeys(wait_set, 8).empty());
+
+  ASSERT_OK(events[3].signal(0, ZX_EVENT_SIGNALED));
+  ASSERT_OK(events[100].signal(0, ZX_EVENT_SIGNALED));
+  ASSERT_OK(events[255].signal(0, ZX_EVENT_SIGNALED));
+
+  zx_wait_set_result_t results[8];
+  size_t actual = 0;
+  ASSERT_OK(zx_wait_set_wait(wait_set.get(), ZX_TIME_INFINITE, results, std::size(results),
+                             &actual));
+  ASSERT_EQ(actual, 3u);
+  std::vector<uint64_t> keys;
+  for (size_t i = 0; i < actual; ++i) {
+    EXPECT_EQ(results[i].pending & ZX_EVENT_SIGNALED, ZX_EVENT_SIGNALED);
+    EXPECT_EQ(results[i].reserved, 0u);
+    keys.push_back(results[i].key);
+  }
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys, (std::vector<uint64_t>{3, 100, 255}));
+}
+
+TEST(WaitSetTest, EntriesAreLevelTriggered) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 42, ZX_EVENT_SIGNALED, 0));
+
+  ASSERT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(PollKeys(wait_set, 4), (std::vector<uint64_t>{42}));
+  }
+
+  // Once the signal is deasserted, the entry is no longer reported, even if it
+  // was still on the ready list.
+  ASSERT_OK(event.signal(ZX_EVENT_SIGNALED, 0));
+  EXPECT_TRUE(PollKeys(wait_set, 4).empty());
+
+  ASSERT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+  EXPECT_EQ(PollKeys(wait_set, 4), (std::vector<uint64_t>{42}));
+}
+
+TEST(WaitSetTest, ReadyEntriesTakeTurns) {
+  zx::handle wait_set = CreateWaitSet();
+  std::array<zx::event, 4> events;
+  for (size_t i = 0; i < events.size(); ++i) {
+    ASSERT_OK(zx::event::create(0, &events[i]));
+    ASSERT_OK(events[i].signal(0, ZX_EVENT_SIGNALED));
+    ASSERT_OK(zx_wait_set_add(wait_set.get(), events[i].get(), i, ZX_EVENT_SIGNALED, 0));
+  }
+
+  // With room for only two results per wait, the entries that stay ready
+  // must still all be reported in turn.
+  std::vector<uint64_t> keys = PollKeys(wait_set, 2);
+  ASSERT_EQ(keys.size(), 2u);
+  std::vector<uint64_t> more = PollKeys(wait_set, 2);
+  ASSERT_EQ(more.size(), 2u);
+  keys.insert(keys.end(), more.begin(), more.end());
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys, (std::vector<uint64_t>{0, 1, 2, 3}));
+}
+
+TEST(WaitSetTest, RemovedEntriesAreNotReported) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+  ASSERT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+
+  ASSERT_OK(zx_wait_set_remove(wait_set.get(), 1));
+  EXPECT_TRUE(PollKeys(wait_set, 1).empty());
+}
+
+TEST(WaitSetTest, ClosingHandleRemovesEntry) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+  zx::event duplicate;
+  ASSERT_OK(event.duplicate(ZX_RIGHT_SAME_RIGHTS, &duplicate));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), duplicate.get(), 2, ZX_EVENT_SIGNALED, 0));
+
+  // The entry is tied to the handle that added it, so closing that handle
+  // removes the entry, even though the event is still alive and signaled.
+  event.reset();
+  EXPECT_EQ(PollKeys(wait_set, 2), (std::vector<uint64_t>{2}));
+  EXPECT_STATUS(zx_wait_set_remove(wait_set.get(), 1), ZX_ERR_NOT_FOUND);
+  EXPECT_OK(zx_wait_set_remove(wait_set.get(), 2));
+}
+
+TEST(WaitSetTest, TransferringHandleRemovesEntry) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::channel local, remote;
+  ASSERT_OK(zx::channel::create(0, &local, &remote));
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+
+  zx_handle_t transferred = event.release();
+  ASSERT_OK(local.write(0, nullptr, 0, &transferred, 1));
+  EXPECT_STATUS(zx_wait_set_remove(wait_set.get(), 1), ZX_ERR_NOT_FOUND);
+}
+
+TEST(WaitSetTest, CycleThroughChannelIsReclaimed) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::channel a, b;
+  ASSERT_OK(zx::channel::create(0, &a, &b));
+  // |observed| travels in the same message as the wait set, so |observer| sees
+  // its peer closed once |a| and the messages queued on it are destroyed.
+  zx::eventpair observed, observer;
+  ASSERT_OK(zx::eventpair::create(0, &observed, &observer));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), a.get(), 1, ZX_CHANNEL_READABLE, 0));
+
+  // Queue the last handle to the wait set on |a|. The wait set's entry refers
+  // to |a|, and |a| now holds the wait set, so only tying the entry to the
+  // handle to |a| lets both objects go away.
+  zx_handle_t handles[] = {wait_set.release(), observed.release()};
+  ASSERT_OK(b.write(0, nullptr, 0, handles, std::size(handles)));
+  a.reset();
+  b.reset();
+
+  EXPECT_OK(observer.wait_one(ZX_EVENTPAIR_PEER_CLOSED, zx::time::infinite(), nullptr));
+}
+
+TEST(WaitSetTest, WaitIsWokenBySignal) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 9, ZX_EVENT_SIGNALED, 0));
+
+  std::thread signaler([&event]() {
+    zx::nanosleep(zx::deadline_after(zx::msec(10)));
+    EXPECT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+  });
+
+  zx_wait_set_result_t result;
+  size_t actual = 0;
+  EXPECT_OK(zx_wait_set_wait(wait_set.get(), ZX_TIME_INFINITE, &result, 1, &actual));
+  signaler.join();
+  EXPECT_EQ(actual, 1u);
+  EXPECT_EQ(result.key, 9u);
+}
+
+TEST(WaitSetTest, CloseWithEntries) {
+  zx::handle wait_set = CreateWaitSet();
+  zx::event event;
+  ASSERT_OK(zx::event::create(0, &event));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 1, ZX_EVENT_SIGNALED, 0));
+  ASSERT_OK(zx_wait_set_add(wait_set.get(), event.get(), 2, ZX_USER_SIGNAL_0, 0));
+  ASSERT_OK(event.signal(0, ZX_EVENT_SIGNALED));
+
+  // Closing the set drops its entries, ready or not, and the event is still
+  // usable afterwards.
+  wait_set.reset();
+  EXPECT_OK(event.signal(0, ZX_USER_SIGNAL_0));
+  EXPECT_OK(event.wait_one(ZX_USER_SIGNAL_0, zx::time::infinite_past(), nullptr));
+}
+
+}  // namespace